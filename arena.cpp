@@ -0,0 +1,139 @@
+/*
+Bump allocator holding the buffers of a model in one block of memory
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <cstdlib>
+#endif
+
+#include "arena.h"
+
+static char* AllocateBlock(size_t size)
+{
+#ifdef _WIN32
+	return (char*) _aligned_malloc(size, ARENA_ALIGNMENT);
+#else
+	void* block = NULL;
+	if (posix_memalign(&block, ARENA_ALIGNMENT, size) != 0)
+		return NULL;
+	return (char*) block;
+#endif
+}
+
+static void FreeBlock(char* block)
+{
+#ifdef _WIN32
+	_aligned_free(block);
+#else
+	free(block);
+#endif
+}
+
+MemoryArena::MemoryArena()
+{
+	mData = NULL;
+	mCapacity = mUsed = mOverflowSize = mPeak = 0;
+}
+
+MemoryArena::MemoryArena(MemoryArena&& other)
+{
+	mData = NULL;
+	mCapacity = mUsed = mOverflowSize = mPeak = 0;
+	*this = static_cast<MemoryArena&&>(other);
+}
+
+MemoryArena& MemoryArena::operator=(MemoryArena&& other)
+{
+	if (this != &other)
+	{
+		Release();
+		mData = other.mData;
+		mCapacity = other.mCapacity;
+		mUsed = other.mUsed;
+		mOverflow.swap(other.mOverflow);
+		mOverflowSize = other.mOverflowSize;
+		mPeak = other.mPeak;
+		other.mData = NULL;
+		other.mCapacity = other.mUsed = other.mOverflowSize = other.mPeak = 0;
+	}
+	return *this;
+}
+
+MemoryArena::~MemoryArena()
+{
+	Release();
+}
+
+int MemoryArena::Reserve(size_t size)
+{
+	Reset();
+	if (size <= mCapacity)
+		return 0;
+
+	FreeBlock(mData);
+	mData = AllocateBlock(Align(size));
+	mCapacity = mData != NULL ? Align(size) : 0;
+	return mData != NULL ? 0 : -1;
+}
+
+void* MemoryArena::Allocate(size_t size)
+{
+	char* block;
+
+	size = Align(size > 0 ? size : 1);
+	if (size <= mCapacity - mUsed)
+	{
+		block = mData + mUsed;
+		mUsed += size;
+		if (mUsed + mOverflowSize > mPeak)
+			mPeak = mUsed + mOverflowSize;
+		return block;
+	}
+
+	block = AllocateBlock(size);
+	if (block == NULL)
+		return NULL;
+	mOverflow.push_back(block);
+	mOverflowSize += size;
+	if (mUsed + mOverflowSize > mPeak)
+		mPeak = mUsed + mOverflowSize;
+	return block;
+}
+
+void MemoryArena::Reset()
+{
+	size_t needed = mUsed + mOverflowSize;
+
+	for (size_t i = 0; i < mOverflow.size(); ++i)
+		FreeBlock(mOverflow[i]);
+	mOverflow.clear();
+	mOverflowSize = 0;
+	mUsed = 0;
+
+	if (needed > mCapacity)
+	{
+		FreeBlock(mData);
+		mData = AllocateBlock(needed);
+		mCapacity = mData != NULL ? needed : 0;
+	}
+}
+
+void MemoryArena::Release()
+{
+	for (size_t i = 0; i < mOverflow.size(); ++i)
+		FreeBlock(mOverflow[i]);
+	mOverflow.clear();
+	FreeBlock(mData);
+	mData = NULL;
+	mCapacity = mUsed = mOverflowSize = mPeak = 0;
+}
@@ -0,0 +1,64 @@
+/*
+Bump allocator holding the buffers of a model in one block of memory
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <vector>
+
+//every allocation starts on a cache line
+static const size_t ARENA_ALIGNMENT = 64;
+
+class MemoryArena
+{
+  private:
+	char* mData;		// Main block, NULL until the first allocation
+	size_t mCapacity;
+	size_t mUsed;
+	std::vector<char*> mOverflow;	// Blocks for requests the main block had no room for
+	size_t mOverflowSize;
+	size_t mPeak;		// Most bytes handed out at once since the last ResetPeak or Release
+
+	MemoryArena(const MemoryArena&) = delete;
+	MemoryArena& operator=(const MemoryArena&) = delete;
+
+ public:
+	MemoryArena();
+	MemoryArena(MemoryArena&& other);
+	MemoryArena& operator=(MemoryArena&& other);
+	~MemoryArena();
+
+	//drops all allocations and makes sure the main block holds at least
+	//size bytes, so allocations summing up to size come from one block
+	int Reserve(size_t size);
+
+	//returns uninitialised memory aligned to ARENA_ALIGNMENT, or NULL,
+	//a request that does not fit the main block gets a block of its own
+	void* Allocate(size_t size);
+	template<typename T> inline T* Allocate(size_t count){return (T*) Allocate(count*sizeof(T));};
+
+	//drops all allocations but keeps the memory, a main block that ran out
+	//is grown to what was used so the next round fits in one block
+	void Reset();
+	void Release();		// Frees everything
+
+	inline size_t GetCapacity(){return mCapacity;};
+	inline size_t GetUsed(){return mUsed + mOverflowSize;};
+	inline size_t GetPeak(){return mPeak;};
+	inline void ResetPeak(){mPeak = mUsed + mOverflowSize;};
+
+	//size rounded up so the next allocation stays aligned
+	static inline size_t Align(size_t size){return (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);};
+};
+
+#endif
@@ -0,0 +1,233 @@
+/*
+Benchmark of the BVH build and of closest and any hit ray queries
+
+Builds a latitude/longitude sphere with its vertices shuffled like a scanned
+mesh, times the build on one and on all threads and shoots random rays from
+a surrounding shell at the inside of the sphere. A sample of the rays is
+checked against testing every triangle.
+
+Usage: bvhbench [triangles in millions] [rays in millions] [threads]
+Build: g++ -O2 -std=c++14 -pthread bvhbench.cpp ../meshbvh.cpp
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "../meshbvh.h"
+#include "../parallel.h"
+
+//rays traced per task, so threads do not fight over the counter
+static const long RAY_BLOCK = 4096;
+
+//rays checked against every triangle
+static const long CHECKED_RAYS = 200;
+
+//latitude/longitude sphere with about the requested number of triangles,
+//vertices are shuffled so neighbours are far apart in memory as in scans
+static void MakeSphere(long triangles, std::vector<float> &vertices, std::vector<long> &indices)
+{
+	long rings = (long) sqrt(triangles / 4.0) + 2;
+	long segments = 2*rings;
+	long vertexCount = (rings + 1)*segments;
+	std::vector<long> order(vertexCount);
+	std::mt19937 random(1);
+
+	for (long i = 0; i < vertexCount; ++i)
+		order[i] = i;
+	std::shuffle(order.begin(), order.end(), random);
+
+	vertices.assign(vertexCount*4, 1.0f);
+	for (long r = 0; r <= rings; ++r)
+	{
+		for (long s = 0; s < segments; ++s)
+		{
+			float theta = 3.14159265f*r/rings, phi = 2.0f*3.14159265f*s/segments;
+			float radius = r == 0 || r == rings ? 0.0f : sinf(theta);
+			float* v = &vertices[4*order[r*segments + s]];
+			v[0] = radius*cosf(phi);
+			v[1] = radius*sinf(phi);
+			v[2] = r == rings ? -1.0f : cosf(theta);
+		}
+	}
+
+	indices.clear();
+	for (long r = 0; r < rings; ++r)
+	{
+		for (long s = 0; s < segments; ++s)
+		{
+			long a = order[r*segments + s], b = order[r*segments + (s + 1) % segments];
+			long c = order[(r + 1)*segments + s], d = order[(r + 1)*segments + (s + 1) % segments];
+			long quad[6] = {a, c, b, b, c, d};
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+}
+
+//origin on a shell of radius 3 and direction towards a point within 1.2 of
+//the centre, so most rays hit and some graze past
+static void MakeRays(long count, std::vector<float> &rays)
+{
+	std::mt19937 random(2);
+	std::normal_distribution<float> normal(0.0f, 1.0f);
+	std::uniform_real_distribution<float> uniform(-1.2f, 1.2f);
+
+	rays.resize(count*6);
+	for (long i = 0; i < count; ++i)
+	{
+		float* ray = &rays[6*i];
+		float x = normal(random), y = normal(random), z = normal(random);
+		float length = sqrtf(x*x + y*y + z*z) + 1e-20f;
+
+		ray[0] = 3.0f*x/length;
+		ray[1] = 3.0f*y/length;
+		ray[2] = 3.0f*z/length;
+		for (int k = 0; k < 3; ++k)
+			ray[3 + k] = uniform(random) - ray[k];
+	}
+}
+
+//closest hit by testing every triangle, in double
+static long BruteForce(const std::vector<float> &vertices, const std::vector<long> &indices, const float* ray, double &distance)
+{
+	const float* o = ray;
+	const float* d = ray + 3;
+	long best = -1;
+
+	distance = 1e30;
+	for (size_t t = 0; t < indices.size() / 3; ++t)
+	{
+		const float* p0 = &vertices[4*indices[3*t]];
+		const float* p1 = &vertices[4*indices[3*t + 1]];
+		const float* p2 = &vertices[4*indices[3*t + 2]];
+		double e1[3], e2[3], s[3], p[3], q[3], det, u, v, h;
+
+		for (int i = 0; i < 3; ++i)
+		{
+			e1[i] = p1[i] - p0[i];
+			e2[i] = p2[i] - p0[i];
+			s[i] = o[i] - p0[i];
+		}
+		p[0] = d[1]*e2[2] - d[2]*e2[1];
+		p[1] = d[2]*e2[0] - d[0]*e2[2];
+		p[2] = d[0]*e2[1] - d[1]*e2[0];
+		det = e1[0]*p[0] + e1[1]*p[1] + e1[2]*p[2];
+		if (det == 0.0)
+			continue;
+		u = (s[0]*p[0] + s[1]*p[1] + s[2]*p[2]) / det;
+		q[0] = s[1]*e1[2] - s[2]*e1[1];
+		q[1] = s[2]*e1[0] - s[0]*e1[2];
+		q[2] = s[0]*e1[1] - s[1]*e1[0];
+		v = (d[0]*q[0] + d[1]*q[1] + d[2]*q[2]) / det;
+		h = (e2[0]*q[0] + e2[1]*q[1] + e2[2]*q[2]) / det;
+		if (u >= 0.0 && v >= 0.0 && u + v <= 1.0 && h >= 0.0 && h < distance)
+		{
+			distance = h;
+			best = (long) t;
+		}
+	}
+	return best;
+}
+
+template<typename Run>
+static double BestOf(int repeats, Run run)
+{
+	double best = 1e30;
+	for (int i = 0; i < repeats; ++i)
+	{
+		auto start = std::chrono::steady_clock::now();
+		run();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (ms < best)
+			best = ms;
+	}
+	return best;
+}
+
+//traces every ray in blocks over threads, returns the number of hits
+template<typename Query>
+static long TraceRays(const std::vector<float> &rays, int threads, Query query)
+{
+	long count = (long) rays.size() / 6;
+	std::atomic<long> hits(0);
+
+	ParallelFor((count + RAY_BLOCK - 1) / RAY_BLOCK, threads, [&](long block)
+	{
+		long last = std::min(count, (block + 1)*RAY_BLOCK), blockHits = 0;
+		for (long i = block*RAY_BLOCK; i < last; ++i)
+			blockHits += query(&rays[6*i]) ? 1 : 0;
+		hits += blockHits;
+	});
+	return hits;
+}
+
+int main(int argc, char** argv)
+{
+	double millions = argc > 1 ? atof(argv[1]) : 1.0;
+	double rayMillions = argc > 2 ? atof(argv[2]) : 2.0;
+	int threads = argc > 3 ? atoi(argv[3]) : 0;
+	std::vector<float> vertices, rays;
+	std::vector<long> indices;
+	MeshBVH serial, bvh;
+	long triangleCount, closestHits = 0, anyHits = 0, wrong = 0;
+
+	MakeSphere((long)(millions*1e6), vertices, indices);
+	MakeRays((long)(rayMillions*1e6), rays);
+	triangleCount = (long) indices.size() / 3;
+	printf("%ld triangles, %ld rays, %d threads\n", triangleCount, (long) rays.size() / 6, ResolveThreadCount(threads));
+
+	double serialMs = BestOf(3, [&]{serial.Build(&vertices[0], 4, &indices[0], triangleCount, 1);});
+	double buildMs = BestOf(3, [&]{bvh.Build(&vertices[0], 4, &indices[0], triangleCount, threads);});
+	printf("build, 1 thread      %9.1f ms\n", serialMs);
+	printf("build, all threads   %9.1f ms  %.2fx\n", buildMs, serialMs / buildMs);
+	printf("%ld nodes, depth %d, %s tree on both\n", bvh.GetNodeCount(), bvh.GetDepth(),
+		serial.GetNodeCount() == bvh.GetNodeCount() && serial.GetDepth() == bvh.GetDepth() ? "same" : "DIFFERENT");
+
+	auto closest = [&](const float* ray)
+	{
+		BVHHit hit;
+		return bvh.Intersect(ray, ray + 3, 1e30f, hit);
+	};
+	auto any = [&](const float* ray)
+	{
+		return bvh.Occluded(ray, ray + 3, 1e30f);
+	};
+	long rayCount = (long) rays.size() / 6;
+	double closestSerialMs = BestOf(3, [&]{closestHits = TraceRays(rays, 1, closest);});
+	double closestMs = BestOf(3, [&]{closestHits = TraceRays(rays, threads, closest);});
+	double anySerialMs = BestOf(3, [&]{anyHits = TraceRays(rays, 1, any);});
+	double anyMs = BestOf(3, [&]{anyHits = TraceRays(rays, threads, any);});
+
+	printf("closest, 1 thread    %9.2f Mrays/s\n", rayCount / closestSerialMs / 1e3);
+	printf("closest, all threads %9.2f Mrays/s  %.2fx\n", rayCount / closestMs / 1e3, closestSerialMs / closestMs);
+	printf("any, 1 thread        %9.2f Mrays/s\n", rayCount / anySerialMs / 1e3);
+	printf("any, all threads     %9.2f Mrays/s  %.2fx\n", rayCount / anyMs / 1e3, anySerialMs / anyMs);
+	printf("hits: closest %ld, any %ld\n", closestHits, anyHits);
+
+	for (long i = 0; i < std::min(rayCount, CHECKED_RAYS); ++i)
+	{
+		const float* ray = &rays[6*i];
+		double distance;
+		BVHHit hit;
+		bool bHit = bvh.Intersect(ray, ray + 3, 1e30f, hit);
+		long expected = BruteForce(vertices, indices, ray, distance);
+
+		if (bHit != (expected >= 0) || (bHit && fabs(hit.distance - distance) > 1e-4*distance))
+			++wrong;
+	}
+	printf("%ld of %ld checked rays disagree with testing every triangle\n", wrong, std::min(rayCount, CHECKED_RAYS));
+	return 0;
+}
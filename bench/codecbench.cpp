@@ -0,0 +1,210 @@
+/*
+Benchmark of the compressed mesh codec
+
+Builds a latitude/longitude sphere with its vertices shuffled like a scanned
+mesh and reports the compression ratio and encode and decode speed of its
+positions, normals, texture coordinates and triangles, both as shuffled and
+after OptimizeVertexCache and OptimizeVertexFetch, then does the same for
+every OBJ file given, loaded the way objtool pack loads them. Every decode
+is checked against the original buffers.
+
+Usage: codecbench [triangles in millions] [threads] [model.obj ...]
+Build: g++ -O2 -std=c++14 -pthread codecbench.cpp ../meshcodec.cpp ../meshoptimize.cpp ../arena.cpp
+	../wavefrontloader.cpp ../wavefrontcache.cpp ../wavefrontpack.cpp ../wavefrontmaterials.cpp ../mappedfile.cpp
+	../meshnormals.cpp ../meshlets.cpp ../meshsimplify.cpp
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "../arena.h"
+#include "../meshcodec.h"
+#include "../meshoptimize.h"
+#include "../parallel.h"
+#include "../wavefrontloader.h"
+
+//the buffers a finished model draws from
+struct BenchMesh
+{
+	std::vector<float> positions;	// x, y, z, w
+	std::vector<float> normals;
+	std::vector<float> texcoords;
+	std::vector<long> indices;
+	long vertexCount;
+};
+
+//latitude/longitude sphere with about the requested number of triangles,
+//vertices are shuffled so neighbours are far apart in memory as in scans
+static void MakeSphere(long triangles, BenchMesh &mesh)
+{
+	long rings = (long) sqrt(triangles / 4.0) + 2;
+	long segments = 2*rings;
+	std::vector<long> order;
+	std::mt19937 random(1);
+
+	mesh.vertexCount = (rings + 1)*segments;
+	order.resize(mesh.vertexCount);
+	for (long i = 0; i < mesh.vertexCount; ++i)
+		order[i] = i;
+	std::shuffle(order.begin(), order.end(), random);
+
+	mesh.positions.assign(mesh.vertexCount*4, 1.0f);
+	mesh.normals.resize(mesh.vertexCount*3);
+	mesh.texcoords.resize(mesh.vertexCount*2);
+	for (long r = 0; r <= rings; ++r)
+	{
+		for (long s = 0; s < segments; ++s)
+		{
+			float theta = 3.14159265f*r/rings, phi = 2.0f*3.14159265f*s/segments;
+			float radius = r == 0 || r == rings ? 0.0f : sinf(theta);
+			long v = order[r*segments + s];
+			float* p = &mesh.positions[4*v];
+			p[0] = radius*cosf(phi);
+			p[1] = radius*sinf(phi);
+			p[2] = r == rings ? -1.0f : cosf(theta);
+			memcpy(&mesh.normals[3*v], p, 3*sizeof(float));
+			mesh.texcoords[2*v] = (float) s/segments;
+			mesh.texcoords[2*v + 1] = (float) r/rings;
+		}
+	}
+
+	mesh.indices.clear();
+	for (long r = 0; r < rings; ++r)
+	{
+		for (long s = 0; s < segments; ++s)
+		{
+			long a = order[r*segments + s], b = order[r*segments + (s + 1) % segments];
+			long c = order[(r + 1)*segments + s], d = order[(r + 1)*segments + (s + 1) % segments];
+			long quad[6] = {a, c, b, b, c, d};
+			mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+		}
+	}
+}
+
+//what OBJClass does to the buffers with SetOptimizeVertexCache
+static void Optimize(BenchMesh &mesh)
+{
+	MemoryArena scratch;
+	std::vector<long> remap(mesh.vertexCount);
+	long triangleCount = (long) mesh.indices.size() / 3;
+
+	OptimizeVertexCache(&mesh.indices[0], triangleCount, mesh.vertexCount, scratch);
+	OptimizeVertexFetch(&mesh.indices[0], triangleCount, mesh.vertexCount, &remap[0]);
+	RemapVertexBuffer(&mesh.positions[0], 4, mesh.vertexCount, &remap[0], scratch);
+	RemapVertexBuffer(&mesh.normals[0], 3, mesh.vertexCount, &remap[0], scratch);
+	RemapVertexBuffer(&mesh.texcoords[0], 2, mesh.vertexCount, &remap[0], scratch);
+}
+
+template<typename Run>
+static double BestOf(int repeats, Run run)
+{
+	double best = 1e30;
+	for (int i = 0; i < repeats; ++i)
+	{
+		auto start = std::chrono::steady_clock::now();
+		run();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (ms < best)
+			best = ms;
+	}
+	return best;
+}
+
+//codes one vertex stream, prints a line and returns false when the decode differs
+static bool BenchVertices(const char* name, const float* vertices, long vertexCount, int floats, int threads)
+{
+	int stride = floats*sizeof(float);
+	size_t rawBytes = (size_t) vertexCount*stride, size = 0;
+	std::vector<unsigned char> coded(VertexEncodeBound(vertexCount, stride));
+	std::vector<float> decoded(vertexCount*floats);
+	int result = 0;
+
+	double encodeMs = BestOf(3, [&]{size = EncodeVertexBuffer(&coded[0], coded.size(), vertices, vertexCount, stride);});
+	double serialMs = BestOf(5, [&]{result |= DecodeVertexBuffer(&decoded[0], vertexCount, stride, &coded[0], size, 1);});
+	double decodeMs = BestOf(5, [&]{result |= DecodeVertexBuffer(&decoded[0], vertexCount, stride, &coded[0], size, threads);});
+	bool bSame = result == 0 && memcmp(&decoded[0], vertices, rawBytes) == 0;
+
+	printf("  %-10s %6.2fx  encode %6.2f GB/s  decode %6.2f GB/s, all threads %6.2f GB/s%s\n", name,
+		(double) rawBytes/size, rawBytes/encodeMs/1e6, rawBytes/serialMs/1e6, rawBytes/decodeMs/1e6, bSame ? "" : "  DIFFERS");
+	return bSame;
+}
+
+static bool BenchIndices(const long* indices, long triangleCount, long vertexCount)
+{
+	size_t rawBytes = (size_t) triangleCount*3*sizeof(long), size = 0;
+	std::vector<unsigned char> coded(IndexEncodeBound(triangleCount));
+	std::vector<long> decoded(triangleCount*3);
+	int result = 0;
+
+	double encodeMs = BestOf(3, [&]{size = EncodeIndexBuffer(&coded[0], coded.size(), indices, triangleCount, vertexCount);});
+	double decodeMs = BestOf(5, [&]{result |= DecodeIndexBuffer(&decoded[0], triangleCount, vertexCount, &coded[0], size);});
+	bool bSame = result == 0 && memcmp(&decoded[0], indices, rawBytes) == 0;
+
+	printf("  %-10s %6.2fx  encode %6.2f GB/s  decode %6.2f GB/s, %.2f bytes per triangle%s\n", "triangles",
+		(double) rawBytes/size, rawBytes/encodeMs/1e6, rawBytes/decodeMs/1e6, (double) size/triangleCount, bSame ? "" : "  DIFFERS");
+	return bSame;
+}
+
+static bool BenchMeshBuffers(const float* positions, const float* normals, const float* texcoords,
+	const long* indices, long vertexCount, long triangleCount, int threads)
+{
+	bool bSame = BenchVertices("positions", positions, vertexCount, 4, threads);
+	bSame &= BenchVertices("normals", normals, vertexCount, 3, threads);
+	if (texcoords != NULL)
+		bSame &= BenchVertices("texcoords", texcoords, vertexCount, 2, threads);
+	bSame &= BenchIndices(indices, triangleCount, vertexCount);
+	return bSame;
+}
+
+int main(int argc, char** argv)
+{
+	double millions = argc > 1 ? atof(argv[1]) : 1.0;
+	int threads = argc > 2 ? atoi(argv[2]) : 0;
+	BenchMesh mesh;
+	bool bSame;
+
+	MakeSphere((long)(millions*1e6), mesh);
+	printf("sphere, %ld vertices, %ld triangles, %d threads\n", mesh.vertexCount, (long) mesh.indices.size() / 3,
+		ResolveThreadCount(threads));
+	printf(" shuffled\n");
+	bSame = BenchMeshBuffers(&mesh.positions[0], &mesh.normals[0], &mesh.texcoords[0], &mesh.indices[0],
+		mesh.vertexCount, (long) mesh.indices.size() / 3, threads);
+	Optimize(mesh);
+	printf(" optimized\n");
+	bSame &= BenchMeshBuffers(&mesh.positions[0], &mesh.normals[0], &mesh.texcoords[0], &mesh.indices[0],
+		mesh.vertexCount, (long) mesh.indices.size() / 3, threads);
+
+	for (int i = 3; i < argc; ++i)
+	{
+		OBJClass objmodel;
+		std::vector<wchar_t> fileName(strlen(argv[i]) + 1);
+
+		mbstowcs(&fileName[0], argv[i], fileName.size());
+		objmodel.SetThreadCount(threads);
+		objmodel.SetOptimizeVertexCache(true);
+		if (objmodel.Load(&fileName[0]) != 0)
+		{
+			printf("%s: could not load\n", argv[i]);
+			continue;
+		}
+		printf("%s, %ld vertices, %ld triangles\n", argv[i], objmodel.GetVertexCount(), objmodel.GetTotalConnectTriangles() / 3);
+		bSame &= BenchMeshBuffers(objmodel.GetVertexBuffer(), objmodel.GetNormalBuffer(), objmodel.GetTextureBuffer(),
+			objmodel.GetIndexBufferV(), objmodel.GetVertexCount(), objmodel.GetTotalConnectTriangles() / 3, threads);
+	}
+	printf("%s\n", bSame ? "every buffer decoded to the original" : "SOME BUFFERS DECODED WRONG");
+	return bSame ? 0 : 1;
+}
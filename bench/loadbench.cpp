@@ -0,0 +1,250 @@
+/*
+Benchmark of OBJClass::Load over generated files of every shape and face form
+
+Generates a file per size, shape and face form with objgenerator, loads
+each a number of times and writes the fastest load of every file as JSON:
+the file, the time of every stage reported by GetLoadTimes, throughput in
+MB/s and triangles per second, and the peak memory of the process so far.
+Sizes run smallest first, so the peak belongs to the largest file yet.
+Progress goes to stderr, the JSON to stdout or the -o file.
+
+Usage: loadbench [-sizes 1000,100000,...] [-shapes grid,sphere,scan] [-faces v,vn,vt,vtn]
+	[-quads] [-negative] [-threads N] [-repeats R] [-optimize] [-dir directory] [-keep] [-o results.json]
+Build: g++ -O2 -std=c++14 -pthread loadbench.cpp objgenerator.cpp ../wavefrontloader.cpp ../wavefrontcache.cpp
+	../wavefrontpack.cpp ../wavefrontmaterials.cpp ../meshcodec.cpp ../mappedfile.cpp ../arena.cpp ../meshnormals.cpp
+	../meshoptimize.cpp ../meshlets.cpp ../meshsimplify.cpp
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "objgenerator.h"
+#include "../parallel.h"
+#include "../wavefrontloader.h"
+
+//largest resident set of the process so far, in bytes
+static unsigned long long PeakMemory()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return counters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	return (unsigned long long) usage.ru_maxrss;
+#else
+	return (unsigned long long) usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+//splits a comma separated list
+static std::vector<std::string> SplitList(const char* text)
+{
+	std::vector<std::string> items;
+	std::string item;
+
+	for (const char* p = text; ; ++p)
+	{
+		if (*p == ',' || *p == '\0')
+		{
+			if (!item.empty())
+				items.push_back(item);
+			item.clear();
+			if (*p == '\0')
+				break;
+		}
+		else
+			item += *p;
+	}
+	return items;
+}
+
+static void PrintUsage()
+{
+	fprintf(stderr, "Usage: loadbench [-sizes 1000,100000,...] [-shapes grid,sphere,scan] [-faces v,vn,vt,vtn]\n");
+	fprintf(stderr, "                 [-quads] [-negative] [-threads N] [-repeats R] [-optimize] [-dir directory] [-keep]\n");
+	fprintf(stderr, "                 [-o results.json]\n");
+}
+
+int main(int argc, char** argv)
+{
+	static const char* faceArguments[FACES_COUNT] = {"v", "vn", "vt", "vtn"};
+	std::vector<long> sizes;
+	std::vector<GeneratorShape> shapes;
+	std::vector<GeneratorFaces> faces;
+	std::string directory = ".";
+	const char* outputPath = NULL;
+	int threads = 0, repeats = 3;
+	bool bQuads = false, bNegative = false, bOptimize = false, bKeep = false, bFirst = true;
+	FILE* output = stdout;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		bool bHasValue = i + 1 < argc;
+
+		if (strcmp(argv[i], "-sizes") == 0 && bHasValue)
+		{
+			std::vector<std::string> items = SplitList(argv[++i]);
+			for (size_t k = 0; k < items.size(); ++k)
+				sizes.push_back(atol(items[k].c_str()));
+		}
+		else if (strcmp(argv[i], "-shapes") == 0 && bHasValue)
+		{
+			std::vector<std::string> items = SplitList(argv[++i]);
+			for (size_t k = 0; k < items.size(); ++k)
+			{
+				for (int s = 0; s < SHAPE_COUNT; ++s)
+				{
+					if (items[k] == GetShapeName((GeneratorShape) s))
+						shapes.push_back((GeneratorShape) s);
+				}
+			}
+		}
+		else if (strcmp(argv[i], "-faces") == 0 && bHasValue)
+		{
+			std::vector<std::string> items = SplitList(argv[++i]);
+			for (size_t k = 0; k < items.size(); ++k)
+			{
+				for (int f = 0; f < FACES_COUNT; ++f)
+				{
+					if (items[k] == faceArguments[f])
+						faces.push_back((GeneratorFaces) f);
+				}
+			}
+		}
+		else if (strcmp(argv[i], "-threads") == 0 && bHasValue)
+			threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-repeats") == 0 && bHasValue)
+			repeats = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-dir") == 0 && bHasValue)
+			directory = argv[++i];
+		else if (strcmp(argv[i], "-o") == 0 && bHasValue)
+			outputPath = argv[++i];
+		else if (strcmp(argv[i], "-quads") == 0)
+			bQuads = true;
+		else if (strcmp(argv[i], "-negative") == 0)
+			bNegative = true;
+		else if (strcmp(argv[i], "-optimize") == 0)
+			bOptimize = true;
+		else if (strcmp(argv[i], "-keep") == 0)
+			bKeep = true;
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+	if (sizes.empty())
+		sizes = {1000, 10000, 100000, 1000000};
+	if (shapes.empty())
+		shapes = {SHAPE_GRID, SHAPE_SPHERE, SHAPE_SCAN};
+	if (faces.empty())
+		faces = {FACES_V, FACES_VN, FACES_VT, FACES_VTN};
+	repeats = repeats < 1 ? 1 : repeats;
+
+	if (outputPath != NULL && (output = fopen(outputPath, "w")) == NULL)
+	{
+		fprintf(stderr, "could not write %s\n", outputPath);
+		return 1;
+	}
+	fprintf(output, "{\n  \"threads\": %d,\n  \"repeats\": %d,\n  \"quads\": %s,\n  \"negative_indices\": %s,\n"
+		"  \"optimize\": %s,\n  \"results\": [", ResolveThreadCount(threads), repeats, bQuads ? "true" : "false",
+		bNegative ? "true" : "false", bOptimize ? "true" : "false");
+
+	for (size_t z = 0; z < sizes.size(); ++z)
+	{
+		for (size_t s = 0; s < shapes.size(); ++s)
+		{
+			for (size_t f = 0; f < faces.size(); ++f)
+			{
+				GeneratorSettings settings;
+				GeneratedOBJ generated;
+				OBJLoadTimes best = OBJLoadTimes();
+				std::string path = directory + "/loadbench_" + GetShapeName(shapes[s]) + "_" + faceArguments[faces[f]] +
+					"_" + std::to_string(sizes[z]) + ".obj";
+				std::vector<wchar_t> fileName(path.size() + 1);
+				bool bLoaded = true;
+
+				settings.shape = shapes[s];
+				settings.faces = faces[f];
+				settings.triangles = sizes[z];
+				settings.bQuads = bQuads;
+				settings.bNegativeIndices = bNegative;
+
+				auto start = std::chrono::steady_clock::now();
+				if (GenerateOBJ(path.c_str(), settings, generated) != 0)
+				{
+					fprintf(stderr, "could not write %s\n", path.c_str());
+					return 1;
+				}
+				double generateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+				mbstowcs(fileName.data(), path.c_str(), fileName.size());
+
+				//a fresh model every time, so no load reuses the memory of the one before
+				best.total = 1e30;
+				for (int r = 0; r < repeats && bLoaded; ++r)
+				{
+					OBJClass objmodel;
+					objmodel.SetThreadCount(threads);
+					objmodel.SetOptimizeVertexCache(bOptimize);
+					bLoaded = objmodel.Load(fileName.data()) == 0 &&
+						objmodel.GetTotalConnectTriangles() / 3 == generated.triangles;
+					if (bLoaded && objmodel.GetLoadTimes().total < best.total)
+						best = objmodel.GetLoadTimes();
+				}
+				if (!bKeep)
+					remove(path.c_str());
+
+				double seconds = best.total / 1e3;
+				fprintf(stderr, "%-7s %-6s %10ld triangles %8.1f MB: %s %9.2f ms, %8.1f MB/s, %6.2f Mtris/s\n",
+					GetShapeName(shapes[s]), GetFacesName(faces[f]), generated.triangles, generated.bytes / 1e6,
+					bLoaded ? "loaded in" : "FAILED   ", bLoaded ? best.total : 0.0,
+					bLoaded ? generated.bytes / seconds / 1e6 : 0.0, bLoaded ? generated.triangles / seconds / 1e6 : 0.0);
+
+				fprintf(output, "%s\n    {\"shape\": \"%s\", \"faces\": \"%s\", \"triangles\": %ld, \"vertices\": %ld, "
+					"\"bytes\": %lld, \"generate_ms\": %.3f, \"loaded\": %s", bFirst ? "" : ",", GetShapeName(shapes[s]),
+					GetFacesName(faces[f]), generated.triangles, generated.vertices, generated.bytes, generateMs,
+					bLoaded ? "true" : "false");
+				if (bLoaded)
+				{
+					fprintf(output, ",\n     \"phases_ms\": {\"count\": %.3f, \"parse\": %.3f, \"validate\": %.3f, "
+						"\"triangulate\": %.3f, \"scale\": %.3f, \"unify\": %.3f, \"normals\": %.3f, \"materials\": %.3f, "
+						"\"optimize\": %.3f, \"levels\": %.3f, \"meshlets\": %.3f},\n     \"load_ms\": %.3f, \"mb_per_s\": %.2f, "
+						"\"triangles_per_s\": %.0f", best.count, best.parse, best.validate, best.triangulate, best.scale,
+						best.unify, best.normals, best.materials, best.optimize, best.levels, best.meshlets, best.total,
+						generated.bytes / seconds / 1e6, generated.triangles / seconds);
+				}
+				fprintf(output, ", \"peak_rss_bytes\": %llu}", PeakMemory());
+				bFirst = false;
+			}
+		}
+	}
+	fprintf(output, "\n  ]\n}\n");
+	if (output != stdout)
+		fclose(output);
+	return 0;
+}
@@ -0,0 +1,187 @@
+/*
+Benchmark of the vertex normal generation against the loop the loader used before
+
+Builds a latitude/longitude sphere with its vertices shuffled like a scanned
+mesh and times both implementations on the same buffers, with degenerate
+faces at the poles and an unused vertex, which the old loop turned into a NaN.
+
+Usage: normalsbench [triangles in millions] [threads]
+Build: g++ -O2 -std=c++14 -pthread normalsbench.cpp ../meshnormals.cpp ../arena.cpp
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "../meshnormals.h"
+#include "../parallel.h"
+
+//the scalar scatter loop OBJClass::CreateNewNormals used, kept as the baseline
+static void LegacyNormals(const float* vertices, long vertexCount, const long* indices, long faceCount, float* normals)
+{
+	float edge1[3], edge2[3], normal[3], length;
+	unsigned int i0, i1, i2;
+
+	memset(normals, 0, vertexCount*3*sizeof(float));
+	for (long i = 0; i < faceCount*3; i = i+3)
+	{
+		i0 = indices[i];
+		i1 = indices[i+1];
+		i2 = indices[i+2];
+
+		edge1[0] = vertices[4*i1] - vertices[4*i0];
+		edge1[1] = vertices[4*i1 +1] - vertices[4*i0 +1];
+		edge1[2] = vertices[4*i1 +2] - vertices[4*i0 +2];
+
+		edge2[0] = vertices[4*i2] - vertices[4*i0];
+		edge2[1] = vertices[4*i2 +1] - vertices[4*i0 +1];
+		edge2[2] = vertices[4*i2 +2] - vertices[4*i0 +2];
+
+		normal[0] = (edge1[1] * edge2[2]) - (edge1[2] * edge2[1]);
+		normal[1] = (edge1[2] * edge2[0]) - (edge1[0] * edge2[2]);
+		normal[2] = (edge1[0] * edge2[1]) - (edge1[1] * edge2[0]);
+
+		for (int k = 0; k < 3; ++k)
+		{
+			normals[3*i0 + k] += normal[k];
+			normals[3*i1 + k] += normal[k];
+			normals[3*i2 + k] += normal[k];
+		}
+	}
+	for (long i = 0; i < vertexCount*3; i = i+3)
+	{
+		length = sqrtf(normals[i]*normals[i] + normals[i+1]*normals[i+1] + normals[i+2]*normals[i+2]);
+		normals[i] /= length;
+		normals[i+1] /= length;
+		normals[i+2] /= length;
+	}
+}
+
+//latitude/longitude sphere with about the requested number of triangles,
+//vertices are shuffled so neighbours are far apart in memory as in scans
+static void MakeSphere(long triangles, std::vector<float> &vertices, std::vector<long> &indices)
+{
+	long rings = (long) sqrt(triangles / 4.0) + 2;
+	long segments = 2*rings;
+	long vertexCount = (rings + 1)*segments;
+	std::vector<long> order(vertexCount);
+	std::mt19937 random(1);
+
+	for (long i = 0; i < vertexCount; ++i)
+		order[i] = i;
+	std::shuffle(order.begin(), order.end(), random);
+
+	vertices.assign(vertexCount*4, 1.0f);
+	for (long r = 0; r <= rings; ++r)
+	{
+		for (long s = 0; s < segments; ++s)
+		{
+			//the poles are exact so their faces are exactly degenerate
+			float theta = 3.14159265f*r/rings, phi = 2.0f*3.14159265f*s/segments;
+			float radius = r == 0 || r == rings ? 0.0f : sinf(theta);
+			float* v = &vertices[4*order[r*segments + s]];
+			v[0] = radius*cosf(phi);
+			v[1] = radius*sinf(phi);
+			v[2] = r == rings ? -1.0f : cosf(theta);
+		}
+	}
+
+	//plus one vertex no face uses
+	vertices.insert(vertices.end(), 4, 1.0f);
+
+	indices.clear();
+	for (long r = 0; r < rings; ++r)
+	{
+		for (long s = 0; s < segments; ++s)
+		{
+			long a = order[r*segments + s], b = order[r*segments + (s + 1) % segments];
+			long c = order[(r + 1)*segments + s], d = order[(r + 1)*segments + (s + 1) % segments];
+			long quad[6] = {a, c, b, b, c, d};
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+}
+
+template<typename Run>
+static double BestOf(int repeats, Run run)
+{
+	double best = 1e30;
+	for (int i = 0; i < repeats; ++i)
+	{
+		auto start = std::chrono::steady_clock::now();
+		run();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (ms < best)
+			best = ms;
+	}
+	return best;
+}
+
+//largest angle in degrees between two sets of unit normals, skipping NaNs
+static double MaxDeviation(const std::vector<float> &a, const std::vector<float> &b)
+{
+	double worst = 0.0;
+	for (size_t i = 0; i + 2 < a.size(); i += 3)
+	{
+		double dot = a[i]*b[i] + a[i+1]*b[i+1] + a[i+2]*b[i+2];
+		if (dot == dot)
+			worst = std::max(worst, acos(std::min(1.0, std::max(-1.0, dot)))*180.0/3.14159265358979);
+	}
+	return worst;
+}
+
+static long CountNaNs(const std::vector<float> &normals)
+{
+	long count = 0;
+	for (size_t i = 0; i < normals.size(); ++i)
+		count += normals[i] != normals[i];
+	return count / 3;
+}
+
+int main(int argc, char** argv)
+{
+	double millions = argc > 1 ? atof(argv[1]) : 10.0;
+	int threads = argc > 2 ? atoi(argv[2]) : 0;
+	std::vector<float> vertices, legacy, area, angle;
+	std::vector<long> indices;
+	MemoryArena scratch;
+	long vertexCount, faceCount;
+
+	MakeSphere((long)(millions*1e6), vertices, indices);
+	vertexCount = (long) vertices.size() / 4;
+	faceCount = (long) indices.size() / 3;
+	legacy.resize(vertexCount*3);
+	area.resize(vertexCount*3);
+	angle.resize(vertexCount*3);
+	printf("%ld vertices, %ld triangles, %d threads\n", vertexCount, faceCount, ResolveThreadCount(threads));
+
+	double legacyMs = BestOf(3, [&]{LegacyNormals(&vertices[0], vertexCount, &indices[0], faceCount, &legacy[0]);});
+	double serialMs = BestOf(3, [&]{scratch.Reset(); ComputeVertexNormals(&vertices[0], 4, vertexCount, &indices[0], faceCount,
+		&area[0], NORMALS_AREA_WEIGHTED, 1, scratch);});
+	double areaMs = BestOf(3, [&]{scratch.Reset(); ComputeVertexNormals(&vertices[0], 4, vertexCount, &indices[0], faceCount,
+		&area[0], NORMALS_AREA_WEIGHTED, threads, scratch);});
+	double angleMs = BestOf(3, [&]{scratch.Reset(); ComputeVertexNormals(&vertices[0], 4, vertexCount, &indices[0], faceCount,
+		&angle[0], NORMALS_ANGLE_WEIGHTED, threads, scratch);});
+
+	printf("legacy scatter       %9.1f ms\n", legacyMs);
+	printf("area, 1 thread       %9.1f ms  %.2fx\n", serialMs, legacyMs / serialMs);
+	printf("area, all threads    %9.1f ms  %.2fx\n", areaMs, legacyMs / areaMs);
+	printf("angle, all threads   %9.1f ms  %.2fx\n", angleMs, legacyMs / angleMs);
+	printf("max deviation from legacy: area %.4f deg, angle %.4f deg\n",
+		MaxDeviation(legacy, area), MaxDeviation(legacy, angle));
+	printf("NaN normals: legacy %ld, area %ld, angle %ld\n", CountNaNs(legacy), CountNaNs(area), CountNaNs(angle));
+	return 0;
+}
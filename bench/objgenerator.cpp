@@ -0,0 +1,328 @@
+/*
+Deterministic generator of OBJ files for the loader benchmarks
+
+Every shape is a grid of quads, open for the height field and wrapped
+around for the spheres, so the size is set by the number of rows. Numbers
+are formatted by hand with six decimals, which is many times faster than
+printf and keeps files of tens of millions of triangles quick to make.
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "objgenerator.h"
+
+static const size_t WRITE_BUFFER = 1 << 20;
+static const size_t WRITE_SLACK = 256;	// Room for the longest line
+
+//xorshift64*, the same numbers everywhere unlike the std distributions
+class GeneratorRandom
+{
+  private:
+	unsigned long long mState;
+
+ public:
+	GeneratorRandom(unsigned int seed) : mState(0x9E3779B97F4A7C15ull ^ seed) {};
+
+	inline unsigned long long Next()
+	{
+		mState ^= mState >> 12;
+		mState ^= mState << 25;
+		mState ^= mState >> 27;
+		return mState * 2685821657736338717ull;
+	}
+
+	//uniform in [0, 1)
+	inline double Uniform(){return (Next() >> 11) * (1.0 / 9007199254740992.0);};
+};
+
+//buffered writer for the hand formatted lines
+class OBJWriter
+{
+  private:
+	FILE* mFile;
+	std::vector<char> mBuffer;
+	char* mPosition;
+	long long mBytes;
+	bool mbError;
+
+ public:
+	OBJWriter(FILE* file) : mFile(file), mBuffer(WRITE_BUFFER), mBytes(0), mbError(false)
+	{
+		mPosition = mBuffer.data();
+	};
+
+	//makes sure a whole line fits
+	inline void Reserve()
+	{
+		if ((size_t)(mPosition - mBuffer.data()) > WRITE_BUFFER - WRITE_SLACK)
+			Flush();
+	}
+
+	void Flush()
+	{
+		size_t size = mPosition - mBuffer.data();
+		mbError |= size > 0 && fwrite(mBuffer.data(), size, 1, mFile) != 1;
+		mBytes += size;
+		mPosition = mBuffer.data();
+	}
+
+	inline void Put(char c){*mPosition++ = c;};
+
+	inline void Put(const char* text)
+	{
+		while (*text != '\0')
+			*mPosition++ = *text++;
+	}
+
+	inline void PutInteger(long long value)
+	{
+		char digits[24];
+		int count = 0;
+		unsigned long long magnitude = value < 0 ? 0ull - (unsigned long long) value : (unsigned long long) value;
+
+		if (value < 0)
+			*mPosition++ = '-';
+		do
+		{
+			digits[count++] = (char)('0' + magnitude % 10);
+			magnitude /= 10;
+		} while (magnitude > 0);
+		while (count > 0)
+			*mPosition++ = digits[--count];
+	}
+
+	//six decimals, rounded half away from zero
+	inline void PutFloat(double value)
+	{
+		long long scaled;
+
+		if (value < 0.0)
+		{
+			*mPosition++ = '-';
+			value = -value;
+		}
+		scaled = (long long)(value*1e6 + 0.5);
+		PutInteger(scaled / 1000000);
+		*mPosition++ = '.';
+		for (long long digit = 100000; digit > 0; digit /= 10)
+			*mPosition++ = (char)('0' + (scaled / digit) % 10);
+	}
+
+	inline long long GetBytes(){return mBytes;};
+	inline bool HasFailed(){return mbError;};
+};
+
+const char* GetShapeName(GeneratorShape shape)
+{
+	static const char* names[SHAPE_COUNT] = {"grid", "sphere", "scan"};
+	return names[shape];
+}
+
+const char* GetFacesName(GeneratorFaces faces)
+{
+	static const char* names[FACES_COUNT] = {"v", "v//n", "v/t", "v/t/n"};
+	return names[faces];
+}
+
+int GenerateOBJ(const char* path, const GeneratorSettings &settings, GeneratedOBJ &generated)
+{
+	bool bGrid = settings.shape == SHAPE_GRID;
+	bool bTexels = settings.faces == FACES_VT || settings.faces == FACES_VTN;
+	bool bNormals = settings.faces == FACES_VN || settings.faces == FACES_VTN;
+	long quads = settings.triangles > 2 ? settings.triangles / 2 : 1;
+	long rows, columns, vertexCount;
+	std::vector<long> order;
+	std::vector<float> positions, normals;
+	GeneratorRandom random(settings.seed);
+	FILE* file;
+
+	//a square grid, or twice as many segments as rings around a sphere
+	rows = bGrid ? (long) sqrt((double) quads) : (long) sqrt(quads / 2.0);
+	rows = rows < 1 ? 1 : rows;
+	columns = bGrid ? quads / rows : 2*rows;
+	columns = columns < (bGrid ? 1 : 3) ? (bGrid ? 1 : 3) : columns;
+	vertexCount = bGrid ? (rows + 1)*(columns + 1) : (rows + 1)*columns;
+
+	positions.resize(vertexCount*3);
+	normals.resize(vertexCount*3);
+	for (long r = 0; r <= rows; ++r)
+	{
+		for (long c = 0; c < (bGrid ? columns + 1 : columns); ++c)
+		{
+			long v = r*(bGrid ? columns + 1 : columns) + c;
+			float* p = &positions[3*v];
+			float* n = &normals[3*v];
+
+			if (bGrid)
+			{
+				double x = 2.0*c/columns - 1.0, y = 2.0*r/rows - 1.0;
+				double dx = 0.3*cos(3.0*x)*cos(3.0*y), dy = -0.3*sin(3.0*x)*sin(3.0*y);
+				double length = sqrt(dx*dx + dy*dy + 1.0);
+				p[0] = (float) x;
+				p[1] = (float) y;
+				p[2] = (float)(0.1*sin(3.0*x)*cos(3.0*y));
+				n[0] = (float)(-dx/length);
+				n[1] = (float)(-dy/length);
+				n[2] = (float)(1.0/length);
+			}
+			else
+			{
+				double theta = 3.14159265358979*r/rows, phi = 2.0*3.14159265358979*c/columns;
+				double radius = settings.shape == SHAPE_SCAN ? 1.0 + 0.01*(random.Uniform() - 0.5) : 1.0;
+				n[0] = (float)(sin(theta)*cos(phi));
+				n[1] = (float)(sin(theta)*sin(phi));
+				n[2] = (float) cos(theta);
+				for (int k = 0; k < 3; ++k)
+					p[k] = (float)(radius*n[k]);
+			}
+		}
+	}
+
+	//where each vertex lands in the file, shuffled for scans
+	order.resize(vertexCount);
+	for (long v = 0; v < vertexCount; ++v)
+		order[v] = v;
+	if (settings.shape == SHAPE_SCAN)
+	{
+		for (long v = vertexCount - 1; v > 0; --v)
+		{
+			long other = (long)(random.Next() % (unsigned long long)(v + 1));
+			long swap = order[v];
+			order[v] = order[other];
+			order[other] = swap;
+		}
+	}
+	std::vector<long> inFile(vertexCount);
+	for (long v = 0; v < vertexCount; ++v)
+		inFile[order[v]] = v;
+
+	file = fopen(path, "wb");
+	if (file == NULL)
+		return -1;
+	OBJWriter writer(file);
+
+	writer.Put("# generated ");
+	writer.Put(GetShapeName(settings.shape));
+	writer.Put(" with faces ");
+	writer.Put(GetFacesName(settings.faces));
+	writer.Put("\n");
+	for (long i = 0; i < vertexCount; ++i)
+	{
+		const float* p = &positions[3*inFile[i]];
+		writer.Reserve();
+		writer.Put("v ");
+		writer.PutFloat(p[0]);
+		writer.Put(' ');
+		writer.PutFloat(p[1]);
+		writer.Put(' ');
+		writer.PutFloat(p[2]);
+		writer.Put('\n');
+	}
+	for (long i = 0; bTexels && i < vertexCount; ++i)
+	{
+		long v = inFile[i], width = bGrid ? columns + 1 : columns;
+		writer.Reserve();
+		writer.Put("vt ");
+		writer.PutFloat((double)(v % width)/columns);
+		writer.Put(' ');
+		writer.PutFloat((double)(v / width)/rows);
+		writer.Put('\n');
+	}
+	for (long i = 0; bNormals && i < vertexCount; ++i)
+	{
+		const float* n = &normals[3*inFile[i]];
+		writer.Reserve();
+		writer.Put("vn ");
+		writer.PutFloat(n[0]);
+		writer.Put(' ');
+		writer.PutFloat(n[1]);
+		writer.Put(' ');
+		writer.PutFloat(n[2]);
+		writer.Put('\n');
+	}
+
+	auto putCorner = [&](long v)
+	{
+		long long index = settings.bNegativeIndices ? (long long) order[v] - vertexCount : (long long) order[v] + 1;
+		writer.Put(' ');
+		writer.PutInteger(index);
+		if (settings.faces == FACES_VN)
+		{
+			writer.Put("//");
+			writer.PutInteger(index);
+		}
+		else if (bTexels)
+		{
+			writer.Put('/');
+			writer.PutInteger(index);
+			if (bNormals)
+			{
+				writer.Put('/');
+				writer.PutInteger(index);
+			}
+		}
+	};
+
+	//corners counter-clockwise seen from outside
+	generated.triangles = 0;
+	for (long r = 0; r < rows; ++r)
+	{
+		for (long c = 0; c < columns; ++c)
+		{
+			long corners[4];
+			if (bGrid)
+			{
+				corners[0] = r*(columns + 1) + c;
+				corners[1] = corners[0] + 1;
+				corners[2] = corners[1] + columns + 1;
+				corners[3] = corners[0] + columns + 1;
+			}
+			else
+			{
+				corners[0] = r*columns + c;
+				corners[1] = (r + 1)*columns + c;
+				corners[2] = (r + 1)*columns + (c + 1) % columns;
+				corners[3] = r*columns + (c + 1) % columns;
+			}
+
+			writer.Reserve();
+			if (settings.bQuads)
+			{
+				writer.Put('f');
+				for (int k = 0; k < 4; ++k)
+					putCorner(corners[k]);
+				writer.Put('\n');
+			}
+			else
+			{
+				writer.Put('f');
+				putCorner(corners[0]);
+				putCorner(corners[1]);
+				putCorner(corners[2]);
+				writer.Put("\nf");
+				putCorner(corners[0]);
+				putCorner(corners[2]);
+				putCorner(corners[3]);
+				writer.Put('\n');
+			}
+			generated.triangles += 2;
+		}
+	}
+
+	writer.Flush();
+	bool bError = writer.HasFailed();
+	bError |= fclose(file) != 0;
+	generated.bytes = writer.GetBytes();
+	generated.vertices = vertexCount;
+	return bError ? -1 : 0;
+}
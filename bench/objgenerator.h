@@ -0,0 +1,62 @@
+/*
+Deterministic generator of OBJ files for the loader benchmarks
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef OBJGENERATOR_H
+#define OBJGENERATOR_H
+
+enum GeneratorShape
+{
+	SHAPE_GRID,		// Height field, vertices in row order
+	SHAPE_SPHERE,	// Latitude/longitude sphere
+	SHAPE_SCAN,		// Sphere with a noisy surface and its vertices shuffled, as scanners write them
+	SHAPE_COUNT
+};
+
+//how the corners of a face are written
+enum GeneratorFaces
+{
+	FACES_V,		// f 1 2 3
+	FACES_VN,		// f 1//1 2//2 3//3
+	FACES_VT,		// f 1/1 2/2 3/3
+	FACES_VTN,		// f 1/1/1 2/2/2 3/3/3
+	FACES_COUNT
+};
+
+struct GeneratorSettings
+{
+	GeneratorShape shape;
+	GeneratorFaces faces;
+	long triangles;			// Wanted, the file comes close
+	bool bQuads;			// Write quads, which the loader splits into two triangles each
+	bool bNegativeIndices;	// Faces refer back from the last vertex instead of from the first
+	unsigned int seed;
+
+	GeneratorSettings() : shape(SHAPE_SPHERE), faces(FACES_VTN), triangles(100000), bQuads(false),
+		bNegativeIndices(false), seed(1) {};
+};
+
+//what a generated file holds
+struct GeneratedOBJ
+{
+	long long bytes;
+	long vertices;
+	long triangles;		// After quads are split
+};
+
+const char* GetShapeName(GeneratorShape shape);
+const char* GetFacesName(GeneratorFaces faces);
+
+//writes the file, the same settings always give the same file with the
+//same C library, returns 0 or -1
+int GenerateOBJ(const char* path, const GeneratorSettings &settings, GeneratedOBJ &generated);
+
+#endif
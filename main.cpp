@@ -1,6 +1,6 @@
 /*
 Simple Obj viewer for Windows using OpenGL and SDL
-Can only read triangular faces, not polygonal, and does not draw textures
+Reads triangular and polygonal faces, does not draw textures
 
 Modified code based on frank253's OpenGl Glut OBJ Loader sample
 openglsamples.sourceforge.net/projects/index.pho/blog/index/
@@ -22,7 +22,14 @@ IN THE SOFTWARE.
 
 #include <windows.h> 
 #include <commdlg.h>
+#include <algorithm>
+#include <atomic>
 #include <string>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <chrono>
+#include <thread>
 #include <SDL.h>
 #include <SDL_opengl.h>
 
@@ -30,15 +37,26 @@ IN THE SOFTWARE.
 
 #include <iostream>
 
+#include "mappedfile.h"
+#include "meshbvh.h"
+#include "meshlets.h"
+#include "meshquantize.h"
+#include "perfstats.h"
 #include "wavefrontloader.h"
+#include "wavefrontscene.h"
 
  
 #define KEY_ESCAPE 27
  
 #define SCREENWIDTH 	640
 #define SCREENHEIGHT 	480
+#define FOV_ANGLE		45.0f	//vertical field of view in degrees
+#define LOD_PIXEL_ERROR	1.0f	//screen error a simplified level may show, in pixels
 #define MAJOR_GL 		2		//using OpenGL 2 functions, fixed pipeline
 #define MINOR_GL 		1
+#define STATS_FILE		"viewerstats.json"	//written by S, in the working directory
+#define LOAD_POLL_MS	15		//how often the title shows the progress of a load, in milliseconds
+#define WATCH_POLL_MS	100		//how often the file drawn is looked at for changes, in milliseconds
 
 struct MyWindow
 {
@@ -55,11 +73,72 @@ struct MyWindow
 	MyWindow();
 }; 
 
+//glMultiDrawElements is OpenGL 1.4 and Windows only exports 1.1, so it is looked up once there is a context
+typedef void (APIENTRY *MultiDrawElementsProc)(GLenum mode, const GLsizei* count, GLenum type, const GLvoid* const* indices, GLsizei drawCount);
+
+struct MeshCulling
+{
+	bool bEnabled;			// C toggles dropping meshlets outside the view
+	bool bCullBackfaces;	// B toggles dropping back faces, which also hides the far side of open surfaces
+	MultiDrawElementsProc multiDrawElements;	// NULL draws the visible ranges copied into one index buffer
+	std::vector<MeshletDrawRange> ranges;
+	std::vector<MeshletDrawRange> clipped;	// The visible ranges of one material
+	std::vector<GLsizei> counts;
+	std::vector<const GLvoid*> offsets;
+	std::vector<long> indices;
+	long submittedTriangles;	// In the last frame
+	long culledTriangles;
+	long drawCalls;				// Of the last frame of a scene
+	std::string title;			// Shown with these counts, set again only when they change
+
+	MeshCulling();
+};
+
+//everything drawn of one file, built by a load thread and only touched by
+//the render thread once the load is done
+struct ViewerModel
+{
+	OBJClass obj;
+	OBJScene scene;				// Drawn instead of obj when a scene file is opened
+	MeshBVH bvh;
+	QuantizedMesh compact;		// Positions and normals drawn from 16 bits, obj's float ones are freed
+	std::wstring fileName;
+	bool bCompact;				// Set before the load, which then builds compact
+};
+
+//a model loading on its own thread, the render thread polls bDone and then
+//joins the thread and takes the model, a cancelled load is joined the same way
+struct ViewerLoad
+{
+	ViewerModel* model;
+	std::thread thread;
+	std::atomic<bool> bCancelled;
+	std::atomic<bool> bDone;		// Set last by the load thread, the model is complete once it reads true
+	int result;					// 0 or -1, written before bDone
+};
+
+//the changes of the file drawn, read on their own thread while the model is
+//drawn and written into it by the render thread between frames
+struct ViewerReload
+{
+	std::thread thread;
+	OBJFileChanges changes;
+	std::atomic<bool> bDone;		// Set last by the reload thread
+	int result;					// Of FindChanges, written before bDone
+};
+
 void MoveCamera (int &rotX, int &rotY);
-void Display(OBJClass &objmodel, bool &wireframeToggle, int &rotX, int &rotY);
+float PlaceCamera(float radius);
+void PickModel(OBJClass &objmodel, MeshBVH &bvh, int &x, int &y, int &rotX, int &rotY);
+int QuantizeModel(OBJClass &objmodel, QuantizedMesh &compact);
+void Display(ViewerModel &model, bool &wireframeToggle, int &rotX, int &rotY, MeshCulling &culling);
+void DrawFrame(MyWindow &window, ViewerModel &model, bool &wireframeToggle, int &rotX, int &rotY, MeshCulling &culling,
+	FrameStats &frames);
+void WriteStats(OBJClass &objmodel, FrameStats &frames);
 void DrawAxis();
 void DrawText(std::string &text, float &x, float &y, void *font);
-void DrawModel(OBJClass &objmodel, bool &wireframeToggle);
+void DrawModel(OBJClass &objmodel, bool &wireframeToggle, float &pixelsPerUnit, MeshCulling &culling, QuantizedMesh &compact);
+void DrawScene(OBJScene &scene, bool &wireframeToggle, MeshCulling &culling);
 void InitGL(int &width, int &height, float &fovangle, float &znear, float &zfar);
 
 MyWindow::MyWindow()
@@ -70,35 +149,240 @@ MyWindow::MyWindow()
 	fovAngle = zNear = zFar = 0.0f;	
 }
 
-void DrawModel(OBJClass &objmodel, bool &wireframeToggle) 
+MeshCulling::MeshCulling()
+{
+	bEnabled = true;
+	bCullBackfaces = false;
+	multiDrawElements = NULL;
+	submittedTriangles = culledTriangles = drawCalls = 0;
+}
+
+//tests the meshlets of the full level against the current matrices, returns
+//the number of visible ranges or -1 when everything has to be drawn
+static long CullModel(OBJClass &objmodel, MeshCulling &culling)
+{
+	GLfloat modelview[16], projection[16];
+	MeshletView view;
+	long visibleTriangles, rangeCount;
+
+	//positions carry w = scale, so model units reach eye space through the modelview with its first three columns divided by the scale
+	glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+	glGetFloatv(GL_PROJECTION_MATRIX, projection);
+	for (int i = 0; i < 12; ++i)
+		modelview[i] /= objmodel.GetScale();
+
+	if (SetupMeshletView(modelview, projection, culling.bCullBackfaces, view) == -1)
+		return -1;
+	culling.ranges.resize(objmodel.GetMeshletCount());
+	rangeCount = CullMeshlets(objmodel.GetMeshlets(), objmodel.GetMeshletCount(), view, culling.ranges.data(), visibleTriangles);
+	culling.submittedTriangles = visibleTriangles;
+	culling.culledTriangles = objmodel.GetLevel(0).triangleCount - visibleTriangles;
+	return rangeCount;
+}
+
+//draws ranges of the index buffer the meshlets cut in one call
+static void DrawVisibleRanges(const long* indices, const MeshletDrawRange* ranges, long rangeCount, MeshCulling &culling)
+{
+	long triangles = 0;
+
+	if (rangeCount == 0)
+		return;
+
+	if (culling.multiDrawElements != NULL)
+	{
+		culling.counts.resize(rangeCount);
+		culling.offsets.resize(rangeCount);
+		for (long i = 0; i < rangeCount; ++i)
+		{
+			culling.counts[i] = (GLsizei)(ranges[i].triangleCount*3);
+			culling.offsets[i] = indices + 3*ranges[i].firstTriangle;
+		}
+		culling.multiDrawElements(GL_TRIANGLES, culling.counts.data(), GL_UNSIGNED_INT, culling.offsets.data(), (GLsizei) rangeCount);
+	}
+	else
+	{
+		for (long i = 0; i < rangeCount; ++i)
+			triangles += ranges[i].triangleCount;
+		culling.indices.resize(triangles*3);
+		long* next = culling.indices.data();
+		for (long i = 0; i < rangeCount; ++i)
+		{
+			const long* first = indices + 3*ranges[i].firstTriangle;
+			next = std::copy(first, first + 3*ranges[i].triangleCount, next);
+		}
+		glDrawElements(GL_TRIANGLES, triangles*3, GL_UNSIGNED_INT, culling.indices.data());
+	}
+}
+
+//draws the level one material at a time in its diffuse colour, with culling
+//the visible ranges are cut to each material, both lists run in triangle order
+static void DrawLevel(OBJClass &objmodel, const OBJLevelOfDetail &lod, long visibleCount, MeshCulling &culling)
+{
+	OBJMaterialRange whole = {0, lod.triangleCount, 0};
+	const OBJMaterialRange* materials = lod.ranges != NULL ? lod.ranges : &whole;
+	long materialCount = lod.ranges != NULL ? lod.rangeCount : 1;
+	long visible = 0;
+
+	for (long m = 0; m < materialCount; ++m)
+	{
+		long first = materials[m].firstTriangle, last = first + materials[m].triangleCount;
+
+		if (lod.ranges != NULL)
+		{
+			const OBJMaterial &material = objmodel.GetMaterial(materials[m].material);
+			glColor4f(material.diffuse[0], material.diffuse[1], material.diffuse[2], material.opacity);
+		}
+		if (visibleCount < 0)
+		{
+			glDrawElements(GL_TRIANGLES, materials[m].triangleCount*3, GL_UNSIGNED_INT, lod.indices + 3*first);
+			continue;
+		}
+
+		//a visible range may go on into the next material, so it is only skipped once it ends before this one
+		while (visible < visibleCount && culling.ranges[visible].firstTriangle + culling.ranges[visible].triangleCount <= first)
+			++visible;
+		culling.clipped.clear();
+		for (long i = visible; i < visibleCount && culling.ranges[i].firstTriangle < last; ++i)
+		{
+			MeshletDrawRange range;
+			range.firstTriangle = std::max(first, culling.ranges[i].firstTriangle);
+			range.triangleCount = std::min(last, culling.ranges[i].firstTriangle + culling.ranges[i].triangleCount) -
+				range.firstTriangle;
+			culling.clipped.push_back(range);
+		}
+		DrawVisibleRanges(lod.indices, culling.clipped.data(), (long) culling.clipped.size(), culling);
+	}
+	glColor3f(1.0f,1.0f,1.0f);
+}
+
+//pixelsPerUnit is the size on screen of one drawing unit at the model's centre
+void DrawModel(OBJClass &objmodel, bool &wireframeToggle, float &pixelsPerUnit, MeshCulling &culling, QuantizedMesh &compact) 
 {    
-	if (objmodel.GetVertexBuffer() != NULL)
+	if (objmodel.GetIndexBufferV() != NULL)
 	{
+		//the coarsest level whose error stays under LOD_PIXEL_ERROR on screen
+		int level = 0;
+		for (int i = objmodel.GetLevelCount() - 1; i > 0 && level == 0; --i)
+		{
+			if (objmodel.GetLevel(i).error/objmodel.GetScale()*pixelsPerUnit <= LOD_PIXEL_ERROR)
+				level = i;
+		}
+		const OBJLevelOfDetail &lod = objmodel.GetLevel(level);
+
+		//meshlets cut the full level only, the simplified ones are small enough to draw whole
+		bool bCull = culling.bEnabled && level == 0 && objmodel.GetMeshletCount() > 0;
+		culling.submittedTriangles = lod.triangleCount;
+		culling.culledTriangles = 0;
+
 		if (wireframeToggle)
 			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 		else
 			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		if (culling.bCullBackfaces)
+			glEnable(GL_CULL_FACE);
+		else
+			glDisable(GL_CULL_FACE);
+
+		//positions are in model units with w = scale, so the centroid moves to
+		//the origin by its model position divided by the scale
+		const float* center = objmodel.GetCenter();
+		float scale = objmodel.GetScale();
+		glPushMatrix();
+		glTranslatef(-center[0]/scale, -center[1]/scale, -center[2]/scale);
+		long rangeCount = bCull ? CullModel(objmodel, culling) : -1;
 
 		glColor3f(1.0f,1.0f,1.0f);	
  		glEnableClientState(GL_VERTEX_ARRAY);		// Enable vertex arrays
+
+		//quantized positions are steps from the box centre, the modelview turns
+		//them back into drawing units and GL_NORMALIZE undoes its scaling of the
+		//normals, which are snorm16 that OpenGL maps to -1 to 1
+		if (!compact.IsEmpty())
+		{
+			const float* origin = compact.GetOrigin();
+			glTranslatef(origin[0]/scale, origin[1]/scale, origin[2]/scale);
+			glScalef(compact.GetStep()/scale, compact.GetStep()/scale, compact.GetStep()/scale);
+			glEnable(GL_NORMALIZE);
+			glVertexPointer(3, GL_SHORT, 0, compact.GetPositions());
+		}
+		else
+			glVertexPointer(4,GL_FLOAT,	0, objmodel.GetVertexBuffer());
  	
-		if (objmodel.HasNormals())
+		if (compact.IsEmpty() ? objmodel.HasNormals() : compact.HasNormals())
 		{
 			glEnableClientState(GL_NORMAL_ARRAY);		// Enable normal arrays
 			//glVertexPointer(4,GL_FLOAT,	0, objmodel.GetFacesTriangles());// Vertex Pt to triangle array
-			glVertexPointer(4,GL_FLOAT,	0, objmodel.GetVertexBuffer());
-			glNormalPointer(GL_FLOAT, 0, objmodel.GetNormalBuffer());						// Normal pointer to normal array
+			if (!compact.IsEmpty())
+				glNormalPointer(GL_SHORT, 0, compact.GetNormals());
+			else
+				glNormalPointer(GL_FLOAT, 0, objmodel.GetNormalBuffer());						// Normal pointer to normal array
 			//glDrawArrays(GL_TRIANGLES, 0, objmodel.mFaceCount*3);		// Draw the triangles
-			glDrawElements(GL_TRIANGLES, objmodel.GetTotalConnectTriangles(), GL_UNSIGNED_INT, objmodel.GetIndexBufferV());
+			DrawLevel(objmodel, lod, rangeCount, culling);
 			glDisableClientState(GL_NORMAL_ARRAY);		// Disable normal arrays	
 		}
 		else
+			DrawLevel(objmodel, lod, rangeCount, culling);
+		glDisableClientState(GL_VERTEX_ARRAY);	// Disable vertex arrays			
+		glDisable(GL_NORMALIZE);
+		glPopMatrix();
+	}
+}
+
+//draws every instance of the scene from its shared pools, which are bound
+//once, each instance is moved by its transform once and draws the ranges
+//of its mesh, setting the colour of each
+void DrawScene(OBJScene &scene, bool &wireframeToggle, MeshCulling &culling)
+{
+	const float* center = scene.GetCenter();
+	float scale = scene.GetScale();
+	long drawCalls = 0;
+
+	if (wireframeToggle)
+		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+	else
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	if (culling.bCullBackfaces)
+		glEnable(GL_CULL_FACE);
+	else
+		glDisable(GL_CULL_FACE);
+
+	//scene units to drawing units around the centre, instances may scale so normals are renormalized
+	glPushMatrix();
+	glScalef(1.0f/scale, 1.0f/scale, 1.0f/scale);
+	glTranslatef(-center[0], -center[1], -center[2]);
+	glEnable(GL_NORMALIZE);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glVertexPointer(4, GL_FLOAT, 0, scene.GetPositions());
+	glNormalPointer(GL_FLOAT, 0, scene.GetNormals());
+
+	for (int m = 0; m < scene.GetMeshCount(); ++m)
+	{
+		const OBJSceneMesh &mesh = scene.GetMesh(m);
+		const OBJMaterialRange* ranges = scene.GetRanges() + mesh.firstRange;
+		long instanceCount = (long)(mesh.transforms.size() / 16);
+
+		for (long i = 0; i < instanceCount; ++i)
 		{
-			glVertexPointer(4,GL_FLOAT,	0, objmodel.GetVertexBuffer());
-			glDrawElements(GL_TRIANGLES, objmodel.GetTotalConnectTriangles(), GL_UNSIGNED_INT, objmodel.GetIndexBufferV());
+			glPushMatrix();
+			glMultMatrixf(mesh.transforms.data() + 16*i);
+			for (long r = 0; r < mesh.rangeCount; ++r)
+			{
+				const OBJMaterial &material = scene.GetMaterial(ranges[r].material);
+				glColor4f(material.diffuse[0], material.diffuse[1], material.diffuse[2], material.opacity);
+				glDrawElements(GL_TRIANGLES, ranges[r].triangleCount*3, GL_UNSIGNED_INT, scene.GetIndices() + 3*ranges[r].firstTriangle);
+			}
+			glPopMatrix();
 		}
-		glDisableClientState(GL_VERTEX_ARRAY);	// Disable vertex arrays			
+		drawCalls += instanceCount*mesh.rangeCount;
 	}
+
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glDisable(GL_NORMALIZE);
+	glPopMatrix();
+	glColor3f(1.0f,1.0f,1.0f);
+	culling.drawCalls = drawCalls;
 }
 
 void DrawAxis()
@@ -167,11 +451,113 @@ void MoveCamera (int &rotX, int &rotY)
     glRotatef( (GLfloat)rotY,0.0f,1.0f,0.0f);  //rotate our camera on the y-axis (up and down)
 }
 
-void Display(OBJClass &objmodel, bool &wireframeToggle, int &rotX, int &rotY) 
+//loads the view matrix for a bounding sphere of radius drawing units, returns
+//the size on screen of one drawing unit at the sphere's centre
+float PlaceCamera(float radius)
 {
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	glLoadIdentity();
-	gluLookAt( 10,3,10, 0, 0, 0, 0, 1, 0);
+
+	//back off along the usual view direction until the bounding sphere fits the view
+	float distance = sqrtf(10*10 + 3*3 + 10*10);
+	if (radius > 0.0f)
+		distance = 1.1f*radius / sinf(FOV_ANGLE*0.5f*3.14159265f/180.0f);
+	float pixelsPerUnit = SCREENHEIGHT*0.5f / tanf(FOV_ANGLE*0.5f*3.14159265f/180.0f) / distance;
+	distance /= sqrtf(10*10 + 3*3 + 10*10);
+	gluLookAt( 10*distance,3*distance,10*distance, 0, 0, 0, 0, 1, 0);
+	return pixelsPerUnit;
+}
+
+//casts a ray through window pixel x, y with the matrices Display draws with
+//and prints the first triangle it hits
+void PickModel(OBJClass &objmodel, MeshBVH &bvh, int &x, int &y, int &rotX, int &rotY)
+{
+	GLdouble modelview[16], projection[16], nearPoint[3], farPoint[3];
+	GLint viewport[4];
+	float origin[3], direction[3], length = 0.0f;
+	BVHHit hit;
+
+	if (bvh.IsEmpty())
+		return;
+
+	glPushMatrix();
+	PlaceCamera(objmodel.GetRadius()/objmodel.GetScale());
+	MoveCamera(rotX, rotY);
+	glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+	glPopMatrix();
+	glGetDoublev(GL_PROJECTION_MATRIX, projection);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	//window rows count from the bottom in OpenGL and from the top in SDL
+	GLdouble winX = x + 0.5, winY = viewport[3] - y - 0.5;
+	if (gluUnProject(winX, winY, 0.0, modelview, projection, viewport, &nearPoint[0], &nearPoint[1], &nearPoint[2]) != GL_TRUE ||
+		gluUnProject(winX, winY, 1.0, modelview, projection, viewport, &farPoint[0], &farPoint[1], &farPoint[2]) != GL_TRUE)
+		return;
+
+	//back from drawing units to model units, DrawModel divides by the scale after moving the centre
+	const float* center = objmodel.GetCenter();
+	float scale = objmodel.GetScale();
+	for (int i = 0; i < 3; ++i)
+	{
+		origin[i] = (float) nearPoint[i]*scale + center[i];
+		direction[i] = (float)(farPoint[i] - nearPoint[i])*scale;
+		length += direction[i]*direction[i];
+	}
+	length = sqrtf(length);
+
+	//the ray runs from the near plane at t = 0 to the far plane at t = 1
+	if (!bvh.Intersect(origin, direction, 1.0f, hit))
+	{
+		std::cout << "Picked nothing at " << x << ", " << y << std::endl;
+		return;
+	}
+	//the corner with the largest barycentric weight is the nearest vertex
+	const long* corners = objmodel.GetLevel(0).indices + 3*hit.triangle;
+	long vertex = 1.0f - hit.u - hit.v >= std::max(hit.u, hit.v) ? corners[0] : (hit.u >= hit.v ? corners[1] : corners[2]);
+	std::cout << "Picked triangle " << hit.triangle << ", nearest vertex " << vertex << " at (" << origin[0] + hit.distance*direction[0]
+		<< ", " << origin[1] + hit.distance*direction[1] << ", " << origin[2] + hit.distance*direction[2]
+		<< "), " << hit.distance*length << " from the near plane" << std::endl;
+	if (objmodel.GetFaceMaterials() != NULL)
+	{
+		const OBJGroup &group = objmodel.GetGroup(objmodel.GetFaceGroups()[hit.triangle]);
+		std::cout << "Material \"" << objmodel.GetMaterial(objmodel.GetFaceMaterials()[hit.triangle]).name << "\", object \""
+			<< group.object << "\", group \"" << group.name << "\" of " << group.triangleCount << " triangles" << std::endl;
+	}
+}
+
+//builds the compact positions and normals, frees the float ones they replace
+//and prints how far they are off and how much smaller they are, the viewer
+//draws no texture coordinates so those stay out, returns 0 or -1 and leaves
+//the floats to draw from when it fails
+int QuantizeModel(OBJClass &objmodel, QuantizedMesh &compact)
+{
+	auto start = std::chrono::steady_clock::now();
+	if (compact.Build(objmodel.GetVertexBuffer(), 4, objmodel.HasNormals() ? objmodel.GetNormalBuffer() : NULL,
+		NULL, objmodel.GetVertexCount(), objmodel.GetBoundsMin(), objmodel.GetBoundsMax(), 0, NORMALS_SNORM16) == -1 ||
+		objmodel.ReleaseVertexBuffers() == -1)
+	{
+		compact.Release();
+		std::cerr << "Compact attributes unavailable for this model" << std::endl;
+		return -1;
+	}
+	const QuantizationStats &stats = compact.GetStats();
+	std::cout << "Compact attributes in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+		<< " ms: " << stats.floatBytes/1048576.0 << " MB -> " << stats.compactBytes/1048576.0 << " MB ("
+		<< (double) stats.floatBytes/stats.compactBytes << "x), largest error position " << stats.positionError
+		<< " (" << stats.positionError/objmodel.GetRadius()*100.0f << "% of the radius), normal " << stats.normalError
+		<< " degrees" << std::endl;
+	return 0;
+}
+
+void Display(ViewerModel &model, bool &wireframeToggle, int &rotX, int &rotY, MeshCulling &culling) 
+{
+	OBJClass &objmodel = model.obj;
+	OBJScene &scene = model.scene;
+
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	
+	//nothing loaded yet has a radius of 0, which keeps the usual view of the axes
+	float pixelsPerUnit = !scene.IsEmpty() ? PlaceCamera(scene.GetRadius()/scene.GetScale()) :
+		PlaceCamera(objmodel.GetIndexBufferV() != NULL ? objmodel.GetRadius()/objmodel.GetScale() : 0.0f);
 	glPushMatrix();
 		
 	MoveCamera(rotX, rotY);
@@ -180,11 +566,276 @@ void Display(OBJClass &objmodel, bool &wireframeToggle, int &rotX, int &rotY)
 	glColor3f(1.0f,1.0f,1.0f);
 	glLineWidth(1.0f);
 	
-	DrawModel(objmodel, wireframeToggle);
+	if (scene.IsEmpty())
+		DrawModel(objmodel, wireframeToggle, pixelsPerUnit, culling, model.compact);
+	else
+		DrawScene(scene, wireframeToggle, culling);
 	
 	glPopMatrix();
 } 
 
+//draws and shows a frame, timing the GL calls and the swap apart since
+//the swap is where the driver makes the CPU wait for the GPU
+void DrawFrame(MyWindow &window, ViewerModel &model, bool &wireframeToggle, int &rotX, int &rotY, MeshCulling &culling,
+	FrameStats &frames)
+{
+	auto start = std::chrono::steady_clock::now();
+	Display(model, wireframeToggle, rotX, rotY, culling);
+	auto submitted = std::chrono::steady_clock::now();
+	SDL_GL_SwapWindow(window.viewWindow);
+	auto swapped = std::chrono::steady_clock::now();
+	
+	frames.Add(std::chrono::duration<double, std::milli>(submitted - start).count(),
+		std::chrono::duration<double, std::milli>(swapped - submitted).count());
+}
+
+//prints the frame time percentiles and writes them with the load statistics to STATS_FILE
+void WriteStats(OBJClass &objmodel, FrameStats &frames)
+{
+	FramePercentiles percentiles = frames.GetFramePercentiles();
+	std::string json = "{\"load\": " + LoadStatsToJSON(objmodel.GetLoadStats()) + ",\n \"frames\": " + frames.ToJSON() + "}\n";
+	FILE* file = fopen(STATS_FILE, "w");
+	
+	std::cout << frames.GetFrameCount() << " frames, ms p50 " << percentiles.p50 << ", p90 " << percentiles.p90
+		<< ", p99 " << percentiles.p99 << ", max " << percentiles.max << std::endl;
+	if (file == NULL || fputs(json.c_str(), file) < 0)
+		std::cerr << "Could not write " << STATS_FILE << std::endl;
+	else
+		std::cout << "Statistics written to " << STATS_FILE << std::endl;
+	if (file != NULL)
+		fclose(file);
+}
+
+//loads a scene or a model with everything the viewer draws it with, on the
+//thread of the load, returns 0 or -1 and prints nothing once cancelled
+static int LoadModel(ViewerModel &model, std::atomic<bool> &bCancelled)
+{
+	OBJClass &obj = model.obj;
+	OBJScene &scene = model.scene;
+
+	//a scene places many files, each loaded once into its pools
+	if (IsSceneFile(model.fileName.c_str()))
+	{
+		scene.SetUseCache(true);
+		if (scene.Load(model.fileName.c_str()) == -1)
+		{
+			scene.Release();
+			if (!bCancelled)
+				std::cerr << "Scene empty: none of its instances could be loaded" << std::endl;
+			return -1;
+		}
+		const OBJSceneStats &sceneStats = scene.GetStats();
+		std::cout << sceneStats.instanceCount << " instances of " << sceneStats.meshCount << " meshes from " << sceneStats.fileCount
+			<< " files, " << sceneStats.uniqueTriangles << " triangles stored and " << sceneStats.drawnTriangles << " drawn in "
+			<< sceneStats.drawCalls << " calls, pools of " << sceneStats.poolBytes << " bytes and transforms of "
+			<< sceneStats.instanceBytes << " bytes" << std::endl;
+		for (int m = 0; m < scene.GetMeshCount(); ++m)
+		{
+			const OBJSceneMesh &mesh = scene.GetMesh(m);
+			long instanceCount = (long)(mesh.transforms.size() / 16);
+			std::cout << "Mesh " << m << ": " << instanceCount << " instances of " << mesh.rangeCount << " materials drawn in "
+				<< instanceCount*mesh.rangeCount << " calls" << std::endl;
+		}
+		return 0;
+	}
+
+	obj.SetUseCache(true);
+	obj.SetOptimizeVertexCache(true);
+	obj.SetBuildMeshlets(true);
+	obj.SetBuildLevels(true);
+	obj.SetTrackChanges(true);
+	if (obj.Load(&model.fileName[0]) == -1)	
+	{
+		obj.Release();
+		if (!bCancelled)
+			std::cerr << "Model incomplete: " << GetLoadErrorText(obj.GetLoadStats().error) << std::endl;
+		return -1;
+	}		
+	const OBJLoadStats &loadStats = obj.GetLoadStats();
+	std::cout << "Loaded " << loadStats.bytesRead << " bytes in " << loadStats.times.total << " ms, "
+		<< loadStats.lines.faces << " face lines, arenas peaked at " << loadStats.peakBytes << " bytes" << std::endl;
+	std::cout << "Vertex cache ACMR " << obj.GetCacheStatsBefore().acmr << " -> " << obj.GetCacheStatsAfter().acmr
+		<< ", ATVR " << obj.GetCacheStatsBefore().atvr << " -> " << obj.GetCacheStatsAfter().atvr << std::endl;
+	const MeshletStats &meshletStats = obj.GetMeshletStats();
+	std::cout << meshletStats.meshletCount << " meshlets, vertex fill " << meshletStats.vertexFill
+		<< ", triangle fill " << meshletStats.triangleFill << ", sphere tightness " << meshletStats.sphereTightness
+		<< ", cullable cones " << meshletStats.coneCulling << std::endl;
+	if (obj.GetMaterialCount() > 0)
+		std::cout << obj.GetMaterialCount() << " materials drawn in " << obj.GetLevel(0).rangeCount << " batches, "
+			<< obj.GetGroupCount() << " groups" << std::endl;
+	for (int i = 1; i < obj.GetLevelCount(); ++i)
+		std::cout << "Level " << i << ": " << obj.GetLevel(i).triangleCount << " triangles, error " << obj.GetLevel(i).error << std::endl;
+
+	if (bCancelled)
+		return -1;
+	auto bvhStart = std::chrono::steady_clock::now();
+	if (model.bvh.Build(obj.GetVertexBuffer(), 4, obj.GetLevel(0).indices, obj.GetLevel(0).triangleCount, 0) == -1)
+		std::cerr << "Picking unavailable, the model is too large for the BVH" << std::endl;
+	else
+		std::cout << "BVH with " << model.bvh.GetNodeCount() << " nodes, depth " << model.bvh.GetDepth() << ", built in "
+			<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - bvhStart).count() << " ms" << std::endl;
+
+	//last, since the BVH copies the float positions the compact ones replace
+	if (bCancelled)
+		return -1;
+	if (model.bCompact)
+		QuantizeModel(obj, model.compact);
+	return 0;
+}
+
+//starts loading a file on a new thread, the window keeps drawing the model it has meanwhile
+static ViewerLoad* StartLoad(const wchar_t* fileName, bool bCompact)
+{
+	ViewerLoad* load = new ViewerLoad();
+
+	load->model = new ViewerModel();
+	load->model->fileName = fileName;
+	load->model->bCompact = bCompact;
+	load->bCancelled = false;
+	load->bDone = false;
+	load->result = -1;
+	load->thread = std::thread([load]()
+	{
+		load->result = LoadModel(*load->model, load->bCancelled);
+		load->bDone = true;
+	});
+	return load;
+}
+
+//stops a load at its next check, from the render thread, the load still has to be joined
+static void CancelLoad(ViewerLoad* load)
+{
+	load->bCancelled = true;
+	load->model->obj.Cancel();
+	load->model->scene.Cancel();
+}
+
+//0 to 1 through the file, a scene counts through its scene file
+static float GetLoadProgress(ViewerLoad* load)
+{
+	if (IsSceneFile(load->model->fileName.c_str()))
+		return load->model->scene.GetLoadProgress();
+	return load->model->obj.GetLoadProgress();
+}
+
+//joins the loads that have finished without waiting for the others, a load
+//that succeeded replaces the model drawn, returns whether it did
+static bool FinishLoads(ViewerLoad* &loading, std::vector<ViewerLoad*> &cancelled, ViewerModel* &model)
+{
+	for (size_t i = 0; i < cancelled.size(); )
+	{
+		if (cancelled[i]->bDone)
+		{
+			cancelled[i]->thread.join();
+			delete cancelled[i]->model;
+			delete cancelled[i];
+			cancelled.erase(cancelled.begin() + i);
+		}
+		else
+			++i;
+	}
+	if (loading == NULL || !loading->bDone)
+		return false;
+
+	ViewerLoad* load = loading;
+	bool bSwapped = load->result == 0;
+	loading = NULL;
+	load->thread.join();
+	if (bSwapped)
+		std::swap(model, load->model);	// The model drawn before is freed with the load
+	delete load->model;
+	delete load;
+	return bSwapped;
+}
+
+//cancels every load and waits for them, before the window goes away
+static void StopLoads(ViewerLoad* &loading, std::vector<ViewerLoad*> &cancelled)
+{
+	if (loading != NULL)
+	{
+		CancelLoad(loading);
+		cancelled.push_back(loading);
+		loading = NULL;
+	}
+	for (size_t i = 0; i < cancelled.size(); ++i)
+	{
+		cancelled[i]->thread.join();
+		delete cancelled[i]->model;
+		delete cancelled[i];
+	}
+	cancelled.clear();
+}
+
+//reads what changed in the file of the model drawn on a new thread, which
+//only reads the model, so it has to stay until the reload is finished
+static ViewerReload* StartReload(ViewerModel* model)
+{
+	ViewerReload* reload = new ViewerReload();
+
+	reload->bDone = false;
+	reload->result = -1;
+	reload->thread = std::thread([reload, model]()
+	{
+		reload->result = model->obj.FindChanges(model->fileName.c_str(), reload->changes);
+		reload->bDone = true;
+	});
+	return reload;
+}
+
+//writes the changes into the model once they are read, with the picking
+//tree refitted, changes that cannot be patched in start a load of the
+//whole file instead, returns whether the model changed
+static bool FinishReload(ViewerReload* &reload, ViewerModel* model, ViewerLoad* &loading)
+{
+	if (reload == NULL || !reload->bDone)
+		return false;
+
+	OBJClass &obj = model->obj;
+	reload->thread.join();
+	bool bPatched = reload->result == 0 && obj.ApplyChanges(reload->changes) == 0;
+	delete reload;
+	reload = NULL;
+	if (!bPatched)
+	{
+		std::cout << "The file changed beyond what can be patched in, loading all of it again" << std::endl;
+		if (loading == NULL)
+			loading = StartLoad(model->fileName.c_str(), model->bCompact);
+		return false;
+	}
+	std::cout << "Patched " << obj.GetLoadStats().bytesRead << " bytes in " << obj.GetLoadTimes().total << " ms" << std::endl;
+	model->bvh.Refit(obj.GetVertexBuffer(), 4, obj.GetLevel(0).indices, 0);
+	return true;
+}
+
+//shows what the last frame drew in the title, which is only set when that
+//changed, the loop leaves the title to the progress while a load runs
+static void ShowFrameCounts(MyWindow &window, ViewerModel &model, MeshCulling &culling)
+{
+	std::string title = window.title;
+
+	if (!model.scene.IsEmpty())
+		title += " " + std::to_string(model.scene.GetStats().drawnTriangles) + " triangles of " +
+			std::to_string(model.scene.GetStats().instanceCount) + " instances drawn in " + std::to_string(culling.drawCalls) + " calls";
+	else if (model.obj.GetIndexBufferV() != NULL)
+		title += " " + std::to_string(culling.submittedTriangles) + " triangles drawn, " +
+			std::to_string(culling.culledTriangles) + " culled";
+	if (title != culling.title)
+	{
+		culling.title = title;
+		SDL_SetWindowTitle(window.viewWindow, title.c_str());
+	}
+}
+
+//waits for a reload to end and drops what it read, before another load or the end
+static void StopReload(ViewerReload* &reload)
+{
+	if (reload == NULL)
+		return;
+	reload->thread.join();
+	delete reload;
+	reload = NULL;
+}
+
 //setting up matrices, lights, shading, etc
 void InitGL(int &width, int &height, float &fovangle, float &znear, float &zfar) 
 {
@@ -228,15 +879,24 @@ int main(int argc, char *argv[])
 	const unsigned char *version;
 	
 	bool isRotatingCamera = false, wireframeToggle = false;	
+	bool bCompact = false;			// Q draws from 16 bit positions and normals, which frees the float ones
+	bool hasMouseMoved = false;		// Between pressing and releasing the left button, a click without moving picks
 	int mousePosition[2] = {0, 0};
 	int mouseDiff[2] = {0, 0};
 	int rotation[2] = {0, 0};
 	
 	OPENFILENAME opdlg = {0}; //ZeroMemory(&opdlg, sizeof(opdlg)); 
 	wchar_t fileName[250];
-	const wchar_t filter[] = L"OBJ Files\0*.obj\0All Files\0*.*\0";
+	const wchar_t filter[] = L"OBJ Files\0*.obj;*.objpack;*.objscene\0All Files\0*.*\0";
 	MyWindow window1;
-	OBJClass obj;
+	ViewerModel* model = new ViewerModel();		// Drawn, empty until the first load is done
+	ViewerLoad* loading = NULL;					// Replaces model once done, opening another file cancels it
+	std::vector<ViewerLoad*> cancelledLoads;	// Joined as they stop, so the window never waits for them
+	int loadPercent = -1;						// Shown in the title while loading
+	FileWatcher watcher;						// On the file of the model drawn
+	ViewerReload* reload = NULL;				// Of that file once it changed, never while a load runs
+	MeshCulling culling;
+	FrameStats frames;			// Of the last frames drawn, S writes them out
 	
 	opdlg.lStructSize = sizeof(opdlg);
 	opdlg.hwndOwner = GetForegroundWindow(); //=NULL;
@@ -256,16 +916,13 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 		
-	if (obj.Load(fileName) == -1)	
-	{
-		obj.Release();
-		std::cerr << "Model incomplete" << std::endl;
-		return 1;
-	}		
+	//the load runs while the window opens, the window shows the progress until it is done
+	loading = StartLoad(fileName, bCompact);
     
 	if (SDL_Init(SDL_INIT_EVERYTHING) < 0) 
 	{
-		obj.Release();
+		StopLoads(loading, cancelledLoads);
+		delete model;
 		std::cerr << "There was an error initing SDL2: " << SDL_GetError() << std::endl;
 		return 1;
 	}
@@ -276,7 +933,7 @@ int main(int argc, char *argv[])
 	window1.width = SCREENWIDTH;
 	window1.height = SCREENHEIGHT;
 	window1.title = "OpenGL+SDL OBJ Viewer."; 
-	window1.fovAngle = 45;
+	window1.fovAngle = FOV_ANGLE;
 	window1.zNear = 1.0f;
 	window1.zFar = 500.0f;	
 
@@ -286,7 +943,8 @@ int main(int argc, char *argv[])
  
 	if (window1.viewWindow == NULL) 
 	{
-		obj.Release();
+		StopLoads(loading, cancelledLoads);
+		delete model;
 		std::cerr << "There was an error creating the window: " << SDL_GetError() << std::endl;
 		return 1;
 	}
@@ -294,7 +952,8 @@ int main(int argc, char *argv[])
 	context = SDL_GL_CreateContext(window1.viewWindow);
 	if (context == NULL) 
 	{
-		obj.Release();
+		StopLoads(loading, cancelledLoads);
+		delete model;
 		SDL_DestroyWindow(window1.viewWindow);
 		std::cerr << "There was an error creating OpenGL context: " << SDL_GetError() << std::endl;
 		return 1;
@@ -303,7 +962,8 @@ int main(int argc, char *argv[])
 	version = glGetString(GL_VERSION);
 	if (version == NULL) 
 	{
-		obj.Release();
+		StopLoads(loading, cancelledLoads);
+		delete model;
 		SDL_DestroyWindow(window1.viewWindow);
 		std::cerr << "There was an error with OpenGL configuration:" << std::endl;
 		return 1;
@@ -312,11 +972,11 @@ int main(int argc, char *argv[])
 	SDL_GL_MakeCurrent(window1.viewWindow, context);
  
 	InitGL(window1.width, window1.height, window1.fovAngle, window1.zNear, window1.zFar);
+	culling.multiDrawElements = (MultiDrawElementsProc) SDL_GL_GetProcAddress("glMultiDrawElements");
 	
 	//drawing on the 1st frame, 
 	//only redraw when rotating camera, setting wireframe mode, resetting camera, and restoring window
-	Display(obj, wireframeToggle, rotation[0], rotation[1]);
-	SDL_GL_SwapWindow(window1.viewWindow);	
+	DrawFrame(window1, *model, wireframeToggle, rotation[0], rotation[1], culling, frames);
 	
 	while (!boolToExit)
 	{
@@ -334,6 +994,47 @@ int main(int argc, char *argv[])
 						// case SDLK_LEFT:
 							// key_left = false;
 							// break;
+						case SDLK_c: //c toggles culling meshlets outside the view
+							culling.bEnabled = !culling.bEnabled;
+							DrawFrame(window1, *model, wireframeToggle, rotation[0], rotation[1], culling, frames);
+							break;
+						case SDLK_q: //q toggles drawing the compact positions and normals
+							bCompact = !bCompact;
+							//a load running keeps what it started with, the floats freed come back with a load of the file
+							if (loading == NULL && model->scene.IsEmpty() && model->obj.GetIndexBufferV() != NULL)
+							{
+								StopReload(reload);
+								if (bCompact && model->compact.IsEmpty())
+									QuantizeModel(model->obj, model->compact);
+								else if (!bCompact && !model->compact.IsEmpty())
+								{
+									loading = StartLoad(model->fileName.c_str(), false);
+									loadPercent = -1;
+								}
+							}
+							DrawFrame(window1, *model, wireframeToggle, rotation[0], rotation[1], culling, frames);
+							break;
+						case SDLK_b: //b toggles culling back faces
+							culling.bCullBackfaces = !culling.bCullBackfaces;
+							DrawFrame(window1, *model, wireframeToggle, rotation[0], rotation[1], culling, frames);
+							break;
+						case SDLK_s: //s prints the frame times and writes the statistics file
+							WriteStats(model->obj, frames);
+							break;
+						case SDLK_o: //o opens another file, cancelling the one still loading
+							opdlg.hwndOwner = GetForegroundWindow();
+							if (GetOpenFileName(&opdlg))
+							{
+								if (loading != NULL)
+								{
+									CancelLoad(loading);
+									cancelledLoads.push_back(loading);
+								}
+								StopReload(reload);
+								loading = StartLoad(fileName, bCompact);
+								loadPercent = -1;
+							}
+							break;
 						default:							
 							break;	
 			        }
@@ -347,6 +1048,8 @@ int main(int argc, char *argv[])
 					{
 						mouseDiff[0] = event.motion.y - mousePosition[1];
 						mouseDiff[1] = event.motion.x - mousePosition[0]; //mouse left and right affect y axis rotation
+						if (mouseDiff[0] != 0 || mouseDiff[1] != 0)
+							hasMouseMoved = true;
 						
 						rotation[0] += mouseDiff[0]; //set the xrot to xrot with the addition	 of the difference in the y position
 						rotation[1] += mouseDiff[1];    //set the xrot to yrot with the addition	 of the difference in the x position
@@ -355,8 +1058,7 @@ int main(int argc, char *argv[])
 						if (rotation[1] >360)	rotation[1] -= 360;
 						if (rotation[1] <-360)	rotation[1] += 360;
 						
-						Display(obj, wireframeToggle, rotation[0], rotation[1]);
-						SDL_GL_SwapWindow(window1.viewWindow);
+						DrawFrame(window1, *model, wireframeToggle, rotation[0], rotation[1], culling, frames);
 					}					
 				
 					mousePosition[0] = event.motion.x;
@@ -369,19 +1071,18 @@ int main(int argc, char *argv[])
 					{
 						case SDL_BUTTON_LEFT: //left button for rotating camera
 							isRotatingCamera = true;
+							hasMouseMoved = false;
 							SDL_GetMouseState(&mousePosition[0], &mousePosition[1]);
 							break;
 						case SDL_BUTTON_MIDDLE: //middle button for wireframe
 							wireframeToggle = !wireframeToggle;
 
-							Display(obj, wireframeToggle, rotation[0], rotation[1]);
-							SDL_GL_SwapWindow(window1.viewWindow);
+							DrawFrame(window1, *model, wireframeToggle, rotation[0], rotation[1], culling, frames);
 							break;
 						case SDL_BUTTON_RIGHT: //right button for resetting camera
 							rotation[0] = rotation[1] = 0;
 							
-							Display(obj, wireframeToggle, rotation[0], rotation[1]);
-							SDL_GL_SwapWindow(window1.viewWindow);							
+							DrawFrame(window1, *model, wireframeToggle, rotation[0], rotation[1], culling, frames);
 							break;
 						default:							
 							break;
@@ -389,6 +1090,8 @@ int main(int argc, char *argv[])
 					break;
 					
 				case SDL_MOUSEBUTTONUP:
+					if (event.button.button == SDL_BUTTON_LEFT && isRotatingCamera && !hasMouseMoved) //left click without dragging picks
+						PickModel(model->obj, model->bvh, event.button.x, event.button.y, rotation[0], rotation[1]);
 					isRotatingCamera = false;
 					//SDL_GetMouseState(&mousePosition[0], &mousePosition[1]);
 					break;
@@ -396,20 +1099,63 @@ int main(int argc, char *argv[])
 				case SDL_WINDOWEVENT:
 					if (event.window.event == SDL_WINDOWEVENT_RESTORED)
 					{
-						Display(obj, wireframeToggle, rotation[0], rotation[1]);
-						SDL_GL_SwapWindow(window1.viewWindow);
+						DrawFrame(window1, *model, wireframeToggle, rotation[0], rotation[1], culling, frames);
 					}
 					break;
 					
 				default:
 					break;
 			}		
-		}			
+		}
+
+		//the model swaps in between frames, so drawing never waits on the load,
+		//a load that failed leaves the model drawn before
+		bool bWasLoading = loading != NULL;
+		if (FinishLoads(loading, cancelledLoads, model))
+		{
+			frames.Reset();
+			watcher.Watch(model->fileName.c_str());
+		}
+		//an edit of the file drawn is patched in between frames the same way,
+		//a scene, or a model whose float positions were freed, is loaded again as a whole
+		if (FinishReload(reload, model, loading))
+			DrawFrame(window1, *model, wireframeToggle, rotation[0], rotation[1], culling, frames);
+		else if (loading == NULL && reload == NULL && watcher.HasChanged())
+		{
+			if (IsSceneFile(model->fileName.c_str()) || !model->compact.IsEmpty())
+				loading = StartLoad(model->fileName.c_str(), bCompact);
+			else
+				reload = StartReload(model);
+		}
+		if (bWasLoading && loading == NULL)
+		{
+			loadPercent = -1;
+			culling.title.clear();		// The progress shown goes
+			DrawFrame(window1, *model, wireframeToggle, rotation[0], rotation[1], culling, frames);
+		}
+		else if (loading != NULL && (int)(GetLoadProgress(loading)*100.0f) != loadPercent)
+		{
+			loadPercent = (int)(GetLoadProgress(loading)*100.0f);
+			std::string title = "OpenGL+SDL OBJ Viewer. Loading " + std::to_string(loadPercent) + "%";
+			SDL_SetWindowTitle(window1.viewWindow, title.c_str());
+		}
+		if (loading == NULL)
+			ShowFrameCounts(window1, *model, culling);
+		//sleeps until the next event, or the next look at the loads while any
+		//runs, or at the file drawn while it is watched
+		if (loading != NULL || reload != NULL || !cancelledLoads.empty())
+			SDL_WaitEventTimeout(NULL, LOAD_POLL_MS);
+		else if (watcher.IsWatching())
+			SDL_WaitEventTimeout(NULL, WATCH_POLL_MS);
+		else
+			SDL_WaitEvent(NULL);
 	}
 	
 	SDL_StopTextInput();
 
-	obj.Release();	
+	StopReload(reload);
+	StopLoads(loading, cancelledLoads);
+	delete model;
 	SDL_GL_DeleteContext(context);
 	SDL_DestroyWindow(window1.viewWindow);
 	SDL_Quit();
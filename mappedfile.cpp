@@ -0,0 +1,567 @@
+/*
+Read-only memory mapping of a file for the Wavefront loader
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
+#include <cstdlib>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#endif
+
+#include <chrono>
+#include <cstring>
+#include <cwchar>
+#include <cwctype>
+
+#include "mappedfile.h"
+
+static bool HasExtension(const std::wstring &name, const wchar_t* extension)
+{
+	size_t length = wcslen(extension);
+
+	if (name.size() < length)
+		return false;
+	for (size_t i = 0; i < length; ++i)
+	{
+		if (towlower(name[name.size() - length + i]) != towlower(extension[i]))
+			return false;
+	}
+	return true;
+}
+
+MappedFile::MappedFile()
+{
+	mData = NULL;
+	mSize = 0;
+	mbCopyOnWrite = false;
+#ifdef _WIN32
+	mFileHandle = INVALID_HANDLE_VALUE;
+	mMappingHandle = NULL;
+#else
+	mFileDescriptor = -1;
+#endif
+}
+
+MappedFile::MappedFile(MappedFile&& other) : MappedFile()
+{
+	*this = static_cast<MappedFile&&>(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other)
+{
+	if (this != &other)
+	{
+		Close();
+		mData = other.mData;
+		mSize = other.mSize;
+		mbCopyOnWrite = other.mbCopyOnWrite;
+		other.mData = NULL;
+		other.mSize = 0;
+		other.mbCopyOnWrite = false;
+#ifdef _WIN32
+		mFileHandle = other.mFileHandle;
+		mMappingHandle = other.mMappingHandle;
+		other.mFileHandle = INVALID_HANDLE_VALUE;
+		other.mMappingHandle = NULL;
+#else
+		mFileDescriptor = other.mFileDescriptor;
+		other.mFileDescriptor = -1;
+#endif
+	}
+	return *this;
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+int MappedFile::Open(const wchar_t* fileName, bool bCopyOnWrite)
+{
+	LARGE_INTEGER size;
+
+	Close();
+
+	mFileHandle = CreateFileW(fileName, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (mFileHandle == INVALID_HANDLE_VALUE)
+		return -1;
+
+	//an empty file cannot be mapped
+	if (!GetFileSizeEx(mFileHandle, &size) || size.QuadPart == 0)
+	{
+		Close();
+		return -1;
+	}
+
+	mMappingHandle = CreateFileMappingW(mFileHandle, NULL, bCopyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+	if (mMappingHandle == NULL)
+	{
+		Close();
+		return -1;
+	}
+
+	mData = (char*) MapViewOfFile(mMappingHandle, bCopyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+	if (mData == NULL)
+	{
+		Close();
+		return -1;
+	}
+	mSize = (size_t) size.QuadPart;
+	mbCopyOnWrite = bCopyOnWrite;
+
+	return 0;
+}
+
+void MappedFile::Close()
+{
+	if (mData != NULL)
+	{
+		UnmapViewOfFile(mData);
+		mData = NULL;
+	}
+	if (mMappingHandle != NULL)
+	{
+		CloseHandle(mMappingHandle);
+		mMappingHandle = NULL;
+	}
+	if (mFileHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(mFileHandle);
+		mFileHandle = INVALID_HANDLE_VALUE;
+	}
+	mSize = 0;
+	mbCopyOnWrite = false;
+}
+
+FILE* OpenFile(const wchar_t* fileName, const char* mode)
+{
+	wchar_t wideMode[8] = {0};
+
+	for (int i = 0; i < 7 && mode[i] != '\0'; ++i)
+		wideMode[i] = (wchar_t) mode[i];
+	return _wfopen(fileName, wideMode);
+}
+
+int GetFileStamp(const wchar_t* fileName, unsigned long long &size, unsigned long long &modified)
+{
+	WIN32_FILE_ATTRIBUTE_DATA info;
+
+	if (!GetFileAttributesExW(fileName, GetFileExInfoStandard, &info))
+		return -1;
+	size = ((unsigned long long) info.nFileSizeHigh << 32) | info.nFileSizeLow;
+	modified = ((unsigned long long) info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime;
+	return 0;
+}
+
+int FindFiles(const wchar_t* directory, const wchar_t* extension, std::vector<std::wstring> &files)
+{
+	WIN32_FIND_DATAW entry;
+	std::wstring base = std::wstring(directory) + L"\\";
+	HANDLE find = FindFirstFileW((base + L"*").c_str(), &entry);
+
+	if (find == INVALID_HANDLE_VALUE)
+		return -1;
+	do
+	{
+		std::wstring name = entry.cFileName;
+		if (name == L"." || name == L"..")
+			continue;
+		//reparse points may loop back up the tree
+		if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			if (!(entry.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT))
+				FindFiles((base + name).c_str(), extension, files);
+		}
+		else if (HasExtension(name, extension))
+			files.push_back(base + name);
+	} while (FindNextFileW(find, &entry));
+	FindClose(find);
+	return 0;
+}
+
+int MakeDirectory(const wchar_t* path)
+{
+	if (CreateDirectoryW(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS)
+		return 0;
+	return -1;
+}
+
+int MoveFileOver(const wchar_t* from, const wchar_t* to)
+{
+	return MoveFileExW(from, to, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+}
+
+int RemoveFile(const wchar_t* fileName)
+{
+	return DeleteFileW(fileName) ? 0 : -1;
+}
+
+//the directory signals every write, rename and resize of any file in it,
+//HasChanged tells the file apart by its stamp
+int FileWatcher::StartNotifications()
+{
+	std::wstring directory = GetDirectoryOf(mFileName.c_str());
+
+	mNotification = FindFirstChangeNotificationW(directory.empty() ? L"." : directory.c_str(), FALSE,
+		FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
+	if (mNotification == INVALID_HANDLE_VALUE)
+		mNotification = NULL;
+	return mNotification != NULL ? 0 : -1;
+}
+
+void FileWatcher::StopNotifications()
+{
+	if (mNotification != NULL)
+		FindCloseChangeNotification(mNotification);
+	mNotification = NULL;
+}
+
+bool FileWatcher::ReadNotifications()
+{
+	if (mNotification == NULL)
+		return true;
+	if (WaitForSingleObject(mNotification, 0) != WAIT_OBJECT_0)
+		return false;
+	FindNextChangeNotification(mNotification);
+	return true;
+}
+
+#else
+
+//POSIX paths are narrow, convert using the current locale
+static int NarrowPath(const wchar_t* fileName, std::string &path)
+{
+	size_t length = wcstombs(NULL, fileName, 0);
+	if (length == (size_t) -1)
+		return -1;
+	path.resize(length);
+	wcstombs(&path[0], fileName, length);
+	return 0;
+}
+
+int MappedFile::Open(const wchar_t* fileName, bool bCopyOnWrite)
+{
+	struct stat info;
+	void* view;
+	std::string path;
+
+	Close();
+
+	if (NarrowPath(fileName, path) != 0)
+		return -1;
+
+	mFileDescriptor = open(path.c_str(), O_RDONLY);
+	if (mFileDescriptor < 0)
+		return -1;
+
+	if (fstat(mFileDescriptor, &info) != 0 || info.st_size == 0)
+	{
+		Close();
+		return -1;
+	}
+
+	view = mmap(NULL, (size_t) info.st_size, bCopyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ,
+		MAP_PRIVATE, mFileDescriptor, 0);
+	if (view == MAP_FAILED)
+	{
+		Close();
+		return -1;
+	}
+	madvise(view, (size_t) info.st_size, MADV_SEQUENTIAL);
+
+	mData = (char*) view;
+	mSize = (size_t) info.st_size;
+	mbCopyOnWrite = bCopyOnWrite;
+
+	return 0;
+}
+
+void MappedFile::Close()
+{
+	if (mData != NULL)
+	{
+		munmap(mData, mSize);
+		mData = NULL;
+	}
+	if (mFileDescriptor >= 0)
+	{
+		close(mFileDescriptor);
+		mFileDescriptor = -1;
+	}
+	mSize = 0;
+	mbCopyOnWrite = false;
+}
+
+FILE* OpenFile(const wchar_t* fileName, const char* mode)
+{
+	std::string path;
+
+	if (NarrowPath(fileName, path) != 0)
+		return NULL;
+	return fopen(path.c_str(), mode);
+}
+
+int GetFileStamp(const wchar_t* fileName, unsigned long long &size, unsigned long long &modified)
+{
+	struct stat info;
+	std::string path;
+
+	if (NarrowPath(fileName, path) != 0 || stat(path.c_str(), &info) != 0)
+		return -1;
+	size = (unsigned long long) info.st_size;
+	modified = (unsigned long long) info.st_mtime * 1000000000ull;
+#ifdef __linux__
+	modified += (unsigned long long) info.st_mtim.tv_nsec;
+#endif
+	return 0;
+}
+
+static int WidenPath(const char* path, std::wstring &fileName)
+{
+	size_t length = mbstowcs(NULL, path, 0);
+	if (length == (size_t) -1)
+		return -1;
+	fileName.resize(length);
+	mbstowcs(&fileName[0], path, length);
+	return 0;
+}
+
+int FindFiles(const wchar_t* directory, const wchar_t* extension, std::vector<std::wstring> &files)
+{
+	std::string path;
+	std::wstring name;
+	DIR* listing;
+	struct dirent* entry;
+
+	if (NarrowPath(directory, path) != 0 || (listing = opendir(path.c_str())) == NULL)
+		return -1;
+	while ((entry = readdir(listing)) != NULL)
+	{
+		struct stat info;
+		std::string child = path + "/" + entry->d_name;
+
+		if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0 ||
+			WidenPath(child.c_str(), name) != 0)
+			continue;
+		//lstat, so a symbolic link cannot loop back up the tree
+		if (lstat(child.c_str(), &info) != 0)
+			continue;
+		if (S_ISDIR(info.st_mode))
+			FindFiles(name.c_str(), extension, files);
+		else if (S_ISREG(info.st_mode) && HasExtension(name, extension))
+			files.push_back(name);
+	}
+	closedir(listing);
+	return 0;
+}
+
+int MakeDirectory(const wchar_t* path)
+{
+	std::string narrow;
+
+	if (NarrowPath(path, narrow) != 0)
+		return -1;
+	return mkdir(narrow.c_str(), 0777) == 0 || errno == EEXIST ? 0 : -1;
+}
+
+int MoveFileOver(const wchar_t* from, const wchar_t* to)
+{
+	std::string narrowFrom, narrowTo;
+
+	if (NarrowPath(from, narrowFrom) != 0 || NarrowPath(to, narrowTo) != 0)
+		return -1;
+	return rename(narrowFrom.c_str(), narrowTo.c_str()) == 0 ? 0 : -1;
+}
+
+int RemoveFile(const wchar_t* fileName)
+{
+	std::string narrow;
+
+	if (NarrowPath(fileName, narrow) != 0)
+		return -1;
+	return unlink(narrow.c_str()) == 0 ? 0 : -1;
+}
+
+#ifdef __linux__
+
+//inotify watches the directory, so a file replaced by a rename is still
+//seen, and its events are read without waiting
+int FileWatcher::StartNotifications()
+{
+	std::string directory;
+	std::wstring wideDirectory = GetDirectoryOf(mFileName.c_str());
+
+	if (NarrowPath(mFileName.c_str() + wideDirectory.size(), mName) != 0 ||
+		NarrowPath(wideDirectory.empty() ? L"." : wideDirectory.c_str(), directory) != 0)
+		return -1;
+	mNotifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (mNotifyDescriptor < 0)
+		return -1;
+	if (inotify_add_watch(mNotifyDescriptor, directory.c_str(), IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0)
+	{
+		StopNotifications();
+		return -1;
+	}
+	return 0;
+}
+
+void FileWatcher::StopNotifications()
+{
+	if (mNotifyDescriptor >= 0)
+		close(mNotifyDescriptor);
+	mNotifyDescriptor = -1;
+}
+
+bool FileWatcher::ReadNotifications()
+{
+	alignas(struct inotify_event) char buffer[4096];
+	bool bChanged = false;
+	ssize_t length;
+
+	if (mNotifyDescriptor < 0)
+		return true;
+	while ((length = read(mNotifyDescriptor, buffer, sizeof(buffer))) > 0)
+	{
+		for (char* p = buffer; p < buffer + length; )
+		{
+			const struct inotify_event* event = (const struct inotify_event*) p;
+
+			if (event->len > 0 && mName == event->name)
+				bChanged = true;
+			p += sizeof(struct inotify_event) + event->len;
+		}
+	}
+	return bChanged;
+}
+
+#else
+
+//without notifications every call reads the stamp
+int FileWatcher::StartNotifications()
+{
+	return -1;
+}
+
+void FileWatcher::StopNotifications()
+{
+}
+
+bool FileWatcher::ReadNotifications()
+{
+	return true;
+}
+
+#endif
+
+#endif
+
+std::wstring GetDirectoryOf(const wchar_t* fileName)
+{
+	const wchar_t* slash = NULL;
+
+	for (const wchar_t* c = fileName; *c != L'\0'; ++c)
+	{
+		if (*c == L'/' || *c == L'\\')
+			slash = c;
+	}
+	return std::wstring(fileName, slash != NULL ? slash + 1 : fileName);
+}
+
+//how long the stamp of a changed file has to stay the same before it is reported
+static const unsigned long long WATCH_SETTLE_MS = 100;
+
+static unsigned long long SteadyMilliseconds()
+{
+	return (unsigned long long) std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+FileWatcher::FileWatcher()
+{
+	mSize = mModified = 0;
+	mPendingSize = mPendingModified = mPendingSince = 0;
+	mbPending = false;
+#ifdef _WIN32
+	mNotification = NULL;
+#else
+	mNotifyDescriptor = -1;
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+	Stop();
+}
+
+//a watcher without notifications still works, only by reading the stamp every call
+int FileWatcher::Watch(const wchar_t* fileName)
+{
+	Stop();
+	if (GetFileStamp(fileName, mSize, mModified) != 0)
+		return -1;
+	mFileName = fileName;
+	StartNotifications();
+	return 0;
+}
+
+void FileWatcher::Stop()
+{
+	StopNotifications();
+	mFileName.clear();
+	mbPending = false;
+}
+
+bool FileWatcher::HasChanged()
+{
+	unsigned long long size, modified, now;
+
+	if (mFileName.empty() || (!ReadNotifications() && !mbPending))
+		return false;
+	//a file being replaced may have no stamp for a moment
+	if (GetFileStamp(mFileName.c_str(), size, modified) != 0)
+	{
+		mbPending = true;
+		mPendingSince = SteadyMilliseconds();
+		return false;
+	}
+	if (size == mSize && modified == mModified)
+	{
+		mbPending = false;
+		return false;
+	}
+	now = SteadyMilliseconds();
+	if (!mbPending || size != mPendingSize || modified != mPendingModified)
+	{
+		mbPending = true;
+		mPendingSize = size;
+		mPendingModified = modified;
+		mPendingSince = now;
+		return false;
+	}
+	if (now - mPendingSince < WATCH_SETTLE_MS)
+		return false;
+	mSize = size;
+	mModified = modified;
+	mbPending = false;
+	return true;
+}
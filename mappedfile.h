@@ -0,0 +1,115 @@
+/*
+Read-only memory mapping of a file for the Wavefront loader
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+class MappedFile
+{
+  private:
+	char* mData;	// Start of the mapped view, NULL when closed
+	size_t mSize;
+	bool mbCopyOnWrite;
+#ifdef _WIN32
+	void* mFileHandle;
+	void* mMappingHandle;
+#else
+	int mFileDescriptor;
+#endif
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+ public:
+	MappedFile();
+	MappedFile(MappedFile&& other);		// The view keeps its address
+	MappedFile& operator=(MappedFile&& other);
+	~MappedFile();
+	//maps the whole file, returns 0 or -1, a copy-on-write view can be
+	//modified in memory without the changes reaching the file
+	int Open(const wchar_t* fileName, bool bCopyOnWrite = false);
+	void Close();
+
+	inline const char* GetData(){return mData;};
+	inline char* GetWritableData(){return mbCopyOnWrite ? mData : NULL;};
+	inline size_t GetSize(){return mSize;};
+};
+
+//fopen for wide file names, narrowed with the current locale outside Windows
+FILE* OpenFile(const wchar_t* fileName, const char* mode);
+
+//size and last modification time of a file, returns 0 or -1
+int GetFileStamp(const wchar_t* fileName, unsigned long long &size, unsigned long long &modified);
+
+//adds every file below directory whose name ends in extension, in any
+//case, to files, returns 0 or -1 when directory cannot be read
+int FindFiles(const wchar_t* directory, const wchar_t* extension, std::vector<std::wstring> &files);
+
+//creates a directory, returns 0 when it exists afterwards or -1
+int MakeDirectory(const wchar_t* path);
+
+//renames from to to in one step, replacing a file named to, so a reader
+//sees either the old file or the new one whole, returns 0 or -1
+int MoveFileOver(const wchar_t* from, const wchar_t* to);
+
+//deletes a file, returns 0 or -1
+int RemoveFile(const wchar_t* fileName);
+
+//the directory part of a file name with its separator, empty for a bare name
+std::wstring GetDirectoryOf(const wchar_t* fileName);
+
+//tells when a file was written, woken by the change notifications of its
+//directory where the system has them and reading its stamp on every call
+//otherwise, a change is only reported once the size and modification time
+//stayed the same for a while, so a file still being written is not read
+class FileWatcher
+{
+  private:
+	std::wstring mFileName;		// Empty while not watching
+	unsigned long long mSize;		// Stamp when watching began or the last change was reported
+	unsigned long long mModified;
+	unsigned long long mPendingSize;	// Stamp of a change waiting to settle
+	unsigned long long mPendingModified;
+	unsigned long long mPendingSince;	// Milliseconds of a steady clock
+	bool mbPending;
+#ifdef _WIN32
+	void* mNotification;
+#else
+	int mNotifyDescriptor;		// -1 without notifications
+	std::string mName;			// Without the directory, as the notifications name it
+#endif
+
+	int StartNotifications();
+	void StopNotifications();
+	bool ReadNotifications();	// Whether the file may have changed since the last call
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+ public:
+	FileWatcher();
+	~FileWatcher();
+	//starts watching a file instead of the one before, returns 0 or -1 when it has no stamp
+	int Watch(const wchar_t* fileName);
+	void Stop();
+	//true once for every change that settled, meant to be called every frame or so
+	bool HasChanged();
+	inline bool IsWatching(){return !mFileName.empty();};
+	inline const std::wstring& GetFileName(){return mFileName;};
+};
+
+#endif
@@ -0,0 +1,687 @@
+/*
+Bounding volume hierarchy over the triangles of a mesh for ray queries
+
+Splits are chosen with the surface area heuristic over 16 centroid bins on
+each axis. The top of the tree is built on the calling thread with the
+binning of big nodes spread over threads, every subtree below a fixed size
+is a task of its own, and the tasks are spliced into one depth first array
+afterwards, so the tree is the same on any number of threads. The corners of
+every triangle are copied in leaf order so a leaf reads one run of memory.
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include "meshbvh.h"
+#include "parallel.h"
+
+static const int BVH_BINS = 16;
+
+//a node holding more triangles is always split, fewer are split when the heuristic says so
+static const long BVH_MAX_LEAF = 8;
+
+//cost of visiting a node relative to testing a triangle
+static const float BVH_TRAVERSAL_COST = 1.0f;
+
+//subtrees of at most this many triangles are built as tasks
+static const long BVH_TASK_TRIANGLES = 1 << 14;
+
+//triangles binned per task while the top of the tree is built
+static const long BVH_BINNING_CHUNK = 1 << 16;
+
+//below this depth nodes are halved, which bounds the depth for the traversal stack
+static const int BVH_MEDIAN_DEPTH = 48;
+static const int BVH_STACK_SIZE = 96;
+
+//marks a node of the top of the tree standing in for a task's subtree
+static const unsigned int BVH_TASK_NODE = 0xFFFFFFFFu;
+
+struct Box
+{
+	float min[3];
+	float max[3];
+};
+
+static inline void EmptyBox(Box &box)
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		box.min[i] = FLT_MAX;
+		box.max[i] = -FLT_MAX;
+	}
+}
+
+//on values, with references into memory gcc turns min and max into branches
+static inline void GrowBox(Box &box, const float* min, const float* max)
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		float low = box.min[i], high = box.max[i], a = min[i], b = max[i];
+		box.min[i] = a < low ? a : low;
+		box.max[i] = b > high ? b : high;
+	}
+}
+
+//half the surface, the factor cancels out in every cost
+static inline float HalfArea(const Box &box)
+{
+	float dx = box.max[0] - box.min[0], dy = box.max[1] - box.min[1], dz = box.max[2] - box.min[2];
+	if (dx < 0.0f)
+		return 0.0f;
+	return dx*dy + dy*dz + dz*dx;
+}
+
+struct Bin
+{
+	Box bounds;
+	long count;
+};
+
+struct AxisBins
+{
+	Bin bins[3][BVH_BINS];
+};
+
+//what one pass over a range of slots gathers
+struct RangeBounds
+{
+	Box bounds;
+	Box centroids;
+};
+
+//the box of one triangle, the slots are reordered as whole primitives so
+//every pass over a node reads one run of memory
+struct BuildPrimitive
+{
+	float min[3];
+	unsigned int triangle;
+	float max[3];
+	unsigned int unused;
+};
+
+static inline float Centroid(const BuildPrimitive &primitive, int axis)
+{
+	return 0.5f*(primitive.min[axis] + primitive.max[axis]);
+}
+
+struct BuildTask
+{
+	long first;
+	long count;
+	int depth;
+	std::vector<BVHNode> nodes;
+	int maxDepth;
+};
+
+static void BoundSlots(const BuildPrimitive* primitives, long first, long last, RangeBounds &range)
+{
+	EmptyBox(range.bounds);
+	EmptyBox(range.centroids);
+	for (long s = first; s < last; ++s)
+	{
+		float centroid[3] = {Centroid(primitives[s], 0), Centroid(primitives[s], 1), Centroid(primitives[s], 2)};
+		GrowBox(range.bounds, primitives[s].min, primitives[s].max);
+		GrowBox(range.centroids, centroid, centroid);
+	}
+}
+
+static inline int BinOf(const BuildPrimitive &primitive, int axis, const Box &centroids, float scale)
+{
+	int bin = (int)((Centroid(primitive, axis) - centroids.min[axis])*scale);
+	return std::min(std::max(bin, 0), BVH_BINS - 1);
+}
+
+static void BinSlots(const BuildPrimitive* primitives, long first, long last, const Box &centroids,
+	const float* scales, Bin (*bins)[BVH_BINS])
+{
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		for (int b = 0; b < BVH_BINS; ++b)
+		{
+			EmptyBox(bins[axis][b].bounds);
+			bins[axis][b].count = 0;
+		}
+	}
+
+	for (long s = first; s < last; ++s)
+	{
+		//a copy, so the compiler need not reload it after every store to a bin
+		BuildPrimitive primitive = primitives[s];
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			if (scales[axis] <= 0.0f)
+				continue;
+			Bin &bin = bins[axis][BinOf(primitive, axis, centroids, scales[axis])];
+			GrowBox(bin.bounds, primitive.min, primitive.max);
+			++bin.count;
+		}
+	}
+}
+
+//runs pass(first, last, part) over chunks of the slots on up to threads
+//threads and folds the parts into result with merge, small ranges are a
+//single chunk on the calling thread
+template<typename Part, typename Pass, typename Merge>
+static void ForChunks(long first, long count, int threads, Part &result, Pass pass, Merge merge)
+{
+	long chunks = (count + BVH_BINNING_CHUNK - 1) / BVH_BINNING_CHUNK;
+
+	if (threads <= 1 || chunks <= 1)
+	{
+		pass(first, first + count, result);
+		return;
+	}
+
+	std::vector<Part> parts(chunks);
+	ParallelFor(chunks, threads, [&](long chunk)
+	{
+		long begin = first + chunk*BVH_BINNING_CHUNK;
+		pass(begin, std::min(first + count, begin + BVH_BINNING_CHUNK), parts[chunk]);
+	});
+	result = parts[0];
+	for (long chunk = 1; chunk < chunks; ++chunk)
+		merge(result, parts[chunk]);
+}
+
+//appends the subtree over slots [first, first + count) to nodes, subtrees
+//small enough become tasks when tasks is given
+static void BuildNode(BuildPrimitive* primitives, long first, long count, int depth, int threads,
+	std::vector<BVHNode> &nodes, std::vector<BuildTask>* tasks, int &maxDepth)
+{
+	size_t index = nodes.size();
+	RangeBounds range;
+	BVHNode node;
+
+	maxDepth = std::max(maxDepth, depth);
+
+	if (tasks != NULL && count <= BVH_TASK_TRIANGLES)
+	{
+		BuildTask task;
+		task.first = first;
+		task.count = count;
+		task.depth = depth;
+		task.maxDepth = depth;
+		node.first = (unsigned int) tasks->size();
+		node.count = BVH_TASK_NODE;
+		nodes.push_back(node);
+		tasks->push_back(task);
+		return;
+	}
+
+	ForChunks(first, count, threads, range, [&](long begin, long end, RangeBounds &part)
+	{
+		BoundSlots(primitives, begin, end, part);
+	}, [](RangeBounds &into, const RangeBounds &part)
+	{
+		GrowBox(into.bounds, part.bounds.min, part.bounds.max);
+		GrowBox(into.centroids, part.centroids.min, part.centroids.max);
+	});
+
+	memcpy(node.boundsMin, range.bounds.min, sizeof(node.boundsMin));
+	memcpy(node.boundsMax, range.bounds.max, sizeof(node.boundsMax));
+	node.first = (unsigned int) first;
+	node.count = (unsigned int) count;
+	nodes.push_back(node);
+
+	if (count <= 1)
+		return;
+
+	//the cheapest split of the binned centroids
+	float scales[3];
+	int bestAxis = -1, bestBin = 0;
+	float bestCost = FLT_MAX, parentArea = HalfArea(range.bounds);
+
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float extent = range.centroids.max[axis] - range.centroids.min[axis];
+		scales[axis] = extent > 0.0f ? BVH_BINS / extent : 0.0f;
+	}
+
+	if (depth < BVH_MEDIAN_DEPTH && parentArea > 0.0f)
+	{
+		AxisBins binned;
+		Bin (*bins)[BVH_BINS] = binned.bins;
+
+		ForChunks(first, count, threads, binned, [&](long begin, long end, AxisBins &part)
+		{
+			BinSlots(primitives, begin, end, range.centroids, scales, part.bins);
+		}, [](AxisBins &into, const AxisBins &part)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				for (int b = 0; b < BVH_BINS; ++b)
+				{
+					GrowBox(into.bins[axis][b].bounds, part.bins[axis][b].bounds.min, part.bins[axis][b].bounds.max);
+					into.bins[axis][b].count += part.bins[axis][b].count;
+				}
+			}
+		});
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float rightArea[BVH_BINS];
+			long rightCount[BVH_BINS];
+			Box box;
+			long n = 0;
+
+			if (scales[axis] <= 0.0f)
+				continue;
+
+			EmptyBox(box);
+			for (int b = BVH_BINS - 1; b > 0; --b)
+			{
+				GrowBox(box, bins[axis][b].bounds.min, bins[axis][b].bounds.max);
+				n += bins[axis][b].count;
+				rightArea[b] = HalfArea(box);
+				rightCount[b] = n;
+			}
+
+			//a split at bin b puts bins [0, b) on the left
+			EmptyBox(box);
+			n = 0;
+			for (int b = 1; b < BVH_BINS; ++b)
+			{
+				GrowBox(box, bins[axis][b - 1].bounds.min, bins[axis][b - 1].bounds.max);
+				n += bins[axis][b - 1].count;
+				if (n == 0 || rightCount[b] == 0)
+					continue;
+
+				float cost = BVH_TRAVERSAL_COST + (HalfArea(box)*n + rightArea[b]*rightCount[b]) / parentArea;
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = b;
+				}
+			}
+		}
+	}
+
+	long middle;
+	if (bestAxis >= 0 && (count > BVH_MAX_LEAF || bestCost < (float) count))
+	{
+		float scale = scales[bestAxis];
+		const Box &centroids = range.centroids;
+		BuildPrimitive* split = std::partition(primitives + first, primitives + first + count,
+			[&](const BuildPrimitive &primitive)
+		{
+			return BinOf(primitive, bestAxis, centroids, scale) < bestBin;
+		});
+		middle = (long)(split - primitives);
+	}
+	else if (count > BVH_MAX_LEAF)
+	{
+		//every centroid in one place or too deep, halve in slot order
+		middle = first + count/2;
+	}
+	else
+		return;
+
+	nodes[index].count = 0;
+	BuildNode(primitives, first, middle - first, depth + 1, threads, nodes, tasks, maxDepth);
+	nodes[index].first = (unsigned int) nodes.size();
+	BuildNode(primitives, middle, first + count - middle, depth + 1, threads, nodes, tasks, maxDepth);
+}
+
+MeshBVH::MeshBVH()
+{
+	mDepth = 0;
+}
+
+void MeshBVH::Release()
+{
+	std::vector<BVHNode>().swap(mNodes);
+	std::vector<long>().swap(mTriangles);
+	std::vector<float>().swap(mCorners);
+	mDepth = 0;
+}
+
+int MeshBVH::Build(const float* positions, int stride, const long* indices, long triangleCount, int threads)
+{
+	std::vector<BuildPrimitive> primitives;
+	std::vector<BVHNode> top;
+	std::vector<BuildTask> tasks;
+	std::vector<size_t> placed;
+	size_t total = 0;
+
+	Release();
+	if (triangleCount < 0 || (unsigned long) triangleCount > 0x7FFFFFFFUL)
+		return -1;
+	if (triangleCount == 0)
+		return 0;
+
+	primitives.resize(triangleCount);
+	ParallelFor((triangleCount + BVH_BINNING_CHUNK - 1) / BVH_BINNING_CHUNK, threads, [&](long chunk)
+	{
+		long last = std::min(triangleCount, (chunk + 1)*BVH_BINNING_CHUNK);
+		for (long t = chunk*BVH_BINNING_CHUNK; t < last; ++t)
+		{
+			BuildPrimitive &primitive = primitives[t];
+			for (int i = 0; i < 3; ++i)
+			{
+				float a = positions[stride*indices[3*t] + i];
+				float b = positions[stride*indices[3*t + 1] + i];
+				float c = positions[stride*indices[3*t + 2] + i];
+				primitive.min[i] = std::min(a, std::min(b, c));
+				primitive.max[i] = std::max(a, std::max(b, c));
+			}
+			primitive.triangle = (unsigned int) t;
+			primitive.unused = 0;
+		}
+	});
+
+	BuildNode(primitives.data(), 0, triangleCount, 0, threads, top, &tasks, mDepth);
+	ParallelFor((long) tasks.size(), threads, [&](long i)
+	{
+		BuildTask &task = tasks[i];
+		BuildNode(primitives.data(), task.first, task.count, task.depth, 1, task.nodes, NULL, task.maxDepth);
+	});
+
+	//splice the tasks in where they stand in, which keeps the depth first order
+	placed.resize(top.size());
+	for (size_t i = 0; i < top.size(); ++i)
+	{
+		placed[i] = total;
+		total += top[i].count == BVH_TASK_NODE ? tasks[top[i].first].nodes.size() : 1;
+	}
+	mNodes.resize(total);
+	for (size_t i = 0; i < top.size(); ++i)
+	{
+		if (top[i].count == BVH_TASK_NODE)
+		{
+			const BuildTask &task = tasks[top[i].first];
+			for (size_t k = 0; k < task.nodes.size(); ++k)
+			{
+				BVHNode node = task.nodes[k];
+				if (node.count == 0)
+					node.first += (unsigned int) placed[i];
+				mNodes[placed[i] + k] = node;
+			}
+			mDepth = std::max(mDepth, task.maxDepth);
+		}
+		else
+		{
+			mNodes[placed[i]] = top[i];
+			if (top[i].count == 0)
+				mNodes[placed[i]].first = (unsigned int) placed[top[i].first];
+		}
+	}
+
+	mTriangles.resize(triangleCount);
+	for (long s = 0; s < triangleCount; ++s)
+		mTriangles[s] = (long) primitives[s].triangle;
+	CopyCorners(positions, stride, indices, threads);
+	return 0;
+}
+
+void MeshBVH::CopyCorners(const float* positions, int stride, const long* indices, int threads)
+{
+	long triangleCount = (long) mTriangles.size();
+
+	mCorners.resize(9*(size_t) triangleCount);
+	ParallelFor((triangleCount + BVH_BINNING_CHUNK - 1) / BVH_BINNING_CHUNK, threads, [&](long chunk)
+	{
+		long last = std::min(triangleCount, (chunk + 1)*BVH_BINNING_CHUNK);
+		for (long s = chunk*BVH_BINNING_CHUNK; s < last; ++s)
+		{
+			const long* triangle = indices + 3*mTriangles[s];
+			const float* p0 = positions + stride*triangle[0];
+			const float* p1 = positions + stride*triangle[1];
+			const float* p2 = positions + stride*triangle[2];
+			float* corners = &mCorners[9*s];
+
+			for (int i = 0; i < 3; ++i)
+			{
+				corners[i] = p0[i];
+				corners[3 + i] = p1[i] - p0[i];
+				corners[6 + i] = p2[i] - p0[i];
+			}
+		}
+	});
+}
+
+//the leaves are bounded in parallel from the positions, then every inner
+//node from its children, which come after it in the depth first order
+void MeshBVH::Refit(const float* positions, int stride, const long* indices, int threads)
+{
+	long nodeCount = (long) mNodes.size();
+
+	if (mNodes.empty())
+		return;
+	CopyCorners(positions, stride, indices, threads);
+	ParallelFor((nodeCount + BVH_BINNING_CHUNK - 1) / BVH_BINNING_CHUNK, threads, [&](long chunk)
+	{
+		long last = std::min(nodeCount, (chunk + 1)*BVH_BINNING_CHUNK);
+		for (long n = chunk*BVH_BINNING_CHUNK; n < last; ++n)
+		{
+			BVHNode &node = mNodes[n];
+			Box box;
+
+			if (node.count == 0)
+				continue;
+			EmptyBox(box);
+			for (unsigned int s = node.first; s < node.first + node.count; ++s)
+			{
+				const long* triangle = indices + 3*mTriangles[s];
+				for (int k = 0; k < 3; ++k)
+					GrowBox(box, positions + stride*triangle[k], positions + stride*triangle[k]);
+			}
+			memcpy(node.boundsMin, box.min, sizeof(box.min));
+			memcpy(node.boundsMax, box.max, sizeof(box.max));
+		}
+	});
+	for (long n = nodeCount - 1; n >= 0; --n)
+	{
+		BVHNode &node = mNodes[n];
+		const BVHNode &left = mNodes[n + 1], &right = mNodes[node.first];
+
+		if (node.count != 0)
+			continue;
+		for (int i = 0; i < 3; ++i)
+		{
+			node.boundsMin[i] = std::min(left.boundsMin[i], right.boundsMin[i]);
+			node.boundsMax[i] = std::max(left.boundsMax[i], right.boundsMax[i]);
+		}
+	}
+}
+
+//a ray with its reciprocal direction, where a zero component becomes tiny so
+//the slab test never multiplies zero by infinity
+struct Ray
+{
+	float origin[3];
+	float direction[3];
+	float inverse[3];
+};
+
+static inline void MakeRay(const float* origin, const float* direction, Ray &ray)
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		float d = fabsf(direction[i]) < 1e-30f ? (direction[i] < 0.0f ? -1e-30f : 1e-30f) : direction[i];
+		ray.origin[i] = origin[i];
+		ray.direction[i] = direction[i];
+		ray.inverse[i] = 1.0f / d;
+	}
+}
+
+static inline bool HitBox(const BVHNode &node, const Ray &ray, float farthest, float &entry)
+{
+	float nearest = 0.0f;
+
+	for (int i = 0; i < 3; ++i)
+	{
+		float t0 = (node.boundsMin[i] - ray.origin[i])*ray.inverse[i];
+		float t1 = (node.boundsMax[i] - ray.origin[i])*ray.inverse[i];
+		nearest = std::max(nearest, std::min(t0, t1));
+		farthest = std::min(farthest, std::max(t0, t1));
+	}
+	entry = nearest;
+	return nearest <= farthest;
+}
+
+//Moller and Trumbore on a corner and two edges, t must lie in [0, farthest]
+static inline bool HitTriangle(const float* corners, const Ray &ray, float farthest, float &t, float &u, float &v)
+{
+	const float* p0 = corners;
+	const float* e1 = corners + 3;
+	const float* e2 = corners + 6;
+	const float* d = ray.direction;
+	float p[3], q[3], s[3], det, inverse;
+
+	p[0] = d[1]*e2[2] - d[2]*e2[1];
+	p[1] = d[2]*e2[0] - d[0]*e2[2];
+	p[2] = d[0]*e2[1] - d[1]*e2[0];
+	det = e1[0]*p[0] + e1[1]*p[1] + e1[2]*p[2];
+	if (det == 0.0f)
+		return false;
+	inverse = 1.0f / det;
+
+	for (int i = 0; i < 3; ++i)
+		s[i] = ray.origin[i] - p0[i];
+	u = (s[0]*p[0] + s[1]*p[1] + s[2]*p[2])*inverse;
+	if (u < 0.0f || u > 1.0f)
+		return false;
+
+	q[0] = s[1]*e1[2] - s[2]*e1[1];
+	q[1] = s[2]*e1[0] - s[0]*e1[2];
+	q[2] = s[0]*e1[1] - s[1]*e1[0];
+	v = (d[0]*q[0] + d[1]*q[1] + d[2]*q[2])*inverse;
+	if (v < 0.0f || u + v > 1.0f)
+		return false;
+
+	t = (e2[0]*q[0] + e2[1]*q[1] + e2[2]*q[2])*inverse;
+	return t >= 0.0f && t <= farthest;
+}
+
+struct StackEntry
+{
+	unsigned int node;
+	float entry;
+};
+
+bool MeshBVH::Intersect(const float* origin, const float* direction, float maxDistance, BVHHit &hit) const
+{
+	StackEntry stack[BVH_STACK_SIZE];
+	int top = 0;
+	unsigned int index = 0;
+	float entry, t, u, v;
+	Ray ray;
+
+	hit.triangle = -1;
+	hit.distance = maxDistance;
+	hit.u = hit.v = 0.0f;
+	MakeRay(origin, direction, ray);
+	if (mNodes.empty() || !HitBox(mNodes[0], ray, maxDistance, entry))
+		return false;
+
+	for (;;)
+	{
+		const BVHNode &node = mNodes[index];
+
+		if (node.count > 0)
+		{
+			for (unsigned int s = node.first; s < node.first + node.count; ++s)
+			{
+				if (HitTriangle(&mCorners[9*(size_t) s], ray, hit.distance, t, u, v))
+				{
+					hit.triangle = mTriangles[s];
+					hit.distance = t;
+					hit.u = u;
+					hit.v = v;
+				}
+			}
+		}
+		else
+		{
+			//the nearer child first, the farther one waits with its entry distance
+			unsigned int near = index + 1, far = node.first;
+			float nearEntry, farEntry;
+			bool bNear = HitBox(mNodes[near], ray, hit.distance, nearEntry);
+			bool bFar = HitBox(mNodes[far], ray, hit.distance, farEntry);
+
+			if (bNear && bFar)
+			{
+				if (farEntry < nearEntry)
+				{
+					std::swap(near, far);
+					std::swap(nearEntry, farEntry);
+				}
+				stack[top].node = far;
+				stack[top].entry = farEntry;
+				++top;
+				index = near;
+				continue;
+			}
+			if (bNear || bFar)
+			{
+				index = bNear ? near : far;
+				continue;
+			}
+		}
+
+		//nodes that start behind the closest hit so far are skipped
+		do
+		{
+			if (top == 0)
+				return hit.triangle >= 0;
+			--top;
+		} while (stack[top].entry > hit.distance);
+		index = stack[top].node;
+	}
+}
+
+bool MeshBVH::Occluded(const float* origin, const float* direction, float maxDistance) const
+{
+	unsigned int stack[BVH_STACK_SIZE];
+	int top = 0;
+	unsigned int index = 0;
+	float entry, t, u, v;
+	Ray ray;
+
+	MakeRay(origin, direction, ray);
+	if (mNodes.empty() || !HitBox(mNodes[0], ray, maxDistance, entry))
+		return false;
+
+	for (;;)
+	{
+		const BVHNode &node = mNodes[index];
+
+		if (node.count > 0)
+		{
+			for (unsigned int s = node.first; s < node.first + node.count; ++s)
+			{
+				if (HitTriangle(&mCorners[9*(size_t) s], ray, maxDistance, t, u, v))
+					return true;
+			}
+		}
+		else
+		{
+			bool bLeft = HitBox(mNodes[index + 1], ray, maxDistance, entry);
+			bool bRight = HitBox(mNodes[node.first], ray, maxDistance, entry);
+
+			if (bLeft && bRight)
+				stack[top++] = node.first;
+			if (bLeft || bRight)
+			{
+				index = bLeft ? index + 1 : node.first;
+				continue;
+			}
+		}
+
+		if (top == 0)
+			return false;
+		index = stack[--top];
+	}
+}
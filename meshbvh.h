@@ -0,0 +1,70 @@
+/*
+Bounding volume hierarchy over the triangles of a mesh for ray queries
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef MESHBVH_H
+#define MESHBVH_H
+
+#include <vector>
+
+//nodes are stored depth first, so the left child of an inner node is the
+//next node and only the right one needs an index, 32 bytes each
+struct BVHNode
+{
+	float boundsMin[3];
+	unsigned int first;		// Right child of an inner node, first triangle slot of a leaf
+	float boundsMax[3];
+	unsigned int count;		// Triangles of a leaf, 0 for an inner node
+};
+
+struct BVHHit
+{
+	long triangle;		// Index of the triangle in the index buffer, -1 for a miss
+	float distance;		// Along the ray, in lengths of its direction
+	float u, v;			// Barycentric weights of the second and third corner
+};
+
+class MeshBVH
+{
+  private:
+	std::vector<BVHNode> mNodes;
+	std::vector<long> mTriangles;	// Triangle of every leaf slot
+	std::vector<float> mCorners;	// First corner and both edges of every leaf slot, 9 floats each
+	int mDepth;
+
+	void CopyCorners(const float* positions, int stride, const long* indices, int threads);
+
+ public:
+	MeshBVH();
+
+	//builds the tree over triangleCount triangles of indices with binned
+	//surface area splits, positions are read as x, y, z every stride floats,
+	//the tree does not depend on threads, returns 0 or -1
+	int Build(const float* positions, int stride, const long* indices, long triangleCount, int threads);
+	void Release();
+	//bounds the same tree again after positions moved, the indices have to be
+	//the ones it was built over, rays stay right but get slower the further
+	//the positions move from where the tree was built
+	void Refit(const float* positions, int stride, const long* indices, int threads);
+
+	//closest triangle the ray origin + t*direction hits for t in [0, maxDistance]
+	bool Intersect(const float* origin, const float* direction, float maxDistance, BVHHit &hit) const;
+
+	//whether any triangle is hit for t in [0, maxDistance], for shadow and visibility rays
+	bool Occluded(const float* origin, const float* direction, float maxDistance) const;
+
+	inline bool IsEmpty() const {return mNodes.empty();};
+	inline long GetNodeCount() const {return (long) mNodes.size();};
+	inline long GetTriangleCount() const {return (long) mTriangles.size();};
+	inline int GetDepth() const {return mDepth;};
+};
+
+#endif
@@ -0,0 +1,610 @@
+/*
+Lossless compression of finished vertex and index buffers
+
+Vertices are cut into blocks of 256 that code independently, so blocks
+decode in parallel. Within a block every byte of the vertex forms a plane,
+each byte is stored as the zigzagged difference from the same byte of the
+vertex before, and every 16 differences take 0, 2, 4 or 8 bits each. After
+OptimizeVertexFetch neighbouring vertices are close, so the high bytes of
+floats barely change. The decoder unpacks, sums and transposes 16 vertices
+at a time with SSE2.
+
+Triangles are coded against a FIFO of the 16 most recent edges and one of
+the 16 most recent vertices. A triangle sharing a recent edge costs one
+byte plus its third corner, and corners that are the next unused vertex,
+which OptimizeVertexFetch makes the common case, cost nothing more. The
+rotation of every triangle is kept, so the decoded buffer is the same.
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdint.h>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MESHCODEC_SSE2
+#endif
+
+#include "meshcodec.h"
+#include "parallel.h"
+
+static const int CODEC_BLOCK = 256;		// Vertices per independently coded block
+static const int CODEC_GROUP = 16;		// Differences sharing one bit width
+static const int CODEC_FIFO = 16;
+
+//bit width of a group, two bits of the plane header each
+enum GroupMode
+{
+	GROUP_ZERO,
+	GROUP_BITS2,
+	GROUP_BITS4,
+	GROUP_BITS8
+};
+
+//corner of a triangle, two bits of the triangle code each
+enum CornerMode
+{
+	CORNER_NEXT,		// The vertex after the highest one used so far
+	CORNER_FIFO,		// One of the recent vertices, a byte gives how recent
+	CORNER_DELTA,		// A varint of the zigzagged difference from the corner before
+	CORNER_INVALID
+};
+
+static inline size_t BlockBound(int vertices, int stride)
+{
+	int groups = (vertices + CODEC_GROUP - 1) / CODEC_GROUP;
+	return (size_t) stride*((groups + 3)/4 + groups*CODEC_GROUP);
+}
+
+size_t VertexEncodeBound(long vertexCount, int stride)
+{
+	long blocks = (vertexCount + CODEC_BLOCK - 1) / CODEC_BLOCK;
+	return blocks*(sizeof(uint32_t) + BlockBound(CODEC_BLOCK, stride));
+}
+
+static inline unsigned char Zigzag(unsigned char delta)
+{
+	return (unsigned char)((delta << 1) ^ ((signed char) delta >> 7));
+}
+
+static inline unsigned char Unzigzag(unsigned char value)
+{
+	return (unsigned char)((value >> 1) ^ -(value & 1));
+}
+
+//codes one block, returns its size
+static size_t EncodeBlock(unsigned char* out, const unsigned char* vertices, int count, int stride)
+{
+	int groups = (count + CODEC_GROUP - 1) / CODEC_GROUP;
+	unsigned char* p = out;
+	unsigned char deltas[CODEC_BLOCK];
+
+	for (int k = 0; k < stride; ++k)
+	{
+		unsigned char* header = p;
+		unsigned char previous = 0;
+
+		//vertices past the end repeat the last one, so their differences are zero
+		for (int v = 0; v < groups*CODEC_GROUP; ++v)
+		{
+			unsigned char byte = v < count ? vertices[(size_t) v*stride + k] : previous;
+			deltas[v] = Zigzag((unsigned char)(byte - previous));
+			previous = byte;
+		}
+
+		memset(header, 0, (groups + 3)/4);
+		p += (groups + 3)/4;
+		for (int g = 0; g < groups; ++g)
+		{
+			const unsigned char* d = deltas + g*CODEC_GROUP;
+			unsigned char largest = *std::max_element(d, d + CODEC_GROUP);
+			int mode = largest == 0 ? GROUP_ZERO : largest < 4 ? GROUP_BITS2 : largest < 16 ? GROUP_BITS4 : GROUP_BITS8;
+
+			header[g/4] |= (unsigned char)(mode << (2*(g % 4)));
+			//difference i goes to byte i % 4 (or i % 8) so the decoder can shift whole words
+			if (mode == GROUP_BITS2)
+			{
+				memset(p, 0, 4);
+				for (int i = 0; i < CODEC_GROUP; ++i)
+					p[i % 4] |= (unsigned char)(d[i] << (2*(i / 4)));
+				p += 4;
+			}
+			else if (mode == GROUP_BITS4)
+			{
+				memset(p, 0, 8);
+				for (int i = 0; i < CODEC_GROUP; ++i)
+					p[i % 8] |= (unsigned char)(d[i] << (4*(i / 8)));
+				p += 8;
+			}
+			else if (mode == GROUP_BITS8)
+			{
+				memcpy(p, d, CODEC_GROUP);
+				p += CODEC_GROUP;
+			}
+		}
+	}
+	return (size_t)(p - out);
+}
+
+size_t EncodeVertexBuffer(unsigned char* out, size_t capacity, const void* vertices, long vertexCount, int stride)
+{
+	long blocks = (vertexCount + CODEC_BLOCK - 1) / CODEC_BLOCK;
+	size_t offset = blocks*sizeof(uint32_t);
+	const unsigned char* bytes = (const unsigned char*) vertices;
+
+	if (stride <= 0 || stride > CODEC_MAX_STRIDE || stride % 4 != 0 || vertexCount < 0 || capacity < offset)
+		return 0;
+
+	for (long b = 0; b < blocks; ++b)
+	{
+		int count = (int) std::min((long) CODEC_BLOCK, vertexCount - b*CODEC_BLOCK);
+		uint32_t size;
+
+		if (capacity - offset < BlockBound(count, stride))
+			return 0;
+		size = (uint32_t) EncodeBlock(out + offset, bytes + (size_t) b*CODEC_BLOCK*stride, count, stride);
+		memcpy(out + b*sizeof(uint32_t), &size, sizeof(size));
+		offset += size;
+	}
+	return offset;
+}
+
+//unpacks the 16 zigzagged differences of a group, returns the bytes read or
+//-1 when the group runs past end
+#ifdef MESHCODEC_SSE2
+static inline size_t UnpackGroup(const unsigned char* p, const unsigned char* end, int mode, __m128i &values)
+{
+	static const size_t sizes[4] = {0, 4, 8, CODEC_GROUP};
+
+	if ((size_t)(end - p) < sizes[mode])
+		return (size_t) -1;
+
+	if (mode == GROUP_ZERO)
+		values = _mm_setzero_si128();
+	else if (mode == GROUP_BITS2)
+	{
+		int32_t word;
+		memcpy(&word, p, 4);
+		__m128i x = _mm_shuffle_epi32(_mm_cvtsi32_si128(word), 0);
+		__m128i low = _mm_unpacklo_epi32(x, _mm_srli_epi32(x, 2));
+		__m128i high = _mm_unpacklo_epi32(_mm_srli_epi32(x, 4), _mm_srli_epi32(x, 6));
+		values = _mm_and_si128(_mm_unpacklo_epi64(low, high), _mm_set1_epi8(3));
+	}
+	else if (mode == GROUP_BITS4)
+	{
+		__m128i x = _mm_loadl_epi64((const __m128i*) p);
+		values = _mm_and_si128(_mm_unpacklo_epi64(x, _mm_srli_epi64(x, 4)), _mm_set1_epi8(15));
+	}
+	else
+		values = _mm_loadu_si128((const __m128i*) p);
+	return sizes[mode];
+}
+#else
+static inline size_t UnpackGroup(const unsigned char* p, const unsigned char* end, int mode, unsigned char* values)
+{
+	static const size_t sizes[4] = {0, 4, 8, CODEC_GROUP};
+
+	if ((size_t)(end - p) < sizes[mode])
+		return (size_t) -1;
+	for (int i = 0; i < CODEC_GROUP; ++i)
+	{
+		if (mode == GROUP_ZERO)
+			values[i] = 0;
+		else if (mode == GROUP_BITS2)
+			values[i] = (p[i % 4] >> (2*(i / 4))) & 3;
+		else if (mode == GROUP_BITS4)
+			values[i] = (p[i % 8] >> (4*(i / 8))) & 15;
+		else
+			values[i] = p[i];
+	}
+	return sizes[mode];
+}
+#endif
+
+#ifdef MESHCODEC_SSE2
+//four planes of 16 vertices become 16 runs of four bytes, four to a register
+static inline void InterleavePlanes(const unsigned char* plane, __m128i runs[4])
+{
+	__m128i p0 = _mm_loadu_si128((const __m128i*) plane);
+	__m128i p1 = _mm_loadu_si128((const __m128i*)(plane + CODEC_BLOCK));
+	__m128i p2 = _mm_loadu_si128((const __m128i*)(plane + 2*CODEC_BLOCK));
+	__m128i p3 = _mm_loadu_si128((const __m128i*)(plane + 3*CODEC_BLOCK));
+	__m128i t0 = _mm_unpacklo_epi8(p0, p1), t1 = _mm_unpackhi_epi8(p0, p1);
+	__m128i t2 = _mm_unpacklo_epi8(p2, p3), t3 = _mm_unpackhi_epi8(p2, p3);
+
+	runs[0] = _mm_unpacklo_epi16(t0, t2);
+	runs[1] = _mm_unpackhi_epi16(t0, t2);
+	runs[2] = _mm_unpacklo_epi16(t1, t3);
+	runs[3] = _mm_unpackhi_epi16(t1, t3);
+}
+#endif
+
+//decodes one block into its planes, then moves the planes into place
+static bool DecodeBlock(unsigned char* vertices, int count, int stride, const unsigned char* p, const unsigned char* end)
+{
+	int groups = (count + CODEC_GROUP - 1) / CODEC_GROUP;
+	unsigned char planes[CODEC_MAX_STRIDE*CODEC_BLOCK];
+
+	for (int k = 0; k < stride; ++k)
+	{
+		const unsigned char* header = p;
+		unsigned char* plane = planes + k*CODEC_BLOCK;
+
+		if (end - p < (groups + 3)/4)
+			return false;
+		p += (groups + 3)/4;
+
+#ifdef MESHCODEC_SSE2
+		__m128i carry = _mm_setzero_si128();
+		for (int g = 0; g < groups; ++g)
+		{
+			__m128i x;
+			size_t used = UnpackGroup(p, end, (header[g/4] >> (2*(g % 4))) & 3, x);
+			if (used == (size_t) -1)
+				return false;
+			p += used;
+
+			//undo the zigzag, then a running sum over the 16 bytes plus the last byte before them
+			x = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(x, 1), _mm_set1_epi8(0x7F)),
+				_mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(x, _mm_set1_epi8(1))));
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 1));
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 2));
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+			x = _mm_add_epi8(x, carry);
+			_mm_storeu_si128((__m128i*)(plane + g*CODEC_GROUP), x);
+
+			carry = _mm_unpackhi_epi8(x, x);
+			carry = _mm_shuffle_epi32(_mm_unpackhi_epi16(carry, carry), 0xFF);
+		}
+#else
+		unsigned char previous = 0;
+		for (int g = 0; g < groups; ++g)
+		{
+			unsigned char* values = plane + g*CODEC_GROUP;
+			size_t used = UnpackGroup(p, end, (header[g/4] >> (2*(g % 4))) & 3, values);
+			if (used == (size_t) -1)
+				return false;
+			p += used;
+			for (int i = 0; i < CODEC_GROUP; ++i)
+				previous = values[i] = (unsigned char)(previous + Unzigzag(values[i]));
+		}
+#endif
+	}
+	if (p != end)
+		return false;
+
+	int v = 0;
+#ifdef MESHCODEC_SSE2
+	for (; v + CODEC_GROUP <= count; v += CODEC_GROUP)
+	{
+		const unsigned char* plane = planes + v;
+		unsigned char* out = vertices + (size_t) v*stride;
+		int k = 0;
+
+		//sixteen planes make whole 16 byte stores, four of 4 byte runs each
+		for (; k + 16 <= stride; k += 16)
+		{
+			__m128i a[4], b[4], c[4], d[4];
+			InterleavePlanes(plane + k*CODEC_BLOCK, a);
+			InterleavePlanes(plane + (k + 4)*CODEC_BLOCK, b);
+			InterleavePlanes(plane + (k + 8)*CODEC_BLOCK, c);
+			InterleavePlanes(plane + (k + 12)*CODEC_BLOCK, d);
+
+			for (int r = 0; r < 4; ++r)
+			{
+				__m128i ab0 = _mm_unpacklo_epi32(a[r], b[r]), ab1 = _mm_unpackhi_epi32(a[r], b[r]);
+				__m128i cd0 = _mm_unpacklo_epi32(c[r], d[r]), cd1 = _mm_unpackhi_epi32(c[r], d[r]);
+				unsigned char* row = out + (size_t)(4*r)*stride + k;
+
+				_mm_storeu_si128((__m128i*) row, _mm_unpacklo_epi64(ab0, cd0));
+				_mm_storeu_si128((__m128i*)(row + stride), _mm_unpackhi_epi64(ab0, cd0));
+				_mm_storeu_si128((__m128i*)(row + 2*stride), _mm_unpacklo_epi64(ab1, cd1));
+				_mm_storeu_si128((__m128i*)(row + 3*stride), _mm_unpackhi_epi64(ab1, cd1));
+			}
+		}
+		for (; k + 8 <= stride; k += 8)
+		{
+			__m128i a[4], b[4];
+			InterleavePlanes(plane + k*CODEC_BLOCK, a);
+			InterleavePlanes(plane + (k + 4)*CODEC_BLOCK, b);
+
+			for (int r = 0; r < 4; ++r)
+			{
+				__m128i ab0 = _mm_unpacklo_epi32(a[r], b[r]), ab1 = _mm_unpackhi_epi32(a[r], b[r]);
+				unsigned char* row = out + (size_t)(4*r)*stride + k;
+
+				_mm_storel_epi64((__m128i*) row, ab0);
+				_mm_storel_epi64((__m128i*)(row + stride), _mm_unpackhi_epi64(ab0, ab0));
+				_mm_storel_epi64((__m128i*)(row + 2*stride), ab1);
+				_mm_storel_epi64((__m128i*)(row + 3*stride), _mm_unpackhi_epi64(ab1, ab1));
+			}
+		}
+		for (; k < stride; k += 4)
+		{
+			__m128i runs[4];
+			InterleavePlanes(plane + k*CODEC_BLOCK, runs);
+
+			for (int r = 0; r < 4; ++r)
+			{
+				for (int i = 0; i < 4; ++i)
+				{
+					int32_t run = _mm_cvtsi128_si32(runs[r]);
+					memcpy(out + (size_t)(4*r + i)*stride + k, &run, 4);
+					runs[r] = _mm_srli_si128(runs[r], 4);
+				}
+			}
+		}
+	}
+#endif
+	for (; v < count; ++v)
+	{
+		for (int k = 0; k < stride; ++k)
+			vertices[(size_t) v*stride + k] = planes[k*CODEC_BLOCK + v];
+	}
+	return true;
+}
+
+int DecodeVertexBuffer(void* vertices, long vertexCount, int stride, const unsigned char* data, size_t size, int threads)
+{
+	long blocks = (vertexCount + CODEC_BLOCK - 1) / CODEC_BLOCK;
+	std::vector<size_t> offsets(blocks + 1);
+	std::atomic<bool> bDamaged(false);
+
+	if (stride <= 0 || stride > CODEC_MAX_STRIDE || stride % 4 != 0 || vertexCount < 0 || size < blocks*sizeof(uint32_t))
+		return -1;
+
+	//the block sizes lead the blocks, their running sum is where each starts
+	offsets[0] = blocks*sizeof(uint32_t);
+	for (long b = 0; b < blocks; ++b)
+	{
+		uint32_t blockSize;
+		memcpy(&blockSize, data + b*sizeof(uint32_t), sizeof(blockSize));
+		if (blockSize > size - offsets[b])
+			return -1;
+		offsets[b + 1] = offsets[b] + blockSize;
+	}
+	if (offsets[blocks] != size)
+		return -1;
+
+	ParallelFor(blocks, threads, [&](long b)
+	{
+		int count = (int) std::min((long) CODEC_BLOCK, vertexCount - b*CODEC_BLOCK);
+		if (!DecodeBlock((unsigned char*) vertices + (size_t) b*CODEC_BLOCK*stride, count, stride,
+			data + offsets[b], data + offsets[b + 1]))
+			bDamaged = true;
+	});
+	return bDamaged ? -1 : 0;
+}
+
+size_t IndexEncodeBound(long triangleCount)
+{
+	//a code byte and three corners of at most five varint bytes
+	return (size_t) triangleCount*16;
+}
+
+//recent edges and vertices shared by the encoder and the decoder
+struct IndexCoderState
+{
+	uint32_t edges[CODEC_FIFO][2];
+	uint32_t vertices[CODEC_FIFO];
+	unsigned int edgeHead;
+	unsigned int vertexHead;
+	uint32_t next;		// Lowest vertex not used yet
+	uint32_t last;		// Previous corner coded
+
+	IndexCoderState()
+	{
+		memset(edges, 0xFF, sizeof(edges));
+		memset(vertices, 0xFF, sizeof(vertices));
+		edgeHead = vertexHead = 0;
+		next = last = 0;
+	}
+
+	inline void PushEdge(uint32_t a, uint32_t b)
+	{
+		edges[edgeHead % CODEC_FIFO][0] = a;
+		edges[edgeHead % CODEC_FIFO][1] = b;
+		++edgeHead;
+	}
+
+	inline void PushVertex(uint32_t v)
+	{
+		vertices[vertexHead % CODEC_FIFO] = v;
+		++vertexHead;
+	}
+
+	//after every corner, coded any way
+	inline void Use(uint32_t v, int mode)
+	{
+		if (mode != CORNER_FIFO)
+			PushVertex(v);
+		if (v >= next)
+			next = v + 1;
+		last = v;
+	}
+};
+
+static inline unsigned char* PutVarint(unsigned char* p, uint32_t value)
+{
+	while (value >= 0x80)
+	{
+		*p++ = (unsigned char)(value | 0x80);
+		value >>= 7;
+	}
+	*p++ = (unsigned char) value;
+	return p;
+}
+
+//picks how to code corner v and writes what follows the triangle code
+static int EncodeCorner(IndexCoderState &state, uint32_t v, unsigned char* &payload)
+{
+	int mode = CORNER_DELTA;
+
+	if (v == state.next)
+		mode = CORNER_NEXT;
+	else
+	{
+		for (int i = 0; i < CODEC_FIFO && mode == CORNER_DELTA; ++i)
+		{
+			if (state.vertices[(state.vertexHead - 1 - i) % CODEC_FIFO] == v)
+			{
+				*payload++ = (unsigned char) i;
+				mode = CORNER_FIFO;
+			}
+		}
+		if (mode == CORNER_DELTA)
+		{
+			int32_t delta = (int32_t)(v - state.last);
+			payload = PutVarint(payload, ((uint32_t) delta << 1) ^ (uint32_t)(delta >> 31));
+		}
+	}
+	state.Use(v, mode);
+	return mode;
+}
+
+size_t EncodeIndexBuffer(unsigned char* out, size_t capacity, const long* indices, long triangleCount, long vertexCount)
+{
+	IndexCoderState state;
+	unsigned char* p = out;
+	unsigned char payload[16];
+
+	if (capacity < IndexEncodeBound(triangleCount) || vertexCount < 0 || (unsigned long) vertexCount > 0xFFFFFFFFUL)
+		return 0;
+
+	for (long t = 0; t < triangleCount; ++t)
+	{
+		const long* triangle = indices + 3*t;
+		uint32_t corners[3];
+		unsigned char* end = payload;
+		int rotation = 3, age = 0;
+
+		for (int k = 0; k < 3; ++k)
+		{
+			if (triangle[k] < 0 || triangle[k] >= vertexCount)
+				return 0;
+			corners[k] = (uint32_t) triangle[k];
+		}
+
+		//the most recent edge any rotation of the triangle starts with
+		for (int i = 0; i < CODEC_FIFO && rotation == 3; ++i)
+		{
+			const uint32_t* edge = state.edges[(state.edgeHead - 1 - i) % CODEC_FIFO];
+			for (int r = 0; r < 3 && rotation == 3; ++r)
+			{
+				if (edge[0] == corners[r] && edge[1] == corners[(r + 1) % 3])
+				{
+					rotation = r;
+					age = i;
+				}
+			}
+		}
+
+		if (rotation < 3)
+		{
+			uint32_t third = corners[(rotation + 2) % 3];
+			int mode = EncodeCorner(state, third, end);
+			*p++ = (unsigned char)(rotation | (age << 2) | (mode << 6));
+		}
+		else
+		{
+			int modes[3];
+			for (int k = 0; k < 3; ++k)
+				modes[k] = EncodeCorner(state, corners[k], end);
+			*p++ = (unsigned char)(3 | (modes[0] << 2) | (modes[1] << 4) | (modes[2] << 6));
+		}
+		memcpy(p, payload, end - payload);
+		p += end - payload;
+
+		//a neighbour wound the same way walks the shared edge backwards
+		state.PushEdge(corners[1], corners[0]);
+		state.PushEdge(corners[2], corners[1]);
+		state.PushEdge(corners[0], corners[2]);
+	}
+	return (size_t)(p - out);
+}
+
+//reads corner v coded with mode, returns false for damaged data
+static inline bool DecodeCorner(IndexCoderState &state, int mode, const unsigned char* &p, const unsigned char* end, uint32_t &v)
+{
+	if (mode == CORNER_NEXT)
+		v = state.next;
+	else if (mode == CORNER_FIFO)
+	{
+		if (p == end || *p >= CODEC_FIFO)
+			return false;
+		v = state.vertices[(state.vertexHead - 1 - *p++) % CODEC_FIFO];
+	}
+	else if (mode == CORNER_DELTA)
+	{
+		uint32_t value = 0;
+		for (int shift = 0; ; shift += 7)
+		{
+			if (p == end || shift > 28)
+				return false;
+			value |= (uint32_t)(*p & 0x7F) << shift;
+			if (*p++ < 0x80)
+				break;
+		}
+		v = state.last + ((value >> 1) ^ (0u - (value & 1)));
+	}
+	else
+		return false;
+	state.Use(v, mode);
+	return true;
+}
+
+int DecodeIndexBuffer(long* indices, long triangleCount, long vertexCount, const unsigned char* data, size_t size)
+{
+	IndexCoderState state;
+	const unsigned char* p = data;
+	const unsigned char* end = data + size;
+
+	for (long t = 0; t < triangleCount; ++t)
+	{
+		uint32_t corners[3];
+		int code;
+
+		if (p == end)
+			return -1;
+		code = *p++;
+		if ((code & 3) < 3)
+		{
+			int rotation = code & 3;
+			const uint32_t* edge = state.edges[(state.edgeHead - 1 - ((code >> 2) & 15)) % CODEC_FIFO];
+			corners[rotation] = edge[0];
+			corners[(rotation + 1) % 3] = edge[1];
+			if (!DecodeCorner(state, code >> 6, p, end, corners[(rotation + 2) % 3]))
+				return -1;
+		}
+		else
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				if (!DecodeCorner(state, (code >> (2 + 2*k)) & 3, p, end, corners[k]))
+					return -1;
+			}
+		}
+
+		for (int k = 0; k < 3; ++k)
+		{
+			if (corners[k] >= (uint32_t) vertexCount)
+				return -1;
+			indices[3*t + k] = (long) corners[k];
+		}
+		state.PushEdge(corners[1], corners[0]);
+		state.PushEdge(corners[2], corners[1]);
+		state.PushEdge(corners[0], corners[2]);
+	}
+	return p == end ? 0 : -1;
+}
@@ -0,0 +1,44 @@
+/*
+Lossless compression of finished vertex and index buffers
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef MESHCODEC_H
+#define MESHCODEC_H
+
+#include <cstddef>
+
+//largest vertex, in bytes, the vertex codec takes
+static const int CODEC_MAX_STRIDE = 256;
+
+//most bytes EncodeVertexBuffer can write
+size_t VertexEncodeBound(long vertexCount, int stride);
+
+//encodes vertexCount vertices of stride bytes, a multiple of 4, returns the
+//bytes written to out or 0 when they do not fit in capacity
+size_t EncodeVertexBuffer(unsigned char* out, size_t capacity, const void* vertices, long vertexCount, int stride);
+
+//decodes into vertices, which holds vertexCount*stride bytes, blocks are
+//decoded in parallel, returns 0 or -1 for damaged data
+int DecodeVertexBuffer(void* vertices, long vertexCount, int stride, const unsigned char* data, size_t size, int threads);
+
+//most bytes EncodeIndexBuffer can write
+size_t IndexEncodeBound(long triangleCount);
+
+//encodes the triangles, which are best ordered by OptimizeVertexCache and
+//OptimizeVertexFetch first, every index must be below vertexCount, returns
+//the bytes written to out or 0 when they do not fit or an index is out of range
+size_t EncodeIndexBuffer(unsigned char* out, size_t capacity, const long* indices, long triangleCount, long vertexCount);
+
+//decodes into indices, which holds triangleCount*3 entries, returns 0 or -1
+//for damaged data or an index not below vertexCount
+int DecodeIndexBuffer(long* indices, long triangleCount, long vertexCount, const unsigned char* data, size_t size);
+
+#endif
@@ -0,0 +1,333 @@
+/*
+Meshlet partitioning of indexed triangle meshes with per-meshlet bounds
+
+The triangles are cut into meshlets in index order, which after the vertex
+cache optimisation keeps neighbouring triangles together. The index buffer
+is split into fixed blocks that are partitioned in parallel, so a meshlet
+never crosses a block and the result is the same on any number of threads.
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "meshlets.h"
+#include "parallel.h"
+
+//triangles partitioned per task, only the last meshlet of a block can end early
+static const long MESHLET_BLOCK = 1 << 16;
+
+//below this the normals spread too far for the cone to cull anything
+static const float MESHLET_MIN_CONE_DOT = 0.1f;
+
+//every meshlet but the last of a block holds at least this many triangles,
+//since a triangle brings at most three new vertices
+static long MinimumTriangles(int maxVertices, int maxTriangles)
+{
+	return std::max(1, std::min(maxTriangles, maxVertices / 3));
+}
+
+static long MeshletBlockBound(long triangles, int maxVertices, int maxTriangles)
+{
+	return (triangles + MinimumTriangles(maxVertices, maxTriangles) - 1) / MinimumTriangles(maxVertices, maxTriangles);
+}
+
+long MeshletBound(long triangleCount, int maxVertices, int maxTriangles)
+{
+	long blocks = (triangleCount + MESHLET_BLOCK - 1) / MESHLET_BLOCK;
+	return MeshletBlockBound(std::min(triangleCount, MESHLET_BLOCK), maxVertices, maxTriangles) * blocks;
+}
+
+//adds the vertices of triangle to a meshlet's vertex list, the list is searched
+//from its end since the triangles before share the most vertices, returns false
+//and leaves the list alone when they do not fit
+static bool AddTriangle(const long* triangle, long* vertices, int &vertexCount, int maxVertices)
+{
+	long added[3];
+	int addedCount = 0;
+
+	for (int k = 0; k < 3; ++k)
+	{
+		long v = triangle[k];
+		bool bFound = false;
+
+		for (int i = vertexCount - 1; i >= 0 && !bFound; --i)
+			bFound = vertices[i] == v;
+		for (int i = 0; i < addedCount && !bFound; ++i)
+			bFound = added[i] == v;
+		if (!bFound)
+			added[addedCount++] = v;
+	}
+
+	if (vertexCount + addedCount > maxVertices)
+		return false;
+	for (int i = 0; i < addedCount; ++i)
+		vertices[vertexCount++] = added[i];
+	return true;
+}
+
+long PartitionMeshlets(const long* indices, long triangleCount, int maxVertices, int maxTriangles,
+	Meshlet* meshlets, int threads, MemoryArena &scratch)
+{
+	long blocks = (triangleCount + MESHLET_BLOCK - 1) / MESHLET_BLOCK;
+	long blockBound = MeshletBlockBound(std::min(triangleCount, MESHLET_BLOCK), maxVertices, maxTriangles);
+	long* blockCounts = scratch.Allocate<long>(std::max(blocks, 1L));
+	long count = 0;
+
+	if (maxVertices < 3 || maxVertices > 0xFFFF || maxTriangles < 1 || maxTriangles > 0xFFFF ||
+		blockCounts == NULL)
+		return -1;
+
+	//every block writes its meshlets to its own part of meshlets
+	ParallelFor(blocks, threads, [&](long block)
+	{
+		long first = block*MESHLET_BLOCK;
+		long last = std::min(triangleCount, first + MESHLET_BLOCK);
+		Meshlet* blockMeshlets = meshlets + block*blockBound;
+		long* vertices = new long[maxVertices];
+		int vertexCount = 0;
+		long m = -1;
+
+		for (long t = first; t < last; ++t)
+		{
+			if (m < 0 || blockMeshlets[m].triangleCount == maxTriangles ||
+				!AddTriangle(indices + 3*t, vertices, vertexCount, maxVertices))
+			{
+				//cleared whole so the padding written to caches is always the same
+				++m;
+				memset(&blockMeshlets[m], 0, sizeof(Meshlet));
+				blockMeshlets[m].firstTriangle = t;
+				vertexCount = 0;
+				AddTriangle(indices + 3*t, vertices, vertexCount, maxVertices);
+			}
+			++blockMeshlets[m].triangleCount;
+			blockMeshlets[m].vertexCount = (unsigned short) vertexCount;
+		}
+
+		blockCounts[block] = m + 1;
+		delete[] vertices;
+	});
+
+	for (long block = 0; block < blocks; ++block)
+	{
+		memmove(meshlets + count, meshlets + block*blockBound, blockCounts[block]*sizeof(Meshlet));
+		count += blockCounts[block];
+	}
+	return count;
+}
+
+//cross product of the edges, its length is twice the area
+static inline float FaceNormal(const float* positions, int stride, const long* triangle, float* n)
+{
+	const float* p0 = positions + stride*triangle[0];
+	const float* p1 = positions + stride*triangle[1];
+	const float* p2 = positions + stride*triangle[2];
+	float e1[3], e2[3];
+
+	for (int i = 0; i < 3; ++i)
+	{
+		e1[i] = p1[i] - p0[i];
+		e2[i] = p2[i] - p0[i];
+	}
+	n[0] = e1[1]*e2[2] - e1[2]*e2[1];
+	n[1] = e1[2]*e2[0] - e1[0]*e2[2];
+	n[2] = e1[0]*e2[1] - e1[1]*e2[0];
+	return sqrtf(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+}
+
+//box, sphere around the box centre and normal cone of one meshlet
+static void BoundMeshlet(const float* positions, int stride, const long* indices, Meshlet &meshlet)
+{
+	const long* first = indices + 3*meshlet.firstTriangle;
+	const long* last = first + 3*meshlet.triangleCount;
+	float axis[3] = {0.0f, 0.0f, 0.0f};
+	float radius2 = 0.0f, minDot = 1.0f, length, n[3];
+
+	for (int i = 0; i < 3; ++i)
+		meshlet.boundsMin[i] = meshlet.boundsMax[i] = positions[stride*first[0] + i];
+
+	for (const long* triangle = first; triangle < last; triangle += 3)
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			const float* p = positions + stride*triangle[k];
+			for (int i = 0; i < 3; ++i)
+			{
+				meshlet.boundsMin[i] = std::min(meshlet.boundsMin[i], p[i]);
+				meshlet.boundsMax[i] = std::max(meshlet.boundsMax[i], p[i]);
+			}
+		}
+
+		length = FaceNormal(positions, stride, triangle, n);
+		if (length > 0.0f)
+		{
+			for (int i = 0; i < 3; ++i)
+				axis[i] += n[i] / length;
+		}
+	}
+
+	//the sphere reaches the farthest vertex, which is tighter than the box corners
+	for (int i = 0; i < 3; ++i)
+		meshlet.center[i] = 0.5f*(meshlet.boundsMin[i] + meshlet.boundsMax[i]);
+	for (const long* corner = first; corner < last; ++corner)
+	{
+		const float* p = positions + stride*corner[0];
+		float dx = p[0] - meshlet.center[0], dy = p[1] - meshlet.center[1], dz = p[2] - meshlet.center[2];
+		radius2 = std::max(radius2, dx*dx + dy*dy + dz*dz);
+	}
+	meshlet.radius = sqrtf(radius2);
+
+	//the cone holds every face normal, its cutoff is the sine of the widest angle to the axis
+	length = sqrtf(axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2]);
+	if (length > 0.0f)
+	{
+		for (int i = 0; i < 3; ++i)
+			axis[i] /= length;
+		for (const long* triangle = first; triangle < last && minDot >= MESHLET_MIN_CONE_DOT; triangle += 3)
+		{
+			float faceLength = FaceNormal(positions, stride, triangle, n);
+			if (faceLength > 0.0f)
+				minDot = std::min(minDot, (n[0]*axis[0] + n[1]*axis[1] + n[2]*axis[2]) / faceLength);
+		}
+	}
+
+	if (length > 0.0f && minDot >= MESHLET_MIN_CONE_DOT)
+	{
+		memcpy(meshlet.coneAxis, axis, sizeof(axis));
+		meshlet.coneCutoff = sqrtf(1.0f - minDot*minDot);
+	}
+	else
+	{
+		meshlet.coneAxis[0] = meshlet.coneAxis[1] = meshlet.coneAxis[2] = 0.0f;
+		meshlet.coneCutoff = 1.0f;
+	}
+}
+
+void ComputeMeshletBounds(const float* positions, int stride, const long* indices,
+	Meshlet* meshlets, long meshletCount, int threads)
+{
+	ParallelFor(meshletCount, threads, [&](long m)
+	{
+		BoundMeshlet(positions, stride, indices, meshlets[m]);
+	});
+}
+
+MeshletStats AnalyzeMeshlets(const Meshlet* meshlets, long meshletCount, int maxVertices, int maxTriangles)
+{
+	MeshletStats stats = {meshletCount, 0.0, 0.0, 0.0, 0.0};
+
+	if (meshletCount == 0)
+		return stats;
+
+	for (long m = 0; m < meshletCount; ++m)
+	{
+		const Meshlet &meshlet = meshlets[m];
+		double diagonal2 = 0.0;
+
+		for (int i = 0; i < 3; ++i)
+			diagonal2 += (double)(meshlet.boundsMax[i] - meshlet.boundsMin[i]) * (meshlet.boundsMax[i] - meshlet.boundsMin[i]);
+
+		stats.vertexFill += (double) meshlet.vertexCount / maxVertices;
+		stats.triangleFill += (double) meshlet.triangleCount / maxTriangles;
+		stats.sphereTightness += diagonal2 > 0.0 ? meshlet.radius / (0.5*sqrt(diagonal2)) : 1.0;
+		stats.coneCulling += meshlet.coneCutoff < 1.0f ? 1.0 : 0.0;
+	}
+
+	stats.vertexFill /= meshletCount;
+	stats.triangleFill /= meshletCount;
+	stats.sphereTightness /= meshletCount;
+	stats.coneCulling /= meshletCount;
+	return stats;
+}
+
+int SetupMeshletView(const float* modelview, const float* projection, bool bCullBackfaces, MeshletView &view)
+{
+	float clip[16], inverse[9], determinant;
+	const float* m = modelview;
+
+	//the eye is where the modelview sends the origin of eye space from, -A^-1 t
+	inverse[0] = m[5]*m[10] - m[9]*m[6];
+	inverse[1] = m[9]*m[2] - m[1]*m[10];
+	inverse[2] = m[1]*m[6] - m[5]*m[2];
+	inverse[3] = m[8]*m[6] - m[4]*m[10];
+	inverse[4] = m[0]*m[10] - m[8]*m[2];
+	inverse[5] = m[4]*m[2] - m[0]*m[6];
+	inverse[6] = m[4]*m[9] - m[8]*m[5];
+	inverse[7] = m[8]*m[1] - m[0]*m[9];
+	inverse[8] = m[0]*m[5] - m[4]*m[1];
+	determinant = m[0]*inverse[0] + m[4]*inverse[1] + m[8]*inverse[2];
+	if (determinant == 0.0f || !std::isfinite(determinant))
+		return -1;
+	for (int i = 0; i < 3; ++i)
+		view.eye[i] = -(inverse[i]*m[12] + inverse[3 + i]*m[13] + inverse[6 + i]*m[14]) / determinant;
+
+	//planes of the clip volume taken back to positions, row 3 plus or minus rows 0 to 2
+	for (int c = 0; c < 4; ++c)
+	{
+		for (int r = 0; r < 4; ++r)
+			clip[4*c + r] = projection[r]*m[4*c] + projection[4 + r]*m[4*c + 1] + projection[8 + r]*m[4*c + 2] + projection[12 + r]*m[4*c + 3];
+	}
+	for (int p = 0; p < 6; ++p)
+	{
+		float sign = p % 2 == 0 ? 1.0f : -1.0f, length;
+		for (int c = 0; c < 4; ++c)
+			view.planes[p][c] = clip[4*c + 3] + sign*clip[4*c + p/2];
+		length = sqrtf(view.planes[p][0]*view.planes[p][0] + view.planes[p][1]*view.planes[p][1] + view.planes[p][2]*view.planes[p][2]);
+		if (length > 0.0f)
+		{
+			for (int c = 0; c < 4; ++c)
+				view.planes[p][c] /= length;
+		}
+	}
+	view.bCullBackfaces = bCullBackfaces;
+	return 0;
+}
+
+long CullMeshlets(const Meshlet* meshlets, long meshletCount, const MeshletView &view,
+	MeshletDrawRange* ranges, long &visibleTriangles)
+{
+	long rangeCount = 0;
+
+	visibleTriangles = 0;
+	for (long m = 0; m < meshletCount; ++m)
+	{
+		const Meshlet &meshlet = meshlets[m];
+		bool bVisible = true;
+
+		for (int p = 0; p < 6 && bVisible; ++p)
+		{
+			const float* plane = view.planes[p];
+			bVisible = plane[0]*meshlet.center[0] + plane[1]*meshlet.center[1] + plane[2]*meshlet.center[2] + plane[3] >= -meshlet.radius;
+		}
+
+		//every face normal points away from an eye inside the cone's back side
+		if (bVisible && view.bCullBackfaces && meshlet.coneCutoff < 1.0f)
+		{
+			float d[3] = {meshlet.center[0] - view.eye[0], meshlet.center[1] - view.eye[1], meshlet.center[2] - view.eye[2]};
+			float distance = sqrtf(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+			bVisible = d[0]*meshlet.coneAxis[0] + d[1]*meshlet.coneAxis[1] + d[2]*meshlet.coneAxis[2] <
+				meshlet.coneCutoff*distance + meshlet.radius;
+		}
+		if (!bVisible)
+			continue;
+
+		visibleTriangles += meshlet.triangleCount;
+		if (rangeCount > 0 && ranges[rangeCount - 1].firstTriangle + ranges[rangeCount - 1].triangleCount == meshlet.firstTriangle)
+			ranges[rangeCount - 1].triangleCount += meshlet.triangleCount;
+		else
+		{
+			ranges[rangeCount].firstTriangle = meshlet.firstTriangle;
+			ranges[rangeCount].triangleCount = meshlet.triangleCount;
+			++rangeCount;
+		}
+	}
+	return rangeCount;
+}
@@ -0,0 +1,88 @@
+/*
+Meshlet partitioning of indexed triangle meshes with per-meshlet bounds
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef MESHLETS_H
+#define MESHLETS_H
+
+#include "arena.h"
+
+//limits that suit mesh shader hardware as well as culling on the CPU
+static const int MESHLET_MAX_VERTICES = 64;
+static const int MESHLET_MAX_TRIANGLES = 124;
+
+//a run of consecutive triangles of the index buffer, so it draws with one
+//call, 64 bytes where long has 32 bits
+struct Meshlet
+{
+	float center[3];	// Bounding sphere
+	float radius;
+	float boundsMin[3];
+	float coneCutoff;	// Sine of the normal cone's half angle, 1 for a cone that never culls
+	float boundsMax[3];
+	float coneAxis[3];	// Mean face normal, zero for a cone that never culls
+	unsigned short triangleCount;
+	unsigned short vertexCount;
+	long firstTriangle;
+};
+
+struct MeshletStats
+{
+	long meshletCount;
+	double vertexFill;		// Average share of the vertex limit used
+	double triangleFill;	// Average share of the triangle limit used
+	double sphereTightness;	// Average radius over half the box diagonal, 1 when the sphere just holds the box
+	double coneCulling;		// Share of meshlets whose cone can cull them
+};
+
+//what the camera sees, in the units of the positions
+struct MeshletView
+{
+	float planes[6][4];		// Frustum planes facing inwards with unit normals
+	float eye[3];
+	bool bCullBackfaces;	// Also drop meshlets whose normal cone faces away from the eye
+};
+
+//consecutive visible triangles of the index buffer
+struct MeshletDrawRange
+{
+	long firstTriangle;
+	long triangleCount;
+};
+
+//most meshlets PartitionMeshlets can make
+long MeshletBound(long triangleCount, int maxVertices, int maxTriangles);
+
+//splits the triangles in index order into meshlets of at most maxVertices
+//different vertices and maxTriangles triangles and sets their triangle range
+//and vertex count, meshlets holds MeshletBound entries and the cut points do
+//not depend on threads, returns the number of meshlets or -1
+long PartitionMeshlets(const long* indices, long triangleCount, int maxVertices, int maxTriangles,
+	Meshlet* meshlets, int threads, MemoryArena &scratch);
+
+//fills in the bounds and cone of partitioned meshlets, positions are read as
+//x, y, z every stride floats
+void ComputeMeshletBounds(const float* positions, int stride, const long* indices,
+	Meshlet* meshlets, long meshletCount, int threads);
+
+//sets up the view from column major OpenGL matrices that take positions to
+//eye space, the modelview must not project, returns 0 or -1 when it is singular
+int SetupMeshletView(const float* modelview, const float* projection, bool bCullBackfaces, MeshletView &view);
+
+//tests every meshlet against the frustum and the normal cones and writes the
+//visible ones as ranges, neighbours merged, ranges holds meshletCount entries,
+//returns the number of ranges and sets the number of visible triangles
+long CullMeshlets(const Meshlet* meshlets, long meshletCount, const MeshletView &view,
+	MeshletDrawRange* ranges, long &visibleTriangles);
+
+MeshletStats AnalyzeMeshlets(const Meshlet* meshlets, long meshletCount, int maxVertices, int maxTriangles);
+
+#endif
@@ -0,0 +1,310 @@
+/*
+Parallel vertex normal generation for indexed triangle meshes
+
+Face normals are computed four triangles at a time, then the weighted normal
+of every corner is binned by ranges of vertices small enough to stay in cache
+and every range is summed by one thread, so no two threads ever add to the
+same normal.
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MESHNORMALS_SSE2
+#endif
+
+#include "meshnormals.h"
+#include "parallel.h"
+
+//triangles handled per task
+static const long NORMALS_BLOCK = 1 << 14;
+
+//triangles binned at a time, bounds the scratch memory to 16 bytes per corner of a pass
+static const long NORMALS_PASS = 1 << 20;
+
+//vertices per range, the normals of a range stay in cache while its corners are added
+static const int NORMALS_RANGE_SHIFT = 14;
+
+//weighted face normal to add to one vertex of a range
+struct NormalContribution
+{
+	float normal[3];
+	unsigned int vertex;	// Offset in the range
+};
+
+//face normals as x, y, z, 0 and the corner angles of every face, NULL when weighting by area
+struct FaceNormals
+{
+	float* normals;
+	float* cornerWeights;
+};
+
+//area weighting keeps the cross product of the edges, whose length is twice the
+//area, angle weighting the unit normal and the corner angles, degenerate faces
+//get a zero normal either way
+static inline void StoreFace(FaceNormals &faces, long face, float nx, float ny, float nz,
+	float dot0, float dot1, float dot2)
+{
+	float* normal = faces.normals + 4*face;
+	float* weights;
+	float length;
+
+	normal[3] = 0.0f;
+	if (faces.cornerWeights == NULL)
+	{
+		normal[0] = nx;
+		normal[1] = ny;
+		normal[2] = nz;
+		return;
+	}
+
+	weights = faces.cornerWeights + 3*face;
+	length = sqrtf(nx*nx + ny*ny + nz*nz);
+	if (!(length > 0.0f))
+	{
+		normal[0] = normal[1] = normal[2] = 0.0f;
+		weights[0] = weights[1] = weights[2] = 0.0f;
+		return;
+	}
+	normal[0] = nx / length;
+	normal[1] = ny / length;
+	normal[2] = nz / length;
+
+	//|e1 x e2| is the same for every corner, so each angle is one atan2
+	weights[0] = atan2f(length, dot0);
+	weights[1] = atan2f(length, dot1);
+	weights[2] = atan2f(length, dot2);
+}
+
+//normals of the triangles in [first, last), stored from the start of faces
+static void ComputeFaceNormals(const float* positions, int stride, const long* indices,
+	long first, long last, FaceNormals &faces)
+{
+	long t = first;
+
+#ifdef MESHNORMALS_SSE2
+	//four triangles per step, the corners are gathered into one register per coordinate
+	for (; t + 4 <= last; t += 4)
+	{
+		const long* tri = indices + 3*t;
+		const float *a0 = positions + stride*tri[0], *b0 = positions + stride*tri[1], *c0 = positions + stride*tri[2];
+		const float *a1 = positions + stride*tri[3], *b1 = positions + stride*tri[4], *c1 = positions + stride*tri[5];
+		const float *a2 = positions + stride*tri[6], *b2 = positions + stride*tri[7], *c2 = positions + stride*tri[8];
+		const float *a3 = positions + stride*tri[9], *b3 = positions + stride*tri[10], *c3 = positions + stride*tri[11];
+		__m128 ax = _mm_set_ps(a3[0], a2[0], a1[0], a0[0]);
+		__m128 ay = _mm_set_ps(a3[1], a2[1], a1[1], a0[1]);
+		__m128 az = _mm_set_ps(a3[2], a2[2], a1[2], a0[2]);
+		__m128 e1x = _mm_sub_ps(_mm_set_ps(b3[0], b2[0], b1[0], b0[0]), ax);
+		__m128 e1y = _mm_sub_ps(_mm_set_ps(b3[1], b2[1], b1[1], b0[1]), ay);
+		__m128 e1z = _mm_sub_ps(_mm_set_ps(b3[2], b2[2], b1[2], b0[2]), az);
+		__m128 e2x = _mm_sub_ps(_mm_set_ps(c3[0], c2[0], c1[0], c0[0]), ax);
+		__m128 e2y = _mm_sub_ps(_mm_set_ps(c3[1], c2[1], c1[1], c0[1]), ay);
+		__m128 e2z = _mm_sub_ps(_mm_set_ps(c3[2], c2[2], c1[2], c0[2]), az);
+		__m128 nx = _mm_sub_ps(_mm_mul_ps(e1y, e2z), _mm_mul_ps(e1z, e2y));
+		__m128 ny = _mm_sub_ps(_mm_mul_ps(e1z, e2x), _mm_mul_ps(e1x, e2z));
+		__m128 nz = _mm_sub_ps(_mm_mul_ps(e1x, e2y), _mm_mul_ps(e1y, e2x));
+		__m128 nw = _mm_setzero_ps();
+
+		if (faces.cornerWeights == NULL)
+		{
+			//x, y, z of four faces become four x, y, z, 0 records
+			_MM_TRANSPOSE4_PS(nx, ny, nz, nw);
+			_mm_storeu_ps(faces.normals + 4*(t - first), nx);
+			_mm_storeu_ps(faces.normals + 4*(t - first) + 4, ny);
+			_mm_storeu_ps(faces.normals + 4*(t - first) + 8, nz);
+			_mm_storeu_ps(faces.normals + 4*(t - first) + 12, nw);
+			continue;
+		}
+
+		//corner dots: e1.e2 at a, e1.e1 - e1.e2 at b, e2.e2 - e1.e2 at c
+		float normal[3][4], dots[3][4];
+		__m128 d12 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, e2x), _mm_mul_ps(e1y, e2y)), _mm_mul_ps(e1z, e2z));
+		__m128 d11 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, e1x), _mm_mul_ps(e1y, e1y)), _mm_mul_ps(e1z, e1z));
+		__m128 d22 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, e2x), _mm_mul_ps(e2y, e2y)), _mm_mul_ps(e2z, e2z));
+		_mm_storeu_ps(normal[0], nx);
+		_mm_storeu_ps(normal[1], ny);
+		_mm_storeu_ps(normal[2], nz);
+		_mm_storeu_ps(dots[0], d12);
+		_mm_storeu_ps(dots[1], _mm_sub_ps(d11, d12));
+		_mm_storeu_ps(dots[2], _mm_sub_ps(d22, d12));
+		for (int k = 0; k < 4; ++k)
+			StoreFace(faces, t - first + k, normal[0][k], normal[1][k], normal[2][k], dots[0][k], dots[1][k], dots[2][k]);
+	}
+#endif
+	for (; t < last; ++t)
+	{
+		const float* a = positions + stride*indices[3*t];
+		const float* b = positions + stride*indices[3*t + 1];
+		const float* c = positions + stride*indices[3*t + 2];
+		float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+		float e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+		float d12 = e1[0]*e2[0] + e1[1]*e2[1] + e1[2]*e2[2];
+		float d11 = e1[0]*e1[0] + e1[1]*e1[1] + e1[2]*e1[2];
+		float d22 = e2[0]*e2[0] + e2[1]*e2[1] + e2[2]*e2[2];
+
+		StoreFace(faces, t - first, e1[1]*e2[2] - e1[2]*e2[1], e1[2]*e2[0] - e1[0]*e2[2], e1[0]*e2[1] - e1[1]*e2[0],
+			d12, d11 - d12, d22 - d12);
+	}
+}
+
+//the weighted face normal of every corner is binned by vertex range and
+//every range is then summed by one thread, so normals need no atomics, stay
+//in cache while they are added to and each vertex adds its faces in file
+//order whatever the number of threads
+int ComputeVertexNormals(const float* positions, int stride, long vertexCount,
+	const long* indices, long triangleCount, float* normals,
+	NormalWeighting weighting, int threads, MemoryArena &scratch)
+{
+	long ranges = (vertexCount >> NORMALS_RANGE_SHIFT) + 1;
+	long passBlocks = (std::min(triangleCount, NORMALS_PASS) + NORMALS_BLOCK - 1) / NORMALS_BLOCK;
+	long* binStart;		// Start of each block's corners in each range, range major
+	NormalContribution* bins;
+
+	binStart = scratch.Allocate<long>(ranges*passBlocks + 1);
+	bins = scratch.Allocate<NormalContribution>(3*std::min(triangleCount, NORMALS_PASS));
+	if (binStart == NULL || bins == NULL)
+		return -1;
+
+	ParallelFor(ranges, threads, [&](long r)
+	{
+		long first = r << NORMALS_RANGE_SHIFT;
+		long last = std::min(vertexCount, (r + 1) << NORMALS_RANGE_SHIFT);
+		memset(normals + 3*first, 0, (last - first)*3*sizeof(float));
+	});
+
+	//a single thread has nobody to race with and adds straight into the normals,
+	//in the same order the ranges would
+	if (ResolveThreadCount(threads) == 1)
+	{
+		std::vector<float> faceNormals(4*std::min(triangleCount, NORMALS_BLOCK));
+		std::vector<float> cornerWeights(weighting == NORMALS_ANGLE_WEIGHTED ? 3*std::min(triangleCount, NORMALS_BLOCK) : 0);
+		FaceNormals faces;
+
+		faces.normals = faceNormals.empty() ? NULL : &faceNormals[0];
+		faces.cornerWeights = cornerWeights.empty() ? NULL : &cornerWeights[0];
+		for (long first = 0; first < triangleCount; first += NORMALS_BLOCK)
+		{
+			long last = std::min(triangleCount, first + NORMALS_BLOCK);
+
+			ComputeFaceNormals(positions, stride, indices, first, last, faces);
+			for (long c = 3*first; c < 3*last; ++c)
+			{
+				const float* face = faces.normals + 4*(c/3 - first);
+				float weight = faces.cornerWeights != NULL ? faces.cornerWeights[c - 3*first] : 1.0f;
+				float* normal = normals + 3*indices[c];
+
+				normal[0] += weight*face[0];
+				normal[1] += weight*face[1];
+				normal[2] += weight*face[2];
+			}
+		}
+		triangleCount = 0;
+	}
+
+	for (long pass = 0; pass < triangleCount; pass += NORMALS_PASS)
+	{
+		long passEnd = std::min(triangleCount, pass + NORMALS_PASS);
+		long blocks = (passEnd - pass + NORMALS_BLOCK - 1) / NORMALS_BLOCK;
+		long total = 0;
+
+		//how many corners of every block fall in each range
+		ParallelFor(blocks, threads, [&](long block)
+		{
+			long first = pass + block*NORMALS_BLOCK;
+			long last = std::min(passEnd, first + NORMALS_BLOCK);
+
+			for (long r = 0; r < ranges; ++r)
+				binStart[r*blocks + block] = 0;
+			for (long c = 3*first; c < 3*last; ++c)
+				++binStart[(indices[c] >> NORMALS_RANGE_SHIFT)*blocks + block];
+		});
+
+		for (long i = 0; i < ranges*blocks; ++i)
+		{
+			long count = binStart[i];
+			binStart[i] = total;
+			total += count;
+		}
+		binStart[ranges*blocks] = total;
+
+		ParallelFor(blocks, threads, [&](long block)
+		{
+			long first = pass + block*NORMALS_BLOCK;
+			long last = std::min(passEnd, first + NORMALS_BLOCK);
+			std::vector<float> faceNormals(4*(last - first));
+			std::vector<float> cornerWeights(weighting == NORMALS_ANGLE_WEIGHTED ? 3*(last - first) : 0);
+			std::vector<long> cursor(ranges);
+			FaceNormals faces;
+
+			faces.normals = &faceNormals[0];
+			faces.cornerWeights = cornerWeights.empty() ? NULL : &cornerWeights[0];
+			ComputeFaceNormals(positions, stride, indices, first, last, faces);
+
+			for (long r = 0; r < ranges; ++r)
+				cursor[r] = binStart[r*blocks + block];
+			for (long c = 3*first; c < 3*last; ++c)
+			{
+				const float* face = faces.normals + 4*(c/3 - first);
+				float weight = faces.cornerWeights != NULL ? faces.cornerWeights[c - 3*first] : 1.0f;
+				NormalContribution &bin = bins[cursor[indices[c] >> NORMALS_RANGE_SHIFT]++];
+
+				bin.normal[0] = weight*face[0];
+				bin.normal[1] = weight*face[1];
+				bin.normal[2] = weight*face[2];
+				bin.vertex = (unsigned int)(indices[c] & ((1 << NORMALS_RANGE_SHIFT) - 1));
+			}
+		});
+
+		ParallelFor(ranges, threads, [&](long r)
+		{
+			float* rangeNormals = normals + 3*(r << NORMALS_RANGE_SHIFT);
+
+			for (long i = binStart[r*blocks]; i < binStart[(r + 1)*blocks]; ++i)
+			{
+				float* normal = rangeNormals + 3*bins[i].vertex;
+				normal[0] += bins[i].normal[0];
+				normal[1] += bins[i].normal[1];
+				normal[2] += bins[i].normal[2];
+			}
+		});
+	}
+
+	ParallelFor(ranges, threads, [&](long r)
+	{
+		long first = r << NORMALS_RANGE_SHIFT;
+		long last = std::min(vertexCount, (r + 1) << NORMALS_RANGE_SHIFT);
+
+		for (long v = first; v < last; ++v)
+		{
+			float* normal = normals + 3*v;
+			float length = sqrtf(normal[0]*normal[0] + normal[1]*normal[1] + normal[2]*normal[2]);
+
+			if (length > 0.0f && length < INFINITY)
+			{
+				normal[0] /= length;
+				normal[1] /= length;
+				normal[2] /= length;
+			}
+			else
+			{
+				normal[0] = 0.0f;
+				normal[1] = 0.0f;
+				normal[2] = 1.0f;
+			}
+		}
+	});
+
+	return 0;
+}
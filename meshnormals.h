@@ -0,0 +1,33 @@
+/*
+Parallel vertex normal generation for indexed triangle meshes
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef MESHNORMALS_H
+#define MESHNORMALS_H
+
+#include "arena.h"
+
+//how much each face adds to the normals of its corners
+enum NormalWeighting
+{
+	NORMALS_AREA_WEIGHTED,		// By face area, large faces dominate
+	NORMALS_ANGLE_WEIGHTED		// By the corner angle, independent of how faces are split up
+};
+
+//writes a unit normal per vertex to normals (3 floats each) from the triangles
+//in indices, positions are read as x, y, z every stride floats, vertices no
+//usable face touches get (0, 0, 1), temporaries come from scratch and stay
+//allocated until the caller resets it, returns 0 or -1
+int ComputeVertexNormals(const float* positions, int stride, long vertexCount,
+	const long* indices, long triangleCount, float* normals,
+	NormalWeighting weighting, int threads, MemoryArena &scratch);
+
+#endif
@@ -0,0 +1,252 @@
+/*
+Vertex cache and vertex fetch optimisation of indexed triangle meshes
+
+The triangle order follows Tom Forsyth's "Linear-Speed Vertex Cache
+Optimisation": vertices are scored by their place in a simulated LRU cache
+and by how many of their triangles are still waiting, and the next triangle
+is the best scoring one around the vertices in the cache.
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#include <cmath>
+#include <cstring>
+
+#include "meshoptimize.h"
+
+//the tuning Forsyth published
+static const int FORSYTH_CACHE_SIZE = 32;
+static const int FORSYTH_MAX_VALENCE = 32;
+static const float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+static const float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+static const float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+static const float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+struct ForsythScores
+{
+	float cache[FORSYTH_CACHE_SIZE];
+	float valence[FORSYTH_MAX_VALENCE];
+
+	ForsythScores()
+	{
+		for (int i = 0; i < FORSYTH_CACHE_SIZE; ++i)
+		{
+			//the last triangle's vertices score the same, so its orientation does not matter
+			if (i < 3)
+				cache[i] = FORSYTH_LAST_TRIANGLE_SCORE;
+			else
+				cache[i] = powf(1.0f - (float)(i - 3) / (FORSYTH_CACHE_SIZE - 3), FORSYTH_CACHE_DECAY_POWER);
+		}
+		//vertices with few triangles left are worth finishing off
+		valence[0] = 0.0f;
+		for (int i = 1; i < FORSYTH_MAX_VALENCE; ++i)
+			valence[i] = FORSYTH_VALENCE_BOOST_SCALE * powf((float) i, -FORSYTH_VALENCE_BOOST_POWER);
+	}
+
+	inline float Score(int cachePosition, long liveTriangles) const
+	{
+		if (liveTriangles == 0)
+			return -1.0f;
+		return (cachePosition >= 0 ? cache[cachePosition] : 0.0f) +
+			valence[liveTriangles < FORSYTH_MAX_VALENCE ? liveTriangles : FORSYTH_MAX_VALENCE - 1];
+	}
+};
+
+VertexCacheStats AnalyzeVertexCache(const long* indices, long triangleCount, long vertexCount,
+	int cacheSize, MemoryArena &scratch)
+{
+	VertexCacheStats stats = {0.0, 0.0};
+	long* stamps = scratch.Allocate<long>(vertexCount);
+	long time = cacheSize + 1, misses = 0, used = 0;
+
+	if (stamps == NULL || triangleCount == 0)
+		return stats;
+	memset(stamps, 0, vertexCount*sizeof(long));
+
+	//a vertex is in the FIFO while fewer than cacheSize misses came after its own
+	for (long i = 0; i < triangleCount*3; ++i)
+	{
+		long v = indices[i];
+		if (stamps[v] == 0)
+			++used;
+		if (time - stamps[v] > cacheSize)
+		{
+			stamps[v] = time++;
+			++misses;
+		}
+	}
+
+	stats.acmr = (double) misses / triangleCount;
+	stats.atvr = used > 0 ? (double) misses / used : 0.0;
+	return stats;
+}
+
+int OptimizeVertexCache(long* indices, long triangleCount, long vertexCount, MemoryArena &scratch,
+	long* order)
+{
+	static const ForsythScores scores;
+	long* live = scratch.Allocate<long>(vertexCount);		// Triangles not yet emitted per vertex
+	long* adjacencyStart = scratch.Allocate<long>(vertexCount + 1);
+	long* adjacency = scratch.Allocate<long>(triangleCount*3);	// Live triangles first
+	int* cachePosition = scratch.Allocate<int>(vertexCount);
+	float* vertexScore = scratch.Allocate<float>(vertexCount);
+	char* emitted = scratch.Allocate<char>(triangleCount);
+	long* output = scratch.Allocate<long>(triangleCount*3);
+	long cache[FORSYTH_CACHE_SIZE + 3], newCache[FORSYTH_CACHE_SIZE + 3];
+	int cacheCount = 0;
+	long best = -1, next = 0;
+
+	if (live == NULL || adjacencyStart == NULL || adjacency == NULL || cachePosition == NULL ||
+		vertexScore == NULL || emitted == NULL || output == NULL)
+		return -1;
+
+	//triangles around every vertex
+	memset(live, 0, vertexCount*sizeof(long));
+	for (long i = 0; i < triangleCount*3; ++i)
+		++live[indices[i]];
+	adjacencyStart[0] = 0;
+	for (long v = 0; v < vertexCount; ++v)
+	{
+		adjacencyStart[v + 1] = adjacencyStart[v] + live[v];
+		live[v] = 0;
+	}
+	for (long i = 0; i < triangleCount*3; ++i)
+	{
+		long v = indices[i];
+		adjacency[adjacencyStart[v] + live[v]++] = i / 3;
+	}
+
+	for (long v = 0; v < vertexCount; ++v)
+	{
+		cachePosition[v] = -1;
+		vertexScore[v] = scores.Score(-1, live[v]);
+	}
+	if (triangleCount > 0)
+		memset(emitted, 0, (size_t) triangleCount);
+
+	for (long n = 0; n < triangleCount; ++n)
+	{
+		const long* triangle;
+		int newCount = 0;
+		float bestScore = -1.0f;
+
+		//nothing around the cache left, start again at the first triangle still waiting
+		if (best < 0)
+		{
+			while (emitted[next])
+				++next;
+			best = next;
+		}
+
+		triangle = indices + 3*best;
+		memcpy(output + 3*n, triangle, 3*sizeof(long));
+		emitted[best] = 1;
+		if (order != NULL)
+			order[n] = best;
+
+		//the triangle leaves the live part of its vertices' lists
+		for (int k = 0; k < 3; ++k)
+		{
+			long v = triangle[k];
+			long* list = adjacency + adjacencyStart[v];
+			long count = live[v];
+
+			for (long j = 0; j < count; ++j)
+			{
+				if (list[j] == best)
+				{
+					list[j] = list[count - 1];
+					list[count - 1] = best;
+					--live[v];
+					break;
+				}
+			}
+		}
+
+		//the triangle's vertices move to the front of the cache
+		for (int k = 0; k < 3; ++k)
+		{
+			long v = triangle[k];
+			if (k == 0 || (v != triangle[0] && (k == 1 || v != triangle[1])))
+				newCache[newCount++] = v;
+		}
+		for (int i = 0; i < cacheCount; ++i)
+		{
+			long v = cache[i];
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+				newCache[newCount++] = v;
+		}
+
+		for (int i = 0; i < newCount; ++i)
+		{
+			long v = newCache[i];
+			cachePosition[v] = i < FORSYTH_CACHE_SIZE ? i : -1;
+			vertexScore[v] = scores.Score(cachePosition[v], live[v]);
+		}
+		cacheCount = newCount < FORSYTH_CACHE_SIZE ? newCount : FORSYTH_CACHE_SIZE;
+		memcpy(cache, newCache, cacheCount*sizeof(long));
+
+		//only triangles around the cache changed score, the best of them goes next
+		best = -1;
+		for (int i = 0; i < cacheCount; ++i)
+		{
+			long v = cache[i];
+			const long* list = adjacency + adjacencyStart[v];
+
+			for (long j = 0; j < live[v]; ++j)
+			{
+				const long* candidate = indices + 3*list[j];
+				float score = vertexScore[candidate[0]] + vertexScore[candidate[1]] + vertexScore[candidate[2]];
+				if (score > bestScore)
+				{
+					bestScore = score;
+					best = list[j];
+				}
+			}
+		}
+	}
+
+	memcpy(indices, output, triangleCount*3*sizeof(long));
+	return 0;
+}
+
+long OptimizeVertexFetch(long* indices, long triangleCount, long vertexCount, long* remap)
+{
+	long next = 0, used;
+
+	for (long v = 0; v < vertexCount; ++v)
+		remap[v] = -1;
+	for (long i = 0; i < triangleCount*3; ++i)
+	{
+		long v = indices[i];
+		if (remap[v] < 0)
+			remap[v] = next++;
+		indices[i] = remap[v];
+	}
+
+	used = next;
+	for (long v = 0; v < vertexCount; ++v)
+	{
+		if (remap[v] < 0)
+			remap[v] = next++;
+	}
+	return used;
+}
+
+int RemapVertexBuffer(float* buffer, int stride, long vertexCount, const long* remap, MemoryArena &scratch)
+{
+	float* copy = scratch.Allocate<float>(vertexCount*stride);
+
+	if (copy == NULL)
+		return -1;
+	memcpy(copy, buffer, vertexCount*stride*sizeof(float));
+	for (long v = 0; v < vertexCount; ++v)
+		memcpy(buffer + remap[v]*stride, copy + v*stride, stride*sizeof(float));
+	return 0;
+}
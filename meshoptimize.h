@@ -0,0 +1,46 @@
+/*
+Vertex cache and vertex fetch optimisation of indexed triangle meshes
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef MESHOPTIMIZE_H
+#define MESHOPTIMIZE_H
+
+#include "arena.h"
+
+//post-transform cache the statistics are simulated for, a FIFO like most hardware
+static const int VERTEX_CACHE_FIFO_SIZE = 16;
+
+struct VertexCacheStats
+{
+	double acmr;	// Vertices transformed per triangle, 0.5 at best, 3 at worst
+	double atvr;	// Vertices transformed per vertex used, 1 at best
+};
+
+//simulates a FIFO post-transform cache of cacheSize entries over the triangles
+VertexCacheStats AnalyzeVertexCache(const long* indices, long triangleCount, long vertexCount,
+	int cacheSize, MemoryArena &scratch);
+
+//reorders the triangles in place for the post-transform cache with Tom Forsyth's
+//linear-speed vertex cache optimisation, every triangle is looked at a bounded
+//number of times so the time grows linearly with the mesh, order[n] gets the
+//old number of the triangle put at n when given, returns 0 or -1
+int OptimizeVertexCache(long* indices, long triangleCount, long vertexCount, MemoryArena &scratch,
+	long* order = NULL);
+
+//numbers the vertices in the order the triangles first use them and rewrites
+//the indices to match, remap[old vertex] gets the new number, vertices no
+//triangle uses go to the end, returns the number of vertices used
+long OptimizeVertexFetch(long* indices, long triangleCount, long vertexCount, long* remap);
+
+//moves every vertex of buffer, stride floats each, to its place in remap
+int RemapVertexBuffer(float* buffer, int stride, long vertexCount, const long* remap, MemoryArena &scratch);
+
+#endif
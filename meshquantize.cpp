@@ -0,0 +1,364 @@
+/*
+Compact vertex attributes: 16 bit positions, octahedral normals and half
+float texture coordinates
+
+Positions are stored as steps from the centre of the bounding box, with one
+step size for all axes so a uniform scale in the modelview dequantizes them
+and normals keep their directions. Normals are folded onto an octahedron and
+stored as two snorm16, picking whichever of the four neighbouring codes
+decodes closest, or kept as three snorm16 for drawing them directly. The
+decoders unpack four octahedral normals or one position at a time with
+SSE2 and give the same bits as the scalar code.
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MESHQUANTIZE_SSE2
+#endif
+
+#include "meshquantize.h"
+#include "parallel.h"
+
+//vertices quantized per task
+static const long QUANTIZE_CHUNK = 1 << 16;
+
+static const float SNORM16_MAX = 32767.0f;
+
+static inline uint32_t FloatBits(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+static inline float BitsFloat(uint32_t bits)
+{
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+//rounds to the nearest half float, ties to even, too large values become infinity
+static unsigned short FloatToHalf(float value)
+{
+	uint32_t bits = FloatBits(value);
+	uint32_t sign = (bits >> 16) & 0x8000u;
+	uint32_t magnitude = bits & 0x7FFFFFFFu;
+
+	if (magnitude >= 0x47800000u)
+		return (unsigned short)(sign | (magnitude > 0x7F800000u ? 0x7E00u : 0x7C00u));
+
+	//below the smallest normal half, adding 0.5 lets the float unit round the subnormal
+	if (magnitude < 0x38800000u)
+		return (unsigned short)(sign | (FloatBits(BitsFloat(magnitude) + 0.5f) - 0x3F000000u));
+
+	//rebias the exponent and round the 13 dropped mantissa bits to even
+	magnitude += 0xC8000FFFu + ((magnitude >> 13) & 1);
+	return (unsigned short)(sign | (magnitude >> 13));
+}
+
+//moves the exponent and mantissa into place and rebias by multiplying with
+//2^112, which also turns subnormal halves into normal floats
+static inline float HalfToFloat(unsigned short half)
+{
+	uint32_t magnitude = half & 0x7FFFu;
+	uint32_t bits = FloatBits(BitsFloat(magnitude << 13)*BitsFloat(0x77800000u));
+
+	if (magnitude > 0x7BFFu)
+		bits |= 0x7F800000u;
+	return BitsFloat(bits | ((uint32_t)(half & 0x8000u) << 16));
+}
+
+static inline void DecodeOctahedral(short qu, short qv, float* n)
+{
+	float x = qu*(1.0f / SNORM16_MAX), y = qv*(1.0f / SNORM16_MAX);
+	float z = 1.0f - fabsf(x) - fabsf(y);
+	float t = std::max(-z, 0.0f), length;
+
+	//the lower half of the octahedron is folded over the diagonals
+	x -= copysignf(t, x);
+	y -= copysignf(t, y);
+	length = sqrtf(x*x + y*y + z*z);
+	n[0] = x / length;
+	n[1] = y / length;
+	n[2] = z / length;
+}
+
+static inline void DecodeSnorm16(const short* q, float* n)
+{
+	float x = q[0]*(1.0f / SNORM16_MAX), y = q[1]*(1.0f / SNORM16_MAX), z = q[2]*(1.0f / SNORM16_MAX);
+	float length = sqrtf(x*x + y*y + z*z);
+
+	if (!(length > 0.0f))
+	{
+		n[0] = n[1] = n[2] = 0.0f;
+		return;
+	}
+	n[0] = x / length;
+	n[1] = y / length;
+	n[2] = z / length;
+}
+
+//returns the cosine of the angle between the normal and its decoded code
+static float EncodeSnorm16(const float* n, short* code)
+{
+	float length = sqrtf(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]), decoded[3];
+
+	if (!(length > 0.0f))
+	{
+		code[0] = code[1] = code[2] = 0;
+		return 1.0f;
+	}
+	for (int i = 0; i < 3; ++i)
+		code[i] = (short) std::min(std::max(floorf(n[i] / length*SNORM16_MAX + 0.5f), -SNORM16_MAX), SNORM16_MAX);
+	DecodeSnorm16(code, decoded);
+	return (decoded[0]*n[0] + decoded[1]*n[1] + decoded[2]*n[2]) / length;
+}
+
+//returns the cosine of the angle between the normal and its decoded code
+static float EncodeOctahedral(const float* n, short* code)
+{
+	float sum = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+	float u, v, best = -2.0f, length, decoded[3];
+
+	if (!(sum > 0.0f))
+	{
+		code[0] = code[1] = 0;
+		return 1.0f;
+	}
+	u = n[0] / sum;
+	v = n[1] / sum;
+	if (n[2] < 0.0f)
+	{
+		float foldedU = (1.0f - fabsf(v))*(u >= 0.0f ? 1.0f : -1.0f);
+		v = (1.0f - fabsf(u))*(v >= 0.0f ? 1.0f : -1.0f);
+		u = foldedU;
+	}
+
+	length = sqrtf(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+	int baseU = (int) floorf(u*SNORM16_MAX), baseV = (int) floorf(v*SNORM16_MAX);
+	for (int k = 0; k < 4; ++k)
+	{
+		short qu = (short) std::min(std::max(baseU + (k & 1), -32767), 32767);
+		short qv = (short) std::min(std::max(baseV + (k >> 1), -32767), 32767);
+		float cosine;
+
+		DecodeOctahedral(qu, qv, decoded);
+		cosine = (decoded[0]*n[0] + decoded[1]*n[1] + decoded[2]*n[2]) / length;
+		if (cosine > best)
+		{
+			best = cosine;
+			code[0] = qu;
+			code[1] = qv;
+		}
+	}
+	return best;
+}
+
+QuantizedMesh::QuantizedMesh()
+{
+	mOrigin[0] = mOrigin[1] = mOrigin[2] = 0.0f;
+	mStep = 1.0f;
+	mNormalEncoding = NORMALS_OCTAHEDRAL;
+	mVertexCount = 0;
+	memset(&mStats, 0, sizeof(mStats));
+}
+
+void QuantizedMesh::Release()
+{
+	std::vector<short>().swap(mPositions);
+	std::vector<short>().swap(mNormals);
+	std::vector<unsigned short>().swap(mTexcoords);
+	mVertexCount = 0;
+	memset(&mStats, 0, sizeof(mStats));
+}
+
+int QuantizedMesh::Build(const float* positions, int positionStride, const float* normals, const float* texcoords,
+	long vertexCount, const float* boundsMin, const float* boundsMax, int threads,
+	NormalEncoding normalEncoding)
+{
+	long chunkCount = (vertexCount + QUANTIZE_CHUNK - 1) / QUANTIZE_CHUNK;
+	std::vector<QuantizationStats> chunkStats;
+	float halfExtent = 0.0f;
+
+	Release();
+	if (positions == NULL || vertexCount <= 0)
+		return -1;
+
+	for (int i = 0; i < 3; ++i)
+	{
+		mOrigin[i] = 0.5f*(boundsMin[i] + boundsMax[i]);
+		halfExtent = std::max(halfExtent, 0.5f*(boundsMax[i] - boundsMin[i]));
+	}
+	mStep = halfExtent > 0.0f ? halfExtent / SNORM16_MAX : 1.0f;
+	if (!std::isfinite(mStep))
+		return -1;
+
+	int normalStride = normalEncoding == NORMALS_OCTAHEDRAL ? 2 : 3;
+	mNormalEncoding = normalEncoding;
+	mPositions.resize(3*(size_t) vertexCount);
+	if (normals != NULL)
+		mNormals.resize(normalStride*(size_t) vertexCount);
+	if (texcoords != NULL)
+		mTexcoords.resize(2*(size_t) vertexCount);
+	mVertexCount = vertexCount;
+	chunkStats.resize(chunkCount);
+
+	ParallelFor(chunkCount, threads, [&](long chunk)
+	{
+		long first = chunk*QUANTIZE_CHUNK, last = std::min(vertexCount, first + QUANTIZE_CHUNK);
+		QuantizationStats &stats = chunkStats[chunk];
+		float minCosine = 1.0f, positionError2 = 0.0f;
+
+		memset(&stats, 0, sizeof(stats));
+		for (long v = first; v < last; ++v)
+		{
+			const float* p = positions + (size_t) positionStride*v;
+			short* q = &mPositions[3*(size_t) v];
+			float error2 = 0.0f;
+
+			for (int i = 0; i < 3; ++i)
+			{
+				float steps = std::min(std::max(floorf((p[i] - mOrigin[i]) / mStep + 0.5f), -SNORM16_MAX), SNORM16_MAX);
+				float decoded = steps*mStep + mOrigin[i];
+				q[i] = (short) steps;
+				error2 += (decoded - p[i])*(decoded - p[i]);
+			}
+			positionError2 = std::max(positionError2, error2);
+
+			if (normals != NULL && normalEncoding == NORMALS_OCTAHEDRAL)
+				minCosine = std::min(minCosine, EncodeOctahedral(normals + 3*(size_t) v, &mNormals[2*(size_t) v]));
+			else if (normals != NULL)
+				minCosine = std::min(minCosine, EncodeSnorm16(normals + 3*(size_t) v, &mNormals[3*(size_t) v]));
+
+			for (int i = 0; i < 2 && texcoords != NULL; ++i)
+			{
+				float t = texcoords[2*(size_t) v + i];
+				unsigned short half = FloatToHalf(t);
+				mTexcoords[2*(size_t) v + i] = half;
+				stats.texcoordError = std::max(stats.texcoordError, fabsf(HalfToFloat(half) - t));
+			}
+		}
+		stats.positionError = sqrtf(positionError2);
+		stats.normalError = acosf(std::min(std::max(minCosine, -1.0f), 1.0f))*180.0f/3.14159265f;
+	});
+
+	for (long chunk = 0; chunk < chunkCount; ++chunk)
+	{
+		mStats.positionError = std::max(mStats.positionError, chunkStats[chunk].positionError);
+		mStats.normalError = std::max(mStats.normalError, chunkStats[chunk].normalError);
+		mStats.texcoordError = std::max(mStats.texcoordError, chunkStats[chunk].texcoordError);
+	}
+	mStats.floatBytes = (size_t) vertexCount*sizeof(float)*(4 + (normals != NULL ? 3 : 0) + (texcoords != NULL ? 2 : 0));
+	mStats.compactBytes = (mPositions.size() + mNormals.size() + mTexcoords.size())*sizeof(short);
+	return 0;
+}
+
+void QuantizedMesh::DecodePositions(long first, long count, float w, float* out) const
+{
+	const short* q = mPositions.data() + 3*(size_t) first;
+	long v = 0;
+
+#ifdef MESHQUANTIZE_SSE2
+	//four shorts per load, the fourth is the x of the next vertex and decodes
+	//to 0*x + w, so the last vertex is left to the scalar code
+	const __m128 scale = _mm_set_ps(0.0f, mStep, mStep, mStep);
+	const __m128 offset = _mm_set_ps(w, mOrigin[2], mOrigin[1], mOrigin[0]);
+
+	for (; v + 1 < count; ++v)
+	{
+		__m128i packed = _mm_loadl_epi64((const __m128i*)(q + 3*v));
+		__m128i wide = _mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16);
+		_mm_storeu_ps(out + 4*v, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(wide), scale), offset));
+	}
+#endif
+	for (; v < count; ++v)
+	{
+		for (int i = 0; i < 3; ++i)
+			out[4*v + i] = q[3*v + i]*mStep + mOrigin[i];
+		out[4*v + 3] = w;
+	}
+}
+
+void QuantizedMesh::DecodeNormals(long first, long count, float* out) const
+{
+	if (mNormalEncoding == NORMALS_SNORM16)
+	{
+		const short* q = mNormals.data() + 3*(size_t) first;
+		for (long v = 0; v < count; ++v)
+			DecodeSnorm16(q + 3*v, out + 3*v);
+		return;
+	}
+
+	const short* q = mNormals.data() + 2*(size_t) first;
+	long v = 0;
+
+#ifdef MESHQUANTIZE_SSE2
+	const __m128 unit = _mm_set1_ps(1.0f / SNORM16_MAX);
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+	float x[4], y[4], z[4];
+
+	for (; v + 4 <= count; v += 4)
+	{
+		__m128i packed = _mm_loadu_si128((const __m128i*)(q + 2*v));
+		__m128 fx = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(packed, 16), 16)), unit);
+		__m128 fy = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(packed, 16)), unit);
+		__m128 fz = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_andnot_ps(signBit, fx)), _mm_andnot_ps(signBit, fy));
+		__m128 t = _mm_max_ps(_mm_xor_ps(fz, signBit), _mm_setzero_ps());
+
+		fx = _mm_sub_ps(fx, _mm_or_ps(t, _mm_and_ps(fx, signBit)));
+		fy = _mm_sub_ps(fy, _mm_or_ps(t, _mm_and_ps(fy, signBit)));
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(fx, fx), _mm_mul_ps(fy, fy)), _mm_mul_ps(fz, fz)));
+		_mm_storeu_ps(x, _mm_div_ps(fx, length));
+		_mm_storeu_ps(y, _mm_div_ps(fy, length));
+		_mm_storeu_ps(z, _mm_div_ps(fz, length));
+		for (int k = 0; k < 4; ++k)
+		{
+			out[3*(v + k)] = x[k];
+			out[3*(v + k) + 1] = y[k];
+			out[3*(v + k) + 2] = z[k];
+		}
+	}
+#endif
+	for (; v < count; ++v)
+		DecodeOctahedral(q[2*v], q[2*v + 1], out + 3*v);
+}
+
+void QuantizedMesh::DecodeTexcoords(long first, long count, float* out) const
+{
+	const unsigned short* h = mTexcoords.data() + 2*(size_t) first;
+	long i = 0;
+
+#ifdef MESHQUANTIZE_SSE2
+	const __m128i magnitudeMask = _mm_set1_epi32(0x7FFF);
+	const __m128 rebias = _mm_castsi128_ps(_mm_set1_epi32(0x77800000));
+	const __m128i largestFinite = _mm_set1_epi32(0x7BFF);
+	const __m128i infinityExponent = _mm_set1_epi32(0x7F800000);
+
+	//four halves per pass, two vertices
+	for (; i + 4 <= 2*count; i += 4)
+	{
+		__m128i half = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(h + i)), _mm_setzero_si128());
+		__m128i magnitude = _mm_and_si128(half, magnitudeMask);
+		__m128i sign = _mm_slli_epi32(_mm_xor_si128(half, magnitude), 16);
+		__m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(magnitude, 13)), rebias);
+		__m128i special = _mm_and_si128(_mm_cmpgt_epi32(magnitude, largestFinite), infinityExponent);
+		_mm_storeu_ps(out + i, _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, special))));
+	}
+#endif
+	for (; i < 2*count; ++i)
+		out[i] = HalfToFloat(h[i]);
+}
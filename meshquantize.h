@@ -0,0 +1,76 @@
+/*
+Compact vertex attributes: 16 bit positions, octahedral normals and half
+float texture coordinates
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef MESHQUANTIZE_H
+#define MESHQUANTIZE_H
+
+#include <cstddef>
+#include <vector>
+
+enum NormalEncoding
+{
+	NORMALS_OCTAHEDRAL,		// Two snorm16 on the folded octahedron, the smallest
+	NORMALS_SNORM16			// x, y and z as snorm16, which OpenGL draws as GL_SHORT normals
+};
+
+struct QuantizationStats
+{
+	float positionError;	// Largest distance of a decoded position from the original, in model units
+	float normalError;		// Largest angle between a decoded normal and the original, in degrees
+	float texcoordError;	// Largest difference of a decoded texture coordinate
+	size_t floatBytes;		// The attributes as floats, the way OBJClass keeps them
+	size_t compactBytes;
+};
+
+class QuantizedMesh
+{
+  private:
+	std::vector<short> mPositions;				// x, y, z per vertex, in steps from mOrigin
+	std::vector<short> mNormals;				// Two or three snorm16 per vertex, as mNormalEncoding says
+	std::vector<unsigned short> mTexcoords;		// Half floats, two per vertex
+	float mOrigin[3];	// Centre of the bounding box
+	float mStep;		// Model units per step, the same on every axis so normals keep their directions
+	NormalEncoding mNormalEncoding;
+	long mVertexCount;
+	QuantizationStats mStats;
+
+ public:
+	QuantizedMesh();
+
+	//quantizes positions (x, y, z every positionStride floats) inside the
+	//bounding box, unit normals (3 floats each) and texture coordinates
+	//(2 floats each), either of which may be NULL, returns 0 or -1
+	int Build(const float* positions, int positionStride, const float* normals, const float* texcoords,
+		long vertexCount, const float* boundsMin, const float* boundsMax, int threads,
+		NormalEncoding normalEncoding = NORMALS_OCTAHEDRAL);
+	void Release();
+
+	//decode count vertices from first, positions to x, y, z, w
+	void DecodePositions(long first, long count, float w, float* out) const;
+	void DecodeNormals(long first, long count, float* out) const;
+	void DecodeTexcoords(long first, long count, float* out) const;
+
+	inline bool IsEmpty() const {return mVertexCount == 0;};
+	inline bool HasNormals() const {return !mNormals.empty();};
+	inline bool HasTexcoords() const {return !mTexcoords.empty();};
+	inline long GetVertexCount() const {return mVertexCount;};
+	inline const short* GetPositions() const {return mPositions.data();};	// 3 shorts per vertex
+	inline const short* GetNormals() const {return mNormals.data();};
+	inline NormalEncoding GetNormalEncoding() const {return mNormalEncoding;};
+	inline const unsigned short* GetTexcoords() const {return mTexcoords.data();};
+	inline const float* GetOrigin() const {return mOrigin;};
+	inline float GetStep() const {return mStep;};
+	inline const QuantizationStats& GetStats() const {return mStats;};
+};
+
+#endif
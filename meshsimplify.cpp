@@ -0,0 +1,477 @@
+/*
+Quadric error simplification of indexed triangle meshes
+
+Every vertex keeps the area weighted sum of the plane quadrics of its faces
+(Garland and Heckbert), so the cost of moving it is the mean squared
+distance to those planes. Candidate edges wait in a 4-ary heap and are
+dropped when a merge has made them outdated, and the triangles around a vertex are found
+through flat adjacency arrays, the vertices merged into one are chained in
+a ring so their lists never have to be rebuilt.
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "meshsimplify.h"
+
+//a collapse may turn a face by at most about 78 degrees
+static const double SIMPLIFY_MIN_FACE_COS = 0.2;
+
+//symmetric 4x4 plane quadric and the face area it was summed over
+struct Quadric
+{
+	double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+	double weight;
+};
+
+//16 bytes so four siblings of the heap share one or two cache lines
+struct Collapse
+{
+	float cost;
+	unsigned int from;
+	unsigned int to;
+	unsigned int unused;
+};
+
+//min-heap with four children per node, half as deep as a binary heap, which
+//matters once the heap is far bigger than the cache
+static void HeapPush(std::vector<Collapse> &heap, const Collapse &collapse)
+{
+	size_t i = heap.size();
+
+	heap.push_back(collapse);
+	while (i > 0 && heap[(i - 1)/4].cost > collapse.cost)
+	{
+		heap[i] = heap[(i - 1)/4];
+		i = (i - 1)/4;
+	}
+	heap[i] = collapse;
+}
+
+static void HeapSiftDown(std::vector<Collapse> &heap, size_t i)
+{
+	Collapse moving = heap[i];
+	size_t size = heap.size();
+
+	for (;;)
+	{
+		size_t first = 4*i + 1, last = std::min(first + 4, size), best = i;
+		float bestCost = moving.cost;
+
+		for (size_t c = first; c < last; ++c)
+		{
+			if (heap[c].cost < bestCost)
+			{
+				bestCost = heap[c].cost;
+				best = c;
+			}
+		}
+		if (best == i)
+			break;
+		heap[i] = heap[best];
+		i = best;
+	}
+	heap[i] = moving;
+}
+
+static Collapse HeapPop(std::vector<Collapse> &heap)
+{
+	Collapse top = heap[0];
+
+	heap[0] = heap.back();
+	heap.pop_back();
+	if (!heap.empty())
+		HeapSiftDown(heap, 0);
+	return top;
+}
+
+static inline void AddQuadric(Quadric &q, const Quadric &r)
+{
+	q.a2 += r.a2; q.ab += r.ab; q.ac += r.ac; q.ad += r.ad;
+	q.b2 += r.b2; q.bc += r.bc; q.bd += r.bd;
+	q.c2 += r.c2; q.cd += r.cd; q.d2 += r.d2;
+	q.weight += r.weight;
+}
+
+//mean squared distance of p to the planes of q and r together
+static inline float Cost(const Quadric &q, const Quadric &r, const float* p)
+{
+	double x = p[0], y = p[1], z = p[2];
+	double weight = q.weight + r.weight;
+	double e =
+		(q.a2 + r.a2)*x*x + 2*(q.ab + r.ab)*x*y + 2*(q.ac + r.ac)*x*z + 2*(q.ad + r.ad)*x +
+		(q.b2 + r.b2)*y*y + 2*(q.bc + r.bc)*y*z + 2*(q.bd + r.bd)*y +
+		(q.c2 + r.c2)*z*z + 2*(q.cd + r.cd)*z + (q.d2 + r.d2);
+
+	return weight > 0.0 ? (float) std::max(e / weight, 0.0) : 0.0f;
+}
+
+static inline void Cross(const float* p0, const float* p1, const float* p2, double* n)
+{
+	double e1[3], e2[3];
+
+	for (int i = 0; i < 3; ++i)
+	{
+		e1[i] = (double) p1[i] - p0[i];
+		e2[i] = (double) p2[i] - p0[i];
+	}
+	n[0] = e1[1]*e2[2] - e1[2]*e2[1];
+	n[1] = e1[2]*e2[0] - e1[0]*e2[2];
+	n[2] = e1[0]*e2[1] - e1[1]*e2[0];
+}
+
+//first vertex at the same position for every vertex, so vertices split by
+//their normal or texture coordinate are one vertex to the simplifier
+static int WeldPositions(const float* positions, int stride, long vertexCount, long* weld, MemoryArena &scratch)
+{
+	long tableSize = 1024, mask;
+	long* table;
+
+	while (tableSize < vertexCount*2)
+		tableSize *= 2;
+	mask = tableSize - 1;
+	table = scratch.Allocate<long>(tableSize);
+	if (table == NULL)
+		return -1;
+	for (long i = 0; i < tableSize; ++i)
+		table[i] = -1;
+
+	for (long v = 0; v < vertexCount; ++v)
+	{
+		const float* p = positions + stride*v;
+		unsigned int bits[3];
+		unsigned long long hash = 14695981039346656037ULL;
+		long slot;
+
+		//+0 and -0 are the same position
+		for (int i = 0; i < 3; ++i)
+		{
+			float value = p[i] == 0.0f ? 0.0f : p[i];
+			memcpy(&bits[i], &value, sizeof(float));
+			hash = (hash ^ bits[i]) * 1099511628211ULL;
+		}
+
+		for (slot = (long)(hash & mask); table[slot] >= 0; slot = (slot + 1) & mask)
+		{
+			const float* q = positions + stride*table[slot];
+			if (q[0] == p[0] && q[1] == p[1] && q[2] == p[2])
+				break;
+		}
+		if (table[slot] < 0)
+			table[slot] = v;
+		weld[v] = table[slot];
+	}
+	return 0;
+}
+
+long SimplifyMesh(const float* positions, int stride, long vertexCount,
+	const long* indices, long triangleCount, long targetTriangles, float targetError,
+	long* destination, float &error, MemoryArena &scratch)
+{
+	long* weld = scratch.Allocate<long>(vertexCount);
+	long* corners = scratch.Allocate<long>(triangleCount*3);	// Welded vertex of every corner
+	long* output = scratch.Allocate<long>(triangleCount*3);		// Vertex every corner is drawn with
+	long* adjacencyStart = scratch.Allocate<long>(vertexCount + 1);
+	long* adjacency = scratch.Allocate<long>(triangleCount*3);
+	long* ring = scratch.Allocate<long>(vertexCount);		// Next vertex merged into the same one
+	Quadric* quadrics = scratch.Allocate<Quadric>(vertexCount);
+	char* locked = scratch.Allocate<char>(vertexCount);
+	char* alive = scratch.Allocate<char>(vertexCount);
+	char* dead = scratch.Allocate<char>(triangleCount);
+	long* pushed = scratch.Allocate<long>(vertexCount);	// Last pushEdges call that reached the vertex
+	std::vector<Collapse> heap;
+	long liveTriangles = 0, written = 0, pushes = 0;
+	float maxCost = 0.0f, costLimit = targetError*targetError;
+
+	error = 0.0f;
+	if (weld == NULL || corners == NULL || output == NULL || adjacencyStart == NULL || adjacency == NULL ||
+		ring == NULL || quadrics == NULL || locked == NULL || alive == NULL || dead == NULL || pushed == NULL)
+		return -1;
+	if (triangleCount <= 0 || vertexCount <= 0)
+		return 0;
+	if ((unsigned long long) vertexCount > 0xFFFFFFFFULL)
+		return -1;
+	if (WeldPositions(positions, stride, vertexCount, weld, scratch) != 0)
+		return -1;
+
+	//a position shared by several vertices is an attribute seam
+	memset(locked, 0, (size_t) vertexCount);
+	memset(alive, 0, (size_t) vertexCount);
+	memset(quadrics, 0, vertexCount*sizeof(Quadric));
+	for (long v = 0; v < vertexCount; ++v)
+	{
+		if (weld[v] != v)
+			locked[weld[v]] = 1;
+		ring[v] = v;
+		pushed[v] = -1;
+	}
+
+	//triangles that are degenerate once welded are left out from the start
+	memset(adjacencyStart, 0, (vertexCount + 1)*sizeof(long));
+	for (long t = 0; t < triangleCount; ++t)
+	{
+		long* c = corners + 3*t;
+		for (int k = 0; k < 3; ++k)
+		{
+			output[3*t + k] = indices[3*t + k];
+			c[k] = weld[indices[3*t + k]];
+		}
+		dead[t] = c[0] == c[1] || c[1] == c[2] || c[2] == c[0];
+		if (dead[t])
+			continue;
+
+		++liveTriangles;
+		for (int k = 0; k < 3; ++k)
+		{
+			++adjacencyStart[c[k] + 1];
+			alive[c[k]] = 1;
+		}
+	}
+	for (long v = 0; v < vertexCount; ++v)
+		adjacencyStart[v + 1] += adjacencyStart[v];
+	{
+		std::vector<long> fill(adjacencyStart, adjacencyStart + vertexCount);
+		for (long t = 0; t < triangleCount; ++t)
+		{
+			if (!dead[t])
+			{
+				for (int k = 0; k < 3; ++k)
+					adjacency[fill[corners[3*t + k]]++] = t;
+			}
+		}
+	}
+
+	//area weighted plane quadrics of the faces at every vertex
+	for (long t = 0; t < triangleCount; ++t)
+	{
+		const long* c = corners + 3*t;
+		const float* p0 = positions + stride*c[0];
+		double n[3], length, d;
+		Quadric q;
+
+		if (dead[t])
+			continue;
+		Cross(p0, positions + stride*c[1], positions + stride*c[2], n);
+		length = sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+		if (length == 0.0)
+			continue;
+
+		q.weight = 0.5*length;
+		n[0] /= length; n[1] /= length; n[2] /= length;
+		d = -(n[0]*p0[0] + n[1]*p0[1] + n[2]*p0[2]);
+		q.a2 = n[0]*n[0]*q.weight; q.ab = n[0]*n[1]*q.weight; q.ac = n[0]*n[2]*q.weight; q.ad = n[0]*d*q.weight;
+		q.b2 = n[1]*n[1]*q.weight; q.bc = n[1]*n[2]*q.weight; q.bd = n[1]*d*q.weight;
+		q.c2 = n[2]*n[2]*q.weight; q.cd = n[2]*d*q.weight; q.d2 = d*d*q.weight;
+		for (int k = 0; k < 3; ++k)
+			AddQuadric(quadrics[c[k]], q);
+	}
+
+	//an edge with one face is a border and one with more than two is not manifold,
+	//both keep their vertices in place
+	for (long v = 0; v < vertexCount; ++v)
+	{
+		for (long i = adjacencyStart[v]; i < adjacencyStart[v + 1]; ++i)
+		{
+			const long* c = corners + 3*adjacency[i];
+			long other = c[0] == v ? c[1] : c[1] == v ? c[2] : c[0];
+			int faces = 0;
+
+			for (long j = adjacencyStart[v]; j < adjacencyStart[v + 1]; ++j)
+			{
+				const long* d = corners + 3*adjacency[j];
+				faces += d[0] == other || d[1] == other || d[2] == other;
+			}
+			if (faces != 2)
+				locked[v] = locked[other] = 1;
+		}
+	}
+
+	//the cheaper way to collapse an edge, if either end may move
+	auto candidate = [&](long a, long b, Collapse &collapse) -> bool
+	{
+		float costA = locked[a] ? -1.0f : Cost(quadrics[a], quadrics[b], positions + stride*b);
+		float costB = locked[b] ? -1.0f : Cost(quadrics[a], quadrics[b], positions + stride*a);
+
+		if (costA < 0.0f && costB < 0.0f)
+			return false;
+		collapse.unused = 0;
+		if (costB < 0.0f || (costA >= 0.0f && costA <= costB))
+		{
+			collapse.cost = costA;
+			collapse.from = (unsigned int) a;
+			collapse.to = (unsigned int) b;
+		}
+		else
+		{
+			collapse.cost = costB;
+			collapse.from = (unsigned int) b;
+			collapse.to = (unsigned int) a;
+		}
+		return true;
+	};
+
+	//every edge around v once, most neighbours share two faces with it
+	auto pushEdges = [&](long v)
+	{
+		long g = v;
+		++pushes;
+		do
+		{
+			for (long i = adjacencyStart[g]; i < adjacencyStart[g + 1]; ++i)
+			{
+				long t = adjacency[i];
+				if (dead[t])
+					continue;
+				for (int k = 0; k < 3; ++k)
+				{
+					long w = corners[3*t + k];
+					Collapse collapse;
+					if (w == v || pushed[w] == pushes)
+						continue;
+					pushed[w] = pushes;
+					if (candidate(v, w, collapse))
+					{
+						HeapPush(heap, collapse);
+					}
+				}
+			}
+			g = ring[g];
+		} while (g != v);
+	};
+
+	for (long t = 0; t < triangleCount; ++t)
+	{
+		const long* c = corners + 3*t;
+		if (dead[t])
+			continue;
+		for (int k = 0; k < 3; ++k)
+		{
+			Collapse collapse;
+			long a = c[k], b = c[(k + 1) % 3];
+			if (a < b && candidate(a, b, collapse))
+				heap.push_back(collapse);
+		}
+	}
+	for (size_t i = heap.size()/4 + 1; i-- > 0; )
+	{
+		if (i < heap.size())
+			HeapSiftDown(heap, i);
+	}
+
+	while (liveTriangles > targetTriangles && !heap.empty())
+	{
+		Collapse collapse = HeapPop(heap), current;
+		long u, v, g, kept = -1;
+		bool bValid = true, bShared = false;
+
+		if (!alive[collapse.from] || !alive[collapse.to])
+			continue;
+
+		//a merge changes only the quadric of the vertex kept, and all its edges go
+		//to the heap again then, so an entry costing something else is outdated
+		if (!candidate(collapse.from, collapse.to, current) || current.cost != collapse.cost ||
+			current.from != collapse.from)
+			continue;
+		if (current.cost > costLimit)
+			break;
+
+		u = current.from;
+		v = current.to;
+
+		//the faces that stay must not fold over, the ones on the edge give the
+		//vertex u's side of a seam at v is drawn with
+		g = u;
+		do
+		{
+			for (long i = adjacencyStart[g]; i < adjacencyStart[g + 1] && bValid; ++i)
+			{
+				long t = adjacency[i];
+				long* c = corners + 3*t;
+				const float* p[3];
+				double before[3], after[3];
+
+				if (dead[t])
+					continue;
+				if (c[0] == v || c[1] == v || c[2] == v)
+				{
+					bShared = true;
+					kept = output[3*t + (c[0] == v ? 0 : c[1] == v ? 1 : 2)];
+					continue;
+				}
+
+				for (int k = 0; k < 3; ++k)
+					p[k] = positions + stride*c[k];
+				Cross(p[0], p[1], p[2], before);
+				for (int k = 0; k < 3; ++k)
+					p[k] = c[k] == u ? positions + stride*v : p[k];
+				Cross(p[0], p[1], p[2], after);
+
+				double dot = before[0]*after[0] + before[1]*after[1] + before[2]*after[2];
+				double lengths = sqrt(before[0]*before[0] + before[1]*before[1] + before[2]*before[2]) *
+					sqrt(after[0]*after[0] + after[1]*after[1] + after[2]*after[2]);
+				if (!(dot > SIMPLIFY_MIN_FACE_COS*lengths))
+					bValid = false;
+			}
+			g = ring[g];
+		} while (g != u && bValid);
+
+		if (!bValid || !bShared)
+			continue;
+
+		g = u;
+		do
+		{
+			for (long i = adjacencyStart[g]; i < adjacencyStart[g + 1]; ++i)
+			{
+				long t = adjacency[i];
+				long* c = corners + 3*t;
+
+				if (dead[t])
+					continue;
+				if (c[0] == v || c[1] == v || c[2] == v)
+				{
+					dead[t] = 1;
+					--liveTriangles;
+					continue;
+				}
+				for (int k = 0; k < 3; ++k)
+				{
+					if (c[k] == u)
+					{
+						c[k] = v;
+						output[3*t + k] = kept;
+					}
+				}
+			}
+			g = ring[g];
+		} while (g != u);
+
+		AddQuadric(quadrics[v], quadrics[u]);
+		alive[u] = 0;
+		std::swap(ring[u], ring[v]);
+		maxCost = std::max(maxCost, current.cost);
+		pushEdges(v);
+	}
+
+	for (long t = 0; t < triangleCount; ++t)
+	{
+		if (!dead[t])
+		{
+			memcpy(destination + 3*written, output + 3*t, 3*sizeof(long));
+			++written;
+		}
+	}
+
+	error = sqrtf(maxCost);
+	return written;
+}
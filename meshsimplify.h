@@ -0,0 +1,30 @@
+/*
+Quadric error simplification of indexed triangle meshes
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef MESHSIMPLIFY_H
+#define MESHSIMPLIFY_H
+
+#include "arena.h"
+
+//collapses edges of the triangles in indices until at most targetTriangles are
+//left or the next collapse would move the surface by more than targetError,
+//every collapse moves a vertex onto a neighbour so the result indexes the same
+//vertex buffer, vertices on borders, on non-manifold edges and at attribute
+//seams (several vertices at one position) never move, positions are read as
+//x, y, z every stride floats, destination holds triangleCount*3 indices,
+//error gets the root mean square distance of the worst collapse, returns the
+//number of triangles written or -1, also for more than 2^32 vertices
+long SimplifyMesh(const float* positions, int stride, long vertexCount,
+	const long* indices, long triangleCount, long targetTriangles, float targetError,
+	long* destination, float &error, MemoryArena &scratch);
+
+#endif
@@ -0,0 +1,422 @@
+/*
+Allocation-free tokenizer and number parsing for Wavefront OBJ text
+
+All functions work on raw [p, end) ranges of the file data, never read
+past end and never need a terminator, so they can run straight on a
+memory mapping or on a block of a stream.
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef OBJPARSER_H
+#define OBJPARSER_H
+
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OBJPARSER_SSE2
+#endif
+
+//records that name the parts of a model rather than adding geometry
+enum OBJMarkerKind
+{
+	OBJ_MARKER_NONE,
+	OBJ_MARKER_LIBRARY,		// mtllib, material libraries to read
+	OBJ_MARKER_MATERIAL,	// usemtl, the material of the faces that follow
+	OBJ_MARKER_OBJECT,		// o
+	OBJ_MARKER_GROUP		// g
+};
+
+//a resolved texel or normal index for a corner that names none, such as
+//the first corner of "f 1 2/2 3//3", no real index can reach it
+static const long OBJ_MISSING_INDEX = LONG_MAX;
+
+//one face corner, 0 marks an index that is not present
+struct OBJCorner
+{
+	long v;
+	long t;
+	long n;
+};
+
+//running bounds and sum of the positions read so far, updated as each
+//position is parsed so the data is only touched while it is in cache
+struct OBJBounds
+{
+	float vmin[4];
+	float vmax[4];
+	double sum[3];
+	long count;
+
+	inline void Reset()
+	{
+		vmin[0] = vmin[1] = vmin[2] = vmin[3] = 0.0f;
+		vmax[0] = vmax[1] = vmax[2] = vmax[3] = 0.0f;
+		sum[0] = sum[1] = sum[2] = 0.0;
+		count = 0;
+	}
+
+	//vertex must have four readable floats, the fourth is not used
+	inline void Add(const float* vertex)
+	{
+#ifdef OBJPARSER_SSE2
+		__m128 v = _mm_loadu_ps(vertex);
+		if (count == 0)
+		{
+			_mm_storeu_ps(vmin, v);
+			_mm_storeu_ps(vmax, v);
+		}
+		else
+		{
+			_mm_storeu_ps(vmin, _mm_min_ps(_mm_loadu_ps(vmin), v));
+			_mm_storeu_ps(vmax, _mm_max_ps(_mm_loadu_ps(vmax), v));
+		}
+#else
+		for (int i = 0; i < 3; ++i)
+		{
+			if (count == 0 || vertex[i] < vmin[i])
+				vmin[i] = vertex[i];
+			if (count == 0 || vertex[i] > vmax[i])
+				vmax[i] = vertex[i];
+		}
+#endif
+		sum[0] += vertex[0];
+		sum[1] += vertex[1];
+		sum[2] += vertex[2];
+		++count;
+	}
+
+	inline void Merge(const OBJBounds &other)
+	{
+		if (other.count == 0)
+			return;
+		for (int i = 0; i < 3; ++i)
+		{
+			if (count == 0 || other.vmin[i] < vmin[i])
+				vmin[i] = other.vmin[i];
+			if (count == 0 || other.vmax[i] > vmax[i])
+				vmax[i] = other.vmax[i];
+			sum[i] += other.sum[i];
+		}
+		count += other.count;
+	}
+};
+
+struct OBJParser
+{
+	//returns the end of the line starting at p, either its '\n' or end,
+	//memchr is already vectorised by the C runtimes
+	static inline const char* FindLineEnd(const char* p, const char* end)
+	{
+		const char* lineEnd = (const char*) memchr(p, '\n', end - p);
+		return lineEnd != NULL ? lineEnd : end;
+	}
+
+	//'\r' counts as a blank so CRLF files need no special casing
+	static inline bool IsBlank(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	static inline bool IsDigit(char c)
+	{
+		return (unsigned char)(c - '0') < 10;
+	}
+
+	static inline const char* SkipBlanks(const char* p, const char* end)
+	{
+		while (p < end && IsBlank(*p))
+			++p;
+		return p;
+	}
+
+	static inline const char* SkipToken(const char* p, const char* end)
+	{
+		while (p < end && !IsBlank(*p))
+			++p;
+		return p;
+	}
+
+	//the end of the records of a line, where a '#' starts a trailing comment
+	static inline const char* FindCommentStart(const char* p, const char* end)
+	{
+		const char* comment = (const char*) memchr(p, '#', end - p);
+		return comment != NULL ? comment : end;
+	}
+
+	//reads an optionally signed decimal integer, returns p unchanged if there
+	//is none, a value past the range of long stops at LONG_MAX or -LONG_MAX,
+	//which no index of a file reaches, so a face using it is rejected
+	static inline const char* ParseInt(const char* p, const char* end, long &value)
+	{
+		const char* start = p;
+		bool negative = false;
+		long result = 0;
+
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = *p == '-';
+			++p;
+		}
+		if (p >= end || !IsDigit(*p))
+			return start;
+
+		do
+		{
+			int digit = *p - '0';
+			result = result > (LONG_MAX - digit) / 10 ? LONG_MAX : result*10 + digit;
+			++p;
+		} while (p < end && IsDigit(*p));
+
+		value = negative ? -result : result;
+		return p;
+	}
+
+	//reads a decimal floating point number with optional fraction and exponent,
+	//returns p unchanged if there is none
+	static inline const char* ParseFloat(const char* p, const char* end, float &value)
+	{
+		//exact powers of ten, a mantissa below 2^53 times one of these rounds once to double,
+		//the cast to float rounds again so the result may be one float step from strtof's
+		static const double powers[] = {
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+		const char* start = p;
+		unsigned long long mantissa = 0;
+		int digits = 0, exponent = 0;
+		bool negative = false, bAnyDigit = false;
+		double result;
+
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = *p == '-';
+			++p;
+		}
+
+		//15 significant digits keep the mantissa below 2^53, far beyond what a float holds,
+		//further integer digits only scale it, up to where the value is out of range anyway
+		for (; p < end && IsDigit(*p); ++p)
+		{
+			bAnyDigit = true;
+			if (digits < 15)
+			{
+				mantissa = mantissa*10 + (*p - '0');
+				if (mantissa != 0)
+					++digits;
+			}
+			else if (exponent < 1000)
+				++exponent;
+		}
+		if (p < end && *p == '.')
+		{
+			for (++p; p < end && IsDigit(*p); ++p)
+			{
+				bAnyDigit = true;
+				if (digits < 15)
+				{
+					mantissa = mantissa*10 + (*p - '0');
+					if (mantissa != 0)
+						++digits;
+					--exponent;
+				}
+			}
+		}
+		if (!bAnyDigit)
+			return start;
+
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			long exponentValue = 0;
+			const char* next = ParseInt(p + 1, end, exponentValue);
+			if (next != p + 1)
+			{
+				if (exponentValue > 1000) exponentValue = 1000;
+				if (exponentValue < -1000) exponentValue = -1000;
+				exponent += (int) exponentValue;
+				p = next;
+			}
+		}
+
+		result = (double) mantissa;
+		if (mantissa == 0)
+			result = 0.0;
+		else if (exponent >= 0 && exponent <= 22)
+			result *= powers[exponent];
+		else if (exponent < 0 && exponent >= -22)
+			result /= powers[-exponent];
+		else
+			result *= pow(10.0, exponent);
+
+		value = (float)(negative ? -result : result);
+		return p;
+	}
+
+	//reads up to count blank separated floats, missing values are left untouched
+	static inline const char* ParseFloats(const char* p, const char* end, float* values, int count)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			p = SkipBlanks(p, end);
+			const char* next = ParseFloat(p, end, values[i]);
+			if (next == p)
+				break;
+			p = next;
+		}
+		return p;
+	}
+
+	//reads one face corner in the v, v/t, v//n or v/t/n form in a single pass,
+	//indices that are not present are set to 0, anything else left in the token
+	//is skipped so a malformed corner cannot stall the caller
+	static inline const char* ParseCorner(const char* p, const char* end, OBJCorner &corner)
+	{
+		corner.v = corner.t = corner.n = 0;
+
+		p = ParseInt(p, end, corner.v);
+		if (p < end && *p == '/')
+		{
+			p = ParseInt(p + 1, end, corner.t);
+			if (p < end && *p == '/')
+				p = ParseInt(p + 1, end, corner.n);
+		}
+		return SkipToken(p, end);
+	}
+
+	//reads the corners of a face line and passes them to emit as a fan of
+	//triangles, emit(const OBJCorner* triangle) is called corners - 2 times,
+	//a face with fewer than three corners is passed on as one triangle with
+	//its missing corners at 0 so the caller can reject it, returns the corner
+	//count, a comment after the corners ends the face
+	template<typename Emit>
+	static inline long ParseFace(const char* p, const char* end, Emit emit)
+	{
+		OBJCorner triangle[3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+		OBJCorner corner;
+		long count = 0;
+
+		end = FindCommentStart(p, end);
+		for (p = SkipBlanks(p, end); p < end; p = SkipBlanks(p, end))
+		{
+			p = ParseCorner(p, end, corner);
+			if (count < 2)
+				triangle[count] = corner;
+			else
+			{
+				triangle[2] = corner;
+				emit(triangle);
+				triangle[1] = corner;
+			}
+			++count;
+		}
+
+		if (count < 3)
+			emit(triangle);
+		return count;
+	}
+
+	//tells the lines naming a library, material, object or group from the
+	//rest and sets [name, nameEnd) to what follows the keyword without the
+	//blanks around it, which may be empty
+	static inline OBJMarkerKind ParseMarker(const char* p, const char* end, const char* &name, const char* &nameEnd)
+	{
+		OBJMarkerKind kind = OBJ_MARKER_NONE;
+		const char* rest = p + 1;
+
+		if (end - p >= 1 && (p[0] == 'o' || p[0] == 'g') && (end - p == 1 || IsBlank(p[1])))
+			kind = p[0] == 'o' ? OBJ_MARKER_OBJECT : OBJ_MARKER_GROUP;
+		else if (end - p >= 6 && (end - p == 6 || IsBlank(p[6])) && memcmp(p, "usemtl", 6) == 0)
+			kind = OBJ_MARKER_MATERIAL;
+		else if (end - p >= 6 && (end - p == 6 || IsBlank(p[6])) && memcmp(p, "mtllib", 6) == 0)
+			kind = OBJ_MARKER_LIBRARY;
+		if (kind == OBJ_MARKER_NONE)
+			return kind;
+
+		if (kind == OBJ_MARKER_MATERIAL || kind == OBJ_MARKER_LIBRARY)
+			rest = p + 6;
+		name = SkipBlanks(rest, end);
+		nameEnd = end;
+		while (nameEnd > name && IsBlank(nameEnd[-1]))
+			--nameEnd;
+		return kind;
+	}
+
+	//number of triangles ParseFace emits for a face with the given corners
+	static inline long FaceTriangles(long corners)
+	{
+		return corners > 3 ? corners - 2 : 1;
+	}
+
+	//counts the blank separated tokens in [p, end) before any comment, which for the text
+	//after the "f" of a face line is its number of corners
+	static inline long CountTokens(const char* p, const char* end)
+	{
+		long count = 0;
+		bool bPrevBlank = true;
+
+		end = FindCommentStart(p, end);
+#ifdef OBJPARSER_SSE2
+		const __m128i space = _mm_set1_epi8(' ');
+		const __m128i tab = _mm_set1_epi8('\t');
+		const __m128i cr = _mm_set1_epi8('\r');
+
+		//a token starts at every non blank byte whose predecessor is blank
+		while (end - p >= 16)
+		{
+			__m128i bytes = _mm_loadu_si128((const __m128i*) p);
+			__m128i blank = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, space),
+				_mm_cmpeq_epi8(bytes, tab)), _mm_cmpeq_epi8(bytes, cr));
+			unsigned int blankMask = (unsigned int) _mm_movemask_epi8(blank);
+			unsigned int prevBlankMask = (blankMask << 1) | (bPrevBlank ? 1u : 0u);
+			unsigned int starts = ~blankMask & prevBlankMask & 0xFFFFu;
+
+			count += PopCount(starts);
+			bPrevBlank = (blankMask & 0x8000u) != 0;
+			p += 16;
+		}
+#endif
+		for (; p < end; ++p)
+		{
+			bool bBlank = IsBlank(*p);
+			if (!bBlank && bPrevBlank)
+				++count;
+			bPrevBlank = bBlank;
+		}
+		return count;
+	}
+
+	static inline int PopCount(unsigned int bits)
+	{
+		bits = bits - ((bits >> 1) & 0x55555555u);
+		bits = (bits & 0x33333333u) + ((bits >> 2) & 0x33333333u);
+		return (int)((((bits + (bits >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24);
+	}
+
+	//64 bits of the bytes, eight at a time, for telling files and stretches of them apart
+	static inline unsigned long long HashBytes(const char* data, size_t size)
+	{
+		unsigned long long hash = 0xCBF29CE484222325ull ^ size;
+		size_t i = 0;
+
+		for (; i + 8 <= size; i += 8)
+		{
+			unsigned long long word;
+			memcpy(&word, data + i, 8);
+			hash = (hash ^ word) * 0x100000001B3ull;
+			hash ^= hash >> 29;
+		}
+		for (; i < size; ++i)
+			hash = (hash ^ (unsigned char) data[i]) * 0x100000001B3ull;
+		return hash;
+	}
+};
+
+#endif
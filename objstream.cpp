@@ -0,0 +1,442 @@
+/*
+Streaming Wavefront OBJ loader, reads a model in fixed-size blocks
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <cmath>
+#include <new>
+
+#include "mappedfile.h"
+#include "objparser.h"
+#include "objstream.h"
+
+//grows a zero-initialised buffer of stride values per element so it holds
+//needed elements, count elements are kept and capacity is updated, returns
+//-1 and leaves the buffer as it was when there is not enough memory
+template<typename T>
+static int GrowBuffer(T* &buffer, long count, long &capacity, long needed, int stride)
+{
+	if (needed <= capacity)
+		return 0;
+
+	long newCapacity = capacity > 0 ? capacity*2 : 1024;
+	while (newCapacity < needed)
+		newCapacity *= 2;
+
+	T* newBuffer = new (std::nothrow) T[newCapacity*stride]();
+	if (newBuffer == NULL)
+		return -1;
+	if (buffer != NULL)
+	{
+		memcpy(newBuffer, buffer, count*stride*sizeof(T));
+		delete[] buffer;
+	}
+	buffer = newBuffer;
+	capacity = newCapacity;
+	return 0;
+}
+
+static inline long ResolveIndex(long index, long count)
+{
+	return index < 0 ? count + index : index - 1;
+}
+
+//texel or normal indices for faces that have not named any yet, NULL
+//when there is not enough memory
+static long* NewMissingIndices(long faceCapacity)
+{
+	long* indices = new (std::nothrow) long[faceCapacity*3];
+	if (indices != NULL)
+		std::fill(indices, indices + faceCapacity*3, OBJ_MISSING_INDEX);
+	return indices;
+}
+
+OBJStream::OBJStream(size_t blockSize)
+{
+	mVertexBuffer = mNormalBuffer = mTextureBuffer = NULL;
+	mIndexBufferV = mIndexBufferN = mIndexBufferT = NULL;
+	mBlockSize = blockSize > 0 ? blockSize : 1 << 20;
+	mCallback = NULL;
+	mUserData = NULL;
+	Begin(0);
+}
+
+OBJStream::~OBJStream()
+{
+	FreeBuffers();
+}
+
+void OBJStream::FreeBuffers()
+{
+	delete[] mVertexBuffer;
+	delete[] mNormalBuffer;
+	delete[] mTextureBuffer;
+	delete[] mIndexBufferV;
+	delete[] mIndexBufferN;
+	delete[] mIndexBufferT;
+	mVertexBuffer = mNormalBuffer = mTextureBuffer = NULL;
+	mIndexBufferV = mIndexBufferN = mIndexBufferT = NULL;
+	mVertexCapacity = mNormalCapacity = mTexelCapacity = mFaceCapacity = 0;
+}
+
+void OBJStream::SetProgressCallback(OBJProgressCallback callback, void* userData)
+{
+	mCallback = callback;
+	mUserData = userData;
+}
+
+void OBJStream::Cancel()
+{
+	mCancelled = true;
+}
+
+void OBJStream::Begin(unsigned long long bytesTotal)
+{
+	FreeBuffers();
+	mCounts.vertices = mCounts.texels = mCounts.normals = mCounts.faces = 0;
+	mLines = OBJLineCounts();
+	mDrawableFaces = 0;
+	mBounds.Reset();
+	mCarry.clear();
+	mPolygons.clear();
+	mMarkers.clear();
+	mDirectory.clear();
+	mProgress.bytesRead = 0;
+	mProgress.bytesTotal = bytesTotal;
+	mProgress.vertices = mProgress.faces = 0;
+	mCancelled = false;
+	mOutOfMemory = false;
+	mStart = std::chrono::steady_clock::now();
+}
+
+void OBJStream::ParseLine(const char* p, const char* lineEnd)
+{
+	const char *name, *nameEnd;
+	OBJMarkerKind kind = OBJ_MARKER_NONE;
+	
+	if (p < lineEnd && (p[0] == 'o' || p[0] == 'g' || p[0] == 'u' || p[0] == 'm'))
+		kind = OBJParser::ParseMarker(p, lineEnd, name, nameEnd);
+	if (kind != OBJ_MARKER_NONE)
+	{
+		OBJMarker marker;
+		marker.triangle = mCounts.faces;
+		marker.kind = kind;
+		marker.name.assign(name, nameEnd);
+		mMarkers.push_back(marker);
+	}
+	if (lineEnd - p <= 2 || kind != OBJ_MARKER_NONE)
+	{
+		++mLines.other;
+		return;
+	}
+
+	// Positions
+	if (p[0] == 'v' && OBJParser::IsBlank(p[1]))
+	{
+		float* vertex;
+
+		if (GrowBuffer(mVertexBuffer, mCounts.vertices, mVertexCapacity, mCounts.vertices + 1, 4) != 0)
+			return OutOfMemory();
+		vertex = mVertexBuffer + 4*mCounts.vertices;
+		OBJParser::ParseFloats(p + 2, lineEnd, vertex, 3);
+		vertex[3] = 1.0f;
+		mBounds.Add(vertex);
+		++mCounts.vertices;
+	}
+
+	else if (p[0] == 'v' && p[1] == 't' && OBJParser::IsBlank(p[2]))
+	{
+		if (GrowBuffer(mTextureBuffer, mCounts.texels, mTexelCapacity, mCounts.texels + 1, 2) != 0)
+			return OutOfMemory();
+		OBJParser::ParseFloats(p + 3, lineEnd, mTextureBuffer + 2*mCounts.texels, 2);
+		++mCounts.texels;
+	}
+
+	else if (p[0] == 'v' && p[1] == 'n' && OBJParser::IsBlank(p[2]))
+	{
+		if (GrowBuffer(mNormalBuffer, mCounts.normals, mNormalCapacity, mCounts.normals + 1, 3) != 0)
+			return OutOfMemory();
+		OBJParser::ParseFloats(p + 3, lineEnd, mNormalBuffer + 3*mCounts.normals, 3);
+		++mCounts.normals;
+	}
+
+	// Faces, polygons are read as a fan and fixed up by the OBJClass if concave
+	else if (p[0] == 'f' && OBJParser::IsBlank(p[1]))
+	{
+		OBJPolygon polygon;
+
+		polygon.firstTriangle = mCounts.faces;
+		polygon.corners = OBJParser::ParseFace(p + 2, lineEnd, [&](const OBJCorner* triangle)
+		{
+			long face = mCounts.faces;
+			bool bDrawable = face == mDrawableFaces;
+
+			if (mOutOfMemory)
+				return;
+
+			//the texel and normal indices are only stored once a face uses them,
+			//the three share one capacity, which only moves once all of them grew
+			if (face >= mFaceCapacity)
+			{
+				long capacity = mFaceCapacity, capacityN = mFaceCapacity, capacityT = mFaceCapacity;
+				if (GrowBuffer(mIndexBufferV, face, capacity, face + 1, 3) != 0 ||
+					(mIndexBufferN != NULL && GrowBuffer(mIndexBufferN, face, capacityN, face + 1, 3) != 0) ||
+					(mIndexBufferT != NULL && GrowBuffer(mIndexBufferT, face, capacityT, face + 1, 3) != 0))
+					return OutOfMemory();
+				mFaceCapacity = capacity;
+			}
+
+			for (int i = 0; i < 3; ++i)
+			{
+				mIndexBufferV[3*face + i] = ResolveIndex(triangle[i].v, mCounts.vertices);
+				//the corners before the first texel or normal index did not name one
+				if (triangle[i].t != 0 && mIndexBufferT == NULL &&
+					(mIndexBufferT = NewMissingIndices(mFaceCapacity)) == NULL)
+					return OutOfMemory();
+				if (triangle[i].n != 0 && mIndexBufferN == NULL &&
+					(mIndexBufferN = NewMissingIndices(mFaceCapacity)) == NULL)
+					return OutOfMemory();
+				if (mIndexBufferT != NULL)
+					mIndexBufferT[3*face + i] = triangle[i].t != 0 ?
+						ResolveIndex(triangle[i].t, mCounts.texels) : OBJ_MISSING_INDEX;
+				if (mIndexBufferN != NULL)
+					mIndexBufferN[3*face + i] = triangle[i].n != 0 ?
+						ResolveIndex(triangle[i].n, mCounts.normals) : OBJ_MISSING_INDEX;
+
+				if (mIndexBufferV[3*face + i] < 0 || mIndexBufferV[3*face + i] >= mCounts.vertices)
+					bDrawable = false;
+			}
+
+			if (bDrawable)
+				++mDrawableFaces;
+			++mCounts.faces;
+		});
+
+		if (polygon.corners > 3)
+			mPolygons.push_back(polygon);
+		++mLines.faces;
+	}
+	else
+		++mLines.other;
+}
+
+//stops the load, End reports it once the caller is done feeding
+void OBJStream::OutOfMemory()
+{
+	std::cout << "NOT ENOUGH MEMORY FOR THE OBJ STREAM" << std::endl;
+	mOutOfMemory = true;
+	mCancelled = true;
+}
+
+void OBJStream::ParseLines(const char* p, const char* end)
+{
+	while (p < end && !mOutOfMemory)
+	{
+		const char* lineEnd = OBJParser::FindLineEnd(p, end);
+		ParseLine(p, lineEnd);
+		p = lineEnd + 1;
+	}
+}
+
+bool OBJStream::ReportProgress()
+{
+	mProgress.vertices = mCounts.vertices;
+	mProgress.faces = mCounts.faces;
+
+	if (mCallback != NULL && !mCallback(mProgress, mUserData))
+		mCancelled = true;
+	return !mCancelled;
+}
+
+//parses the whole lines of a block, the unfinished last line is kept until
+//the next block completes it, so only the block and that line are ever buffered
+int OBJStream::Feed(const char* data, size_t size)
+{
+	const char* end = data + size;
+	const char* p = data;
+	const char* last = end;
+
+	if (mCancelled)
+		return -1;
+
+	if (!mCarry.empty())
+	{
+		const char* lineEnd = OBJParser::FindLineEnd(p, end);
+		mCarry.append(p, lineEnd);
+		if (lineEnd < end)
+		{
+			ParseLine(mCarry.data(), mCarry.data() + mCarry.size());
+			mCarry.clear();
+		}
+		p = lineEnd < end ? lineEnd + 1 : end;
+	}
+
+	while (last > p && last[-1] != '\n')
+		--last;
+	ParseLines(p, last);
+	mCarry.append(last, end);
+
+	mProgress.bytesRead += size;
+	return ReportProgress() ? 0 : -1;
+}
+
+int OBJStream::End(OBJClass &obj)
+{
+	size_t indexBuffers;
+
+	if (mCancelled)
+	{
+		FreeBuffers();
+		obj.mLoadStats = OBJLoadStats();
+		obj.mLoadStats.source = OBJ_SOURCE_STREAM;
+		obj.mLoadStats.bytesRead = mProgress.bytesRead;
+		return obj.FailLoad(mOutOfMemory ? OBJ_LOAD_OUT_OF_MEMORY : OBJ_LOAD_CANCELLED);
+	}
+
+	if (!mCarry.empty())
+		ParseLine(mCarry.data(), mCarry.data() + mCarry.size());
+	mCarry.clear();
+	ReportProgress();
+
+	//the OBJClass reads the raw buffers in place and builds the finished
+	//model in its own arena, so they are freed here either way
+	obj.Release();
+	obj.mScratch.ResetPeak();
+	obj.mLoadStats = OBJLoadStats();
+	obj.mLoadStats.source = OBJ_SOURCE_STREAM;
+	obj.mLoadStats.bytesRead = mProgress.bytesRead;
+	obj.mLoadStats.lines = mLines;
+	obj.mLoadStats.lines.vertices = mCounts.vertices;
+	obj.mLoadStats.lines.texels = mCounts.texels;
+	obj.mLoadStats.lines.normals = mCounts.normals;
+	obj.mLoadStats.times.parse = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - mStart).count();
+	obj.mVertexBuffer = mVertexBuffer;
+	obj.mIndexBufferV = mIndexBufferV;
+	obj.mVertexCount = mCounts.vertices;
+	obj.mFaceCount = mCounts.faces;
+	obj.mNormalCount = mCounts.normals;
+	obj.mTexelCount = mCounts.texels;
+	if ((mCounts.normals > 0 && mIndexBufferN == NULL && (mIndexBufferN = NewMissingIndices(mFaceCapacity)) == NULL) ||
+		(mCounts.texels > 0 && mIndexBufferT == NULL && (mIndexBufferT = NewMissingIndices(mFaceCapacity)) == NULL))
+	{
+		std::cout << "NOT ENOUGH MEMORY FOR THE OBJ STREAM" << std::endl;
+		obj.Release();
+		FreeBuffers();
+		return obj.FailLoad(OBJ_LOAD_OUT_OF_MEMORY);
+	}
+	if (mCounts.normals > 0)
+	{
+		obj.mNormalBuffer = mNormalBuffer;
+		obj.mIndexBufferN = mIndexBufferN;
+	}
+	if (mCounts.texels > 0)
+	{
+		obj.mTextureBuffer = mTextureBuffer;
+		obj.mIndexBufferT = mIndexBufferT;
+	}
+	obj.mPolygons.swap(mPolygons);
+	mPolygons.clear();
+	obj.mMarkers.swap(mMarkers);
+	mMarkers.clear();
+	obj.mDirectory = mDirectory;
+
+	if (obj.FinishLoad(mBounds) != 0)
+	{
+		obj.Release();
+		obj.EndScratch();
+		FreeBuffers();
+		return -1;
+	}
+	//the raw buffers were held next to the arenas until now
+	indexBuffers = 1 + (mIndexBufferN != NULL ? 1 : 0) + (mIndexBufferT != NULL ? 1 : 0);
+	obj.mLoadStats.peakBytes += (mVertexCapacity*4 + mNormalCapacity*3 + mTexelCapacity*2)*sizeof(float) +
+		indexBuffers*mFaceCapacity*3*sizeof(long);
+	FreeBuffers();
+	obj.EndScratch();
+	obj.mLoadStats.times.total = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - mStart).count();
+	//a cancel that came in while the model was finished leaves no half model behind either
+	if (mCancelled)
+	{
+		obj.Release();
+		return obj.FailLoad(OBJ_LOAD_CANCELLED);
+	}
+	return 0;
+}
+
+//reads blocks until the end of the stream, the one block buffer is all
+//the memory the load needs besides the geometry itself
+void OBJStream::ReadBlocks(FILE* stream)
+{
+	char* block = new (std::nothrow) char[mBlockSize];
+	size_t size;
+
+	if (block == NULL)
+	{
+		OutOfMemory();
+		return;
+	}
+	while (!mCancelled && (size = fread(block, 1, mBlockSize, stream)) > 0)
+		Feed(block, size);
+
+	delete[] block;
+}
+
+int OBJStream::LoadPipe(FILE* pipe, OBJClass &obj)
+{
+	Begin(0);
+	ReadBlocks(pipe);
+	return End(obj);
+}
+
+int OBJStream::LoadFile(const wchar_t* fileName, OBJClass &obj)
+{
+	FILE* file = OpenFile(fileName, "rb");
+
+	if (file == NULL)
+		return -1;
+
+	fseek(file, 0, SEEK_END);
+	Begin((unsigned long long) ftell(file));
+	fseek(file, 0, SEEK_SET);
+	mDirectory = GetDirectoryOf(fileName);
+
+	ReadBlocks(file);
+	fclose(file);
+	return End(obj);
+}
+
+//the buffer is already in memory, it is fed in place a block at a time
+int OBJStream::LoadMemory(const char* data, size_t size, OBJClass &obj)
+{
+	size_t offset = 0;
+
+	Begin(size);
+	while (!mCancelled && offset < size)
+	{
+		size_t block = size - offset < mBlockSize ? size - offset : mBlockSize;
+		Feed(data + offset, block);
+		offset += block;
+	}
+	return End(obj);
+}
+
+float OBJStream::GetScale()
+{
+	float scale = 0.0f;
+
+	for (int i = 0; i < 3; ++i)
+		scale += (mBounds.vmax[i] - mBounds.vmin[i]) * (mBounds.vmax[i] - mBounds.vmin[i]);
+	return scale > 0.0f ? sqrtf(scale)/7.2f : 1.0f;
+}
@@ -0,0 +1,108 @@
+/*
+Streaming Wavefront OBJ loader, reads a model in fixed-size blocks
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef OBJSTREAM_H
+#define OBJSTREAM_H
+
+#include <cstdio>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "objparser.h"
+#include "wavefrontloader.h"
+
+struct OBJProgress
+{
+	unsigned long long bytesRead;
+	unsigned long long bytesTotal;	// 0 when the size is not known, e.g. a pipe
+	long vertices;
+	long faces;
+};
+
+//called after every block, return false to cancel the load
+typedef bool (*OBJProgressCallback)(const OBJProgress &progress, void* userData);
+
+class OBJStream
+{
+  private:
+	//geometry read so far, grown as blocks arrive and handed to the OBJClass at the end
+	float* mVertexBuffer;
+	float* mNormalBuffer;
+	float* mTextureBuffer;
+	long* mIndexBufferV;
+	long* mIndexBufferN;
+	long* mIndexBufferT;
+
+	long mVertexCapacity;
+	long mNormalCapacity;
+	long mTexelCapacity;
+	long mFaceCapacity;
+
+	OBJRecordCounts mCounts;
+	OBJLineCounts mLines;	// Face lines and lines that are no record, the rest is in mCounts
+	std::vector<OBJPolygon> mPolygons;
+	std::vector<OBJMarker> mMarkers;	// mtllib, usemtl, o and g lines
+	std::wstring mDirectory;			// Where the material libraries are, empty unless loading a file
+	long mDrawableFaces;	// Leading triangles whose vertices have all been read
+	OBJBounds mBounds;
+
+	std::string mCarry;		// Unfinished last line of the previous block
+	size_t mBlockSize;
+
+	OBJProgress mProgress;
+	OBJProgressCallback mCallback;
+	void* mUserData;
+	std::atomic<bool> mCancelled;
+	bool mOutOfMemory;		// A buffer could not grow, the load is cancelled with that error
+	std::chrono::steady_clock::time_point mStart;	// Of Begin, the parse time includes waiting for the data
+
+	void ParseLines(const char* p, const char* end);
+	void ParseLine(const char* p, const char* lineEnd);
+	bool ReportProgress();
+	void OutOfMemory();
+	void ReadBlocks(FILE* stream);
+	void FreeBuffers();
+
+	OBJStream(const OBJStream&) = delete;
+	OBJStream& operator=(const OBJStream&) = delete;
+
+ public:
+	OBJStream(size_t blockSize = 1 << 20);
+	~OBJStream();
+
+	void SetProgressCallback(OBJProgressCallback callback, void* userData);
+	void Cancel();		// Safe to call from any thread
+
+	//push interface, Begin, any number of Feed calls and then End
+	void Begin(unsigned long long bytesTotal);
+	int Feed(const char* data, size_t size);	// Returns -1 once cancelled
+	int End(OBJClass &obj);					// Hands the geometry to obj, returns 0 or -1
+
+	//pull interface over the common sources
+	int LoadFile(const wchar_t* fileName, OBJClass &obj);
+	int LoadPipe(FILE* pipe, OBJClass &obj);
+	int LoadMemory(const char* data, size_t size, OBJClass &obj);
+
+	//partial geometry for drawing while the load runs, valid until the next
+	//Feed, positions have w = 1 and GetScale gives the scale of the data so far
+	inline const float* GetVertexBuffer(){return mVertexBuffer;};
+	inline const long* GetIndexBufferV(){return mIndexBufferV;};
+	inline long GetVertexCount(){return mCounts.vertices;};
+	inline long GetDrawableTriangles(){return mDrawableFaces*3;};
+	float GetScale();
+
+	inline const OBJProgress& GetProgress(){return mProgress;};
+};
+
+#endif
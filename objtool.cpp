@@ -0,0 +1,652 @@
+/*
+Command line companion of the viewer for machines without a display
+
+Usage: objtool render <model.obj> <image.png|image.ppm> [-width W] [-height H]
+	[-rotx degrees] [-roty degrees] [-wireframe] [-noaxis] [-threads N] [-cache]
+       objtool quantize <model.obj> [-threads N] [-cache] [-xyz]
+       objtool pack <model.obj> <model.objpack> [-threads N]
+       objtool batch <directory> [output directory] [-threads N] [-memory MB] [-optimize] [-meshlets]
+	[-levels] [-angle]
+       objtool stats <model.obj> [-threads N] [-cache] [-optimize] [-meshlets] [-levels]
+       objtool watch <model.obj> [-threads N] [-optimize] [-meshlets] [-levels] [-count N]
+render, quantize, pack and stats read an OBJ from standard input when the model is -.
+Build: g++ -O2 -std=c++14 -pthread objtool.cpp softrender.cpp meshquantize.cpp meshcodec.cpp wavefrontloader.cpp
+	wavefrontcache.cpp wavefrontpack.cpp wavefrontmaterials.cpp mappedfile.cpp arena.cpp meshnormals.cpp meshoptimize.cpp
+	meshlets.cpp meshsimplify.cpp perfstats.cpp objstream.cpp
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "mappedfile.h"
+#include "meshquantize.h"
+#include "objstream.h"
+#include "parallel.h"
+#include "perfstats.h"
+#include "softrender.h"
+#include "wavefrontloader.h"
+
+static void PrintUsage()
+{
+	std::cout << "Usage: objtool render <model.obj> <image.png|image.ppm> [-width W] [-height H]" << std::endl;
+	std::cout << "                      [-rotx degrees] [-roty degrees] [-wireframe] [-noaxis] [-threads N] [-cache]" << std::endl;
+	std::cout << "       objtool quantize <model.obj> [-threads N] [-cache] [-xyz]" << std::endl;
+	std::cout << "       objtool pack <model.obj> <model.objpack> [-threads N]" << std::endl;
+	std::cout << "       objtool batch <directory> [output directory] [-threads N] [-memory MB] [-optimize] [-meshlets]" << std::endl;
+	std::cout << "                     [-levels] [-angle]" << std::endl;
+	std::cout << "       objtool stats <model.obj> [-threads N] [-cache] [-optimize] [-meshlets] [-levels]" << std::endl;
+	std::cout << "       objtool watch <model.obj> [-threads N] [-optimize] [-meshlets] [-levels] [-count N]" << std::endl;
+	std::cout << "render, quantize, pack and stats read an OBJ from standard input when the model is -." << std::endl;
+}
+
+static bool EndsWith(const char* text, const char* suffix)
+{
+	size_t length = strlen(text), suffixLength = strlen(suffix);
+	return length >= suffixLength && strcmp(text + length - suffixLength, suffix) == 0;
+}
+
+static int WidenPath(const char* path, std::vector<wchar_t> &fileName)
+{
+	fileName.resize(strlen(path) + 1);
+	return mbstowcs(fileName.data(), path, fileName.size()) == (size_t) -1 ? -1 : 0;
+}
+
+static long FileSize(const char* path)
+{
+	FILE* file = fopen(path, "rb");
+	long size = -1;
+
+	if (file != NULL && fseek(file, 0, SEEK_END) == 0)
+		size = ftell(file);
+	if (file != NULL)
+		fclose(file);
+	return size;
+}
+
+//loads a model named in the local multibyte encoding, OBJ or packed, or
+//an OBJ piped to standard input when the name is -, returns 0 or -1
+static int LoadModel(OBJClass &objmodel, const char* path, int threads, bool bUseCache)
+{
+	std::vector<wchar_t> fileName;
+
+	objmodel.SetThreadCount(threads);
+	if (strcmp(path, "-") == 0)
+	{
+		//read a block at a time, so the pipe is never held in memory whole
+		OBJStream stream;
+#ifdef _WIN32
+		_setmode(_fileno(stdin), _O_BINARY);
+#endif
+		return stream.LoadPipe(stdin, objmodel);
+	}
+	if (WidenPath(path, fileName) == -1)
+		return -1;
+	objmodel.SetUseCache(bUseCache);
+	return objmodel.Load(fileName.data());
+}
+
+static int RenderCommand(int argc, char** argv)
+{
+	SoftRenderSettings settings;
+	SoftRenderer renderer;
+	OBJClass objmodel;
+	bool bUseCache = false;
+
+	if (argc < 2)
+	{
+		PrintUsage();
+		return -1;
+	}
+	for (int i = 2; i < argc; ++i)
+	{
+		bool bHasValue = i + 1 < argc;
+
+		if (strcmp(argv[i], "-width") == 0 && bHasValue)
+			settings.width = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-height") == 0 && bHasValue)
+			settings.height = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-rotx") == 0 && bHasValue)
+			settings.rotX = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-roty") == 0 && bHasValue)
+			settings.rotY = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-threads") == 0 && bHasValue)
+			settings.threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-wireframe") == 0)
+			settings.bWireframe = true;
+		else if (strcmp(argv[i], "-noaxis") == 0)
+			settings.bDrawAxis = false;
+		else if (strcmp(argv[i], "-cache") == 0)
+			bUseCache = true;
+		else
+		{
+			PrintUsage();
+			return -1;
+		}
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	if (LoadModel(objmodel, argv[0], settings.threads, bUseCache) == -1)
+	{
+		std::cout << "COULD NOT LOAD " << argv[0] << std::endl;
+		return -1;
+	}
+	double loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	if (renderer.Render(objmodel, settings) == -1)
+	{
+		std::cout << "IMAGE SIZE NOT SUPPORTED" << std::endl;
+		return -1;
+	}
+	const SoftRenderStats &stats = renderer.GetStats();
+	double totalMs = stats.setupMs + stats.rasterMs;
+
+	if ((EndsWith(argv[1], ".ppm") ? renderer.WritePPM(argv[1]) : renderer.WritePNG(argv[1])) == -1)
+	{
+		std::cout << "COULD NOT WRITE " << argv[1] << std::endl;
+		return -1;
+	}
+
+	std::cout << "Loaded " << objmodel.GetVertexCount() << " vertices in " << loadMs << " ms" << std::endl;
+	std::cout << "Drew " << stats.triangles << " triangles (" << stats.rasterized << " rasterized) at "
+		<< settings.width << "x" << settings.height << " in " << totalMs << " ms: setup " << stats.setupMs
+		<< " ms, raster " << stats.rasterMs << " ms, " << (totalMs > 0.0 ? stats.triangles / totalMs / 1e3 : 0.0)
+		<< " Mtris/s" << std::endl;
+	return 0;
+}
+
+//reports how far the compact attributes are off and how much memory they save
+static int QuantizeCommand(int argc, char** argv)
+{
+	QuantizedMesh compact;
+	OBJClass objmodel;
+	int threads = 0;
+	bool bUseCache = false;
+	NormalEncoding normalEncoding = NORMALS_OCTAHEDRAL;
+
+	if (argc < 1)
+	{
+		PrintUsage();
+		return -1;
+	}
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-cache") == 0)
+			bUseCache = true;
+		else if (strcmp(argv[i], "-xyz") == 0)
+			normalEncoding = NORMALS_SNORM16;
+		else
+		{
+			PrintUsage();
+			return -1;
+		}
+	}
+
+	if (LoadModel(objmodel, argv[0], threads, bUseCache) == -1)
+	{
+		std::cout << "COULD NOT LOAD " << argv[0] << std::endl;
+		return -1;
+	}
+	auto start = std::chrono::steady_clock::now();
+	if (compact.Build(objmodel.GetVertexBuffer(), 4, objmodel.HasNormals() ? objmodel.GetNormalBuffer() : NULL,
+		objmodel.GetTextureBuffer(), objmodel.GetVertexCount(), objmodel.GetBoundsMin(), objmodel.GetBoundsMax(), threads,
+		normalEncoding) == -1)
+	{
+		std::cout << "COULD NOT QUANTIZE " << argv[0] << std::endl;
+		return -1;
+	}
+	double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	//what a renderer reading the compact attributes pays to unpack them
+	std::vector<float> decoded(4*(size_t) compact.GetVertexCount());
+	start = std::chrono::steady_clock::now();
+	compact.DecodePositions(0, compact.GetVertexCount(), objmodel.GetScale(), decoded.data());
+	if (compact.HasNormals())
+		compact.DecodeNormals(0, compact.GetVertexCount(), decoded.data());
+	if (compact.HasTexcoords())
+		compact.DecodeTexcoords(0, compact.GetVertexCount(), decoded.data());
+	double decodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	const QuantizationStats &stats = compact.GetStats();
+	std::cout << compact.GetVertexCount() << " vertices: " << stats.floatBytes << " bytes as floats, " << stats.compactBytes
+		<< " compact, " << (double) stats.floatBytes/stats.compactBytes << "x smaller" << std::endl;
+	std::cout << "Largest error: position " << stats.positionError << " model units (" << stats.positionError/objmodel.GetRadius()*100.0f
+		<< "% of the radius), normal " << stats.normalError << " degrees, texture coordinate " << stats.texcoordError << std::endl;
+	std::cout << "Encoded in " << buildMs << " ms, decoded in " << decodeMs << " ms" << std::endl;
+	return 0;
+}
+
+//compresses a model, then reads it back to time the decoder and check
+//that every buffer comes back the same
+static int PackCommand(int argc, char** argv)
+{
+	OBJClass objmodel, packed;
+	std::vector<wchar_t> packName;
+	int threads = 0;
+
+	if (argc < 2)
+	{
+		PrintUsage();
+		return -1;
+	}
+	for (int i = 2; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else
+		{
+			PrintUsage();
+			return -1;
+		}
+	}
+
+	//the codecs gain most from the vertex and triangle order the optimizer leaves
+	objmodel.SetOptimizeVertexCache(true);
+	if (LoadModel(objmodel, argv[0], threads, false) == -1)
+	{
+		std::cout << "COULD NOT LOAD " << argv[0] << std::endl;
+		return -1;
+	}
+	if (WidenPath(argv[1], packName) == -1)
+		return -1;
+
+	auto start = std::chrono::steady_clock::now();
+	if (objmodel.WritePacked(packName.data()) == -1)
+	{
+		std::cout << "COULD NOT WRITE " << argv[1] << std::endl;
+		return -1;
+	}
+	double writeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	start = std::chrono::steady_clock::now();
+	packed.SetThreadCount(threads);
+	if (packed.ReadPacked(packName.data()) == -1)
+	{
+		std::cout << "COULD NOT READ " << argv[1] << std::endl;
+		return -1;
+	}
+	double readMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	long vertexCount = objmodel.GetVertexCount();
+	long indexCount = objmodel.GetTotalConnectTriangles();
+	bool bTextures = objmodel.GetTextureBuffer() != NULL;
+	if (packed.GetVertexCount() != vertexCount || packed.GetTotalConnectTriangles() != indexCount ||
+		memcmp(packed.GetVertexBuffer(), objmodel.GetVertexBuffer(), vertexCount*4*sizeof(float)) != 0 ||
+		memcmp(packed.GetNormalBuffer(), objmodel.GetNormalBuffer(), vertexCount*3*sizeof(float)) != 0 ||
+		(packed.GetTextureBuffer() != NULL) != bTextures ||
+		(bTextures && memcmp(packed.GetTextureBuffer(), objmodel.GetTextureBuffer(), vertexCount*2*sizeof(float)) != 0) ||
+		memcmp(packed.GetIndexBufferV(), objmodel.GetIndexBufferV(), indexCount*sizeof(long)) != 0)
+	{
+		std::cout << "PACKED MODEL DIFFERS FROM " << argv[0] << std::endl;
+		return -1;
+	}
+
+	unsigned long long bufferBytes = (unsigned long long) vertexCount*(bTextures ? 9 : 7)*sizeof(float) + indexCount*sizeof(long);
+	long packedBytes = FileSize(argv[1]);
+	std::cout << vertexCount << " vertices, " << indexCount/3 << " triangles: " << bufferBytes << " bytes of buffers, "
+		<< FileSize(argv[0]) << " of OBJ, " << packedBytes << " packed, " << (double) bufferBytes/packedBytes << "x smaller" << std::endl;
+	std::cout << "Wrote in " << writeMs << " ms, read back in " << readMs << " ms, "
+		<< (readMs > 0.0 ? bufferBytes/readMs/1e6 : 0.0) << " GB/s of buffers" << std::endl;
+	return 0;
+}
+
+//bytes a load may hold per byte of OBJ text, from the peak memory of large
+//models: the parse and the finished buffers, the optimizer's remapping and
+//the simplifier's quadrics
+static const unsigned long long BATCH_BYTES_PER_BYTE = 2;
+static const unsigned long long BATCH_OPTIMIZE_BYTES_PER_BYTE = 2;
+static const unsigned long long BATCH_LEVELS_BYTES_PER_BYTE = 3;
+
+//caps the memory of the loads running at once, files are let in in the
+//order they were handed out, so a large file waiting for room is not
+//overtaken for ever by small ones
+class MemoryBudget
+{
+  private:
+	std::mutex mMutex;
+	std::condition_variable mChanged;
+	unsigned long long mLimit;
+	unsigned long long mUsed;
+	unsigned long long mPeak;
+	long mTurn;		// The next file allowed to take memory
+
+ public:
+	MemoryBudget(unsigned long long limit) : mLimit(limit), mUsed(0), mPeak(0), mTurn(0) {};
+
+	//waits for turn and room, a file larger than the whole budget waits
+	//until nothing else runs, returns the bytes to give back to Release
+	unsigned long long Acquire(long turn, unsigned long long bytes)
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		bytes = std::min(bytes, mLimit);
+		mChanged.wait(lock, [&]{return turn == mTurn && (mUsed + bytes <= mLimit || mUsed == 0);});
+		mUsed += bytes;
+		mPeak = std::max(mPeak, mUsed);
+		++mTurn;
+		mChanged.notify_all();
+		return bytes;
+	}
+
+	void Release(unsigned long long bytes)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mUsed -= bytes;
+		mChanged.notify_all();
+	}
+
+	inline unsigned long long GetPeak(){return mPeak;};
+};
+
+struct BatchFile
+{
+	std::wstring path;
+	unsigned long long size;
+};
+
+static std::string NarrowPath(const std::wstring &path)
+{
+	std::vector<char> narrow(path.size()*MB_CUR_MAX + 1);
+
+	if (wcstombs(narrow.data(), path.c_str(), narrow.size()) == (size_t) -1)
+		return "?";
+	return narrow.data();
+}
+
+//where the packed file of path goes, directories in between are created
+static std::wstring PackedPath(const std::wstring &path, const std::wstring &input, const std::wstring &output)
+{
+	std::wstring packed = output + path.substr(input.size());
+
+	for (size_t i = output.size() + 1; i < packed.size(); ++i)
+	{
+		if (packed[i] == L'/' || packed[i] == L'\\')
+			MakeDirectory(packed.substr(0, i).c_str());
+	}
+	return packed.substr(0, packed.size() - 4) + L".objpack";
+}
+
+//loads every OBJ file below a directory with the chosen processing and
+//writes each as a packed file into a copy of the directory tree
+static int BatchCommand(int argc, char** argv)
+{
+	std::vector<wchar_t> name;
+	std::wstring input, output;
+	std::vector<std::wstring> paths;
+	std::vector<BatchFile> files;
+	std::mutex printMutex;
+	std::atomic<long> failed(0), triangles(0);
+	std::atomic<unsigned long long> bytes(0);
+	unsigned long long memoryLimit = 4096, bytesPerByte = BATCH_BYTES_PER_BYTE;
+	int threads = 0, i = 1;
+	bool bOptimize = false, bMeshlets = false, bLevels = false, bAngle = false;
+
+	if (argc < 1)
+	{
+		PrintUsage();
+		return -1;
+	}
+	if (argc > 1 && argv[1][0] != '-')
+	{
+		if (WidenPath(argv[1], name) == -1)
+			return -1;
+		output = name.data();
+		i = 2;
+	}
+	for (; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-memory") == 0 && i + 1 < argc)
+			memoryLimit = strtoull(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "-optimize") == 0)
+			bOptimize = true;
+		else if (strcmp(argv[i], "-meshlets") == 0)
+			bMeshlets = true;
+		else if (strcmp(argv[i], "-levels") == 0)
+			bLevels = true;
+		else if (strcmp(argv[i], "-angle") == 0)
+			bAngle = true;
+		else
+		{
+			PrintUsage();
+			return -1;
+		}
+	}
+
+	if (WidenPath(argv[0], name) == -1)
+		return -1;
+	input = name.data();
+	while (input.size() > 1 && (input.back() == L'/' || input.back() == L'\\'))
+		input.pop_back();
+	if (FindFiles(input.c_str(), L".obj", paths) == -1)
+	{
+		std::cout << "COULD NOT READ " << argv[0] << std::endl;
+		return -1;
+	}
+	if (!output.empty() && MakeDirectory(output.c_str()) == -1)
+	{
+		std::cout << "COULD NOT CREATE " << argv[1] << std::endl;
+		return -1;
+	}
+
+	//largest first, so the long loads start early and the small ones fill in around them
+	for (size_t f = 0; f < paths.size(); ++f)
+	{
+		BatchFile file = {paths[f], 0};
+		unsigned long long modified;
+		if (GetFileStamp(paths[f].c_str(), file.size, modified) == 0)
+			files.push_back(file);
+	}
+	std::stable_sort(files.begin(), files.end(), [](const BatchFile &a, const BatchFile &b){return a.size > b.size;});
+
+	if (bOptimize || bMeshlets)
+		bytesPerByte += BATCH_OPTIMIZE_BYTES_PER_BYTE;
+	if (bLevels)
+		bytesPerByte += BATCH_LEVELS_BYTES_PER_BYTE;
+	MemoryBudget budget(std::max(memoryLimit, 1ull) << 20);
+
+	//files spread over the threads, each file gets the threads left over
+	threads = ResolveThreadCount(threads);
+	int workers = (int) std::min((size_t) threads, std::max(files.size(), (size_t) 1));
+	int fileThreads = std::max(1, threads / workers);
+	std::cout << files.size() << " files, " << workers << " at a time with " << fileThreads << " threads each, "
+		<< memoryLimit << " MB of memory" << std::endl;
+
+	auto start = std::chrono::steady_clock::now();
+	ParallelFor((long) files.size(), workers, [&](long f)
+	{
+		const BatchFile &file = files[f];
+		unsigned long long charged = budget.Acquire(f, file.size*bytesPerByte);
+		auto fileStart = std::chrono::steady_clock::now();
+		OBJClass objmodel;
+		int result;
+
+		objmodel.SetThreadCount(fileThreads);
+		objmodel.SetOptimizeVertexCache(bOptimize);
+		objmodel.SetBuildMeshlets(bMeshlets);
+		objmodel.SetBuildLevels(bLevels);
+		objmodel.SetNormalWeighting(bAngle ? NORMALS_ANGLE_WEIGHTED : NORMALS_AREA_WEIGHTED);
+		result = objmodel.Load(const_cast<wchar_t*>(file.path.c_str()));
+		if (result == 0 && !output.empty())
+			result = objmodel.WritePacked(PackedPath(file.path, input, output).c_str());
+		long fileTriangles = objmodel.GetTotalConnectTriangles() / 3;
+		objmodel.Release();
+		budget.Release(charged);
+
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - fileStart).count();
+		std::lock_guard<std::mutex> lock(printMutex);
+		if (result != 0)
+		{
+			std::cout << "COULD NOT CONVERT " << NarrowPath(file.path) << std::endl;
+			++failed;
+			return;
+		}
+		bytes += file.size;
+		triangles += fileTriangles;
+		std::cout << NarrowPath(file.path) << ": " << file.size/1e6 << " MB, " << fileTriangles << " triangles in " << ms
+			<< " ms, " << (ms > 0.0 ? file.size/ms/1e3 : 0.0) << " MB/s, " << (ms > 0.0 ? fileTriangles/ms/1e3 : 0.0)
+			<< " Mtris/s" << std::endl;
+	});
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << files.size() - failed << " of " << files.size() << " files, " << bytes/1e6 << " MB, " << triangles
+		<< " triangles in " << seconds << " s: " << (seconds > 0.0 ? bytes/seconds/1e6 : 0.0) << " MB/s, "
+		<< (seconds > 0.0 ? triangles/seconds/1e6 : 0.0) << " Mtris/s, at most "
+		<< (budget.GetPeak() >> 20) << " MB of memory estimated in use" << std::endl;
+	return failed > 0 ? -1 : 0;
+}
+
+//loads a model with the given options and prints its load statistics as
+//JSON, a failed load prints them too since they say why it failed
+static int StatsCommand(int argc, char** argv)
+{
+	OBJClass objmodel;
+	int threads = 0;
+	bool bUseCache = false;
+	int result;
+
+	if (argc < 1)
+	{
+		PrintUsage();
+		return -1;
+	}
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-cache") == 0)
+			bUseCache = true;
+		else if (strcmp(argv[i], "-optimize") == 0)
+			objmodel.SetOptimizeVertexCache(true);
+		else if (strcmp(argv[i], "-meshlets") == 0)
+			objmodel.SetBuildMeshlets(true);
+		else if (strcmp(argv[i], "-levels") == 0)
+			objmodel.SetBuildLevels(true);
+		else
+		{
+			PrintUsage();
+			return -1;
+		}
+	}
+
+	result = LoadModel(objmodel, argv[0], threads, bUseCache);
+	printf("{\"threads\": %d, \"vertices\": %ld, \"triangles\": %ld,\n \"load\": %s}\n", ResolveThreadCount(threads),
+		objmodel.GetVertexCount(), objmodel.GetTotalConnectTriangles() / 3, LoadStatsToJSON(objmodel.GetLoadStats()).c_str());
+	if (result == -1)
+		std::cout << "COULD NOT LOAD " << argv[0] << ": " << GetLoadErrorText(objmodel.GetLoadStats().error) << std::endl;
+	return result;
+}
+
+//how often watch looks at the file
+static const int WATCH_POLL_MS = 20;
+
+//loads a model and loads it again whenever its file changes, patching in
+//the stretches that changed where it can, until count changes were handled
+static int WatchCommand(int argc, char** argv)
+{
+	OBJClass objmodel;
+	FileWatcher watcher;
+	std::vector<wchar_t> fileName;
+	int threads = 0;
+	long count = -1;
+
+	if (argc < 1 || WidenPath(argv[0], fileName) == -1)
+	{
+		PrintUsage();
+		return -1;
+	}
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-count") == 0 && i + 1 < argc)
+			count = atol(argv[++i]);
+		else if (strcmp(argv[i], "-optimize") == 0)
+			objmodel.SetOptimizeVertexCache(true);
+		else if (strcmp(argv[i], "-meshlets") == 0)
+			objmodel.SetBuildMeshlets(true);
+		else if (strcmp(argv[i], "-levels") == 0)
+			objmodel.SetBuildLevels(true);
+		else
+		{
+			PrintUsage();
+			return -1;
+		}
+	}
+
+	objmodel.SetThreadCount(threads);
+	objmodel.SetTrackChanges(true);
+	if (objmodel.Load(fileName.data()) == -1 || watcher.Watch(fileName.data()) == -1)
+	{
+		std::cout << "COULD NOT LOAD " << argv[0] << ": " << GetLoadErrorText(objmodel.GetLoadStats().error) << std::endl;
+		return -1;
+	}
+	printf("loaded %s, %ld triangles in %.2f ms, watching it\n", argv[0], objmodel.GetTotalConnectTriangles() / 3,
+		objmodel.GetLoadTimes().total);
+	fflush(stdout);
+
+	while (count != 0)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(WATCH_POLL_MS));
+		if (!watcher.HasChanged())
+			continue;
+		if (objmodel.ReloadChanges(fileName.data()) == 0)
+			printf("patched %llu bytes in %.2f ms, %.2f ms of it finding them\n", objmodel.GetLoadStats().bytesRead,
+				objmodel.GetLoadTimes().total, objmodel.GetLoadTimes().count + objmodel.GetLoadTimes().parse);
+		else
+		{
+			const char* reason = GetLoadErrorText(objmodel.GetLoadStats().error);
+			if (objmodel.Load(fileName.data()) == 0)
+				printf("loaded again in %.2f ms, %s\n", objmodel.GetLoadTimes().total, reason);
+			else
+				std::cout << "COULD NOT LOAD " << argv[0] << ": " << GetLoadErrorText(objmodel.GetLoadStats().error) << std::endl;
+		}
+		fflush(stdout);
+		if (count > 0)
+			--count;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1 && strcmp(argv[1], "render") == 0)
+		return RenderCommand(argc - 2, argv + 2) == -1 ? 1 : 0;
+	if (argc > 1 && strcmp(argv[1], "quantize") == 0)
+		return QuantizeCommand(argc - 2, argv + 2) == -1 ? 1 : 0;
+	if (argc > 1 && strcmp(argv[1], "pack") == 0)
+		return PackCommand(argc - 2, argv + 2) == -1 ? 1 : 0;
+	if (argc > 1 && strcmp(argv[1], "batch") == 0)
+		return BatchCommand(argc - 2, argv + 2) == -1 ? 1 : 0;
+	if (argc > 1 && strcmp(argv[1], "stats") == 0)
+		return StatsCommand(argc - 2, argv + 2) == -1 ? 1 : 0;
+	if (argc > 1 && strcmp(argv[1], "watch") == 0)
+		return WatchCommand(argc - 2, argv + 2) == -1 ? 1 : 0;
+
+	PrintUsage();
+	return 1;
+}
@@ -0,0 +1,66 @@
+/*
+Minimal fork-join helpers used by the loader's parallel stages
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+//turns a requested thread count into a usable one, 0 means every hardware thread
+inline int ResolveThreadCount(int threads)
+{
+	if (threads <= 0)
+	{
+		threads = (int) std::thread::hardware_concurrency();
+		if (threads <= 0)
+			threads = 1;
+	}
+	return threads;
+}
+
+//calls task(item) for every item in [0, count) on up to threads threads,
+//the calling thread takes part and items are handed out one at a time so
+//uneven items balance themselves
+template<typename Task>
+void ParallelFor(long count, int threads, Task task)
+{
+	std::atomic<long> next(0);
+	std::vector<std::thread> workers;
+
+	threads = ResolveThreadCount(threads);
+	if (threads > count)
+		threads = (int) count;
+
+	if (threads <= 1)
+	{
+		for (long i = 0; i < count; ++i)
+			task(i);
+		return;
+	}
+
+	auto work = [&]()
+	{
+		for (long i = next++; i < count; i = next++)
+			task(i);
+	};
+
+	workers.reserve(threads - 1);
+	for (int i = 1; i < threads; ++i)
+		workers.push_back(std::thread(work));
+	work();
+	for (size_t i = 0; i < workers.size(); ++i)
+		workers[i].join();
+}
+
+#endif
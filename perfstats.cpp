@@ -0,0 +1,123 @@
+/*
+Frame time window of the viewer and JSON reports of the load and frame statistics
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "perfstats.h"
+
+FrameStats::FrameStats()
+{
+	Reset();
+}
+
+void FrameStats::Reset()
+{
+	mFrameCount = 0;
+}
+
+//nearest rank percentiles of count values, which are sorted in place
+static FramePercentiles Percentiles(float* values, int count)
+{
+	FramePercentiles percentiles = {0.0, 0.0, 0.0, 0.0};
+	auto rank = [&](double fraction)
+	{
+		int index = (int) ceil(fraction*count) - 1;
+		return (double) values[index < 0 ? 0 : index];
+	};
+
+	if (count == 0)
+		return percentiles;
+	std::sort(values, values + count);
+	percentiles.p50 = rank(0.5);
+	percentiles.p90 = rank(0.9);
+	percentiles.p99 = rank(0.99);
+	percentiles.max = values[count - 1];
+	return percentiles;
+}
+
+FramePercentiles FrameStats::GetSubmitPercentiles()
+{
+	float values[FRAME_STATS_WINDOW];
+	int count = (int) std::min<long long>(mFrameCount, FRAME_STATS_WINDOW);
+
+	std::copy(mSubmit, mSubmit + count, values);
+	return Percentiles(values, count);
+}
+
+FramePercentiles FrameStats::GetSwapPercentiles()
+{
+	float values[FRAME_STATS_WINDOW];
+	int count = (int) std::min<long long>(mFrameCount, FRAME_STATS_WINDOW);
+
+	std::copy(mSwap, mSwap + count, values);
+	return Percentiles(values, count);
+}
+
+FramePercentiles FrameStats::GetFramePercentiles()
+{
+	float values[FRAME_STATS_WINDOW];
+	int count = (int) std::min<long long>(mFrameCount, FRAME_STATS_WINDOW);
+
+	for (int i = 0; i < count; ++i)
+		values[i] = mSubmit[i] + mSwap[i];
+	return Percentiles(values, count);
+}
+
+static void AppendPercentiles(std::string &json, const char* name, const FramePercentiles &percentiles)
+{
+	char text[160];
+
+	snprintf(text, sizeof(text), "\"%s\": {\"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f}",
+		name, percentiles.p50, percentiles.p90, percentiles.p99, percentiles.max);
+	json += text;
+}
+
+std::string FrameStats::ToJSON()
+{
+	std::string json;
+	char text[96];
+
+	snprintf(text, sizeof(text), "{\"frames\": %lld, \"window\": %d, ", mFrameCount,
+		(int) std::min<long long>(mFrameCount, FRAME_STATS_WINDOW));
+	json = text;
+	AppendPercentiles(json, "submit_ms", GetSubmitPercentiles());
+	json += ", ";
+	AppendPercentiles(json, "swap_ms", GetSwapPercentiles());
+	json += ", ";
+	AppendPercentiles(json, "frame_ms", GetFramePercentiles());
+	json += "}";
+	return json;
+}
+
+std::string LoadStatsToJSON(const OBJLoadStats &stats)
+{
+	static const char* sources[] = {"parse", "stream", "cache", "packed", "patch"};
+	static const char* errors[] = {"ok", "open_failed", "empty", "out_of_memory", "bad_index",
+		"bad_packed_file", "cancelled", "changed_layout"};
+	const OBJLoadTimes &times = stats.times;
+	const OBJLineCounts &lines = stats.lines;
+	char text[1024];
+
+	snprintf(text, sizeof(text), "{\"source\": \"%s\", \"error\": \"%s\", \"bad_triangle\": %ld, "
+		"\"bytes_read\": %llu, \"peak_bytes\": %llu, \"lines\": {\"vertices\": %lld, \"texels\": %lld, "
+		"\"normals\": %lld, \"faces\": %lld, \"other\": %lld}, \"phases_ms\": {\"count\": %.3f, \"parse\": %.3f, "
+		"\"validate\": %.3f, \"triangulate\": %.3f, \"scale\": %.3f, \"unify\": %.3f, \"normals\": %.3f, "
+		"\"materials\": %.3f, \"optimize\": %.3f, \"levels\": %.3f, \"meshlets\": %.3f}, \"total_ms\": %.3f, \"mb_per_s\": %.2f}",
+		sources[stats.source], errors[stats.error], stats.badTriangle, stats.bytesRead,
+		(unsigned long long) stats.peakBytes, lines.vertices, lines.texels, lines.normals, lines.faces, lines.other,
+		times.count, times.parse, times.validate, times.triangulate, times.scale, times.unify, times.normals,
+		times.materials, times.optimize, times.levels, times.meshlets, times.total,
+		times.total > 0.0 ? stats.bytesRead / times.total / 1e3 : 0.0);
+	return text;
+}
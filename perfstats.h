@@ -0,0 +1,64 @@
+/*
+Frame time window of the viewer and JSON reports of the load and frame statistics
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef PERFSTATS_H
+#define PERFSTATS_H
+
+#include <string>
+
+#include "wavefrontloader.h"
+
+//frames FrameStats keeps, several seconds at the usual refresh rates
+static const int FRAME_STATS_WINDOW = 512;
+
+//of the frames in the window, in milliseconds
+struct FramePercentiles
+{
+	double p50;
+	double p90;
+	double p99;
+	double max;
+};
+
+//rolling window of frame times, adding a frame is two stores so it can stay
+//on all the time, the window is only sorted when percentiles are asked for
+class FrameStats
+{
+  private:
+	float mSubmit[FRAME_STATS_WINDOW];	// Issuing the GL calls of the frame
+	float mSwap[FRAME_STATS_WINDOW];	// Waiting in the buffer swap
+	long long mFrameCount;	// Every frame added, the window holds the last ones
+
+ public:
+	FrameStats();
+
+	inline void Add(double submitMs, double swapMs)
+	{
+		int slot = (int)(mFrameCount % FRAME_STATS_WINDOW);
+		mSubmit[slot] = (float) submitMs;
+		mSwap[slot] = (float) swapMs;
+		++mFrameCount;
+	}
+	void Reset();
+
+	inline long long GetFrameCount(){return mFrameCount;};
+	FramePercentiles GetSubmitPercentiles();
+	FramePercentiles GetSwapPercentiles();
+	FramePercentiles GetFramePercentiles();	// Submit and swap of each frame added up
+
+	std::string ToJSON();
+};
+
+//one JSON object each, without a trailing newline
+std::string LoadStatsToJSON(const OBJLoadStats &stats);
+
+#endif
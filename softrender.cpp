@@ -0,0 +1,947 @@
+/*
+Software rasterizer that draws a model the way the viewer's Display does,
+for machines without a GPU or a display
+
+Every vertex is transformed and lit once with the fixed pipeline state
+InitGL sets up. The triangles are then clipped, snapped to 1/16 pixel and
+binned into 64x64 tiles in parallel batches, and the tiles are rasterized in
+parallel, so each tile is drawn by one thread in submission order and the
+image does not depend on the number of threads. Edge functions are
+evaluated four pixels at a time, and each 8x8 block keeps its farthest
+depth so triangles behind everything in a block skip it.
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SOFTRENDER_SSE2
+#endif
+
+#include "parallel.h"
+#include "softrender.h"
+
+static const int SOFT_TILE = 64;
+static const int SOFT_BLOCK = 8;
+static const float SOFT_SUBPIXELS = 16.0f;
+static const int SOFT_MAX_SIZE = 16384;
+
+//triangles set up per task, and per batch so the setup records stay small
+static const long SOFT_SETUP_CHUNK = 1 << 14;
+static const long SOFT_BATCH = 1 << 19;
+
+//the lighting InitGL sets up: global ambient and one white directional
+//light shining along the view direction, the material follows glColor
+static const float SOFT_AMBIENT = 0.1f;
+static const float SOFT_DIFFUSE = 0.6f;
+
+//the glClearColor of InitGL
+static const unsigned int SOFT_CLEAR_COLOR = 0xFF80FF00u;
+
+//DrawAxis draws its lines five units long and five pixels wide
+static const float SOFT_AXIS_LENGTH = 5.0f;
+static const int SOFT_AXIS_WIDTH = 5;
+
+SoftRenderSettings::SoftRenderSettings()
+{
+	width = 640;
+	height = 480;
+	fovAngle = 45.0f;
+	zNear = 1.0f;
+	zFar = 500.0f;
+	rotX = rotY = 0;
+	bWireframe = false;
+	bDrawAxis = true;
+	threads = 0;
+}
+
+//4x4 matrices are column major as in OpenGL, out = a*b
+static void MultiplyMatrix(const float* a, const float* b, float* out)
+{
+	float result[16];
+
+	for (int c = 0; c < 4; ++c)
+	{
+		for (int r = 0; r < 4; ++r)
+			result[4*c + r] = a[r]*b[4*c] + a[4 + r]*b[4*c + 1] + a[8 + r]*b[4*c + 2] + a[12 + r]*b[4*c + 3];
+	}
+	memcpy(out, result, sizeof(result));
+}
+
+static void IdentityMatrix(float* m)
+{
+	memset(m, 0, 16*sizeof(float));
+	m[0] = m[5] = m[10] = m[15] = 1.0f;
+}
+
+//gluPerspective
+static void PerspectiveMatrix(float fovAngle, float aspect, float zNear, float zFar, float* m)
+{
+	float f = 1.0f / tanf(fovAngle*0.5f*3.14159265f/180.0f);
+
+	memset(m, 0, 16*sizeof(float));
+	m[0] = f / aspect;
+	m[5] = f;
+	m[10] = (zFar + zNear) / (zNear - zFar);
+	m[11] = -1.0f;
+	m[14] = 2.0f*zFar*zNear / (zNear - zFar);
+}
+
+//gluLookAt towards the origin with y up
+static void LookAtMatrix(const float* eye, float* m)
+{
+	float f[3] = {-eye[0], -eye[1], -eye[2]}, s[3], u[3], length;
+
+	length = sqrtf(f[0]*f[0] + f[1]*f[1] + f[2]*f[2]);
+	for (int i = 0; i < 3; ++i)
+		f[i] /= length;
+	s[0] = -f[2];	// f x (0, 1, 0)
+	s[1] = 0.0f;
+	s[2] = f[0];
+	length = sqrtf(s[0]*s[0] + s[2]*s[2]);
+	s[0] /= length;
+	s[2] /= length;
+	u[0] = s[1]*f[2] - s[2]*f[1];
+	u[1] = s[2]*f[0] - s[0]*f[2];
+	u[2] = s[0]*f[1] - s[1]*f[0];
+
+	IdentityMatrix(m);
+	for (int i = 0; i < 3; ++i)
+	{
+		m[4*i] = s[i];
+		m[4*i + 1] = u[i];
+		m[4*i + 2] = -f[i];
+	}
+	for (int r = 0; r < 3; ++r)
+		m[12 + r] = -(m[r]*eye[0] + m[4 + r]*eye[1] + m[8 + r]*eye[2]);
+}
+
+//glRotatef about one of the axes
+static void RotationMatrix(float angle, int axis, float* m)
+{
+	float c = cosf(angle*3.14159265f/180.0f), s = sinf(angle*3.14159265f/180.0f);
+	int a = (axis + 1) % 3, b = (axis + 2) % 3;
+
+	IdentityMatrix(m);
+	m[5*a] = c;
+	m[5*b] = c;
+	m[4*a + b] = s;
+	m[4*b + a] = -s;
+}
+
+static inline void TransformPoint(const float* m, const float* p, float* out)
+{
+	for (int r = 0; r < 4; ++r)
+		out[r] = m[r]*p[0] + m[4 + r]*p[1] + m[8 + r]*p[2] + m[12 + r]*p[3];
+}
+
+//fixed pipeline lighting of a white material, the light shines along -z in eye space
+static inline float ShadeNormal(const float* modelview, const float* normal)
+{
+	float z = modelview[2]*normal[0] + modelview[6]*normal[1] + modelview[10]*normal[2];
+	return std::min(1.0f, SOFT_AMBIENT + SOFT_DIFFUSE*std::max(z, 0.0f));
+}
+
+static inline unsigned int PackColor(float r, float g, float b)
+{
+	unsigned int red = (unsigned int)(std::min(std::max(r, 0.0f), 1.0f)*255.0f + 0.5f);
+	unsigned int green = (unsigned int)(std::min(std::max(g, 0.0f), 1.0f)*255.0f + 0.5f);
+	unsigned int blue = (unsigned int)(std::min(std::max(b, 0.0f), 1.0f)*255.0f + 0.5f);
+	return 0xFF000000u | (blue << 16) | (green << 8) | red;
+}
+
+//a corner after clipping, before the perspective divide
+struct ClipVertex
+{
+	float position[4];
+	float shade;
+};
+
+//a corner in the image, shade is divided by w for perspective correct interpolation
+struct ScreenVertex
+{
+	float x, y;
+	float z;		// Window depth
+	float iw;		// 1/w
+	float shade;
+};
+
+struct TriangleSetup
+{
+	float x[3], y[3];	// Snapped image position, row 0 at the top
+	float z[3];
+	float iw[3];
+	float shade[3];
+	float minZ;
+	short minX, minY, maxX, maxY;	// Pixels the triangle may touch
+	unsigned int edges;	// Bit k set when the edge opposite corner k is drawn as a wire
+};
+
+struct LineSetup
+{
+	ScreenVertex ends[2];
+	float color[3];
+	int width;
+};
+
+//what one setup task produced, the triangle indices binned per tile
+struct SetupChunk
+{
+	std::vector<TriangleSetup> triangles;
+	std::vector<std::vector<unsigned int> > bins;
+};
+
+struct RenderTarget
+{
+	unsigned int* color;
+	float* depth;
+	float* blockDepth;
+	int stride;
+	int blocksPerRow;
+};
+
+//clips a convex polygon to one side of a plane through clip space, keeping
+//points where sign*z <= w, returns the number of corners left
+static int ClipPolygon(const ClipVertex* in, int count, float sign, ClipVertex* out)
+{
+	int kept = 0;
+
+	for (int i = 0; i < count; ++i)
+	{
+		const ClipVertex &a = in[i];
+		const ClipVertex &b = in[(i + 1) % count];
+		float da = a.position[3] - sign*a.position[2];
+		float db = b.position[3] - sign*b.position[2];
+
+		if (da >= 0.0f)
+			out[kept++] = a;
+		if ((da >= 0.0f) != (db >= 0.0f))
+		{
+			float t = da / (da - db);
+			ClipVertex &c = out[kept++];
+			for (int k = 0; k < 4; ++k)
+				c.position[k] = a.position[k] + t*(b.position[k] - a.position[k]);
+			c.shade = a.shade + t*(b.shade - a.shade);
+		}
+	}
+	return kept;
+}
+
+static inline float Snap(float v)
+{
+	return floorf(v*SOFT_SUBPIXELS + 0.5f) / SOFT_SUBPIXELS;
+}
+
+static inline void ProjectVertex(const ClipVertex &in, int width, int height, ScreenVertex &out)
+{
+	float iw = 1.0f / in.position[3];
+
+	out.x = Snap((in.position[0]*iw + 1.0f)*0.5f*width);
+	out.y = Snap((1.0f - in.position[1]*iw)*0.5f*height);
+	out.z = in.position[2]*iw*0.5f + 0.5f;
+	out.iw = iw;
+	out.shade = in.shade*iw;
+}
+
+//adds a clipped triangle to the chunk and its tiles, unless it covers no pixel
+static void EmitTriangle(const ClipVertex* corners, unsigned int edges, int width, int height, int tilesX,
+	bool bWireframe, SetupChunk &chunk)
+{
+	TriangleSetup setup;
+	ScreenVertex v[3];
+	float minX, minY, maxX, maxY;
+
+	for (int k = 0; k < 3; ++k)
+	{
+		ProjectVertex(corners[k], width, height, v[k]);
+		setup.x[k] = v[k].x;
+		setup.y[k] = v[k].y;
+		setup.z[k] = v[k].z;
+		setup.iw[k] = v[k].iw;
+		setup.shade[k] = v[k].shade;
+	}
+
+	if ((setup.x[1] - setup.x[0])*(setup.y[2] - setup.y[0]) == (setup.x[2] - setup.x[0])*(setup.y[1] - setup.y[0]))
+		return;
+
+	minX = std::min(setup.x[0], std::min(setup.x[1], setup.x[2]));
+	maxX = std::max(setup.x[0], std::max(setup.x[1], setup.x[2]));
+	minY = std::min(setup.y[0], std::min(setup.y[1], setup.y[2]));
+	maxY = std::max(setup.y[0], std::max(setup.y[1], setup.y[2]));
+
+	//a filled triangle covers pixel centres, wires touch every pixel they cross
+	float bias = bWireframe ? 0.0f : 0.5f;
+	minX = std::max(ceilf(minX - bias), 0.0f);
+	minY = std::max(ceilf(minY - bias), 0.0f);
+	maxX = std::min(floorf(maxX - bias), (float)(width - 1));
+	maxY = std::min(floorf(maxY - bias), (float)(height - 1));
+	if (bWireframe)
+	{
+		minX = std::max(floorf(std::min(setup.x[0], std::min(setup.x[1], setup.x[2]))), 0.0f);
+		minY = std::max(floorf(std::min(setup.y[0], std::min(setup.y[1], setup.y[2]))), 0.0f);
+	}
+	if (!(minX <= maxX && minY <= maxY))
+		return;
+
+	setup.minX = (short) minX;
+	setup.minY = (short) minY;
+	setup.maxX = (short) maxX;
+	setup.maxY = (short) maxY;
+	setup.minZ = std::min(setup.z[0], std::min(setup.z[1], setup.z[2]));
+	setup.edges = edges;
+
+	unsigned int index = (unsigned int) chunk.triangles.size();
+	chunk.triangles.push_back(setup);
+	for (int ty = setup.minY / SOFT_TILE; ty <= setup.maxY / SOFT_TILE; ++ty)
+	{
+		for (int tx = setup.minX / SOFT_TILE; tx <= setup.maxX / SOFT_TILE; ++tx)
+			chunk.bins[ty*tilesX + tx].push_back(index);
+	}
+}
+
+//an edge function in the form both triangles on the edge share, so they
+//evaluate it to exactly opposite values and no pixel is drawn twice or missed
+struct Edge
+{
+	float ox, oy;	// Start, the lower of the two corners
+	float dx, dy;
+	float sign;		// Makes the value positive inside
+	bool bOwner;	// Pixel centres exactly on the edge belong to this triangle
+};
+
+static inline float EdgeValue(const Edge &edge, float px, float py)
+{
+	return ((px - edge.ox)*edge.dy - (py - edge.oy)*edge.dx)*edge.sign;
+}
+
+//edge k runs between the two corners other than k, returns 1/twice the area
+static float SetupEdges(const TriangleSetup &triangle, Edge* edges)
+{
+	float area = (triangle.x[1] - triangle.x[0])*(triangle.y[2] - triangle.y[0]) -
+		(triangle.x[2] - triangle.x[0])*(triangle.y[1] - triangle.y[0]);
+	float orientation = area > 0.0f ? -1.0f : 1.0f;
+
+	for (int k = 0; k < 3; ++k)
+	{
+		int a = (k + 1) % 3, b = (k + 2) % 3;
+		bool bFromA = triangle.y[a] < triangle.y[b] || (triangle.y[a] == triangle.y[b] && triangle.x[a] < triangle.x[b]);
+		int start = bFromA ? a : b, end = bFromA ? b : a;
+		Edge &edge = edges[k];
+
+		edge.ox = triangle.x[start];
+		edge.oy = triangle.y[start];
+		edge.dx = triangle.x[end] - edge.ox;
+		edge.dy = triangle.y[end] - edge.oy;
+		edge.sign = bFromA ? orientation : -orientation;
+
+		//top-left rule, the gradient points inside
+		float gx = edge.sign*edge.dy, gy = -edge.sign*edge.dx;
+		edge.bOwner = gx > 0.0f || (gx == 0.0f && gy > 0.0f);
+	}
+	return 1.0f / fabsf(area);
+}
+
+static inline bool Inside(float value, bool bOwner)
+{
+	return value > 0.0f || (value == 0.0f && bOwner);
+}
+
+//whether any pixel centre of the block can be inside every edge, tested at
+//the corner each edge is largest at with a little slack for rounding
+static bool BlockTouches(const Edge* edges, int bx, int by)
+{
+	for (int k = 0; k < 3; ++k)
+	{
+		float gx = edges[k].sign*edges[k].dy, gy = -edges[k].sign*edges[k].dx;
+		float px = bx + (gx > 0.0f ? SOFT_BLOCK - 0.5f : 0.5f);
+		float py = by + (gy > 0.0f ? SOFT_BLOCK - 0.5f : 0.5f);
+		if (EdgeValue(edges[k], px, py) < -0.01f*(fabsf(gx) + fabsf(gy)))
+			return false;
+	}
+	return true;
+}
+
+static void UpdateBlockDepth(RenderTarget &target, int bx, int by)
+{
+	float farthest = 0.0f;
+
+	for (int y = by; y < by + SOFT_BLOCK; ++y)
+	{
+		const float* row = target.depth + (size_t) y*target.stride + bx;
+		for (int x = 0; x < SOFT_BLOCK; ++x)
+			farthest = std::max(farthest, row[x]);
+	}
+	target.blockDepth[(by / SOFT_BLOCK)*target.blocksPerRow + bx / SOFT_BLOCK] = farthest;
+}
+
+//fills the triangle's pixels in [x0, x1] x [y0, y1], which lies in one tile
+static void FillTriangle(const TriangleSetup &triangle, int x0, int y0, int x1, int y1, RenderTarget &target)
+{
+	Edge edges[3];
+	float inverseArea = SetupEdges(triangle, edges);
+
+#ifdef SOFTRENDER_SSE2
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+	__m128 ox[3], oy[3], dx[3], dy[3], sign[3], owner[3];
+
+	for (int k = 0; k < 3; ++k)
+	{
+		ox[k] = _mm_set1_ps(edges[k].ox);
+		oy[k] = _mm_set1_ps(edges[k].oy);
+		dx[k] = _mm_set1_ps(edges[k].dx);
+		dy[k] = _mm_set1_ps(edges[k].dy);
+		sign[k] = _mm_set1_ps(edges[k].sign);
+		owner[k] = _mm_castsi128_ps(_mm_set1_epi32(edges[k].bOwner ? -1 : 0));
+	}
+#endif
+
+	for (int by = y0 & ~(SOFT_BLOCK - 1); by <= y1; by += SOFT_BLOCK)
+	{
+		for (int bx = x0 & ~(SOFT_BLOCK - 1); bx <= x1; bx += SOFT_BLOCK)
+		{
+			float blockDepth = target.blockDepth[(by / SOFT_BLOCK)*target.blocksPerRow + bx / SOFT_BLOCK];
+			bool bWritten = false;
+
+			//hidden behind everything drawn in the block, or missing it
+			if (triangle.minZ > blockDepth || !BlockTouches(edges, bx, by))
+				continue;
+
+			int rowFirst = std::max(by, y0), rowLast = std::min(by + SOFT_BLOCK - 1, y1);
+			int columnFirst = std::max(bx, x0), columnLast = std::min(bx + SOFT_BLOCK - 1, x1);
+
+			for (int y = rowFirst; y <= rowLast; ++y)
+			{
+				float py = y + 0.5f;
+#ifdef SOFTRENDER_SSE2
+				__m128 pyv = _mm_set1_ps(py);
+				__m128 first = _mm_set1_ps((float) columnFirst), last = _mm_set1_ps((float) columnLast + 1.0f);
+
+				for (int x = bx; x < bx + SOFT_BLOCK; x += 4)
+				{
+					__m128 px = _mm_add_ps(_mm_set1_ps((float) x), offsets);
+					__m128 mask = _mm_and_ps(_mm_cmpgt_ps(px, first), _mm_cmplt_ps(px, last));
+					__m128 value[3];
+
+					for (int k = 0; k < 3; ++k)
+					{
+						value[k] = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(_mm_sub_ps(px, ox[k]), dy[k]),
+							_mm_mul_ps(_mm_sub_ps(pyv, oy[k]), dx[k])), sign[k]);
+						mask = _mm_and_ps(mask, _mm_or_ps(_mm_cmpgt_ps(value[k], zero),
+							_mm_and_ps(_mm_cmpeq_ps(value[k], zero), owner[k])));
+					}
+					if (_mm_movemask_ps(mask) == 0)
+						continue;
+
+					__m128 l0 = _mm_mul_ps(value[0], _mm_set1_ps(inverseArea));
+					__m128 l1 = _mm_mul_ps(value[1], _mm_set1_ps(inverseArea));
+					__m128 l2 = _mm_mul_ps(value[2], _mm_set1_ps(inverseArea));
+					__m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(l0, _mm_set1_ps(triangle.z[0])),
+						_mm_mul_ps(l1, _mm_set1_ps(triangle.z[1]))), _mm_mul_ps(l2, _mm_set1_ps(triangle.z[2])));
+					float* depth = target.depth + (size_t) y*target.stride + x;
+					__m128 stored = _mm_loadu_ps(depth);
+
+					mask = _mm_and_ps(mask, _mm_cmple_ps(z, stored));
+					if (_mm_movemask_ps(mask) == 0)
+						continue;
+
+					__m128 q = _mm_add_ps(_mm_add_ps(_mm_mul_ps(l0, _mm_set1_ps(triangle.iw[0])),
+						_mm_mul_ps(l1, _mm_set1_ps(triangle.iw[1]))), _mm_mul_ps(l2, _mm_set1_ps(triangle.iw[2])));
+					__m128 shade = _mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(l0, _mm_set1_ps(triangle.shade[0])),
+						_mm_mul_ps(l1, _mm_set1_ps(triangle.shade[1]))), _mm_mul_ps(l2, _mm_set1_ps(triangle.shade[2]))), q);
+					shade = _mm_min_ps(_mm_max_ps(shade, zero), _mm_set1_ps(1.0f));
+					__m128i gray = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(shade, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+					gray = _mm_or_si128(_mm_or_si128(gray, _mm_slli_epi32(gray, 8)),
+						_mm_or_si128(_mm_slli_epi32(gray, 16), _mm_set1_epi32((int) 0xFF000000u)));
+
+					unsigned int* color = target.color + (size_t) y*target.stride + x;
+					__m128i maskInt = _mm_castps_si128(mask);
+					_mm_storeu_ps(depth, _mm_or_ps(_mm_and_ps(mask, z), _mm_andnot_ps(mask, stored)));
+					_mm_storeu_si128((__m128i*) color, _mm_or_si128(_mm_and_si128(maskInt, gray),
+						_mm_andnot_si128(maskInt, _mm_loadu_si128((const __m128i*) color))));
+					bWritten = true;
+				}
+#else
+				for (int x = columnFirst; x <= columnLast; ++x)
+				{
+					float px = x + 0.5f, value[3];
+					bool bInside = true;
+
+					for (int k = 0; k < 3 && bInside; ++k)
+					{
+						value[k] = EdgeValue(edges[k], px, py);
+						bInside = Inside(value[k], edges[k].bOwner);
+					}
+					if (!bInside)
+						continue;
+
+					float l0 = value[0]*inverseArea, l1 = value[1]*inverseArea, l2 = value[2]*inverseArea;
+					float z = l0*triangle.z[0] + l1*triangle.z[1] + l2*triangle.z[2];
+					size_t i = (size_t) y*target.stride + x;
+					if (z > target.depth[i])
+						continue;
+
+					float q = l0*triangle.iw[0] + l1*triangle.iw[1] + l2*triangle.iw[2];
+					float shade = (l0*triangle.shade[0] + l1*triangle.shade[1] + l2*triangle.shade[2]) / q;
+					target.depth[i] = z;
+					target.color[i] = PackColor(shade, shade, shade);
+					bWritten = true;
+				}
+#endif
+			}
+
+			if (bWritten)
+				UpdateBlockDepth(target, bx, by);
+		}
+	}
+}
+
+//a line of the given width stepping along its longer axis, drawing only the
+//pixels in [x0, x1] x [y0, y1], the block depths stay as they are since a
+//line only brings pixels nearer
+static void DrawLine(ScreenVertex a, ScreenVertex b, const float* color, int width,
+	int x0, int y0, int x1, int y1, RenderTarget &target)
+{
+	float dx = b.x - a.x, dy = b.y - a.y;
+	bool bXMajor = fabsf(dx) >= fabsf(dy);
+
+	if (dx == 0.0f && dy == 0.0f)
+		return;
+	if (bXMajor ? a.x > b.x : a.y > b.y)
+	{
+		std::swap(a, b);
+		dx = -dx;
+		dy = -dy;
+	}
+
+	float start = bXMajor ? a.x : a.y, length = bXMajor ? dx : dy;
+	int first = (int) ceilf(start - 0.5f), last = (int) ceilf(start + length - 0.5f) - 1;
+	first = std::max(first, bXMajor ? x0 : y0);
+	last = std::min(last, bXMajor ? x1 : y1);
+
+	for (int i = first; i <= last; ++i)
+	{
+		float t = (i + 0.5f - start) / length;
+		float minor = bXMajor ? a.y + t*dy : a.x + t*dx;
+		float z = a.z + t*(b.z - a.z);
+		float shade = (a.shade + t*(b.shade - a.shade)) / (a.iw + t*(b.iw - a.iw));
+		unsigned int packed = PackColor(color[0]*shade, color[1]*shade, color[2]*shade);
+		int m0 = (int) floorf(minor) - (width - 1)/2;
+
+		for (int m = m0; m < m0 + width; ++m)
+		{
+			int x = bXMajor ? i : m, y = bXMajor ? m : i;
+			if (x < x0 || x > x1 || y < y0 || y > y1)
+				continue;
+
+			size_t p = (size_t) y*target.stride + x;
+			if (z <= target.depth[p])
+			{
+				target.depth[p] = z;
+				target.color[p] = packed;
+			}
+		}
+	}
+}
+
+//clips a line to the near and far planes and projects it, returns false when nothing is left
+static bool SetupLine(const float* modelviewProjection, const float* from, const float* to, float shade,
+	const float* color, int lineWidth, int width, int height, LineSetup &line)
+{
+	ClipVertex ends[2];
+	float t0 = 0.0f, t1 = 1.0f;
+
+	TransformPoint(modelviewProjection, from, ends[0].position);
+	TransformPoint(modelviewProjection, to, ends[1].position);
+	for (int plane = 0; plane < 2; ++plane)
+	{
+		float sign = plane == 0 ? -1.0f : 1.0f;
+		float da = ends[0].position[3] - sign*ends[0].position[2];
+		float db = ends[1].position[3] - sign*ends[1].position[2];
+
+		if (da < 0.0f && db < 0.0f)
+			return false;
+		if (da < 0.0f)
+			t0 = std::max(t0, da / (da - db));
+		else if (db < 0.0f)
+			t1 = std::min(t1, da / (da - db));
+	}
+	if (t0 > t1)
+		return false;
+
+	for (int e = 0; e < 2; ++e)
+	{
+		ClipVertex v;
+		float t = e == 0 ? t0 : t1;
+		for (int k = 0; k < 4; ++k)
+			v.position[k] = ends[0].position[k] + t*(ends[1].position[k] - ends[0].position[k]);
+		v.shade = shade;
+		ProjectVertex(v, width, height, line.ends[e]);
+	}
+	memcpy(line.color, color, sizeof(line.color));
+	line.width = lineWidth;
+	return true;
+}
+
+//the lines of DrawAxis, with its letters at the ends of x and z
+static void SetupAxis(const float* modelview, const float* modelviewProjection, int width, int height,
+	std::vector<LineSetup> &lines)
+{
+	const float L = SOFT_AXIS_LENGTH;
+	const float segments[][6] =
+	{
+		{0.0f, 0.0f, 0.0f, L, 0.0f, 0.0f},
+		{L - 0.2f, -0.2f, 0.0f, L + 0.2f, 0.2f, 0.0f},
+		{L - 0.2f, 0.2f, 0.0f, L + 0.2f, -0.2f, 0.0f},
+		{0.0f, 0.0f, 0.0f, 0.0f, L, 0.0f},
+		{0.0f, 0.0f, 0.0f, 0.0f, 0.0f, L},
+		{0.0f, -0.2f, L + 0.2f, 0.0f, 0.2f, L - 0.2f},
+		{0.0f, -0.2f, L - 0.2f, 0.0f, -0.2f, L + 0.2f},
+		{0.0f, 0.2f, L - 0.2f, 0.0f, 0.2f, L + 0.2f}
+	};
+	const float colors[][3] = {{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}};
+	const int axisOf[] = {0, 0, 0, 1, 2, 2, 2, 2};
+
+	//the lines are lit with the current normal, which is still (0, 0, 1)
+	const float normal[3] = {0.0f, 0.0f, 1.0f};
+	float shade = ShadeNormal(modelview, normal);
+
+	for (size_t i = 0; i < sizeof(segments)/sizeof(segments[0]); ++i)
+	{
+		float from[4] = {segments[i][0], segments[i][1], segments[i][2], 1.0f};
+		float to[4] = {segments[i][3], segments[i][4], segments[i][5], 1.0f};
+		LineSetup line;
+		if (SetupLine(modelviewProjection, from, to, shade, colors[axisOf[i]], SOFT_AXIS_WIDTH, width, height, line))
+			lines.push_back(line);
+	}
+}
+
+SoftRenderer::SoftRenderer()
+{
+	mWidth = mHeight = mStride = mRows = 0;
+	memset(&mStats, 0, sizeof(mStats));
+}
+
+int SoftRenderer::Render(OBJClass &objmodel, const SoftRenderSettings &settings)
+{
+	auto start = std::chrono::steady_clock::now();
+	int threads = ResolveThreadCount(settings.threads);
+	float projection[16], view[16], rotation[16], modelview[16], modelviewProjection[16];
+	float axisModelview[16], axisModelviewProjection[16];
+	std::vector<LineSetup> axisLines;
+	std::vector<SetupChunk> chunks;
+	std::vector<ClipVertex> vertices;
+
+	if (settings.width <= 0 || settings.height <= 0 || settings.width > SOFT_MAX_SIZE || settings.height > SOFT_MAX_SIZE)
+		return -1;
+
+	memset(&mStats, 0, sizeof(mStats));
+	mWidth = settings.width;
+	mHeight = settings.height;
+	mStride = (mWidth + SOFT_TILE - 1) / SOFT_TILE * SOFT_TILE;
+	mRows = (mHeight + SOFT_TILE - 1) / SOFT_TILE * SOFT_TILE;
+	mColor.assign((size_t) mStride*mRows, SOFT_CLEAR_COLOR);
+	mDepth.assign((size_t) mStride*mRows, 1.0f);
+	mBlockDepth.assign((size_t)(mStride / SOFT_BLOCK)*(mRows / SOFT_BLOCK), 1.0f);
+
+	int tilesX = mStride / SOFT_TILE, tilesY = mRows / SOFT_TILE;
+	RenderTarget target = {mColor.data(), mDepth.data(), mBlockDepth.data(), mStride, mStride / SOFT_BLOCK};
+
+	//the matrices of InitGL, Display, MoveCamera and DrawModel, with the camera
+	//backed off as in Display until the bounding sphere fits the view
+	float distance = 1.0f;
+	if (objmodel.GetRadius() > 0.0f)
+		distance = 1.1f*objmodel.GetRadius()/objmodel.GetScale() / sinf(settings.fovAngle*0.5f*3.14159265f/180.0f) /
+			sqrtf(10*10 + 3*3 + 10*10);
+	float eye[3] = {10*distance, 3*distance, 10*distance};
+
+	PerspectiveMatrix(settings.fovAngle, (float) mWidth / mHeight, settings.zNear, settings.zFar, projection);
+	LookAtMatrix(eye, view);
+	RotationMatrix((float) settings.rotX, 0, rotation);
+	MultiplyMatrix(view, rotation, axisModelview);
+	RotationMatrix((float) settings.rotY, 1, rotation);
+	MultiplyMatrix(axisModelview, rotation, axisModelview);
+	MultiplyMatrix(projection, axisModelview, axisModelviewProjection);
+
+	IdentityMatrix(modelview);
+	if (objmodel.GetScale() != 0.0f)
+	{
+		modelview[12] = -objmodel.GetCenter()[0]/objmodel.GetScale();
+		modelview[13] = -objmodel.GetCenter()[1]/objmodel.GetScale();
+		modelview[14] = -objmodel.GetCenter()[2]/objmodel.GetScale();
+	}
+	MultiplyMatrix(axisModelview, modelview, modelview);
+	MultiplyMatrix(projection, modelview, modelviewProjection);
+
+	if (settings.bDrawAxis)
+		SetupAxis(axisModelview, axisModelviewProjection, mWidth, mHeight, axisLines);
+
+	const float* positions = objmodel.GetVertexBuffer();
+	const float* normals = objmodel.HasNormals() ? objmodel.GetNormalBuffer() : NULL;
+	const long* indices = objmodel.GetLevelCount() > 0 ? objmodel.GetLevel(0).indices : objmodel.GetIndexBufferV();
+	long triangleCount = objmodel.GetLevelCount() > 0 ? objmodel.GetLevel(0).triangleCount : 0;
+	long vertexCount = objmodel.GetVertexCount();
+	if (positions == NULL || indices == NULL)
+		triangleCount = vertexCount = 0;
+
+	//every vertex once, without normals the current normal lights them all alike
+	vertices.resize(vertexCount);
+	ParallelFor((vertexCount + SOFT_SETUP_CHUNK - 1) / SOFT_SETUP_CHUNK, threads, [&](long block)
+	{
+		const float front[3] = {0.0f, 0.0f, 1.0f};
+		long last = std::min(vertexCount, (block + 1)*SOFT_SETUP_CHUNK);
+
+		for (long v = block*SOFT_SETUP_CHUNK; v < last; ++v)
+		{
+			TransformPoint(modelviewProjection, positions + 4*v, vertices[v].position);
+			vertices[v].shade = ShadeNormal(modelview, normals != NULL ? normals + 3*v : front);
+		}
+	});
+
+	mStats.triangles = triangleCount;
+	mStats.setupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	for (long batch = 0; batch < triangleCount || batch == 0; batch += SOFT_BATCH)
+	{
+		long batchEnd = std::min(triangleCount, batch + SOFT_BATCH);
+		long chunkCount = (batchEnd - batch + SOFT_SETUP_CHUNK - 1) / SOFT_SETUP_CHUNK;
+		auto setupStart = std::chrono::steady_clock::now();
+
+		if ((long) chunks.size() < chunkCount)
+			chunks.resize(chunkCount);
+		ParallelFor(chunkCount, threads, [&](long c)
+		{
+			SetupChunk &chunk = chunks[c];
+			long first = batch + c*SOFT_SETUP_CHUNK, last = std::min(batchEnd, first + SOFT_SETUP_CHUNK);
+
+			chunk.triangles.clear();
+			chunk.bins.resize(tilesX*tilesY);
+			for (size_t tile = 0; tile < chunk.bins.size(); ++tile)
+				chunk.bins[tile].clear();
+
+			for (long t = first; t < last; ++t)
+			{
+				ClipVertex corners[3], clipped[5], scratch[5];
+				int outsideNear = 0, outsideFar = 0;
+
+				for (int k = 0; k < 3; ++k)
+				{
+					corners[k] = vertices[indices[3*t + k]];
+					outsideNear += corners[k].position[2] < -corners[k].position[3];
+					outsideFar += corners[k].position[2] > corners[k].position[3];
+				}
+				if (outsideNear == 3 || outsideFar == 3)
+					continue;
+				if (outsideNear == 0 && outsideFar == 0)
+				{
+					EmitTriangle(corners, 7, mWidth, mHeight, tilesX, settings.bWireframe, chunk);
+					continue;
+				}
+
+				//a fan over the clipped polygon, only its outline is drawn as wires
+				int count = ClipPolygon(corners, 3, -1.0f, scratch);
+				count = ClipPolygon(scratch, count, 1.0f, clipped);
+				for (int i = 1; i + 1 < count; ++i)
+				{
+					ClipVertex fan[3] = {clipped[0], clipped[i], clipped[i + 1]};
+					unsigned int edges = 1 | (i + 2 == count ? 2 : 0) | (i == 1 ? 4 : 0);
+					EmitTriangle(fan, edges, mWidth, mHeight, tilesX, settings.bWireframe, chunk);
+				}
+			}
+		});
+		for (long c = 0; c < chunkCount; ++c)
+			mStats.rasterized += (long) chunks[c].triangles.size();
+
+		auto rasterStart = std::chrono::steady_clock::now();
+		mStats.setupMs += std::chrono::duration<double, std::milli>(rasterStart - setupStart).count();
+
+		//tiles hand themselves out one at a time, each draws its bins in submission order
+		ParallelFor(tilesX*tilesY, threads, [&](long tile)
+		{
+			int x0 = (int)(tile % tilesX)*SOFT_TILE, y0 = (int)(tile / tilesX)*SOFT_TILE;
+			int x1 = std::min(x0 + SOFT_TILE, mWidth) - 1, y1 = std::min(y0 + SOFT_TILE, mHeight) - 1;
+			const float white[3] = {1.0f, 1.0f, 1.0f};
+
+			if (x0 > x1 || y0 > y1)
+				return;
+
+			if (batch == 0)
+			{
+				for (size_t i = 0; i < axisLines.size(); ++i)
+					DrawLine(axisLines[i].ends[0], axisLines[i].ends[1], axisLines[i].color, axisLines[i].width,
+						x0, y0, x1, y1, target);
+			}
+
+			for (long c = 0; c < chunkCount; ++c)
+			{
+				const std::vector<unsigned int> &bin = chunks[c].bins[tile];
+				for (size_t i = 0; i < bin.size(); ++i)
+				{
+					const TriangleSetup &triangle = chunks[c].triangles[bin[i]];
+					int left = std::max(x0, (int) triangle.minX), top = std::max(y0, (int) triangle.minY);
+					int right = std::min(x1, (int) triangle.maxX), bottom = std::min(y1, (int) triangle.maxY);
+
+					if (!settings.bWireframe)
+					{
+						FillTriangle(triangle, left, top, right, bottom, target);
+						continue;
+					}
+					for (int k = 0; k < 3; ++k)
+					{
+						int a = (k + 1) % 3, b = (k + 2) % 3;
+						ScreenVertex ends[2] =
+						{
+							{triangle.x[a], triangle.y[a], triangle.z[a], triangle.iw[a], triangle.shade[a]},
+							{triangle.x[b], triangle.y[b], triangle.z[b], triangle.iw[b], triangle.shade[b]}
+						};
+						if (triangle.edges & (1u << k))
+							DrawLine(ends[0], ends[1], white, 1, x0, y0, x1, y1, target);
+					}
+				}
+			}
+		});
+		mStats.rasterMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - rasterStart).count();
+	}
+	return 0;
+}
+
+int SoftRenderer::WritePPM(const char* fileName)
+{
+	FILE* file = fopen(fileName, "wb");
+	std::vector<unsigned char> row(3*(size_t) mWidth);
+	bool bFailed = file == NULL;
+
+	if (!bFailed)
+		bFailed = fprintf(file, "P6\n%d %d\n255\n", mWidth, mHeight) < 0;
+	for (int y = 0; y < mHeight && !bFailed; ++y)
+	{
+		for (int x = 0; x < mWidth; ++x)
+		{
+			unsigned int pixel = mColor[(size_t) y*mStride + x];
+			row[3*x] = (unsigned char)(pixel & 0xFF);
+			row[3*x + 1] = (unsigned char)((pixel >> 8) & 0xFF);
+			row[3*x + 2] = (unsigned char)((pixel >> 16) & 0xFF);
+		}
+		bFailed = fwrite(row.data(), 1, row.size(), file) != row.size();
+	}
+	if (file != NULL && fclose(file) != 0)
+		bFailed = true;
+	return bFailed ? -1 : 0;
+}
+
+static unsigned int Crc32(const unsigned char* data, size_t size, unsigned int crc)
+{
+	static unsigned int table[256];
+	static bool bTableReady = false;
+
+	if (!bTableReady)
+	{
+		for (unsigned int n = 0; n < 256; ++n)
+		{
+			unsigned int c = n;
+			for (int k = 0; k < 8; ++k)
+				c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			table[n] = c;
+		}
+		bTableReady = true;
+	}
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; ++i)
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+static void PutBigEndian(std::vector<unsigned char> &out, unsigned int value)
+{
+	out.push_back((unsigned char)(value >> 24));
+	out.push_back((unsigned char)(value >> 16));
+	out.push_back((unsigned char)(value >> 8));
+	out.push_back((unsigned char) value);
+}
+
+static void PutChunk(std::vector<unsigned char> &out, const char* type, const std::vector<unsigned char> &data)
+{
+	size_t start;
+
+	PutBigEndian(out, (unsigned int) data.size());
+	start = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data.begin(), data.end());
+	PutBigEndian(out, Crc32(&out[start], out.size() - start, 0));
+}
+
+int SoftRenderer::WritePNG(const char* fileName)
+{
+	static const unsigned char signature[8] = {137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+	std::vector<unsigned char> png(signature, signature + 8), header, raw, deflated;
+	unsigned int a = 1, b = 0;
+
+	//8 bit RGB rows, each after a filter type byte of 0
+	PutBigEndian(header, (unsigned int) mWidth);
+	PutBigEndian(header, (unsigned int) mHeight);
+	header.push_back(8);
+	header.push_back(2);
+	header.push_back(0);
+	header.push_back(0);
+	header.push_back(0);
+	PutChunk(png, "IHDR", header);
+
+	raw.reserve((size_t) mHeight*(3*mWidth + 1));
+	for (int y = 0; y < mHeight; ++y)
+	{
+		raw.push_back(0);
+		for (int x = 0; x < mWidth; ++x)
+		{
+			unsigned int pixel = mColor[(size_t) y*mStride + x];
+			raw.push_back((unsigned char)(pixel & 0xFF));
+			raw.push_back((unsigned char)((pixel >> 8) & 0xFF));
+			raw.push_back((unsigned char)((pixel >> 16) & 0xFF));
+		}
+	}
+
+	//a zlib stream of stored blocks, which any reader inflates
+	deflated.reserve(raw.size() + raw.size()/65535*5 + 16);
+	deflated.push_back(0x78);
+	deflated.push_back(0x01);
+	for (size_t offset = 0; offset < raw.size() || offset == 0; offset += 65535)
+	{
+		size_t length = std::min((size_t) 65535, raw.size() - offset);
+		deflated.push_back(offset + length >= raw.size() ? 1 : 0);
+		deflated.push_back((unsigned char)(length & 0xFF));
+		deflated.push_back((unsigned char)(length >> 8));
+		deflated.push_back((unsigned char)(~length & 0xFF));
+		deflated.push_back((unsigned char)((~length >> 8) & 0xFF));
+		deflated.insert(deflated.end(), raw.begin() + offset, raw.begin() + offset + length);
+		if (raw.empty())
+			break;
+	}
+	for (size_t i = 0; i < raw.size(); ++i)
+	{
+		a = (a + raw[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+	PutBigEndian(deflated, (b << 16) | a);
+	PutChunk(png, "IDAT", deflated);
+	PutChunk(png, "IEND", std::vector<unsigned char>());
+
+	FILE* file = fopen(fileName, "wb");
+	if (file == NULL)
+		return -1;
+	bool bFailed = fwrite(png.data(), 1, png.size(), file) != png.size();
+	if (fclose(file) != 0)
+		bFailed = true;
+	return bFailed ? -1 : 0;
+}
@@ -0,0 +1,74 @@
+/*
+Software rasterizer that draws a model the way the viewer's Display does,
+for machines without a GPU or a display
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef SOFTRENDER_H
+#define SOFTRENDER_H
+
+#include <vector>
+
+#include "wavefrontloader.h"
+
+//image and camera, the defaults match the viewer's window
+struct SoftRenderSettings
+{
+	int width;
+	int height;
+	float fovAngle;		// Vertical field of view in degrees
+	float zNear;
+	float zFar;
+	int rotX;			// Camera rotation in degrees, as MoveCamera takes it
+	int rotY;
+	bool bWireframe;
+	bool bDrawAxis;
+	int threads;		// 0 uses every core
+
+	SoftRenderSettings();
+};
+
+struct SoftRenderStats
+{
+	long triangles;		// Submitted
+	long rasterized;	// Left after clipping and dropping those that cover no pixel centre
+	double setupMs;		// Vertex lighting, clipping and binning
+	double rasterMs;
+};
+
+class SoftRenderer
+{
+  private:
+	int mWidth;
+	int mHeight;
+	int mStride;		// Pixels per row, whole tiles
+	int mRows;			// Rows, whole tiles
+	std::vector<unsigned int> mColor;	// RGBA with red in the lowest byte
+	std::vector<float> mDepth;			// Window depth, 1 is the far plane
+	std::vector<float> mBlockDepth;		// Farthest depth of every 8x8 block, for skipping hidden triangles
+	SoftRenderStats mStats;
+
+ public:
+	SoftRenderer();
+
+	//draws the model and the axes into the image, returns 0 or -1
+	int Render(OBJClass &objmodel, const SoftRenderSettings &settings);
+
+	//write the last image as binary PPM or as PNG with uncompressed deflate blocks, return 0 or -1
+	int WritePPM(const char* fileName);
+	int WritePNG(const char* fileName);
+
+	inline int GetWidth(){return mWidth;};
+	inline int GetHeight(){return mHeight;};
+	inline unsigned int GetPixel(int x, int y){return mColor[(size_t) y*mStride + x];};	// Row 0 is the top
+	inline const SoftRenderStats& GetStats(){return mStats;};
+};
+
+#endif
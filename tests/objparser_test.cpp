@@ -0,0 +1,396 @@
+/*
+Tests of the OBJ tokenizer and of the loader on small hand written files
+
+Checks the number parsing of objparser.h against the C library, the SSE2
+token count against a byte at a time count, the fans ParseFace makes of
+faces, and loads files that differ only in line endings, index forms or
+the stream they come from, which must give the same model. Prints every
+failed check and exits with 1 if there was any.
+
+Usage: objparser_test
+Build: make -C tests test, or g++ -O2 -std=c++14 -pthread objparser_test.cpp ../objstream.cpp
+	../wavefrontloader.cpp ../wavefrontcache.cpp ../wavefrontpack.cpp ../wavefrontmaterials.cpp ../mappedfile.cpp
+	../arena.cpp ../meshcodec.cpp ../meshnormals.cpp ../meshoptimize.cpp ../meshlets.cpp ../meshsimplify.cpp
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../mappedfile.h"
+#include "../objparser.h"
+#include "../objstream.h"
+#include "../wavefrontloader.h"
+
+//the file every loader test writes, next to where the test runs
+static const wchar_t TEST_FILE[] = L"objparser_test.obj";
+
+static int failures = 0;
+
+#define CHECK(condition) Check((condition), #condition, __LINE__)
+
+static void Check(bool bPassed, const char* text, int line)
+{
+	if (!bPassed)
+	{
+		printf("FAILED line %d: %s\n", line, text);
+		++failures;
+	}
+}
+
+static const char* ParseInt(const char* text, long &value)
+{
+	return OBJParser::ParseInt(text, text + strlen(text), value);
+}
+
+//the parsed float must be the one strtod gives rounded to float, or its neighbour
+static bool ParsesLikeStrtod(const char* text)
+{
+	float value = 0.0f;
+	float expected = (float) strtod(text, NULL);
+	const char* end = OBJParser::ParseFloat(text, text + strlen(text), value);
+
+	if (end == text)
+		return false;
+	if (std::isinf(expected) || expected == 0.0f)
+		return value == expected;
+	return value == expected || nextafterf(value, expected) == expected;
+}
+
+static void TestParseInt()
+{
+	long value = 0;
+	char overflow[64];
+
+	CHECK(*ParseInt("123 ", value) == ' ' && value == 123);
+	CHECK(*ParseInt("-45/", value) == '/' && value == -45);
+	CHECK(*ParseInt("+7", value) == '\0' && value == 7);
+	CHECK(*ParseInt("007", value) == '\0' && value == 7);
+
+	//no digits leaves p and the value as they were
+	value = 99;
+	CHECK(*ParseInt("-", value) == '-' && value == 99);
+	CHECK(*ParseInt("/2", value) == '/' && value == 99);
+	CHECK(*ParseInt("x", value) == 'x' && value == 99);
+
+	//values past long stop at its largest, however many digits follow
+	snprintf(overflow, sizeof(overflow), "%ld0", LONG_MAX);
+	CHECK(*ParseInt(overflow, value) == '\0' && value == LONG_MAX);
+	CHECK(*ParseInt("99999999999999999999999999999999", value) == '\0' && value == LONG_MAX);
+	CHECK(*ParseInt("-99999999999999999999999999999999", value) == '\0' && value == -LONG_MAX);
+	snprintf(overflow, sizeof(overflow), "%ld", LONG_MAX);
+	CHECK(*ParseInt(overflow, value) == '\0' && value == LONG_MAX);
+}
+
+static void TestParseFloat()
+{
+	static const char* numbers[] = {
+		"0", "-0", "1", "-1", "+2.5", "0.1", ".5", "5.", "-.25", "123456.789",
+		"1e3", "1E3", "-2.25e3", "+3e-2", "6.02214076e23", "1.17549435e-38", "3.4028234e38",
+		"1e-50", "1e400", "-1e400", "1e-400", "0.000000000000000000000000000000001234",
+		"3.14159265358979323846264338327950288419716939937510",
+		"123456789012345678901234567890", "1234567890123456789012345678901234567890e-20",
+		"0.1234567890123456789012345", "9007199254740993", "4.9406564584124654e-324"};
+	float value = 7.0f;
+	const char* text;
+
+	for (size_t i = 0; i < sizeof(numbers)/sizeof(numbers[0]); ++i)
+	{
+		if (!ParsesLikeStrtod(numbers[i]))
+			printf("FAILED to parse %s like strtod\n", numbers[i]);
+		CHECK(ParsesLikeStrtod(numbers[i]));
+	}
+
+	//an exponent without digits is not part of the number
+	text = "2e";
+	CHECK(OBJParser::ParseFloat(text, text + 2, value) == text + 1 && value == 2.0f);
+	text = "2e+x";
+	CHECK(OBJParser::ParseFloat(text, text + 4, value) == text + 1 && value == 2.0f);
+
+	//nothing to read leaves p and the value as they were
+	value = 7.0f;
+	text = ".";
+	CHECK(OBJParser::ParseFloat(text, text + 1, value) == text && value == 7.0f);
+	text = "-x";
+	CHECK(OBJParser::ParseFloat(text, text + 2, value) == text && value == 7.0f);
+
+	//the range ends the number even when the text goes on
+	text = "1.25e1";
+	CHECK(OBJParser::ParseFloat(text, text + 4, value) == text + 4 && value == 1.25f);
+}
+
+//the count the SSE2 path must agree with, one byte at a time
+static long CountTokensScalar(const char* p, const char* end)
+{
+	long count = 0;
+	bool bPrevBlank = true;
+
+	for (; p < end; ++p)
+	{
+		bool bBlank = *p == ' ' || *p == '\t' || *p == '\r';
+		if (!bBlank && bPrevBlank)
+			++count;
+		bPrevBlank = bBlank;
+	}
+	return count;
+}
+
+static void TestCountTokens()
+{
+	static const char alphabet[] = {' ', ' ', '\t', '\r', '1', '/', '-', 'f'};
+	std::vector<char> line;
+	unsigned int seed = 1;
+	int mismatches = 0;
+
+	//every length around the 16 byte blocks and every offset into them
+	for (int length = 0; length < 80; ++length)
+	{
+		for (int trial = 0; trial < 200; ++trial)
+		{
+			line.resize(length + 1);
+			for (int i = 0; i < length; ++i)
+			{
+				seed = seed*1103515245u + 12345u;
+				line[i] = alphabet[(seed >> 16) % sizeof(alphabet)];
+			}
+			for (int offset = 0; offset < 2 && offset <= length; ++offset)
+			{
+				if (OBJParser::CountTokens(&line[offset], &line[length]) !=
+					CountTokensScalar(&line[offset], &line[length]))
+					++mismatches;
+			}
+		}
+	}
+	CHECK(mismatches == 0);
+
+	const char* face = " 1/1/1  2/2/2\t3/3/3 4/4/4 \r";
+	CHECK(OBJParser::CountTokens(face, face + strlen(face)) == 4);
+	face = " 1 2 3 # a triangle, 4 5";
+	CHECK(OBJParser::CountTokens(face, face + strlen(face)) == 3);
+	face = " 1 2 3#4";
+	CHECK(OBJParser::CountTokens(face, face + strlen(face)) == 3);
+	CHECK(OBJParser::FaceTriangles(4) == 2);
+}
+
+static std::vector<OBJCorner> ParseFaceCorners(const char* text)
+{
+	std::vector<OBJCorner> corners;
+
+	OBJParser::ParseFace(text, text + strlen(text), [&](const OBJCorner* triangle)
+	{
+		corners.insert(corners.end(), triangle, triangle + 3);
+	});
+	return corners;
+}
+
+static void TestParseFace()
+{
+	std::vector<OBJCorner> corners;
+
+	corners = ParseFaceCorners("1/2/3 4/5/6 7/8/9");
+	CHECK(corners.size() == 3 && corners[0].v == 1 && corners[0].t == 2 && corners[0].n == 3 &&
+		corners[2].v == 7 && corners[2].t == 8 && corners[2].n == 9);
+
+	corners = ParseFaceCorners("1//3 4//6 7//9");
+	CHECK(corners.size() == 3 && corners[1].v == 4 && corners[1].t == 0 && corners[1].n == 6);
+
+	corners = ParseFaceCorners("1/2 4/5 7/8");
+	CHECK(corners.size() == 3 && corners[1].v == 4 && corners[1].t == 5 && corners[1].n == 0);
+
+	corners = ParseFaceCorners("-1/-2/-3 -4 -5 -6\r");
+	CHECK(corners.size() == 6 && corners[0].v == -1 && corners[0].t == -2 && corners[0].n == -3 &&
+		corners[5].v == -6 && corners[5].t == 0);
+
+	//a fan of two triangles shares the first corner
+	corners = ParseFaceCorners("1 2 3 4");
+	CHECK(corners.size() == 6 && corners[3].v == 1 && corners[4].v == 3 && corners[5].v == 4);
+
+	//a trailing comment is not a corner
+	corners = ParseFaceCorners("1 2 3 # a triangle\r");
+	CHECK(corners.size() == 3 && corners[2].v == 3);
+	corners = ParseFaceCorners("1/1 2/2 3/3 4/4#quad");
+	CHECK(corners.size() == 6 && corners[5].v == 4 && corners[5].t == 4);
+
+	//too few corners still give one triangle, with 0 for the missing ones
+	corners = ParseFaceCorners("1 2");
+	CHECK(corners.size() == 3 && corners[2].v == 0);
+}
+
+static int WriteTestFile(const std::string &text)
+{
+	FILE* file = OpenFile(TEST_FILE, "wb");
+
+	if (file == NULL)
+		return -1;
+	bool bError = fwrite(text.data(), 1, text.size(), file) != text.size();
+	return fclose(file) != 0 || bError ? -1 : 0;
+}
+
+//loads text through the file loader, or through OBJStream in blocks of blockSize
+static int LoadText(const std::string &text, OBJClass &obj, size_t blockSize = 0)
+{
+	if (blockSize > 0)
+	{
+		OBJStream stream(blockSize);
+		return stream.LoadMemory(text.data(), text.size(), obj);
+	}
+	if (WriteTestFile(text) != 0)
+		return -1;
+	obj.SetThreadCount(1);
+	return obj.Load(const_cast<wchar_t*>(TEST_FILE));
+}
+
+//the same vertices, normals, texture coordinates and triangles
+static bool SameModel(OBJClass &a, OBJClass &b)
+{
+	long vertices = a.GetVertexCount(), corners = a.GetTotalConnectTriangles();
+
+	if (vertices != b.GetVertexCount() || corners != b.GetTotalConnectTriangles() ||
+		(a.GetTextureBuffer() == NULL) != (b.GetTextureBuffer() == NULL))
+		return false;
+	return memcmp(a.GetVertexBuffer(), b.GetVertexBuffer(), vertices*4*sizeof(float)) == 0 &&
+		memcmp(a.GetNormalBuffer(), b.GetNormalBuffer(), vertices*3*sizeof(float)) == 0 &&
+		(a.GetTextureBuffer() == NULL ||
+		memcmp(a.GetTextureBuffer(), b.GetTextureBuffer(), vertices*2*sizeof(float)) == 0) &&
+		memcmp(a.GetIndexBufferV(), b.GetIndexBufferV(), corners*sizeof(long)) == 0;
+}
+
+//the vertex at a position, -1 if there is none
+static long FindVertex(OBJClass &obj, float x, float y, float z)
+{
+	const float* positions = obj.GetVertexBuffer();
+
+	for (long v = 0; v < obj.GetVertexCount(); ++v)
+	{
+		if (positions[4*v] == x && positions[4*v + 1] == y && positions[4*v + 2] == z)
+			return v;
+	}
+	return -1;
+}
+
+static const char QUADS[] =
+	"# two quads\n"
+	"v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nv 2 0 0\nv 2 1 0\n"
+	"vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+	"vn 0 0 1\n"
+	"f 1/1/1 2/2/1 3/3/1 4/4/1\n"
+	"f 2/1/1 5/2/1 6/3/1 3/4/1\n";
+
+static void TestLineEndings()
+{
+	OBJClass lf, crlf, noEnd, stream;
+	std::string text = QUADS, crlfText;
+
+	for (size_t i = 0; i < text.size(); ++i)
+		crlfText += text[i] == '\n' ? std::string("\r\n") : std::string(1, text[i]);
+
+	CHECK(LoadText(text, lf) == 0);
+	CHECK(lf.GetVertexCount() == 8 && lf.GetTotalConnectTriangles() == 12);
+	CHECK(LoadText(crlfText, crlf) == 0 && SameModel(lf, crlf));
+	CHECK(LoadText(text.substr(0, text.size() - 1), noEnd) == 0 && SameModel(lf, noEnd));
+	crlf.Release();
+	CHECK(LoadText(crlfText.substr(0, crlfText.size() - 2), crlf) == 0 && SameModel(lf, crlf));
+
+	//blocks that split lines, and CRLF pairs, anywhere
+	for (size_t block = 1; block < 24; block += 3)
+	{
+		stream.Release();
+		CHECK(LoadText(crlfText, stream, block) == 0 && SameModel(lf, stream));
+	}
+}
+
+static void TestIndexForms()
+{
+	OBJClass positive, negative, full, normalsOnly, texelsOnly;
+	long v;
+
+	CHECK(LoadText("v 0 0 0\nv 1 0 0\nv 0 1 0\nv 0 0 1\nf 1 2 3\nf 1 3 4\n", positive) == 0);
+	CHECK(LoadText("v 0 0 0\nv 1 0 0\nv 0 1 0\nf -3 -2 -1\nv 0 0 1\nf -4 -2 -1\n", negative) == 0);
+	CHECK(SameModel(positive, negative));
+
+	//v/t/n, each corner takes its own texel and normal
+	CHECK(LoadText("v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0.25 0.5\nvt 0.75 0.5\n"
+		"vn 0 0 1\nvn 1 0 0\nf 1/1/1 2/2/2 3/-1/-2\n", full) == 0);
+	v = FindVertex(full, 1.0f, 0.0f, 0.0f);
+	CHECK(v >= 0 && full.GetTextureBuffer()[2*v] == 0.75f && full.GetNormalBuffer()[3*v] == 1.0f);
+	v = FindVertex(full, 0.0f, 1.0f, 0.0f);
+	CHECK(v >= 0 && full.GetTextureBuffer()[2*v] == 0.75f && full.GetNormalBuffer()[3*v + 2] == 1.0f);
+
+	//v//n, no texture coordinates at all
+	CHECK(LoadText("v 0 0 0\nv 1 0 0\nv 0 1 0\nvn 0 1 0\nf 1//1 2//1 3//1\n", normalsOnly) == 0);
+	v = FindVertex(normalsOnly, 1.0f, 0.0f, 0.0f);
+	CHECK(normalsOnly.GetTextureBuffer() == NULL && v >= 0 && normalsOnly.GetNormalBuffer()[3*v + 1] == 1.0f);
+
+	//v/t, the normals are generated
+	CHECK(LoadText("v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0.5 0.25\nf 1/1 2/1 3/1\n", texelsOnly) == 0);
+	v = FindVertex(texelsOnly, 0.0f, 1.0f, 0.0f);
+	CHECK(v >= 0 && texelsOnly.GetTextureBuffer()[2*v + 1] == 0.25f &&
+		fabsf(texelsOnly.GetNormalBuffer()[3*v + 2] - 1.0f) < 1e-6f);
+}
+
+static void TestMissingCorners()
+{
+	OBJClass obj, stream;
+	long v;
+
+	//the second face leaves its texels and normals out, it does not take the first of them
+	static const char MIXED[] =
+		"v 0 0 0\nv 1 0 0\nv 0 1 0\nv 0 0 1\n"
+		"vt 0.5 0.5\nvn 0 0 -1\n"
+		"f 1/1/1 2/1/1 3/1/1\n"
+		"f 1 2 4\n";
+
+	CHECK(LoadText(MIXED, obj) == 0);
+	CHECK(obj.GetVertexCount() == 6);
+	v = FindVertex(obj, 0.0f, 0.0f, 1.0f);
+	CHECK(v >= 0 && obj.GetTextureBuffer()[2*v] == 0.0f && obj.GetTextureBuffer()[2*v + 1] == 0.0f);
+	CHECK(v >= 0 && fabsf(obj.GetNormalBuffer()[3*v + 1] + 1.0f) < 1e-6f);
+	CHECK(LoadText(MIXED, stream, 7) == 0 && SameModel(obj, stream));
+}
+
+static void TestBadFiles()
+{
+	OBJClass obj;
+
+	CHECK(LoadText("", obj) == -1 && obj.GetLoadStats().error == OBJ_LOAD_EMPTY);
+	CHECK(LoadText("v 0 0 0\nv 1 0 0\n", obj) == -1 && obj.GetLoadStats().error == OBJ_LOAD_EMPTY);
+	CHECK(LoadText("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\nf 1 2 4\n", obj) == -1 &&
+		obj.GetLoadStats().error == OBJ_LOAD_BAD_INDEX && obj.GetLoadStats().badTriangle == 1);
+	CHECK(LoadText("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 99999999999999999999999\n", obj) == -1 &&
+		obj.GetLoadStats().error == OBJ_LOAD_BAD_INDEX);
+	CHECK(LoadText("v 0 0 0\nv 1 0 0\nv 0 1 0\nvn 0 0 1\nf 1//1 2//1 3//2\n", obj) == -1 &&
+		obj.GetLoadStats().error == OBJ_LOAD_BAD_INDEX);
+}
+
+int main()
+{
+	TestParseInt();
+	TestParseFloat();
+	TestCountTokens();
+	TestParseFace();
+	TestLineEndings();
+	TestIndexForms();
+	TestMissingCorners();
+	TestBadFiles();
+	RemoveFile(TEST_FILE);
+
+	if (failures > 0)
+	{
+		printf("%d checks failed\n", failures);
+		return 1;
+	}
+	printf("all checks passed\n");
+	return 0;
+}
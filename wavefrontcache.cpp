@@ -0,0 +1,356 @@
+/*
+Binary mesh cache for the Wavefront loader
+
+The cache is a sidecar file next to the OBJ file holding the buffers of
+the finished model, each aligned so that reading it back is a mapping of
+the file and a pointer fix-up, without any parsing or copying.
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <stdint.h>
+
+#include "wavefrontloader.h"
+
+//bump whenever the layout or the meaning of the buffers changes
+static const uint32_t CACHE_VERSION = 9;
+static const char CACHE_MAGIC[8] = {'O', 'B', 'J', 'C', 'A', 'C', 'H', 'E'};
+static const wchar_t CACHE_EXTENSION[] = L".meshcache";
+static const wchar_t CACHE_TEMP_EXTENSION[] = L".tmp";	// After CACHE_EXTENSION while the cache is written
+static const uint64_t CACHE_ALIGNMENT = 64;
+
+//how the buffers were processed, a cache made with other options is stale
+enum CacheFlags
+{
+	CACHE_FLAG_VERTEX_ORDER = 1,	// Triangles and vertices reordered by OptimizeVertexOrder
+	CACHE_FLAG_MESHLETS = 2,
+	CACHE_FLAG_LEVELS = 4,
+	CACHE_FLAG_GENERATED_NORMALS = 8,	// Some normals were generated, so the weighting matters
+	CACHE_FLAG_ANGLE_NORMALS = 16		// Those normals were angle weighted
+};
+
+enum CacheBuffer
+{
+	CACHE_VERTEX,
+	CACHE_NORMAL,
+	CACHE_TEXTURE,
+	CACHE_INDEX_V,
+	CACHE_INDEX_N,
+	CACHE_INDEX_T,
+	CACHE_MESHLETS,
+	CACHE_MATERIALS,
+	CACHE_GROUPS,
+	CACHE_FACE_MATERIALS,
+	CACHE_FACE_GROUPS,
+	CACHE_LEVEL_INDICES,	// One buffer per level after the first, which is CACHE_INDEX_V
+	CACHE_LEVEL_RANGES = CACHE_LEVEL_INDICES + OBJ_MAX_LEVELS - 1,	// One buffer per level
+	CACHE_BUFFER_COUNT = CACHE_LEVEL_RANGES + OBJ_MAX_LEVELS
+};
+
+struct OBJCacheHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t indexSize;			// sizeof(long) of the writer
+	uint32_t flags;
+	uint32_t reserved;
+	uint64_t fileSize;
+	unsigned long long sourceSize;		// Size and modification time of the OBJ file
+	unsigned long long sourceModified;
+
+	int64_t vertexCount;
+	int64_t texelCount;
+	int64_t normalCount;
+	int64_t faceCount;
+	int64_t totalConnectTriangles;
+	int64_t meshletCount;
+	int64_t levelCount;
+	int64_t levelTriangles[OBJ_MAX_LEVELS];
+	float levelErrors[OBJ_MAX_LEVELS];
+
+	float scale;
+	float vmax[3];
+	float vmin[3];
+	float center[3];
+	float radius;
+	VertexCacheStats cacheStatsBefore;
+	VertexCacheStats cacheStatsAfter;
+
+	uint64_t offsets[CACHE_BUFFER_COUNT];	// 0 for a buffer the model does not have
+	uint64_t sizes[CACHE_BUFFER_COUNT];
+};
+
+//flags of a cache made with these load options, the normal weighting only
+//counts for a model that had normals generated, a file with all of its
+//normals gives the same cache whatever the weighting
+static uint32_t OptionFlags(bool bOptimizeVertexCache, bool bBuildMeshlets, bool bBuildLevels,
+	bool bGeneratedNormals, NormalWeighting weighting)
+{
+	return (bOptimizeVertexCache ? CACHE_FLAG_VERTEX_ORDER : 0) | (bBuildMeshlets ? CACHE_FLAG_MESHLETS : 0) |
+		(bBuildLevels ? CACHE_FLAG_LEVELS : 0) | (bGeneratedNormals ? CACHE_FLAG_GENERATED_NORMALS : 0) |
+		(bGeneratedNormals && weighting == NORMALS_ANGLE_WEIGHTED ? CACHE_FLAG_ANGLE_NORMALS : 0);
+}
+
+static std::wstring CacheName(const wchar_t* fileName)
+{
+	return std::wstring(fileName) + CACHE_EXTENSION;
+}
+
+int OBJClass::WriteCache(const wchar_t* fileName)
+{
+	static const char padding[CACHE_ALIGNMENT] = {0};
+	OBJCacheHeader header;
+	const void* buffers[CACHE_BUFFER_COUNT];
+	std::wstring cacheName = CacheName(fileName), tempName = cacheName + CACHE_TEMP_EXTENSION;
+	uint64_t offset;
+	FILE* file;
+	bool bWriteError = false;
+
+	if (mVertexBuffer == NULL || mIndexBufferV == NULL)
+		return -1;
+
+	memset(&header, 0, sizeof(header));
+	if (GetFileStamp(fileName, header.sourceSize, header.sourceModified) != 0)
+		return -1;
+
+	header.version = CACHE_VERSION;
+	header.indexSize = sizeof(long);
+	header.flags = OptionFlags(mbOptimizeVertexCache, mbBuildMeshlets, mbBuildLevels, mbGeneratedNormals, mNormalWeighting);
+	header.vertexCount = mVertexCount;
+	header.texelCount = mTexelCount;
+	header.normalCount = mNormalCount;
+	header.faceCount = mFaceCount;
+	header.totalConnectTriangles = mTotalConnectTriangles;
+	header.meshletCount = mMeshletCount;
+	header.levelCount = mLevelCount;
+	for (int i = 0; i < mLevelCount; ++i)
+	{
+		header.levelTriangles[i] = mLevels[i].triangleCount;
+		header.levelErrors[i] = mLevels[i].error;
+	}
+	header.scale = mScale;
+	memcpy(header.vmax, mVmax, sizeof(mVmax));
+	memcpy(header.vmin, mVmin, sizeof(mVmin));
+	memcpy(header.center, mCenter, sizeof(mCenter));
+	header.radius = mRadius;
+	header.cacheStatsBefore = mCacheStatsBefore;
+	header.cacheStatsAfter = mCacheStatsAfter;
+
+	buffers[CACHE_VERTEX] = mVertexBuffer;
+	buffers[CACHE_NORMAL] = mNormalBuffer;
+	buffers[CACHE_TEXTURE] = mTextureBuffer;
+	buffers[CACHE_INDEX_V] = mIndexBufferV;
+	buffers[CACHE_INDEX_N] = mIndexBufferN;
+	buffers[CACHE_INDEX_T] = mIndexBufferT;
+	buffers[CACHE_MESHLETS] = mMeshlets;
+	header.sizes[CACHE_VERTEX] = (uint64_t) mVertexCount*4*sizeof(float);
+	header.sizes[CACHE_NORMAL] = mNormalBuffer ? (uint64_t) mNormalCount*3*sizeof(float) : 0;
+	header.sizes[CACHE_TEXTURE] = mTextureBuffer ? (uint64_t) mTexelCount*2*sizeof(float) : 0;
+	header.sizes[CACHE_INDEX_V] = (uint64_t) mFaceCount*3*sizeof(long);
+	header.sizes[CACHE_INDEX_N] = mIndexBufferN ? (uint64_t) mFaceCount*3*sizeof(long) : 0;
+	header.sizes[CACHE_INDEX_T] = mIndexBufferT ? (uint64_t) mFaceCount*3*sizeof(long) : 0;
+	header.sizes[CACHE_MESHLETS] = mMeshlets ? (uint64_t) mMeshletCount*sizeof(Meshlet) : 0;
+	buffers[CACHE_MATERIALS] = mMaterials;
+	buffers[CACHE_GROUPS] = mGroups;
+	buffers[CACHE_FACE_MATERIALS] = mFaceMaterials;
+	buffers[CACHE_FACE_GROUPS] = mFaceGroups;
+	header.sizes[CACHE_MATERIALS] = mMaterials ? (uint64_t) mMaterialCount*sizeof(OBJMaterial) : 0;
+	header.sizes[CACHE_GROUPS] = mGroups ? (uint64_t) mGroupCount*sizeof(OBJGroup) : 0;
+	header.sizes[CACHE_FACE_MATERIALS] = mFaceMaterials ? (uint64_t) mFaceCount*sizeof(int) : 0;
+	header.sizes[CACHE_FACE_GROUPS] = mFaceGroups ? (uint64_t) mFaceCount*sizeof(int) : 0;
+	for (int i = 1; i < OBJ_MAX_LEVELS; ++i)
+	{
+		buffers[CACHE_LEVEL_INDICES + i - 1] = i < mLevelCount ? mLevels[i].indices : NULL;
+		header.sizes[CACHE_LEVEL_INDICES + i - 1] = i < mLevelCount ? (uint64_t) mLevels[i].triangleCount*3*sizeof(long) : 0;
+	}
+	for (int i = 0; i < OBJ_MAX_LEVELS; ++i)
+	{
+		buffers[CACHE_LEVEL_RANGES + i] = i < mLevelCount ? mLevels[i].ranges : NULL;
+		header.sizes[CACHE_LEVEL_RANGES + i] = i < mLevelCount && mLevels[i].ranges ?
+			(uint64_t) mLevels[i].rangeCount*sizeof(OBJMaterialRange) : 0;
+	}
+
+	//written beside the cache and renamed over it, so a viewer that maps the
+	//old cache keeps it whole and no reader ever sees a half written one
+	file = OpenFile(tempName.c_str(), "wb");
+	if (file == NULL)
+		return -1;
+
+	//the header is written last, so an interrupted write never leaves a valid cache
+	bWriteError |= fwrite(&header, sizeof(header), 1, file) != 1;
+	offset = sizeof(header);
+
+	for (int i = 0; i < CACHE_BUFFER_COUNT && !bWriteError; ++i)
+	{
+		if (header.sizes[i] == 0)
+			continue;
+
+		uint64_t pad = (CACHE_ALIGNMENT - offset % CACHE_ALIGNMENT) % CACHE_ALIGNMENT;
+		bWriteError |= pad > 0 && fwrite(padding, (size_t) pad, 1, file) != 1;
+		offset += pad;
+
+		header.offsets[i] = offset;
+		bWriteError |= fwrite(buffers[i], (size_t) header.sizes[i], 1, file) != 1;
+		offset += header.sizes[i];
+	}
+
+	memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.fileSize = offset;
+	bWriteError |= fseek(file, 0, SEEK_SET) != 0;
+	bWriteError |= fwrite(&header, sizeof(header), 1, file) != 1;
+	bWriteError |= fclose(file) != 0;
+
+	if (bWriteError || MoveFileOver(tempName.c_str(), cacheName.c_str()) != 0)
+	{
+		RemoveFile(tempName.c_str());
+		return -1;
+	}
+	return 0;
+}
+
+//maps the cache of fileName copy-on-write, so later processing can still
+//change the buffers in memory, and points the buffers into the mapping
+int OBJClass::ReadCache(const wchar_t* fileName)
+{
+	OBJCacheHeader header;
+	unsigned long long sourceSize, sourceModified;
+	char* data;
+	void* buffers[CACHE_BUFFER_COUNT];
+
+	if (GetFileStamp(fileName, sourceSize, sourceModified) != 0)
+		return -1;
+
+	Release();
+	if (mCacheFile.Open(CacheName(fileName).c_str(), true) != 0)
+		return -1;
+
+	data = mCacheFile.GetWritableData();
+	if (mCacheFile.GetSize() < sizeof(header))
+	{
+		mCacheFile.Close();
+		return -1;
+	}
+	memcpy(&header, data, sizeof(header));
+
+	//an edited OBJ file, another writer, other options or a damaged file all mean a reparse,
+	//whether normals were generated is up to the file, so the cache says
+	bool bGeneratedNormals = (header.flags & CACHE_FLAG_GENERATED_NORMALS) != 0;
+	if (memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+		header.version != CACHE_VERSION || header.indexSize != sizeof(long) ||
+		header.flags != OptionFlags(mbOptimizeVertexCache, mbBuildMeshlets, mbBuildLevels, bGeneratedNormals, mNormalWeighting) ||
+		header.sourceSize != sourceSize || header.sourceModified != sourceModified ||
+		header.fileSize != mCacheFile.GetSize() || header.vertexCount <= 0 || header.faceCount <= 0)
+	{
+		mCacheFile.Close();
+		return -1;
+	}
+
+	for (int i = 0; i < CACHE_BUFFER_COUNT; ++i)
+	{
+		buffers[i] = NULL;
+		if (header.sizes[i] == 0)
+			continue;
+
+		if (header.offsets[i] % CACHE_ALIGNMENT != 0 || header.offsets[i] > header.fileSize ||
+			header.sizes[i] > header.fileSize - header.offsets[i])
+		{
+			mCacheFile.Close();
+			return -1;
+		}
+		buffers[i] = data + header.offsets[i];
+	}
+
+	if (buffers[CACHE_VERTEX] == NULL || buffers[CACHE_INDEX_V] == NULL ||
+		header.sizes[CACHE_VERTEX] != (uint64_t) header.vertexCount*4*sizeof(float) ||
+		header.sizes[CACHE_INDEX_V] != (uint64_t) header.faceCount*3*sizeof(long) ||
+		(buffers[CACHE_NORMAL] && header.sizes[CACHE_NORMAL] != (uint64_t) header.normalCount*3*sizeof(float)) ||
+		(buffers[CACHE_TEXTURE] && header.sizes[CACHE_TEXTURE] != (uint64_t) header.texelCount*2*sizeof(float)) ||
+		(buffers[CACHE_INDEX_N] && header.sizes[CACHE_INDEX_N] != header.sizes[CACHE_INDEX_V]) ||
+		(buffers[CACHE_INDEX_T] && header.sizes[CACHE_INDEX_T] != header.sizes[CACHE_INDEX_V]) ||
+		(mbBuildMeshlets && (buffers[CACHE_MESHLETS] == NULL || header.meshletCount <= 0 ||
+		header.sizes[CACHE_MESHLETS] != (uint64_t) header.meshletCount*sizeof(Meshlet))) ||
+		header.levelCount < 1 || header.levelCount > OBJ_MAX_LEVELS || header.levelTriangles[0] != header.faceCount)
+	{
+		mCacheFile.Close();
+		return -1;
+	}
+
+	for (int i = 1; i < header.levelCount; ++i)
+	{
+		if (buffers[CACHE_LEVEL_INDICES + i - 1] == NULL || header.levelTriangles[i] <= 0 ||
+			header.sizes[CACHE_LEVEL_INDICES + i - 1] != (uint64_t) header.levelTriangles[i]*3*sizeof(long))
+		{
+			mCacheFile.Close();
+			return -1;
+		}
+	}
+	
+	//the materials, groups and per face numbers come together, the counts follow from the sizes
+	bool bMaterials = buffers[CACHE_MATERIALS] != NULL;
+	if (header.sizes[CACHE_MATERIALS] % sizeof(OBJMaterial) != 0 || header.sizes[CACHE_GROUPS] % sizeof(OBJGroup) != 0 ||
+		(buffers[CACHE_GROUPS] != NULL) != bMaterials ||
+		header.sizes[CACHE_FACE_MATERIALS] != (bMaterials ? (uint64_t) header.faceCount*sizeof(int) : 0) ||
+		header.sizes[CACHE_FACE_GROUPS] != (bMaterials ? (uint64_t) header.faceCount*sizeof(int) : 0))
+	{
+		mCacheFile.Close();
+		return -1;
+	}
+	for (int i = 0; i < header.levelCount; ++i)
+	{
+		if (header.sizes[CACHE_LEVEL_RANGES + i] % sizeof(OBJMaterialRange) != 0 ||
+			(buffers[CACHE_LEVEL_RANGES + i] != NULL) != bMaterials)
+		{
+			mCacheFile.Close();
+			return -1;
+		}
+	}
+
+	mbGeneratedNormals = bGeneratedNormals;
+	mVertexBuffer = (float*) buffers[CACHE_VERTEX];
+	mNormalBuffer = (float*) buffers[CACHE_NORMAL];
+	mTextureBuffer = (float*) buffers[CACHE_TEXTURE];
+	mIndexBufferV = (long*) buffers[CACHE_INDEX_V];
+	mIndexBufferN = (long*) buffers[CACHE_INDEX_N];
+	mIndexBufferT = (long*) buffers[CACHE_INDEX_T];
+	mMeshlets = (Meshlet*) buffers[CACHE_MESHLETS];
+	mMeshletCount = mMeshlets ? (long) header.meshletCount : 0;
+	mLevelCount = (int) header.levelCount;
+	for (int i = 0; i < mLevelCount; ++i)
+	{
+		mLevels[i].indices = i == 0 ? mIndexBufferV : (long*) buffers[CACHE_LEVEL_INDICES + i - 1];
+		mLevels[i].triangleCount = (long) header.levelTriangles[i];
+		mLevels[i].error = header.levelErrors[i];
+		mLevels[i].ranges = (OBJMaterialRange*) buffers[CACHE_LEVEL_RANGES + i];
+		mLevels[i].rangeCount = (long)(header.sizes[CACHE_LEVEL_RANGES + i] / sizeof(OBJMaterialRange));
+	}
+	mMaterials = (OBJMaterial*) buffers[CACHE_MATERIALS];
+	mMaterialCount = (int)(header.sizes[CACHE_MATERIALS] / sizeof(OBJMaterial));
+	mGroups = (OBJGroup*) buffers[CACHE_GROUPS];
+	mGroupCount = (long)(header.sizes[CACHE_GROUPS] / sizeof(OBJGroup));
+	mFaceMaterials = (int*) buffers[CACHE_FACE_MATERIALS];
+	mFaceGroups = (int*) buffers[CACHE_FACE_GROUPS];
+
+	mVertexCount = (long) header.vertexCount;
+	mTexelCount = (long) header.texelCount;
+	mNormalCount = (long) header.normalCount;
+	mFaceCount = (long) header.faceCount;
+	mTotalConnectTriangles = (long) header.totalConnectTriangles;
+	mScale = header.scale;
+	memcpy(mVmax, header.vmax, sizeof(mVmax));
+	memcpy(mVmin, header.vmin, sizeof(mVmin));
+	memcpy(mCenter, header.center, sizeof(mCenter));
+	mRadius = header.radius;
+	mCacheStatsBefore = header.cacheStatsBefore;
+	mCacheStatsAfter = header.cacheStatsAfter;
+
+	return 0;
+}
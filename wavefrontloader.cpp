@@ -1,6 +1,6 @@
 /*
 Simple Obj viewer for Windows using OpenGL and SDL
-Can only read triangular faces, not polygonal, and does not draw textures or materials
+Reads triangular and polygonal faces, does not draw textures
 
 Modified code based on frank253's OpenGl Glut OBJ Loader sample
 openglsamples.sourceforge.net/projects/index.pho/blog/index/
@@ -21,14 +21,46 @@ IN THE SOFTWARE.
 */
 
 #include <iostream>
-#include <fstream>
 #include <string>
-
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <functional>
 #include <vector>
+
+#include <cstring>
+#include <cwchar>
 #include <cmath>
+#include <new>
 
+#include "arena.h"
+#include "mappedfile.h"
+#include "meshlets.h"
+#include "meshnormals.h"
+#include "meshoptimize.h"
+#include "meshsimplify.h"
+#include "objparser.h"
+#include "parallel.h"
 #include "wavefrontloader.h"
 
+//milliseconds between calls, for the stages of a load
+class PhaseTimer
+{
+  private:
+	std::chrono::steady_clock::time_point mStart;
+	
+ public:
+	PhaseTimer() : mStart(std::chrono::steady_clock::now()) {};
+	
+	inline double Lap()
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		double ms = std::chrono::duration<double, std::milli>(now - mStart).count();
+		mStart = now;
+		return ms;
+	}
+};
+
 OBJClass::OBJClass()
 {
 	mNormalBuffer = NULL;							
@@ -37,11 +69,108 @@ OBJClass::OBJClass()
 	mIndexBufferV = NULL;
 	mIndexBufferN = NULL;
 	mIndexBufferT = NULL;
+	mMeshlets = NULL;
+	mMeshletCount = 0;
 	mScale = 1.0f;
+	mThreadCount = 0;
+	mbUseCache = false;
+	mNormalWeighting = NORMALS_AREA_WEIGHTED;
+	mbGeneratedNormals = false;
+	mbOptimizeVertexCache = false;
+	mCacheStatsBefore.acmr = mCacheStatsBefore.atvr = 0.0;
+	mCacheStatsAfter = mCacheStatsBefore;
+	mbBuildMeshlets = false;
+	mbBuildLevels = false;
+	mLevelCount = 0;
+	mLoadStats = OBJLoadStats();
 	mFaceCount = mTexelCount = mNormalCount = mVertexCount = mTotalConnectTriangles = 0;	
+	mMaterials = NULL;
+	mMaterialCount = 0;
+	mGroups = NULL;
+	mGroupCount = 0;
+	mFaceMaterials = mFaceGroups = NULL;
+	mRadius = 0.0f;
 	mCenter[0] = mCenter[1] = mCenter[2] = 0.0f;
 	mVmax[0] = mVmax[1] = mVmax[2] = 0.0f;
 	mVmin[0] = mVmin[1] = mVmin[2] = 0.0f;
+	mbCancelled = false;
+	mProgress = 0.0f;
+	mbTrackChanges = false;
+	mbKeepScratch = false;
+	mFileSize = 0;
+}
+
+OBJClass::OBJClass(OBJClass&& other) : OBJClass()
+{
+	*this = static_cast<OBJClass&&>(other);
+}
+
+//hands the model over without copying any buffer, other is left empty
+OBJClass& OBJClass::operator=(OBJClass&& other)
+{
+	if (this == &other)
+		return *this;
+	
+	Release();
+	mNormalBuffer = other.mNormalBuffer;
+	mTextureBuffer = other.mTextureBuffer;
+	mVertexBuffer = other.mVertexBuffer;
+	mIndexBufferN = other.mIndexBufferN;
+	mIndexBufferT = other.mIndexBufferT;
+	mIndexBufferV = other.mIndexBufferV;
+	mMeshlets = other.mMeshlets;
+	mMeshletCount = other.mMeshletCount;
+	mbGeneratedNormals = other.mbGeneratedNormals;
+	mScale = other.mScale;
+	memcpy(mVmax, other.mVmax, sizeof(mVmax));
+	memcpy(mVmin, other.mVmin, sizeof(mVmin));
+	memcpy(mCenter, other.mCenter, sizeof(mCenter));
+	mRadius = other.mRadius;
+	mFaceCount = other.mFaceCount;
+	mTexelCount = other.mTexelCount;
+	mNormalCount = other.mNormalCount;
+	mVertexCount = other.mVertexCount;
+	mTotalConnectTriangles = other.mTotalConnectTriangles;
+	mMaterials = other.mMaterials;
+	mMaterialCount = other.mMaterialCount;
+	mGroups = other.mGroups;
+	mGroupCount = other.mGroupCount;
+	mFaceMaterials = other.mFaceMaterials;
+	mFaceGroups = other.mFaceGroups;
+	mThreadCount = other.mThreadCount;
+	mbUseCache = other.mbUseCache;
+	mNormalWeighting = other.mNormalWeighting;
+	mbOptimizeVertexCache = other.mbOptimizeVertexCache;
+	mCacheStatsBefore = other.mCacheStatsBefore;
+	mCacheStatsAfter = other.mCacheStatsAfter;
+	mbBuildMeshlets = other.mbBuildMeshlets;
+	mbBuildLevels = other.mbBuildLevels;
+	memcpy(mLevels, other.mLevels, sizeof(mLevels));
+	mLevelCount = other.mLevelCount;
+	mLoadStats = other.mLoadStats;
+	mbTrackChanges = other.mbTrackChanges;
+	mbKeepScratch = other.mbKeepScratch;
+	mFileSize = other.mFileSize;
+	
+	//the buffers stay where they are, only their owners move
+	mCacheFile = static_cast<MappedFile&&>(other.mCacheFile);
+	mMesh = static_cast<MemoryArena&&>(other.mMesh);
+	mScratch = static_cast<MemoryArena&&>(other.mScratch);
+	mPolygons.swap(other.mPolygons);
+	mMarkers.swap(other.mMarkers);
+	mDirectory.swap(other.mDirectory);
+	std::swap(mParts, other.mParts);
+	mFileBlocks.swap(other.mFileBlocks);
+	mVertexSources.swap(other.mVertexSources);
+	
+	other.mNormalBuffer = other.mTextureBuffer = other.mVertexBuffer = NULL;
+	other.mIndexBufferN = other.mIndexBufferT = other.mIndexBufferV = NULL;
+	other.mMeshlets = NULL;
+	other.mMaterials = NULL;
+	other.mGroups = NULL;
+	other.mFaceMaterials = other.mFaceGroups = NULL;
+	other.Release();
+	return *this;
 }
 
 OBJClass::~OBJClass()
@@ -49,289 +178,711 @@ OBJClass::~OBJClass()
 	Release();
 }
 
-//calculate mCenter of the 3D model using centroid of image moment equation
-void OBJClass::CalcCenter()
+//turns a 1-based or negative (relative) OBJ index into a 0-based index,
+//count is the number of elements defined before the face
+static inline long ResolveIndex(long index, long count)
+{
+	return index < 0 ? count + index : index - 1;
+}
+
+//odd, so every power of it is too and no line drops out of the hash
+static const unsigned long long STRUCTURE_MULTIPLIER = 0x9E3779B97F4A7C15ull;
+
+//hash of the face and marker lines in order, the sum of every line's hash
+//times a power of STRUCTURE_MULTIPLIER, so the hashes of stretches that
+//follow each other add up to the hash of all their lines
+struct OBJStructureHash
+{
+	unsigned long long hash;
+	unsigned long long weight;	// Multiplies the hash of the next line
+	
+	inline void Reset(){hash = 0; weight = 1;};
+	inline void AddLine(const char* p, const char* lineEnd)
+	{
+		hash += weight*OBJParser::HashBytes(p, lineEnd - p);
+		weight *= STRUCTURE_MULTIPLIER;
+	}
+	inline void Append(unsigned long long otherHash, unsigned long long otherWeight)
+	{
+		hash += weight*otherHash;
+		weight *= otherWeight;
+	}
+};
+
+//counts the records in [p, end) so the buffers can be sized before parsing,
+//lines gets the face lines and the lines that are no record, markers the
+//mtllib, usemtl, o and g lines with the triangles counted before them and
+//structure, unless NULL, the hash of the face and marker lines
+static void CountRecords(const char* p, const char* end, OBJRecordCounts &counts, OBJLineCounts &lines,
+	std::vector<OBJMarker> &markers, OBJStructureHash* structure)
+{
+	while (p < end)
+	{
+		const char* lineEnd = OBJParser::FindLineEnd(p, end);
+
+		if (lineEnd - p > 2 && p[0] == 'v' && OBJParser::IsBlank(p[1]))
+			++counts.vertices;
+		else if (lineEnd - p > 2 && p[0] == 'v' && p[1] == 't' && OBJParser::IsBlank(p[2]))
+			++counts.texels;
+		else if (lineEnd - p > 2 && p[0] == 'v' && p[1] == 'n' && OBJParser::IsBlank(p[2]))
+			++counts.normals;
+		else if (lineEnd - p > 2 && p[0] == 'f' && OBJParser::IsBlank(p[1]))
+		{
+			counts.faces += OBJParser::FaceTriangles(OBJParser::CountTokens(p + 2, lineEnd));
+			++lines.faces;
+			if (structure != NULL)
+				structure->AddLine(p, lineEnd);
+		}
+		else
+		{
+			const char *name, *nameEnd;
+			OBJMarkerKind kind = OBJ_MARKER_NONE;
+			
+			//the rare lines are only looked at closely when their first letter could start one
+			if (p < lineEnd && (p[0] == 'o' || p[0] == 'g' || p[0] == 'u' || p[0] == 'm'))
+				kind = OBJParser::ParseMarker(p, lineEnd, name, nameEnd);
+			if (kind != OBJ_MARKER_NONE)
+			{
+				OBJMarker marker;
+				marker.triangle = counts.faces;
+				marker.kind = kind;
+				marker.name.assign(name, nameEnd);
+				markers.push_back(marker);
+				if (structure != NULL)
+					structure->AddLine(p, lineEnd);
+			}
+			++lines.other;
+		}
+		p = lineEnd + 1;
+	}
+}
+
+//parses the records in [p, end) straight from the file data, 
+//cursor holds the number of each record type read so far,
+//faces with more than three corners are added to polygons and
+//every position is added to bounds
+void OBJClass::ParseRecords(const char* p, const char* end, OBJRecordCounts &cursor,
+	std::vector<OBJPolygon> &polygons, OBJBounds &bounds)
+{
+	while (p < end)
+	{
+		const char* lineEnd = OBJParser::FindLineEnd(p, end);
+
+		if (lineEnd - p > 2)
+		{
+			// Positions
+			if (p[0] == 'v' && OBJParser::IsBlank(p[1]))
+			{
+				OBJParser::ParseFloats(p + 2, lineEnd, mVertexBuffer + 4*cursor.vertices, 3);
+				bounds.Add(mVertexBuffer + 4*cursor.vertices);
+				++cursor.vertices;
+			}
+
+			else if (p[0] == 'v' && p[1] == 't' && OBJParser::IsBlank(p[2]))
+			{
+				OBJParser::ParseFloats(p + 3, lineEnd, mTextureBuffer + 2*cursor.texels, 2);
+				++cursor.texels;
+			}
+
+			// mNormalBuffer
+			else if (p[0] == 'v' && p[1] == 'n' && OBJParser::IsBlank(p[2]))
+			{
+				OBJParser::ParseFloats(p + 3, lineEnd, mNormalBuffer + 3*cursor.normals, 3);
+				++cursor.normals;
+			}
+
+			// Faces, polygons are read as a fan and fixed up after the parse if concave
+			else if (p[0] == 'f' && OBJParser::IsBlank(p[1]))
+			{
+				OBJPolygon polygon;
+				
+				polygon.firstTriangle = cursor.faces;
+				polygon.corners = OBJParser::ParseFace(p + 2, lineEnd, [&](const OBJCorner* triangle)
+				{
+					for (int i = 0; i < 3; ++i)
+					{
+						mIndexBufferV[3*cursor.faces + i] = ResolveIndex(triangle[i].v, cursor.vertices);
+						//a corner without a texel or normal in a file that has them is
+						//marked, it gets zero texcoords and a generated normal later
+						if (mIndexBufferT != NULL)
+							mIndexBufferT[3*cursor.faces + i] = triangle[i].t != 0 ?
+								ResolveIndex(triangle[i].t, cursor.texels) : OBJ_MISSING_INDEX;
+						if (mIndexBufferN != NULL)
+							mIndexBufferN[3*cursor.faces + i] = triangle[i].n != 0 ?
+								ResolveIndex(triangle[i].n, cursor.normals) : OBJ_MISSING_INDEX;
+					}
+					++cursor.faces;
+				});
+				
+				if (polygon.corners > 3)
+					polygons.push_back(polygon);
+			}
+		}
+		p = lineEnd + 1;
+	}
+}
+
+//one stretch of whole lines of the file, parsed independently of the others
+struct OBJChunk
 {
-	float m000 =0.0f;
-	float m100 =0.0f;
-	float m010 =0.0f;
-	float m001 =0.0f;
+	const char* begin;
+	const char* end;
+	OBJRecordCounts counts;	// Records in the chunk
+	OBJLineCounts lines;
+	OBJRecordCounts start;	// Records in all the chunks before it
+	std::vector<OBJPolygon> polygons;
+	std::vector<OBJMarker> markers;	// Triangles counted from the start of the chunk
+	OBJBounds bounds;
+	unsigned long long hash;		// Of the bytes, only made when changes are tracked
+	OBJStructureHash structure;
+};
+
+//smallest chunk worth handing to another thread
+static const size_t MIN_CHUNK_SIZE = 1 << 20;
+//largest chunk, the progress moves and a cancel is noticed at least this often
+static const size_t MAX_CHUNK_SIZE = 64 << 20;
+//largest chunk when changes are tracked, every chunk is kept as a block and
+//a change makes FindChanges read its whole block again
+static const size_t CHANGE_BLOCK_SIZE = 1 << 20;
+
+//share of a parse done once the records are counted and once they are read,
+//the stages of FinishLoad move it on evenly from there
+static const float PROGRESS_COUNTED = 0.1f;
+static const float PROGRESS_PARSED = 0.5f;
+static const int FINISH_STAGES = 8;
+
+//splits [data, end) into chunks that start and stop on line boundaries
+//and hold at most about maxSize bytes
+static void SplitChunks(const char* data, const char* end, int threads, size_t maxSize, std::vector<OBJChunk> &chunks)
+{
+	OBJChunk chunk = {};
+	size_t size = end - data;
+	size_t count = 1;
+
+	//a few chunks per thread so a slow chunk does not hold the rest up
+	if (threads > 1)
+	{
+		count = size / MIN_CHUNK_SIZE + 1;
+		if (count > (size_t) threads*4)
+			count = (size_t) threads*4;
+	}
+	count = std::max(count, size / maxSize + 1);
 
-	for (long i = 0; i < mVertexCount*4; i = i+4)
+	chunk.begin = data;
+	for (size_t i = 1; i <= count && chunk.begin < end; ++i)
 	{
-		++m000;
-		m100 = m100 + mVertexBuffer[i];
-		m010 = m010 + mVertexBuffer[i+1];
-		m001 = m001 + mVertexBuffer[i+2];
+		chunk.end = i == count ? end : OBJParser::FindLineEnd(data + size*i/count, end);
+		if (chunk.end < end)
+			++chunk.end;
+		if (chunk.end > chunk.begin)
+		{
+			chunks.push_back(chunk);
+			chunk.begin = chunk.end;
+		}
 	}
-	mCenter[0] = m100/m000;
-	mCenter[1] = m010/m000;
-	mCenter[2] = m001/m000;	
 }
 
-//*
 int OBJClass::Load(wchar_t* fileName)
 { 
+	PhaseTimer loadTimer;
+	int result;
+	
+	mLoadStats = OBJLoadStats();
+	mScratch.ResetPeak();
+	mProgress = 0.0f;
+	
+	//a cache that still matches the file replaces the whole parse
+	size_t nameLength = wcslen(fileName);
+	if (nameLength > 8 && wcscmp(fileName + nameLength - 8, L".objpack") == 0)
+		result = ReadPacked(fileName);
+	else if (mbUseCache && ReadCache(fileName) == 0)
+	{
+		mLoadStats.source = OBJ_SOURCE_CACHE;
+		mLoadStats.bytesRead = mCacheFile.GetSize();
+		result = 0;
+	}
+	else
+		result = ParseFile(fileName);
+	
+	//a cancel that came too late to stop a stage still drops the model
+	if (result == 0 && mbCancelled)
+	{
+		Release();
+		result = FailLoad(OBJ_LOAD_CANCELLED);
+	}
+	mbCancelled = false;
+	mProgress = 1.0f;
+	
+	//a failed load keeps the peak of the scratch arena, the mesh arena is released by then
+	if (result != 0)
+		mLoadStats.peakBytes = mScratch.GetPeak();
+	EndScratch();
+	mLoadStats.times.total = loadTimer.Lap();
+	return result;
+}
+
+//what FindChanges needs of a chunk once the file is closed
+static void KeepBlock(const OBJChunk &chunk, const char* data, OBJFileBlock &block)
+{
+	block.offset = chunk.begin - data;
+	block.size = chunk.end - chunk.begin;
+	block.hash = chunk.hash;
+	block.structureHash = chunk.structure.hash;
+	block.structureWeight = chunk.structure.weight;
+	block.counts = chunk.counts;
+	for (int i = 0; i < 3; ++i)
+	{
+		block.vmin[i] = chunk.bounds.vmin[i];
+		block.vmax[i] = chunk.bounds.vmax[i];
+		block.sum[i] = chunk.bounds.sum[i];
+	}
+}
+
+//maps the file and parses it in chunks, one per task
+int OBJClass::ParseFile(const wchar_t* fileName)
+{
+	MappedFile file;
+	std::vector<OBJChunk> chunks;
+	OBJRecordCounts counts = {0, 0, 0, 0};
+	OBJBounds bounds;
+	const char *data, *end;
+	int threads = ResolveThreadCount(mThreadCount);
+	std::atomic<long> chunksDone(0);
+	unsigned long long fileSize, modified;
+	PhaseTimer timer;
+	
+	Release();
+	mPolygons.clear();
 	mFaceCount = 0;
-	//positioncount = 0;
 	mTexelCount = 0;
 	mNormalCount = 0;
 	mVertexCount = 0;
+	mTotalConnectTriangles = 0;
+	
+	//an empty file cannot be mapped, so it is told apart from one that cannot be opened first
+	if (GetFileStamp(fileName, fileSize, modified) == 0 && fileSize == 0)
+		return FailLoad(OBJ_LOAD_EMPTY);
 	
-	int itrP = 0, itrT = 0, itrN = 0, itrF = 0, count = 0, offset = 0;
-	long fV = 0, fT = 0, fN = 0, fVmax = 0,fTmax = 0, fNmax = 0;
-	std::string line, type;	
-	char* nextToken;
-	
-	// Open OBJ file
-    std::ifstream inOBJ;
-    inOBJ.open(fileName);
-    if(!inOBJ.good())
-    {
-        std::cout << "ERROR OPENING OBJ FILE" << std::endl;
-		inOBJ.close();
-        return -1;
-    }
+	// Map OBJ file, its lines are parsed in place without being copied
+	if (file.Open(fileName) != 0)
+	{
+		std::cout << "ERROR OPENING OBJ FILE" << std::endl;
+		return FailLoad(OBJ_LOAD_OPEN_FAILED);
+	}
+	data = file.GetData();
+	end = data + file.GetSize();
+	mLoadStats.bytesRead = file.GetSize();
+	mDirectory = GetDirectoryOf(fileName);
+	
+	SplitChunks(data, end, threads, mbTrackChanges ? CHANGE_BLOCK_SIZE : MAX_CHUNK_SIZE, chunks);
     
-    // Read OBJ file, 1st pass
-    while(!inOBJ.eof())
-    {
-        std::string line;
-        std::getline(inOBJ, line);
-        std::string type = line.substr(0,2);
-        
-        if(type.compare("v ") == 0)
-            ++mVertexCount;
-        else if(type.compare("vt") == 0)
-            ++mTexelCount;
-        else if(type.compare("vn") == 0)
-            ++mNormalCount;
-	    else if(type.compare("vt") == 0)
-            ++mTexelCount;
-        else if(type.compare("f ") == 0)
-            ++mFaceCount;
-    }    
+	// Count the records of every chunk so the buffers are allocated once
+	ParallelFor((long) chunks.size(), threads, [&](long i)
+	{
+		if (mbCancelled)
+			return;
+		chunks[i].structure.Reset();
+		CountRecords(chunks[i].begin, chunks[i].end, chunks[i].counts, chunks[i].lines, chunks[i].markers,
+			mbTrackChanges ? &chunks[i].structure : NULL);
+		if (mbTrackChanges)
+			chunks[i].hash = OBJParser::HashBytes(chunks[i].begin, chunks[i].end - chunks[i].begin);
+		ReportProgress(PROGRESS_COUNTED*++chunksDone/chunks.size());
+	});
+	if (!ReportProgress(PROGRESS_COUNTED))
+		return FailLoad(OBJ_LOAD_CANCELLED);
+	
+	//prefix sum, each chunk writes its records at the totals of the chunks before it
+	for (size_t i = 0; i < chunks.size(); ++i)
+	{
+		chunks[i].start = counts;
+		for (size_t k = 0; k < chunks[i].markers.size(); ++k)
+		{
+			mMarkers.push_back(static_cast<OBJMarker&&>(chunks[i].markers[k]));
+			mMarkers.back().triangle += counts.faces;
+		}
+		counts.vertices += chunks[i].counts.vertices;
+		counts.texels += chunks[i].counts.texels;
+		counts.normals += chunks[i].counts.normals;
+		counts.faces += chunks[i].counts.faces;
+		mLoadStats.lines.faces += chunks[i].lines.faces;
+		mLoadStats.lines.other += chunks[i].lines.other;
+	}
+	mLoadStats.lines.vertices = counts.vertices;
+	mLoadStats.lines.texels = counts.texels;
+	mLoadStats.lines.normals = counts.normals;
+	mLoadStats.times.count = timer.Lap();
+	
+	mVertexCount = counts.vertices;
+	mTexelCount = counts.texels;
+	mNormalCount = counts.normals;
+	mFaceCount = counts.faces;
    
 	if ( mVertexCount == 0 || mFaceCount == 0)
-		return -1;
+		return FailLoad(OBJ_LOAD_EMPTY);
    
-    mVertexBuffer = new float[mVertexCount*4]();
-	mIndexBufferV = new long[mFaceCount*3]();
+	//the raw buffers only live until the vertices are unified, so they come from
+	//the scratch arena, freed when the load ends unless SetKeepScratch keeps it
+	if (mScratch.Reserve(MemoryArena::Align(mVertexCount*4*sizeof(float)) +
+		MemoryArena::Align(mNormalCount*3*sizeof(float)) + MemoryArena::Align(mTexelCount*2*sizeof(float)) +
+		MemoryArena::Align(mFaceCount*3*sizeof(long))*3) != 0)
+	{
+		std::cout << "NOT ENOUGH MEMORY FOR THE OBJ FILE" << std::endl;
+		return FailLoad(OBJ_LOAD_OUT_OF_MEMORY);
+	}
+	mVertexBuffer = mScratch.Allocate<float>(mVertexCount*4);
+	mIndexBufferV = mScratch.Allocate<long>(mFaceCount*3);
+	memset(mVertexBuffer, 0, mVertexCount*4*sizeof(float));
+	memset(mIndexBufferV, 0, mFaceCount*3*sizeof(long));
 	
 	if (mNormalCount)
 	{
-		mNormalBuffer  = new float[mNormalCount*3]();
-		mIndexBufferN = new long[mFaceCount*3]();	
+		mNormalBuffer = mScratch.Allocate<float>(mNormalCount*3);
+		mIndexBufferN = mScratch.Allocate<long>(mFaceCount*3);
+		memset(mNormalBuffer, 0, mNormalCount*3*sizeof(float));
+		memset(mIndexBufferN, 0, mFaceCount*3*sizeof(long));
 	}
 	if (mTexelCount)
 	{
-		mTextureBuffer  = new float[mTexelCount*2]();
-		mIndexBufferT = new long[mFaceCount*3]();
-    }
+		mTextureBuffer = mScratch.Allocate<float>(mTexelCount*2);
+		mIndexBufferT = mScratch.Allocate<long>(mFaceCount*3);
+		memset(mTextureBuffer, 0, mTexelCount*2*sizeof(float));
+		memset(mIndexBufferT, 0, mFaceCount*3*sizeof(long));
+	}
+	
+	//the cursor starts at the chunk's global offsets, so relative face
+	//indices resolve against every element defined before the chunk too
+	chunksDone = 0;
+	ParallelFor((long) chunks.size(), threads, [&](long i)
+	{
+		OBJRecordCounts cursor = chunks[i].start;
+		chunks[i].bounds.Reset();
+		if (mbCancelled)
+			return;
+		ParseRecords(chunks[i].begin, chunks[i].end, cursor, chunks[i].polygons, chunks[i].bounds);
+		ReportProgress(PROGRESS_COUNTED + (PROGRESS_PARSED - PROGRESS_COUNTED)*++chunksDone/chunks.size());
+	});
+	
+	file.Close();
+	mLoadStats.times.parse = timer.Lap();
+	if (!ReportProgress(PROGRESS_PARSED))
+		return FailLoad(OBJ_LOAD_CANCELLED);
+	
+	//merged in file order so the sums come out the same for any thread count
+	bounds.Reset();
+	for (size_t i = 0; i < chunks.size(); ++i)
+	{
+		mPolygons.insert(mPolygons.end(), chunks[i].polygons.begin(), chunks[i].polygons.end());
+		bounds.Merge(chunks[i].bounds);
+	}
+	
+	//the chunks are kept as the blocks FindChanges compares the file against
+	if (mbTrackChanges)
+	{
+		mFileBlocks.resize(chunks.size());
+		for (size_t i = 0; i < chunks.size(); ++i)
+			KeepBlock(chunks[i], data, mFileBlocks[i]);
+		mFileSize = end - data;
+	}
+	
+	if (FinishLoad(bounds) != 0)
+	{
+		Release();
+		return -1;
+	}
+	
+	if (mbUseCache && WriteCache(fileName) != 0)
+		std::cout << "Could not write the mesh cache" << std::endl;
+	return 0;
+}
+
+//2D cross product of (b - a) and (c - b), positive for a left turn
+static inline float Turn(const float* a, const float* b, const float* c)
+{
+	return (b[0] - a[0])*(c[1] - b[1]) - (b[1] - a[1])*(c[0] - b[0]);
+}
+
+static inline bool InTriangle(const float* p, const float* a, const float* b, const float* c)
+{
+	return Turn(a, b, p) >= 0.0f && Turn(b, c, p) >= 0.0f && Turn(c, a, p) >= 0.0f;
+}
+
+//splits a polygon, projected to 2D with counter-clockwise winding, into
+//corners - 2 triangles of corner numbers by ear clipping
+static void ClipEars(const std::vector<float> &points, std::vector<long> &remaining, std::vector<long> &triangles)
+{
+	long count = (long) remaining.size();
+	
+	triangles.clear();
+	while (count > 3)
+	{
+		long ear = -1;
 		
-    inOBJ.clear();
-	inOBJ.seekg (0, std::ios::beg);	
-	
-	//second pass
-	while(!inOBJ.eof())
-    {        
-        std::getline(inOBJ, line);
-        type = line.substr(0,2);
-        
-        // Positions
-        if(type.compare("v ") == 0)
-        {
-            char* ln = new char[line.size()+1];
-            memcpy(ln, line.c_str(), line.size()+1);
-            
-            // Extract tokens
-            strtok_s(ln, " ", &nextToken);
-			mVertexBuffer[4*itrP ] = (float) atof(strtok_s(NULL, " ", &nextToken));
-			mVertexBuffer[4*itrP + 1] = (float) atof(strtok_s(NULL, " ", &nextToken));
-			mVertexBuffer[4*itrP + 2] = (float) atof(strtok_s(NULL, " ", &nextToken));
-            
-			delete[] ln;
-            ++itrP;
-        }
-        
-        else if(type.compare("vt") == 0)
-        {
-            char* ln = new char[line.size()+1];
-            memcpy(ln, line.c_str(), line.size()+1);
-            
-            strtok_s(ln, " ", &nextToken);
-            mTextureBuffer[2*itrT ] = (float) atof(strtok_s(NULL, " ", &nextToken));
-			mTextureBuffer[2*itrT + 1] = (float) atof(strtok_s(NULL, " ", &nextToken));
-            
-			delete[] ln;
-            ++itrT;
-        }
-        
-        // mNormalBuffer
-        else if(type.compare("vn") == 0)
-        {
-            char* ln = new char[line.size()+1];
-            memcpy(ln, line.c_str(), line.size()+1);
-            
-            strtok_s(ln, " ", &nextToken);
-            mNormalBuffer[3*itrN ] = (float) atof(strtok_s(NULL, " ", &nextToken));
-			mNormalBuffer[3*itrN + 1] = (float) atof(strtok_s(NULL, " ", &nextToken));
-			mNormalBuffer[3*itrN + 2] = (float) atof(strtok_s(NULL, " ", &nextToken));
-            
-			delete[] ln;
-            ++itrN;
-        }
-        
-        // Faces
-        else if(type.compare("f ") == 0)
-        {
-			const char* ln = line.c_str();
-			fV = fT = fN = 0;		
-			offset = count = 0;
+		for (long i = 0; i < count && ear < 0; ++i)
+		{
+			const float* a = &points[2*remaining[(i + count - 1) % count]];
+			const float* b = &points[2*remaining[i]];
+			const float* c = &points[2*remaining[(i + 1) % count]];
+			
+			//a reflex or flat corner is never an ear
+			if (Turn(a, b, c) <= 0.0f)
+				continue;
 			
-			sscanf_s(ln, "%*s%n", &count);
-			offset = count;
-
-            if (strstr(ln, "//"))
-            {
-				sscanf_s(ln + offset, "%d//%d%n", &fV, &fN, &count);				
-				mIndexBufferV[3*itrF ] = fV < 0 ? fV + mVertexCount -1: fV -1;
-				mIndexBufferN[3*itrF ] = fN < 0 ? fN + mNormalCount -1: fN -1;	
-				offset += count;
-
-				sscanf_s(ln + offset, "%d//%d%n", &fV, &fN, &count);				
-				mIndexBufferV[3*itrF + 1] = fV < 0 ? fV + mVertexCount -1: fV -1;
-				mIndexBufferN[3*itrF + 1] = fN < 0 ? fN + mNormalCount -1: fN -1;	
-				offset += count;
-
-				sscanf_s(ln + offset, "%d//%d%n", &fV, &fN, &count);				
-				mIndexBufferV[3*itrF + 2] = fV < 0 ? fV + mVertexCount -1: fV -1;
-				mIndexBufferN[3*itrF + 2] = fN < 0 ? fN + mNormalCount -1: fN -1;	
-				offset += count;
-				//printf("%d %d %d\n", mIndexBufferV[3*itrF],mIndexBufferV[3*itrF+1],mIndexBufferV[3*itrF+2]);
-
-            }
-            else if (sscanf_s(ln + offset, "%d/%d/%d%n", &fV, &fT, &fN, &count) == 3)
-            {
-                mIndexBufferV[3*itrF ] = fV < 0 ? fV + mVertexCount -1: fV -1;
-				mIndexBufferT[3*itrF ] = fT < 0 ? fT + mTexelCount -1: fT -1;
-				mIndexBufferN[3*itrF ] = fN < 0 ? fN + mNormalCount -1: fN -1;	
-				offset += count;
-
-				sscanf_s(ln + offset, "%d/%d/%d%n", &fV, &fT, &fN, &count);				
-				mIndexBufferV[3*itrF + 1] = fV < 0 ? fV + mVertexCount -1: fV -1;
-				mIndexBufferT[3*itrF + 1] = fT < 0 ? fT + mTexelCount -1: fT -1;
-				mIndexBufferN[3*itrF + 1] = fN < 0 ? fN + mNormalCount -1: fN -1;	
-				offset += count;
-
-				sscanf_s(ln + offset, "%d/%d/%d%n", &fV, &fT, &fN, &count);				
-				mIndexBufferV[3*itrF + 2] = fV < 0 ? fV + mVertexCount -1: fV -1;
-				mIndexBufferT[3*itrF + 2] = fT < 0 ? fT + mTexelCount -1: fT -1;
-				mIndexBufferN[3*itrF + 2] = fN < 0 ? fN + mNormalCount -1: fN -1;	
-				offset += count;
-            }
-			else if (sscanf_s(ln + offset, "%d/%d%n", &fV, &fT, &count ) == 2)
+			ear = i;
+			for (long j = 0; j < count; ++j)
 			{
-				mIndexBufferV[3*itrF ] = fV < 0 ? fV + mVertexCount -1: fV -1;
-				mIndexBufferT[3*itrF ] = fT < 0 ? fT + mTexelCount -1: fT -1;
-				offset += count;
-
-				sscanf_s(ln + offset, "%d/%d%n", &fV, &fT, &count );				
-				mIndexBufferV[3*itrF + 1] = fV < 0 ? fV + mVertexCount -1: fV -1;
-				mIndexBufferT[3*itrF + 1] = fT < 0 ? fT + mTexelCount -1: fT -1;
-				offset += count;
-
-				sscanf_s(ln + offset, "%d/%d%n", &fV, &fT, &count );				
-				mIndexBufferV[3*itrF + 2] = fV < 0 ? fV + mVertexCount -1: fV -1;
-				mIndexBufferT[3*itrF + 2] = fT < 0 ? fT + mTexelCount -1: fT -1;
-				offset += count;
+				const float* p = &points[2*remaining[j]];
+				if (j != i && j != (i + 1) % count && j != (i + count - 1) % count &&
+					p != a && p != b && p != c && InTriangle(p, a, b, c))
+				{
+					ear = -1;
+					break;
+				}
 			}
-			else
-			{
-				sscanf_s(ln + offset, "%d%n", &fV, &count );
-				mIndexBufferV[3*itrF ] = fV < 0 ? fV + mVertexCount -1: fV -1;
-				offset += count;
-
-				sscanf_s(ln + offset, "%d%n", &fV, &count );				
-				mIndexBufferV[3*itrF + 1] = fV < 0 ? fV + mVertexCount -1: fV-1;
-				offset += count;
+		}
+		
+		//self-intersecting or degenerate outlines have no ear left, cut the next corner
+		if (ear < 0)
+			ear = 0;
+		
+		triangles.push_back(remaining[(ear + count - 1) % count]);
+		triangles.push_back(remaining[ear]);
+		triangles.push_back(remaining[(ear + 1) % count]);
+		remaining.erase(remaining.begin() + ear);
+		--count;
+	}
+	triangles.insert(triangles.end(), remaining.begin(), remaining.end());
+}
 
-				sscanf_s(ln + offset, "%d%n", &fV, &count );			
-				mIndexBufferV[3*itrF + 2] = fV < 0 ? fV + mVertexCount -1: fV-1;
-				offset += count;				
-			}
-            ++itrF;
-        }
-    }	
+//polygons are parsed as fans, which is only right when they are convex,
+//the concave ones are re-triangulated in place by ear clipping, the
+//triangle count of a polygon does not change so nothing is reallocated
+void OBJClass::TriangulatePolygons()
+{
+	const long POLYGONS_PER_TASK = 4096;
+	long tasks = ((long) mPolygons.size() + POLYGONS_PER_TASK - 1) / POLYGONS_PER_TASK;
 	
-	fVmax = fTmax = fNmax = 0;
-
-	//find the maximum index in the faces
-	for(long i=0; i < mFaceCount*3; ++i)
+	ParallelFor(tasks, mThreadCount, [&](long task)
 	{
-		if (mIndexBufferV[i] > fVmax )
-			fVmax = mIndexBufferV[i];
+		std::vector<long> cornersV, cornersT, cornersN, remaining, triangles;
+		std::vector<float> points;
+		long last = std::min((long) mPolygons.size(), (task + 1)*POLYGONS_PER_TASK);
 		
-		if (mTexelCount > 0)
+		for (long i = task*POLYGONS_PER_TASK; i < last; ++i)
 		{
-			if (mIndexBufferT[i] > fTmax )
-				fTmax = mIndexBufferT[i];
+			const OBJPolygon &polygon = mPolygons[i];
+			long* fanV = mIndexBufferV + 3*polygon.firstTriangle;
+			long* fanT = mIndexBufferT ? mIndexBufferT + 3*polygon.firstTriangle : NULL;
+			long* fanN = mIndexBufferN ? mIndexBufferN + 3*polygon.firstTriangle : NULL;
+			long n = polygon.corners;
+			float normal[3] = {0.0f, 0.0f, 0.0f};
+			int axisU, axisV, axis = 0;
+			float area = 0.0f;
+			bool bConvex = true;
+			
+			//corners 0 and 1 start the fan, every triangle adds one corner
+			cornersV.resize(n);
+			cornersT.resize(n);
+			cornersN.resize(n);
+			for (long k = 0; k < n; ++k)
+			{
+				long slot = k < 2 ? k : 3*(k - 2) + 2;
+				cornersV[k] = fanV[slot];
+				cornersT[k] = fanT ? fanT[slot] : 0;
+				cornersN[k] = fanN ? fanN[slot] : 0;
+			}
+			
+			//Newell's normal picks the plane to project the polygon onto
+			for (long k = 0; k < n; ++k)
+			{
+				const float* a = mVertexBuffer + 4*cornersV[k];
+				const float* b = mVertexBuffer + 4*cornersV[(k + 1) % n];
+				normal[0] += (a[1] - b[1])*(a[2] + b[2]);
+				normal[1] += (a[2] - b[2])*(a[0] + b[0]);
+				normal[2] += (a[0] - b[0])*(a[1] + b[1]);
+			}
+			if (fabs(normal[1]) > fabs(normal[axis]))
+				axis = 1;
+			if (fabs(normal[2]) > fabs(normal[axis]))
+				axis = 2;
+			axisU = (axis + 1) % 3;
+			axisV = (axis + 2) % 3;
+			
+			points.resize(2*n);
+			for (long k = 0; k < n; ++k)
+			{
+				points[2*k] = mVertexBuffer[4*cornersV[k] + axisU];
+				points[2*k + 1] = mVertexBuffer[4*cornersV[k] + axisV];
+			}
+			
+			//make the projected outline counter-clockwise
+			for (long k = 0; k < n; ++k)
+			{
+				long next = (k + 1) % n;
+				area += points[2*k]*points[2*next + 1] - points[2*next]*points[2*k + 1];
+			}
+			if (area < 0.0f)
+			{
+				for (long k = 0; k < n; ++k)
+					points[2*k + 1] = -points[2*k + 1];
+			}
+			
+			for (long k = 0; k < n && bConvex; ++k)
+			{
+				bConvex = Turn(&points[2*((k + n - 1) % n)], &points[2*k], &points[2*((k + 1) % n)]) >= 0.0f;
+			}
+			if (bConvex)
+				continue;
+			
+			remaining.resize(n);
+			for (long k = 0; k < n; ++k)
+				remaining[k] = k;
+			ClipEars(points, remaining, triangles);
+			
+			for (long k = 0; k < 3*(n - 2); ++k)
+			{
+				fanV[k] = cornersV[triangles[k]];
+				if (fanT)
+					fanT[k] = cornersT[triangles[k]];
+				if (fanN)
+					fanN[k] = cornersN[triangles[k]];
+			}
 		}
-		if (mNormalCount > 0)
+	});
+	
+	mPolygons.clear();
+}
+
+//faces validated per task by FinishLoad
+static const long VALIDATE_BLOCK_FACES = 1 << 16;
+
+//checks the parsed indices and derives everything else from the raw buffers
+//and the bounds gathered while parsing, shared by Load and OBJStream, the
+//finished model is built in the mesh arena and the raw buffers are not used
+//any more afterwards
+int OBJClass::FinishLoad(const OBJBounds &bounds)
+{
+	std::atomic<bool> bIndexError(false), bMissingNormals(false);
+	long blocks = (mFaceCount + VALIDATE_BLOCK_FACES - 1) / VALIDATE_BLOCK_FACES;
+	int stage = 0;
+	PhaseTimer timer;
+	//the progress moves on after every stage, which is also where a cancel stops the load
+	auto nextStage = [&]()
+	{
+		return ReportProgress(PROGRESS_PARSED + (1.0f - PROGRESS_PARSED)*++stage/FINISH_STAGES);
+	};
+	//corner i refers to an element the file does not define, a texel or
+	//normal the corner leaves out is not an error
+	auto isBadCorner = [&](long i)
+	{
+		return (mIndexBufferV[i] < 0 || mIndexBufferV[i] >= mVertexCount) ||
+			(mTexelCount > 0 && mIndexBufferT[i] != OBJ_MISSING_INDEX &&
+				(mIndexBufferT[i] < 0 || mIndexBufferT[i] >= mTexelCount)) ||
+			(mNormalCount > 0 && mIndexBufferN[i] != OBJ_MISSING_INDEX &&
+				(mIndexBufferN[i] < 0 || mIndexBufferN[i] >= mNormalCount));
+	};
+	
+	if ( mVertexCount == 0 || mFaceCount == 0)
+		return FailLoad(OBJ_LOAD_EMPTY);
+	
+	//every index in the faces must refer to data in the file,
+	//otherwise this model is missing data
+	ParallelFor(blocks, mThreadCount, [&](long block)
+	{
+		long first = block*VALIDATE_BLOCK_FACES*3;
+		long last = std::min(mFaceCount, (block + 1)*VALIDATE_BLOCK_FACES)*3;
+		
+		bool bMissing = false;
+		
+		for(long i = first; i < last && !bIndexError; ++i)
 		{
-			if (mIndexBufferN[i] > fNmax )
-				fNmax = mIndexBufferN[i];
+			if (isBadCorner(i))
+				bIndexError = true;
+			bMissing |= mNormalCount > 0 && mIndexBufferN[i] == OBJ_MISSING_INDEX;
 		}
-	}
-
-	//if maximum index in the faces are larger than my vertex/normal/texel counts, 
-	//then this model is missing data
-	if ( fVmax > mVertexCount || (mNormalCount > 0 && fNmax > mNormalCount) || (mTexelCount > 0 && fTmax > mTexelCount) )
+		if (bMissing)
+			bMissingNormals = true;
+	});
+	
+	mLoadStats.times.validate = timer.Lap();
+	if (bIndexError)
 	{
-		return -1;
+		//the blocks stop at the first error any of them finds, so the first
+		//bad triangle is searched for again, which only failed loads pay for
+		long i = 0;
+		while (!isBadCorner(i))
+			++i;
+		mLoadStats.badTriangle = i / 3;
+		mPolygons.clear();
+		return FailLoad(OBJ_LOAD_BAD_INDEX);
 	}
-
-	mTotalConnectTriangles = mFaceCount*3;
+	if (!nextStage())
+		return FailLoad(OBJ_LOAD_CANCELLED);
 	
-	CalcMaxMin();
-	CalcScale();
-	//CalcCenter();
+	TriangulatePolygons();
+	mLoadStats.times.triangulate = timer.Lap();
+	if (!nextStage())
+		return FailLoad(OBJ_LOAD_CANCELLED);
 	
-	for (long i = 0; i < mVertexCount*4; i = i+4)
+	//the scale is known before the vertices are copied, so the copy writes w
+	for (int i = 0; i < 3; ++i)
 	{
-		mVertexBuffer[i + 3] = mScale;
+		mVmin[i] = bounds.vmin[i];
+		mVmax[i] = bounds.vmax[i];
+		mCenter[i] = bounds.count > 0 ? (float)(bounds.sum[i] / bounds.count) : 0.0f;
 	}
+	CalcScale();
+	mLoadStats.times.scale = timer.Lap();
 	
-	RemakeNormals();
-	//RemakeTextures();
-	    
-	// Close OBJ file
-    inOBJ.close();
-    
-    return 0;
-}
-
-void OBJClass::CalcMaxMin()
-{
-	mVmax[0] = mVmax[1] = mVmax[2] = 0.0f;
-	mVmin[0] = mVmin[1] = mVmin[2] = 0.0f;
+	//the runs of faces follow from the markers alone, so the copy of the faces can already sort them
+	PlanParts();
+	mLoadStats.times.materials = timer.Lap();
+	
+	if (UnifyVertices() != 0)
+		return FailLoad(OBJ_LOAD_OUT_OF_MEMORY);
+	mLoadStats.times.unify = timer.Lap();
+	if (!nextStage())
+		return FailLoad(OBJ_LOAD_CANCELLED);
 
-	for (long i = 0; i < mVertexCount*4; i = i+4)
-	{
-		if ( mVertexBuffer[i] > mVmax[0])
-			mVmax[0] = mVertexBuffer[i];
-		if (mVertexBuffer[i+1] > mVmax[1])
-			mVmax[1] = mVertexBuffer[i+1];
-		if (mVertexBuffer[i+2] > mVmax[2])
-			mVmax[2] = mVertexBuffer[i+2];
-		
-		if ( mVertexBuffer[i] < mVmin[0])
-			mVmin[0] = mVertexBuffer[i];
-		if (mVertexBuffer[i+1] < mVmin[1])
-			mVmin[1] = mVertexBuffer[i+1];
-		if (mVertexBuffer[i+2] < mVmin[2])
-			mVmin[2] = mVertexBuffer[i+2];
-	}	
+	mTotalConnectTriangles = mFaceCount*3;
+	
+	mbGeneratedNormals = mNormalCount == 0 || bMissingNormals;
+	if (mNormalCount == 0 && CreateNewNormals() != 0)
+		return FailLoad(OBJ_LOAD_OUT_OF_MEMORY);
+	if (bMissingNormals && CreateMissingNormals() != 0)
+		return FailLoad(OBJ_LOAD_OUT_OF_MEMORY);
+	mLoadStats.times.normals = timer.Lap();
+	if (!nextStage())
+		return FailLoad(OBJ_LOAD_CANCELLED);
+	
+	if (BuildParts() != 0)
+		return FailLoad(OBJ_LOAD_OUT_OF_MEMORY);
+	mLoadStats.times.materials += timer.Lap();
+	if (!nextStage())
+		return FailLoad(OBJ_LOAD_CANCELLED);
+	
+	if (mbOptimizeVertexCache && OptimizeVertexOrder() != 0)
+		return FailLoad(OBJ_LOAD_OUT_OF_MEMORY);
+	mLoadStats.times.optimize = timer.Lap();
+	if (!nextStage())
+		return FailLoad(OBJ_LOAD_CANCELLED);
+	
+	mLevels[0].indices = mIndexBufferV;
+	mLevels[0].triangleCount = mFaceCount;
+	mLevels[0].error = 0.0f;
+	mLevelCount = 1;
+	if (mbBuildLevels && (BuildLevels() != 0 || SortLevelsByMaterial() != 0))
+		return FailLoad(OBJ_LOAD_OUT_OF_MEMORY);
+	mLoadStats.times.levels = timer.Lap();
+	if (!nextStage())
+		return FailLoad(OBJ_LOAD_CANCELLED);
+	
+	if (mbBuildMeshlets && BuildMeshlets() != 0)
+		return FailLoad(OBJ_LOAD_OUT_OF_MEMORY);
+	mLoadStats.times.meshlets = timer.Lap();
+	
+	mLoadStats.peakBytes = mMesh.GetPeak() + mScratch.GetPeak();
+	mScratch.Reset();
+	return 0;
 }
 
 void OBJClass::CalcScale()
@@ -350,179 +901,1037 @@ void OBJClass::CalcScale()
 	mScale = sqrt(mScale)/7.2f;
 }
 
-void OBJClass::RemakeNormals()
+//hash of a face corner's (v, vt, vn) triple
+static inline unsigned int HashCorner(long v, long t, long n)
 {
-	bool bRemakeNormal = false;
+	unsigned int h = (unsigned int) v * 0x9E3779B1u;
+	h ^= (unsigned int) t * 0x85EBCA77u + (h << 6) + (h >> 2);
+	h ^= (unsigned int) n * 0xC2B2AE3Du + (h << 6) + (h >> 2);
+	h ^= h >> 16;
+	h *= 0x7FEB352Du;
+	h ^= h >> 15;
+	return h;
+}
+
+//corners handled per task by UnifyVertices
+static const long UNIFY_BLOCK_CORNERS = 1 << 16;
+
+//copies a position with w set to mScale, radius2 keeps the largest squared
+//distance from mCenter, which gives the bounding radius without another pass
+inline void OBJClass::CopyPosition(float* to, const float* from, float &radius2)
+{
+	float dx = from[0] - mCenter[0], dy = from[1] - mCenter[1], dz = from[2] - mCenter[2];
+	float distance2 = dx*dx + dy*dy + dz*dz;
 	
-	if ( mNormalCount > 0)
+	to[0] = from[0];
+	to[1] = from[1];
+	to[2] = from[2];
+	to[3] = mScale;
+	if (distance2 > radius2)
+		radius2 = distance2;
+}
+
+//OBJ files index positions, texels and normals separately, OpenGL needs one
+//index per vertex, so every distinct (v, vt, vn) triple of the faces becomes
+//a vertex of its own, found through an open-addressing hash table whose
+//slots hold the first corner that used the triple
+int OBJClass::UnifyVertices()
+{
+	const long EMPTY = -1;
+	long corners = mFaceCount*3;
+	long blocks = (corners + UNIFY_BLOCK_CORNERS - 1) / UNIFY_BLOCK_CORNERS;
+	long tableSize = 1024, mask, uniqueCount = 0;
+	long estimate = std::max(mVertexCount, std::max(mNormalCount, mTexelCount));
+	std::atomic<long>* slots = NULL;
+	bool bNormals = mNormalBuffer != NULL, bTextures = mTextureBuffer != NULL;
+	std::vector<long> blockStart(blocks + 1, 0);
+	std::vector<float> blockRadius(std::max(blocks, 1L), 0.0f);	// Squared, largest per block
+	std::atomic<bool> bOverflow(false), bSameIndices(true);
+	long* newIndexBuffer;
+	long* newVertexIds;
+	float *newVertexBuffer, *newNormalBuffer, *newTextureBuffer;
+	//faces planned to be sorted by material are written at their sorted places
+	const std::vector<OBJPartRun> &runs = mParts.runs;
+	bool bSortRuns = mParts.bSortRuns && !runs.empty();
+	//a parse that keeps its blocks also keeps where every vertex came from
+	bool bSources = !mFileBlocks.empty();
+	long* sources;
+	
+	//files that already use one index per vertex, or have no other indices,
+	//only need their buffers copied to the mesh arena
+	if (mIndexBufferN != NULL || mIndexBufferT != NULL)
 	{
-		if ( mVertexCount != mNormalCount )
+		ParallelFor(blocks, mThreadCount, [&](long block)
 		{
-			bRemakeNormal = true;
-		}
-		else
+			long last = std::min(corners, (block + 1)*UNIFY_BLOCK_CORNERS);
+			for (long i = block*UNIFY_BLOCK_CORNERS; i < last && bSameIndices; ++i)
+			{
+				if ((mIndexBufferN != NULL && mIndexBufferN[i] != mIndexBufferV[i]) ||
+					(mIndexBufferT != NULL && mIndexBufferT[i] != mIndexBufferV[i]))
+					bSameIndices = false;
+			}
+		});
+	}
+	if (bSameIndices && (mNormalCount == 0 || mNormalCount == mVertexCount) &&
+		(mTexelCount == 0 || mTexelCount == mVertexCount))
+	{
+		if (ReserveMesh(mVertexCount, bTextures) != 0)
+			return -1;
+		
+		newVertexBuffer = mMesh.Allocate<float>(mVertexCount*4);
+		newNormalBuffer = mMesh.Allocate<float>(mVertexCount*3);
+		newTextureBuffer = bTextures ? mMesh.Allocate<float>(mVertexCount*2) : NULL;
+		newIndexBuffer = mMesh.Allocate<long>(corners);
+		mVertexSources.resize(bSources ? mVertexCount*3 : 0);
+		sources = mVertexSources.data();
+		blockRadius.assign((mVertexCount + UNIFY_BLOCK_CORNERS - 1) / UNIFY_BLOCK_CORNERS, 0.0f);
+		ParallelFor((long) blockRadius.size(), mThreadCount, [&](long block)
 		{
-			for(long i=0; i < mFaceCount; ++i)
+			long last = std::min(mVertexCount, (block + 1)*UNIFY_BLOCK_CORNERS);
+			float radius = 0.0f;
+			
+			for (long v = block*UNIFY_BLOCK_CORNERS; v < last; ++v)
 			{
-				if (mIndexBufferV[i] != mIndexBufferN[i])
+				CopyPosition(newVertexBuffer + 4*v, mVertexBuffer + 4*v, radius);
+				if (bSources)
 				{
-					bRemakeNormal= true;
-					break;
+					sources[3*v] = v;
+					sources[3*v + 1] = bTextures ? v : -1;
+					sources[3*v + 2] = bNormals ? v : -1;
 				}
 			}
-		}	
+			blockRadius[block] = radius;
+		});
+		if (bNormals)
+			memcpy(newNormalBuffer, mNormalBuffer, mVertexCount*3*sizeof(float));
+		if (bTextures)
+			memcpy(newTextureBuffer, mTextureBuffer, mVertexCount*2*sizeof(float));
+		if (bSortRuns)
+		{
+			ParallelFor((long) runs.size(), mThreadCount, [&](long r)
+			{
+				memcpy(newIndexBuffer + 3*runs[r].sortedFirst, mIndexBufferV + 3*runs[r].first,
+					runs[r].count*3*sizeof(long));
+			});
+		}
+		else
+			memcpy(newIndexBuffer, mIndexBufferV, corners*sizeof(long));
+		
+		mVertexBuffer = newVertexBuffer;
+		mNormalBuffer = newNormalBuffer;
+		mTextureBuffer = newTextureBuffer;
+		mIndexBufferV = newIndexBuffer;
+		mIndexBufferN = mIndexBufferT = NULL;
+		mNormalCount = bNormals ? mVertexCount : 0;
+		mRadius = sqrtf(*std::max_element(blockRadius.begin(), blockRadius.end()));
+		return 0;
 	}
-	else
+	
+	auto sameCorner = [&](long a, long b)
+	{
+		return mIndexBufferV[a] == mIndexBufferV[b] &&
+			(mIndexBufferT == NULL || mIndexBufferT[a] == mIndexBufferT[b]) &&
+			(mIndexBufferN == NULL || mIndexBufferN[a] == mIndexBufferN[b]);
+	};
+	auto hashCorner = [&](long c)
 	{
-		CreateNewNormals();
-	}	
+		return (long)(HashCorner(mIndexBufferV[c], mIndexBufferT ? mIndexBufferT[c] : 0,
+			mIndexBufferN ? mIndexBufferN[c] : 0) & (unsigned int) mask);
+	};
 	
-	if (bRemakeNormal)
+	//the table starts at twice the largest attribute count and doubles
+	//whenever the distinct triples fill more than three quarters of it
+	while (tableSize < estimate*2)
+		tableSize *= 2;
+	for (;;)
 	{
-		float* newnormalbuffer = new float[mVertexCount*3]();
+		//a table that overflowed stays in the scratch arena until the load ends
+		mask = tableSize - 1;
+		slots = (std::atomic<long>*) mScratch.Allocate(tableSize*sizeof(std::atomic<long>));
+		if (slots == NULL)
+			return -1;
+		bOverflow = false;
+		
+		ParallelFor((tableSize + UNIFY_BLOCK_CORNERS - 1) / UNIFY_BLOCK_CORNERS, mThreadCount, [&](long block)
+		{
+			long last = std::min(tableSize, (block + 1)*UNIFY_BLOCK_CORNERS);
+			for (long i = block*UNIFY_BLOCK_CORNERS; i < last; ++i)
+				new (&slots[i]) std::atomic<long>(EMPTY);
+		});
+		
+		//a slot only ever goes from empty to a corner and then to smaller
+		//corners with the same triple, so it ends up at the first use of
+		//its triple whatever order the threads run in
+		ParallelFor(blocks, mThreadCount, [&](long block)
+		{
+			long last = std::min(corners, (block + 1)*UNIFY_BLOCK_CORNERS);
+			
+			for (long c = block*UNIFY_BLOCK_CORNERS; c < last && !bOverflow; ++c)
+			{
+				long slot = hashCorner(c);
+				long probes = 0;
+				
+				for (;;)
+				{
+					long stored = slots[slot].load(std::memory_order_relaxed);
+					
+					if (stored == EMPTY)
+					{
+						if (slots[slot].compare_exchange_weak(stored, c, std::memory_order_relaxed))
+							break;
+						continue;
+					}
+					if (sameCorner(stored, c))
+					{
+						while (c < stored && !slots[slot].compare_exchange_weak(stored, c, std::memory_order_relaxed))
+						{
+						}
+						break;
+					}
+					
+					slot = (slot + 1) & mask;
+					if (++probes > tableSize/4)
+					{
+						bOverflow = true;
+						break;
+					}
+				}
+			}
+		});
 		
-		for(long i=0; i < mFaceCount; ++i)
+		if (!bOverflow)
 		{
-			newnormalbuffer[mIndexBufferV[i]] = mNormalBuffer[mIndexBufferN[i]];
-			newnormalbuffer[mIndexBufferV[i]+1] = mNormalBuffer[mIndexBufferN[i]+1];
-			newnormalbuffer[mIndexBufferV[i]+2] = mNormalBuffer[mIndexBufferN[i]+2];
+			//number the first use of every triple in corner order, per block first
+			ParallelFor(blocks, mThreadCount, [&](long block)
+			{
+				long last = std::min(corners, (block + 1)*UNIFY_BLOCK_CORNERS);
+				long count = 0;
+				
+				for (long c = block*UNIFY_BLOCK_CORNERS; c < last; ++c)
+				{
+					long slot = hashCorner(c);
+					while (!sameCorner(slots[slot].load(std::memory_order_relaxed), c))
+						slot = (slot + 1) & mask;
+					if (slots[slot].load(std::memory_order_relaxed) == c)
+						++count;
+				}
+				blockStart[block + 1] = count;
+			});
+			
+			for (long i = 0; i < blocks; ++i)
+				blockStart[i + 1] += blockStart[i];
+			uniqueCount = blockStart[blocks];
+			
+			if (uniqueCount*4 <= tableSize*3)
+				break;
 		}
 		
-		delete[] mNormalBuffer;
+		tableSize *= 2;
+	}
+	
+	newVertexIds = mScratch.Allocate<long>(tableSize);
+	if (newVertexIds == NULL || ReserveMesh(uniqueCount, bTextures) != 0)
+		return -1;
+	newVertexBuffer = mMesh.Allocate<float>(uniqueCount*4);
+	newNormalBuffer = mMesh.Allocate<float>(uniqueCount*3);
+	newTextureBuffer = bTextures ? mMesh.Allocate<float>(uniqueCount*2) : NULL;
+	newIndexBuffer = mMesh.Allocate<long>(corners);
+	mVertexSources.resize(bSources ? uniqueCount*3 : 0);
+	sources = mVertexSources.data();
+	
+	//the first use of a triple writes the new vertex and its number, every
+	//corner keeps the slot of its triple for the final pass
+	ParallelFor(blocks, mThreadCount, [&](long block)
+	{
+		long last = std::min(corners, (block + 1)*UNIFY_BLOCK_CORNERS);
+		long vertex = blockStart[block];
+		float radius = 0.0f;
+		size_t run = 0;
 		
-		mNormalBuffer = newnormalbuffer;
+		//the last run starting at or before the block's first triangle
+		if (bSortRuns)
+			run = std::upper_bound(runs.begin(), runs.end(), block*UNIFY_BLOCK_CORNERS/3,
+				[](long triangle, const OBJPartRun &r){return triangle < r.first;}) - runs.begin() - 1;
+		
+		for (long c = block*UNIFY_BLOCK_CORNERS; c < last; ++c)
+		{
+			long slot = hashCorner(c), to = c;
+			while (!sameCorner(slots[slot].load(std::memory_order_relaxed), c))
+				slot = (slot + 1) & mask;
+			if (bSortRuns)
+			{
+				while (c >= 3*(runs[run].first + runs[run].count))
+					++run;
+				to = c + 3*(runs[run].sortedFirst - runs[run].first);
+			}
+			newIndexBuffer[to] = slot;
+			
+			if (slots[slot].load(std::memory_order_relaxed) != c)
+				continue;
+			
+			CopyPosition(newVertexBuffer + 4*vertex, mVertexBuffer + 4*mIndexBufferV[c], radius);
+			//a corner without its own texel or normal starts at zero, the
+			//zero normal is generated once the vertices are known
+			if (bNormals)
+			{
+				if (mIndexBufferN == NULL)
+					memcpy(newNormalBuffer + 3*vertex, mNormalBuffer + 3*mIndexBufferV[c], 3*sizeof(float));
+				else if (mIndexBufferN[c] != OBJ_MISSING_INDEX)
+					memcpy(newNormalBuffer + 3*vertex, mNormalBuffer + 3*mIndexBufferN[c], 3*sizeof(float));
+				else
+					memset(newNormalBuffer + 3*vertex, 0, 3*sizeof(float));
+			}
+			if (bTextures)
+			{
+				if (mIndexBufferT == NULL)
+					memcpy(newTextureBuffer + 2*vertex, mTextureBuffer + 2*mIndexBufferV[c], 2*sizeof(float));
+				else if (mIndexBufferT[c] != OBJ_MISSING_INDEX)
+					memcpy(newTextureBuffer + 2*vertex, mTextureBuffer + 2*mIndexBufferT[c], 2*sizeof(float));
+				else
+					memset(newTextureBuffer + 2*vertex, 0, 2*sizeof(float));
+			}
+			if (bSources)
+			{
+				sources[3*vertex] = mIndexBufferV[c];
+				sources[3*vertex + 1] = !bTextures ? -1 : (mIndexBufferT == NULL ? mIndexBufferV[c] :
+					(mIndexBufferT[c] != OBJ_MISSING_INDEX ? mIndexBufferT[c] : -1));
+				sources[3*vertex + 2] = !bNormals ? -1 : (mIndexBufferN == NULL ? mIndexBufferV[c] :
+					(mIndexBufferN[c] != OBJ_MISSING_INDEX ? mIndexBufferN[c] : -1));
+			}
+			newVertexIds[slot] = vertex;
+			++vertex;
+		}
+		blockRadius[block] = radius;
+	});
+	
+	ParallelFor(blocks, mThreadCount, [&](long block)
+	{
+		long last = std::min(corners, (block + 1)*UNIFY_BLOCK_CORNERS);
+		for (long c = block*UNIFY_BLOCK_CORNERS; c < last; ++c)
+			newIndexBuffer[c] = newVertexIds[newIndexBuffer[c]];
+	});
+	
+	mVertexBuffer = newVertexBuffer;
+	mNormalBuffer = newNormalBuffer;
+	mTextureBuffer = newTextureBuffer;
+	mIndexBufferV = newIndexBuffer;
+	mIndexBufferN = mIndexBufferT = NULL;
+	
+	mVertexCount = uniqueCount;
+	mNormalCount = bNormals ? uniqueCount : 0;
+	mTexelCount = bTextures ? uniqueCount : 0;
+	mRadius = sqrtf(*std::max_element(blockRadius.begin(), blockRadius.end()));
+	return 0;
+}
+
+//sizes the mesh arena for the finished model in one allocation, normals
+//are always there since they are generated when the file has none and the
+//material and group of every face when the file names any
+int OBJClass::ReserveMesh(long vertexCount, bool bTextures)
+{
+	size_t size = MemoryArena::Align(vertexCount*4*sizeof(float)) +
+		MemoryArena::Align(vertexCount*3*sizeof(float)) +
+		(bTextures ? MemoryArena::Align(vertexCount*2*sizeof(float)) : 0) +
+		MemoryArena::Align(mFaceCount*3*sizeof(long)) +
+		(mParts.runs.empty() ? 0 : MemoryArena::Align(mFaceCount*sizeof(int))*2);
+	
+	if (mMesh.Reserve(size) != 0)
+	{
+		std::cout << "NOT ENOUGH MEMORY FOR THE MODEL" << std::endl;
+		return -1;
 	}
+	return 0;
+}
+
+//normals for files without any, weighted as set by SetNormalWeighting
+int OBJClass::CreateNewNormals()
+{
+	if (ComputeVertexNormals(mVertexBuffer, 4, mVertexCount, mIndexBufferV, mFaceCount,
+		mNormalBuffer, mNormalWeighting, mThreadCount, mScratch) != 0)
+		return -1;
+	
+	mNormalCount = mVertexCount;
+	return 0;
 }
 
-void OBJClass::CreateNewNormals()
+//normals for the vertices of a file that has normals but whose corners
+//left some out, those vertices hold a zero normal after UnifyVertices and
+//take the generated one, as does a zero normal of the file itself, the
+//others keep the normal of the file
+int OBJClass::CreateMissingNormals()
 {
-	float edge1[3], edge2[3], normal[3], length;
-	unsigned int i0, i1, i2;
+	float* generated = mScratch.Allocate<float>(mVertexCount*3);
+	long blocks = (mVertexCount + UNIFY_BLOCK_CORNERS - 1) / UNIFY_BLOCK_CORNERS;
 	
-	if ( mNormalBuffer == NULL)
-		mNormalBuffer  = new float[mVertexCount*3]();
+	if (generated == NULL || ComputeVertexNormals(mVertexBuffer, 4, mVertexCount, mIndexBufferV, mFaceCount,
+		generated, mNormalWeighting, mThreadCount, mScratch) != 0)
+		return -1;
 	
-	for (long i = 0; i < mFaceCount*3; i = i+3)
-    {
-        i0 = mIndexBufferV[i];
-		i1 = mIndexBufferV[i+1];
-		i2 = mIndexBufferV[i+2];
+	ParallelFor(blocks, mThreadCount, [&](long block)
+	{
+		long last = std::min(mVertexCount, (block + 1)*UNIFY_BLOCK_CORNERS);
+		for (long v = block*UNIFY_BLOCK_CORNERS; v < last; ++v)
+		{
+			float* normal = mNormalBuffer + 3*v;
+			if (normal[0] == 0.0f && normal[1] == 0.0f && normal[2] == 0.0f)
+				memcpy(normal, generated + 3*v, 3*sizeof(float));
+		}
+	});
+	return 0;
+}
 
-        // Calculate triangle face normal.
+//reorders the triangles for the post-transform cache and then the vertices
+//in the order the triangles use them, every buffer is per vertex by now,
+//a model with materials is sorted by material in between, which keeps the
+//cache order within each material
+int OBJClass::OptimizeVertexOrder()
+{
+	long* remap;
+	long* order = NULL;
+	
+	mCacheStatsBefore = AnalyzeVertexCache(mIndexBufferV, mFaceCount, mVertexCount,
+		VERTEX_CACHE_FIFO_SIZE, mScratch);
+	if (mFaceMaterials != NULL && (order = mScratch.Allocate<long>(mFaceCount)) == NULL)
+		return -1;
+	if (OptimizeVertexCache(mIndexBufferV, mFaceCount, mVertexCount, mScratch, order) != 0)
+		return -1;
+	if (mFaceMaterials != NULL && (ReorderFaces(order) != 0 || SortByMaterial() != 0))
+		return -1;
+	
+	remap = mScratch.Allocate<long>(mVertexCount);
+	if (remap == NULL)
+		return -1;
+	OptimizeVertexFetch(mIndexBufferV, mFaceCount, mVertexCount, remap);
+	if (RemapVertexBuffer(mVertexBuffer, 4, mVertexCount, remap, mScratch) != 0 ||
+		(mNormalBuffer != NULL && RemapVertexBuffer(mNormalBuffer, 3, mVertexCount, remap, mScratch) != 0) ||
+		(mTextureBuffer != NULL && RemapVertexBuffer(mTextureBuffer, 2, mVertexCount, remap, mScratch) != 0))
+		return -1;
+	if (!mVertexSources.empty())
+	{
+		std::vector<long> sources(mVertexSources.size());
+		for (long v = 0; v < mVertexCount; ++v)
+			memcpy(&sources[3*remap[v]], &mVertexSources[3*v], 3*sizeof(long));
+		mVertexSources.swap(sources);
+	}
+	
+	mCacheStatsAfter = AnalyzeVertexCache(mIndexBufferV, mFaceCount, mVertexCount,
+		VERTEX_CACHE_FIFO_SIZE, mScratch);
+	return 0;
+}
 
-        edge1[0] = mVertexBuffer[4*i1] - mVertexBuffer[4*i0]; 
-        edge1[1] = mVertexBuffer[4*i1 +1] - mVertexBuffer[4*i0 +1];
-        edge1[2] = mVertexBuffer[4*i1 +2] - mVertexBuffer[4*i0 +2];
+//each level is simplified from the one before, which costs less than starting
+//from the model every time, and the errors add up to a bound for the level,
+//the chain ends early once a level can not be made without too much error
+int OBJClass::BuildLevels()
+{
+	static const float LEVEL_RATIOS[OBJ_MAX_LEVELS - 1] = {0.5f, 0.25f, 0.1f, 0.02f};
+	static const float LEVEL_MAX_ERROR = 0.1f;	// Of the model's radius
+	
+	for (int level = 1; level < OBJ_MAX_LEVELS; ++level)
+	{
+		const OBJLevelOfDetail &finer = mLevels[level - 1];
+		OBJLevelOfDetail &coarser = mLevels[level];
+		long target = (long)(LEVEL_RATIOS[level - 1]*mFaceCount);
+		float allowed = LEVEL_MAX_ERROR*mRadius - finer.error;
+		long* indices;
+		long count;
+		float error;
+		
+		if (allowed <= 0.0f)
+			break;
+		
+		//the buffers are final, nothing the scratch arena holds is needed any more
+		mScratch.Reset();
+		indices = mScratch.Allocate<long>(finer.triangleCount*3);
+		if (indices == NULL)
+			return -1;
+		count = SimplifyMesh(mVertexBuffer, 4, mVertexCount, finer.indices, finer.triangleCount,
+			target, allowed, indices, error, mScratch);
+		if (count < 0)
+			return -1;
+		
+		//a level barely smaller than the one before is not worth drawing
+		if (count == 0 || count > finer.triangleCount - finer.triangleCount/8)
+			break;
+		if (mbOptimizeVertexCache && OptimizeVertexCache(indices, count, mVertexCount, mScratch) != 0)
+			return -1;
+		
+		coarser.indices = mMesh.Allocate<long>(count*3);
+		if (coarser.indices == NULL)
+		{
+			std::cout << "NOT ENOUGH MEMORY FOR THE LEVELS OF DETAIL" << std::endl;
+			return -1;
+		}
+		memcpy(coarser.indices, indices, count*3*sizeof(long));
+		coarser.triangleCount = count;
+		coarser.error = finer.error + error;
+		coarser.ranges = NULL;
+		coarser.rangeCount = 0;
+		mLevelCount = level + 1;
+	}
+	return 0;
+}
 
-        edge2[0] = mVertexBuffer[4*i2] - mVertexBuffer[4*i0];
-        edge2[1] = mVertexBuffer[4*i2 +1] - mVertexBuffer[4*i0 +1];
-        edge2[2] = mVertexBuffer[4*i2 +2] - mVertexBuffer[4*i0 +2];
+//meshlets are partitioned into a scratch array of the most there can be
+//and only the ones made are kept with the model
+int OBJClass::BuildMeshlets()
+{
+	Meshlet* meshlets = mScratch.Allocate<Meshlet>(MeshletBound(mFaceCount,
+		MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES));
+	long count;
+	
+	if (meshlets == NULL)
+		return -1;
+	count = PartitionMeshlets(mIndexBufferV, mFaceCount, MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES,
+		meshlets, mThreadCount, mScratch);
+	if (count < 0)
+		return -1;
+	
+	mMeshlets = mMesh.Allocate<Meshlet>(count);
+	if (mMeshlets == NULL)
+	{
+		std::cout << "NOT ENOUGH MEMORY FOR THE MESHLETS" << std::endl;
+		return -1;
+	}
+	memcpy(mMeshlets, meshlets, count*sizeof(Meshlet));
+	mMeshletCount = count;
+	ComputeMeshletBounds(mVertexBuffer, 4, mIndexBufferV, mMeshlets, mMeshletCount, mThreadCount);
+	return 0;
+}
 
-        normal[0] = (edge1[1] * edge2[2]) - (edge1[2] * edge2[1]);
-        normal[1] = (edge1[2] * edge2[0]) - (edge1[0] * edge2[2]);
-        normal[2] = (edge1[0] * edge2[1]) - (edge1[1] * edge2[0]);
+//reads the positions, texels and normals of [p, end) one after another into
+//the three buffers and adds the positions to bounds, the faces and every
+//other line are left out since FindChanges only reads stretches whose faces
+//did not change
+static void ParseAttributes(const char* p, const char* end, float* positions, float* texels, float* normals,
+	OBJBounds &bounds)
+{
+	while (p < end)
+	{
+		const char* lineEnd = OBJParser::FindLineEnd(p, end);
 
-        // Accumulate the normals.
+		if (lineEnd - p > 2)
+		{
+			if (p[0] == 'v' && OBJParser::IsBlank(p[1]))
+			{
+				OBJParser::ParseFloats(p + 2, lineEnd, positions, 3);
+				bounds.Add(positions);
+				positions += 4;
+			}
+			else if (p[0] == 'v' && p[1] == 't' && OBJParser::IsBlank(p[2]))
+			{
+				OBJParser::ParseFloats(p + 3, lineEnd, texels, 2);
+				texels += 2;
+			}
+			else if (p[0] == 'v' && p[1] == 'n' && OBJParser::IsBlank(p[2]))
+			{
+				OBJParser::ParseFloats(p + 3, lineEnd, normals, 3);
+				normals += 3;
+			}
+		}
+		p = lineEnd + 1;
+	}
+}
 
-        mNormalBuffer[3*i0] += normal[0];
-        mNormalBuffer[3*i0+1] += normal[1];
-        mNormalBuffer[3*i0+2] += normal[2];
+//the old blocks [firstBlock, lastBlock) whose bytes are now [begin, end) of
+//the file, split into the pieces [firstPiece, lastPiece)
+struct OBJChangedStretch
+{
+	size_t firstBlock;
+	size_t lastBlock;
+	const char* begin;
+	const char* end;
+	size_t firstPiece;
+	size_t lastPiece;
+};
 
-        mNormalBuffer[3*i1] += normal[0];
-        mNormalBuffer[3*i1+1] += normal[1];
-        mNormalBuffer[3*i1+2] += normal[2];
+//adds the range of one kind of element a stretch read, if it read any
+static void AddChangedRange(std::vector<OBJChangedRange> &ranges, long first, long count, long &offset)
+{
+	OBJChangedRange range = {first, count, offset};
 
-        mNormalBuffer[3*i2] += normal[0];
-        mNormalBuffer[3*i2+1] += normal[1];
-        mNormalBuffer[3*i2+2] += normal[2];
-    }
+	if (count == 0)
+		return;
+	ranges.push_back(range);
+	offset += count;
+}
 
-    // Normalize the vertex normals.
-    for (long i = 0; i < mVertexCount*3; i = i+3)
-    {
-        length = sqrtf(mNormalBuffer[i] * mNormalBuffer[i] +
-            mNormalBuffer[i+1] * mNormalBuffer[i+1] +
-            mNormalBuffer[i+2] * mNormalBuffer[i+2]);
+//the buffer position of raw element source among the changed ranges, -1 when it did not change
+static inline long FindChanged(const std::vector<OBJChangedRange> &ranges, long source)
+{
+	std::vector<OBJChangedRange>::const_iterator range = std::upper_bound(ranges.begin(), ranges.end(), source,
+		[](long element, const OBJChangedRange &r){return element < r.first;});
 
-        mNormalBuffer[i] /= length;
-        mNormalBuffer[i+1] /= length;
-        mNormalBuffer[i+2] /= length;
-    }
-	
-	mNormalCount = mVertexCount;
+	if (source < 0 || range == ranges.begin())
+		return -1;
+	--range;
+	return source < range->first + range->count ? range->offset + source - range->first : -1;
 }
 
-void OBJClass::RemakeTextures()
+//blocks that still hold their bytes are found first, the prefix at the same
+//offsets and after a change of size the suffix moved by it, a stretch that
+//changed is only read when its face and marker lines are the same as before
+//and it has as many records of each kind, hashes of every block that did not
+//change are taken at their word, the file is not compared byte by byte
+int OBJClass::FindChanges(const wchar_t* fileName, OBJFileChanges &changes)
 {
-	bool bRemakeTexture = false;	
+	MappedFile file;
+	std::vector<OBJChangedStretch> stretches;
+	std::vector<OBJChunk> pieces;
+	std::vector<OBJRecordCounts> blockStart(mFileBlocks.size() + 1);
+	const char *data, *end;
+	long blockCount = (long) mFileBlocks.size();
+	long long delta;
+	int threads = ResolveThreadCount(mThreadCount);
+	OBJRecordCounts offsets = {0, 0, 0, 0};
+	PhaseTimer timer;
 	
-	if ( mTexelCount > 0)
+	changes = OBJFileChanges();
+	changes.error = OBJ_LOAD_CHANGED_LAYOUT;
+	if (mFileBlocks.empty() || mVertexSources.empty())
+		return -1;
+	if (file.Open(fileName) != 0)
 	{
-		if ( mVertexCount != mTexelCount )
-		{
-			bRemakeTexture = true;
-		}
-		else
+		changes.error = OBJ_LOAD_OPEN_FAILED;
+		return -1;
+	}
+	data = file.GetData();
+	end = data + file.GetSize();
+	delta = (long long) file.GetSize() - (long long) mFileSize;
+	
+	//block b holds the same bytes shift bytes further on in the file
+	auto isSame = [&](long b, long long shift)
+	{
+		const OBJFileBlock &block = mFileBlocks[b];
+		long long at = (long long) block.offset + shift;
+		return at >= 0 && at + (long long) block.size <= end - data &&
+			OBJParser::HashBytes(data + at, block.size) == block.hash;
+	};
+	//how many of count blocks in a row pass matches, hashed in parallel a
+	//few blocks per thread at a time so little is hashed past the first miss
+	auto countMatching = [&](long count, std::function<bool(long)> matches)
+	{
+		long wave = threads*4;
+		std::vector<char> bMatched(wave);
+		
+		for (long first = 0; first < count; first += wave)
 		{
-			for(long i=0; i < mFaceCount; ++i)
+			long size = std::min(wave, count - first);
+			ParallelFor(size, threads, [&](long i){bMatched[i] = matches(first + i);});
+			for (long i = 0; i < size; ++i)
 			{
-				if (mIndexBufferV[i] != mIndexBufferT[i])
-				{
-					bRemakeTexture= true;
-					break;
-				}
+				if (!bMatched[i])
+					return first + i;
 			}
 		}
-	}	
+		return count;
+	};
 	
-	if (bRemakeTexture)
+	if (delta == 0)
 	{
-		float* newtexturebuffer = new float[mVertexCount*2]();
-		
-		for(long i=0; i < mFaceCount; ++i)
+		//every block is where it was, each run of blocks that changed is a stretch of its own
+		std::vector<char> bChanged(blockCount);
+		ParallelFor(blockCount, threads, [&](long b){bChanged[b] = !isSame(b, 0);});
+		for (long b = 0; b < blockCount; ++b)
 		{
-			newtexturebuffer[mIndexBufferV[i]] = mTextureBuffer[mIndexBufferT[i]];
-			newtexturebuffer[mIndexBufferV[i]+1] = mTextureBuffer[mIndexBufferT[i]+1];
+			if (!bChanged[b])
+				continue;
+			OBJChangedStretch stretch = {(size_t) b, (size_t) b, NULL, NULL, 0, 0};
+			while (b < blockCount && bChanged[b])
+				++b;
+			stretch.lastBlock = b;
+			stretches.push_back(stretch);
 		}
+	}
+	else
+	{
+		//the bytes between the blocks that stayed at the start and the ones that moved at the end
+		long prefix = countMatching(blockCount, [&](long b){return isSame(b, 0);});
+		long suffix = countMatching(blockCount - prefix, [&](long i){return isSame(blockCount - 1 - i, delta);});
+		OBJChangedStretch stretch = {(size_t) prefix, (size_t)(blockCount - suffix), NULL, NULL, 0, 0};
+		stretches.push_back(stretch);
+	}
+	
+	for (size_t i = 0; i < stretches.size(); ++i)
+	{
+		OBJChangedStretch &stretch = stretches[i];
+		unsigned long long from = stretch.firstBlock < mFileBlocks.size() ? mFileBlocks[stretch.firstBlock].offset : mFileSize;
+		unsigned long long to = stretch.lastBlock > stretch.firstBlock ?
+			mFileBlocks[stretch.lastBlock - 1].offset + mFileBlocks[stretch.lastBlock - 1].size : from;
+		long long newTo = (long long) to + delta;
 		
-		delete[] mTextureBuffer;
+		//the stretch has to start and end on a line of its own, or its lines run into the blocks around it
+		if (newTo < (long long) from || newTo > end - data ||
+			(from > 0 && (long long) from < newTo && data[from - 1] != '\n') ||
+			(newTo < end - data && newTo > (long long) from && data[newTo - 1] != '\n'))
+			return -1;
+		stretch.begin = data + from;
+		stretch.end = data + newTo;
+		stretch.firstPiece = pieces.size();
+		SplitChunks(stretch.begin, stretch.end, threads, CHANGE_BLOCK_SIZE, pieces);
+		stretch.lastPiece = pieces.size();
+		changes.bytesParsed += stretch.end - stretch.begin;
+	}
+	
+	ParallelFor((long) pieces.size(), threads, [&](long i)
+	{
+		pieces[i].structure.Reset();
+		CountRecords(pieces[i].begin, pieces[i].end, pieces[i].counts, pieces[i].lines, pieces[i].markers,
+			&pieces[i].structure);
+		pieces[i].hash = OBJParser::HashBytes(pieces[i].begin, pieces[i].end - pieces[i].begin);
+	});
+	changes.hashTime = timer.Lap();
+	
+	//raw elements before every block, where the elements of a stretch are numbered from
+	for (size_t b = 0; b < mFileBlocks.size(); ++b)
+	{
+		blockStart[b + 1].vertices = blockStart[b].vertices + mFileBlocks[b].counts.vertices;
+		blockStart[b + 1].texels = blockStart[b].texels + mFileBlocks[b].counts.texels;
+		blockStart[b + 1].normals = blockStart[b].normals + mFileBlocks[b].counts.normals;
+		blockStart[b + 1].faces = blockStart[b].faces + mFileBlocks[b].counts.faces;
+	}
+	
+	//the faces and markers of a stretch are the same when their hashes are,
+	//the elements only have to come out the same in number
+	for (size_t i = 0; i < stretches.size(); ++i)
+	{
+		const OBJChangedStretch &stretch = stretches[i];
+		const OBJRecordCounts &before = blockStart[stretch.firstBlock], &after = blockStart[stretch.lastBlock];
+		OBJRecordCounts counts = {0, 0, 0, 0};
+		OBJStructureHash oldStructure, newStructure;
 		
-		mTextureBuffer = newtexturebuffer;
-		newtexturebuffer = NULL;
+		oldStructure.Reset();
+		newStructure.Reset();
+		for (size_t b = stretch.firstBlock; b < stretch.lastBlock; ++b)
+			oldStructure.Append(mFileBlocks[b].structureHash, mFileBlocks[b].structureWeight);
+		for (size_t k = stretch.firstPiece; k < stretch.lastPiece; ++k)
+		{
+			//the pieces keep where their elements go in the changed buffers
+			pieces[k].start.vertices = offsets.vertices + counts.vertices;
+			pieces[k].start.texels = offsets.texels + counts.texels;
+			pieces[k].start.normals = offsets.normals + counts.normals;
+			counts.vertices += pieces[k].counts.vertices;
+			counts.texels += pieces[k].counts.texels;
+			counts.normals += pieces[k].counts.normals;
+			counts.faces += pieces[k].counts.faces;
+			newStructure.Append(pieces[k].structure.hash, pieces[k].structure.weight);
+		}
+		if (counts.vertices != after.vertices - before.vertices || counts.texels != after.texels - before.texels ||
+			counts.normals != after.normals - before.normals || counts.faces != after.faces - before.faces ||
+			newStructure.hash != oldStructure.hash || newStructure.weight != oldStructure.weight)
+			return -1;
+		
+		AddChangedRange(changes.positionRanges, before.vertices, counts.vertices, offsets.vertices);
+		AddChangedRange(changes.texelRanges, before.texels, counts.texels, offsets.texels);
+		AddChangedRange(changes.normalRanges, before.normals, counts.normals, offsets.normals);
 	}
+	
+	changes.positions.resize(offsets.vertices*4);
+	changes.texels.resize(offsets.texels*2);
+	changes.normals.resize(offsets.normals*3);
+	ParallelFor((long) pieces.size(), threads, [&](long i)
+	{
+		pieces[i].bounds.Reset();
+		ParseAttributes(pieces[i].begin, pieces[i].end, changes.positions.data() + 4*pieces[i].start.vertices,
+			changes.texels.data() + 2*pieces[i].start.texels, changes.normals.data() + 3*pieces[i].start.normals,
+			pieces[i].bounds);
+	});
+	
+	//the blocks of the file as it is now, the pieces take the place of the
+	//stretches they were cut from and the blocks after them move by delta
+	for (size_t b = 0, i = 0; b < mFileBlocks.size() || i < stretches.size(); )
+	{
+		if (i < stretches.size() && b == stretches[i].firstBlock)
+		{
+			for (size_t k = stretches[i].firstPiece; k < stretches[i].lastPiece; ++k)
+			{
+				changes.blocks.push_back(OBJFileBlock());
+				KeepBlock(pieces[k], data, changes.blocks.back());
+			}
+			b = stretches[i++].lastBlock;
+			continue;
+		}
+		changes.blocks.push_back(mFileBlocks[b++]);
+		if (delta != 0 && !stretches.empty() && b > stretches[0].lastBlock)
+			changes.blocks.back().offset += delta;
+	}
+	
+	changes.fileSize = file.GetSize();
+	changes.changedBlocks = (long) pieces.size();
+	changes.parseTime = timer.Lap();
+	changes.error = OBJ_LOAD_OK;
+	return 0;
 }
- 
-void OBJClass::Release()
+
+int OBJClass::ApplyChanges(OBJFileChanges &changes)
 {
-    if (this->mNormalBuffer!=NULL)
+	PhaseTimer timer;
+	OBJBounds bounds;
+	std::vector<char> bMoved;
+	long blocks = (mVertexCount + UNIFY_BLOCK_CORNERS - 1) / UNIFY_BLOCK_CORNERS;
+	std::vector<float> blockRadius(std::max(blocks, 1L), 0.0f);	// Squared, largest per block
+	bool bPositions = !changes.positionRanges.empty();
+	std::atomic<bool> bMissingNormals(false);
+	long fileNormals = 0;
+	
+	mLoadStats = OBJLoadStats();
+	mLoadStats.source = OBJ_SOURCE_PATCH;
+	mLoadStats.bytesRead = changes.bytesParsed;
+	mLoadStats.times.count = changes.hashTime;
+	mLoadStats.times.parse = changes.parseTime;
+	mScratch.ResetPeak();
+	if (changes.blocks.empty() || mVertexSources.size() != (size_t) mVertexCount*3)
+		return FailLoad(OBJ_LOAD_CHANGED_LAYOUT);
+	
+	//only lines without elements changed, comments say, the model stays as it is
+	if (!bPositions && changes.texelRanges.empty() && changes.normalRanges.empty())
 	{
-        delete[] mNormalBuffer;
-		mNormalBuffer = NULL;
+		mFileBlocks.swap(changes.blocks);
+		mFileSize = changes.fileSize;
+		mLoadStats.times.total = mLoadStats.times.count + mLoadStats.times.parse;
+		return 0;
 	}
-    if (this->mVertexBuffer!=NULL)
+	
+	//the bounds of the file follow from its blocks as they do from the chunks of a parse
+	bounds.Reset();
+	for (size_t b = 0; b < changes.blocks.size(); ++b)
 	{
-        delete[] mVertexBuffer;
-		mVertexBuffer = NULL;
+		const OBJFileBlock &block = changes.blocks[b];
+		OBJBounds blockBounds;
+		
+		blockBounds.Reset();
+		for (int i = 0; i < 3; ++i)
+		{
+			blockBounds.vmin[i] = block.vmin[i];
+			blockBounds.vmax[i] = block.vmax[i];
+			blockBounds.sum[i] = block.sum[i];
+		}
+		blockBounds.count = block.counts.vertices;
+		bounds.Merge(blockBounds);
+		fileNormals += block.counts.normals;
 	}
-	if (this->mTextureBuffer!=NULL)
+	for (int i = 0; i < 3; ++i)
 	{
-        delete[] mTextureBuffer;
-		mTextureBuffer = NULL;
+		mVmin[i] = bounds.vmin[i];
+		mVmax[i] = bounds.vmax[i];
+		mCenter[i] = bounds.count > 0 ? (float)(bounds.sum[i] / bounds.count) : 0.0f;
 	}
+	CalcScale();
+	mLoadStats.times.scale = timer.Lap();
+	
+	//every vertex gets the w of the new scale and its distance from the new
+	//centre, the ones made from a changed element are copied again
+	bMoved.assign(mVertexCount, 0);
+	ParallelFor(blocks, mThreadCount, [&](long block)
+	{
+		long last = std::min(mVertexCount, (block + 1)*UNIFY_BLOCK_CORNERS);
+		float radius = 0.0f;
+		
+		for (long v = block*UNIFY_BLOCK_CORNERS; v < last; ++v)
+		{
+			const long* source = &mVertexSources[3*v];
+			long position = FindChanged(changes.positionRanges, source[0]);
+			long texel = FindChanged(changes.texelRanges, source[1]);
+			long normal = FindChanged(changes.normalRanges, source[2]);
+			
+			CopyPosition(mVertexBuffer + 4*v, position >= 0 ? &changes.positions[4*position] : mVertexBuffer + 4*v, radius);
+			bMoved[v] = position >= 0;
+			if (texel >= 0)
+				memcpy(mTextureBuffer + 2*v, &changes.texels[2*texel], 2*sizeof(float));
+			if (normal >= 0)
+				memcpy(mNormalBuffer + 3*v, &changes.normals[3*normal], 3*sizeof(float));
+			//a vertex whose corner had no normal in a file with normals follows its faces
+			else if (bPositions && fileNormals > 0 && source[2] < 0)
+			{
+				memset(mNormalBuffer + 3*v, 0, 3*sizeof(float));
+				bMissingNormals = true;
+			}
+		}
+		blockRadius[block] = radius;
+	});
+	mRadius = sqrtf(*std::max_element(blockRadius.begin(), blockRadius.end()));
+	mLoadStats.times.unify = timer.Lap();
+	
+	if (bPositions && fileNormals == 0 && CreateNewNormals() != 0)
+		return FailLoad(OBJ_LOAD_OUT_OF_MEMORY);
+	if (bMissingNormals && CreateMissingNormals() != 0)
+		return FailLoad(OBJ_LOAD_OUT_OF_MEMORY);
+	mLoadStats.times.normals = timer.Lap();
+	
+	if (bPositions && mGroups != NULL)
+		UpdateGroupBounds();
+	mLoadStats.times.materials = timer.Lap();
+	
+	//only the meshlets with a vertex that moved get their bounds again
+	if (bPositions)
+	{
+		ParallelFor(mMeshletCount, mThreadCount, [&](long m)
+		{
+			const long* indices = mIndexBufferV + 3*mMeshlets[m].firstTriangle;
+			bool bChanged = false;
+			
+			for (long i = 0; i < 3*mMeshlets[m].triangleCount && !bChanged; ++i)
+				bChanged = bMoved[indices[i]] != 0;
+			if (bChanged)
+				ComputeMeshletBounds(mVertexBuffer, 4, mIndexBufferV, mMeshlets + m, 1, 1);
+		});
+	}
+	mLoadStats.times.meshlets = timer.Lap();
+	
+	mFileBlocks.swap(changes.blocks);
+	mFileSize = changes.fileSize;
+	mLoadStats.peakBytes = mScratch.GetPeak();
+	EndScratch();
+	mLoadStats.times.total = mLoadStats.times.count + mLoadStats.times.parse + mLoadStats.times.scale +
+		mLoadStats.times.unify + mLoadStats.times.normals + mLoadStats.times.materials + mLoadStats.times.meshlets;
+	return 0;
+}
+
+int OBJClass::ReloadChanges(const wchar_t* fileName)
+{
+	OBJFileChanges changes;
+	
+	if (FindChanges(fileName, changes) != 0)
+	{
+		mLoadStats = OBJLoadStats();
+		mLoadStats.source = OBJ_SOURCE_PATCH;
+		return FailLoad(changes.error);
+	}
+	return ApplyChanges(changes);
+}
+
+//the model is one block of the mesh arena or one cache mapping, so
+//releasing it takes the same time whatever its size
+void OBJClass::Release()
+{
+	mNormalBuffer = mVertexBuffer = mTextureBuffer = NULL;
+	mIndexBufferV = mIndexBufferN = mIndexBufferT = NULL;
+	mMeshlets = NULL;
+	mMeshletCount = 0;
+	mMaterials = NULL;
+	mMaterialCount = 0;
+	mGroups = NULL;
+	mGroupCount = 0;
+	mFaceMaterials = mFaceGroups = NULL;
+	mMarkers.clear();
+	mParts.runs.clear();
+	mFileBlocks.clear();
+	std::vector<long>().swap(mVertexSources);
+	mFileSize = 0;
+	mbGeneratedNormals = false;
+	mLevelCount = 0;
+	mCacheStatsBefore.acmr = mCacheStatsBefore.atvr = 0.0;
+	mCacheStatsAfter = mCacheStatsBefore;
+	mCacheFile.Close();
+	mMesh.Release();
+	mScratch.Reset();
+}
+
+//hands the memory kept for parsing back, the next load allocates it again
+void OBJClass::ReleaseScratch()
+{
+	mScratch.Release();
+}
 
-	if (this->mIndexBufferV!=NULL)
+//moves a buffer of count elements kept by ReleaseVertexBuffers into mesh,
+//or with mesh NULL only adds the room it takes to size
+template<typename T>
+static void KeepBuffer(T* &buffer, size_t count, MemoryArena* mesh, size_t &size)
+{
+	if (buffer == NULL)
+		return;
+	if (mesh == NULL)
 	{
-        delete[] mIndexBufferV;
-		mIndexBufferV = NULL;
+		size += MemoryArena::Align(count*sizeof(T));
+		return;
 	}
-	if (this->mIndexBufferN!=NULL)
+	//the arena was reserved for the sum of the sizes, so this comes from its main block
+	T* kept = count > 0 ? mesh->Allocate<T>(count) : NULL;
+	if (kept != NULL)
+		memcpy(kept, buffer, count*sizeof(T));
+	buffer = kept;
+}
+
+//the buffers left are copied into an arena just large enough, a mapped
+//cache file included, so the memory of the positions and normals goes back
+int OBJClass::ReleaseVertexBuffers()
+{
+	MemoryArena mesh;
+	size_t size = 0;
+	
+	if (mVertexBuffer == NULL)
+		return -1;
+	
+	//the first pass adds up the sizes, the second copies
+	for (int pass = 0; pass < 2; ++pass)
 	{
-        delete[] mIndexBufferN;	
-		mIndexBufferN = NULL; 
+		MemoryArena* target = pass == 0 ? NULL : &mesh;
+		if (pass == 1 && mesh.Reserve(size) != 0)
+		{
+			std::cout << "NOT ENOUGH MEMORY FOR THE MODEL" << std::endl;
+			return -1;
+		}
+		KeepBuffer(mTextureBuffer, (size_t) mVertexCount*2, target, size);
+		KeepBuffer(mIndexBufferV, (size_t) mFaceCount*3, target, size);
+		KeepBuffer(mIndexBufferN, (size_t) mFaceCount*3, target, size);
+		KeepBuffer(mIndexBufferT, (size_t) mFaceCount*3, target, size);
+		KeepBuffer(mMeshlets, (size_t) mMeshletCount, target, size);
+		KeepBuffer(mMaterials, (size_t) mMaterialCount, target, size);
+		KeepBuffer(mGroups, (size_t) mGroupCount, target, size);
+		KeepBuffer(mFaceMaterials, (size_t) mFaceCount, target, size);
+		KeepBuffer(mFaceGroups, (size_t) mFaceCount, target, size);
+		for (int i = 0; i < mLevelCount; ++i)
+		{
+			if (i > 0)
+				KeepBuffer(mLevels[i].indices, (size_t) mLevels[i].triangleCount*3, target, size);
+			KeepBuffer(mLevels[i].ranges, (size_t) mLevels[i].rangeCount, target, size);
+		}
 	}
-	if (this->mIndexBufferT!=NULL)
+	if (mLevelCount > 0)
+		mLevels[0].indices = mIndexBufferV;
+	
+	//patching writes positions, so what FindChanges needs goes as well
+	mVertexBuffer = mNormalBuffer = NULL;
+	mFileBlocks.clear();
+	std::vector<long>().swap(mVertexSources);
+	mCacheFile.Close();
+	mMesh = std::move(mesh);
+	return 0;
+}
+
+//the parse memory is as large as the biggest file loaded so far, so it is
+//only kept past the end of a load when the caller loads again soon after
+void OBJClass::EndScratch()
+{
+	if (mbKeepScratch)
+		mScratch.Reset();
+	else
+		mScratch.Release();
+}
+
+void OBJClass::Cancel(bool bCancel)
+{
+	mbCancelled = bCancel;
+}
+
+bool OBJClass::ReportProgress(float progress)
+{
+	mProgress.store(progress, std::memory_order_relaxed);
+	return !mbCancelled;
+}
+
+const char* GetLoadErrorText(OBJLoadError error)
+{
+	switch (error)
 	{
-        delete[] mIndexBufferT;	
-		mIndexBufferT = NULL;
+	case OBJ_LOAD_OK:				return "none";
+	case OBJ_LOAD_OPEN_FAILED:		return "the file could not be opened";
+	case OBJ_LOAD_EMPTY:			return "the file has no positions or no faces";
+	case OBJ_LOAD_OUT_OF_MEMORY:	return "not enough memory";
+	case OBJ_LOAD_BAD_INDEX:		return "a face refers to data missing from the file";
+	case OBJ_LOAD_BAD_PACKED_FILE:	return "not a packed model or a damaged one";
+	case OBJ_LOAD_CANCELLED:		return "cancelled";
+	case OBJ_LOAD_CHANGED_LAYOUT:	return "the faces or the number of records changed";
 	}
+	return "unknown";
 }
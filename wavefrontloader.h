@@ -1,6 +1,6 @@
 /*
 Simple Obj viewer for Windows using OpenGL and SDL
-Can only read triangular faces, not polygonal, and does not draw textures
+Reads triangular and polygonal faces, does not draw textures
 
 Modified code based on frank253's OpenGl Glut OBJ Loader sample
 openglsamples.sourceforge.net/projects/index.pho/blog/index/
@@ -20,6 +20,227 @@ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 IN THE SOFTWARE.
 */
 
+#ifndef WAVEFRONTLOADER_H
+#define WAVEFRONTLOADER_H
+
+#include "arena.h"
+#include "mappedfile.h"
+#include "meshlets.h"
+#include "meshnormals.h"
+#include "meshoptimize.h"
+#include "meshsimplify.h"
+#include "objparser.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+//number of each record type in a stretch of an OBJ file
+struct OBJRecordCounts
+{
+	long vertices;
+	long texels;
+	long normals;
+	long faces;		// Triangles, after polygons are split up
+};
+
+//a face with more than three corners, parsed as a fan of corners - 2
+//triangles starting at firstTriangle
+struct OBJPolygon
+{
+	long firstTriangle;
+	long corners;
+};
+
+//the model itself and the simplifications built by SetBuildLevels
+static const int OBJ_MAX_LEVELS = 5;
+
+//longest material, object or group name kept, longer ones are cut
+static const int OBJ_NAME_LENGTH = 64;
+
+//colours of a newmtl entry of a material library, material 0 is the white
+//one faces get before any usemtl and names missing from every library keep
+struct OBJMaterial
+{
+	char name[OBJ_NAME_LENGTH];
+	float ambient[3];	// Ka
+	float diffuse[3];	// Kd
+	float specular[3];	// Ks
+	float shininess;	// Ns
+	float opacity;		// d, or 1 - Tr
+};
+
+//faces between g or o lines, a group is its name within an object and
+//group 0 holds the faces before the first of them
+struct OBJGroup
+{
+	char name[OBJ_NAME_LENGTH];
+	char object[OBJ_NAME_LENGTH];
+	float vmin[3];			// Bounds in model units, zero for a group without faces
+	float vmax[3];
+	long triangleCount;
+};
+
+//triangles of a level drawn with one material
+struct OBJMaterialRange
+{
+	long firstTriangle;
+	long triangleCount;
+	int material;
+};
+
+//an index buffer drawing the model with fewer triangles, every level
+//indexes the model's own vertex buffer
+struct OBJLevelOfDetail
+{
+	long* indices;
+	long triangleCount;
+	float error;	// Model units the surface may be off by
+	OBJMaterialRange* ranges;	// The level's triangles sorted by material, NULL for a model without materials
+	long rangeCount;
+};
+
+//an mtllib, usemtl, o or g line and the number of triangles before it
+struct OBJMarker
+{
+	long triangle;
+	OBJMarkerKind kind;
+	std::string name;
+};
+
+//faces of the file in a row with one material and group
+struct OBJPartRun
+{
+	long first;
+	long count;
+	long sortedFirst;	// Where the run goes once sorted by material
+	int material;
+	int group;
+};
+
+//the materials, groups and runs the markers of a load make, planned before
+//the vertices are unified so the faces can be sorted as they are copied
+struct OBJParts
+{
+	std::vector<OBJMaterial> materials;
+	std::vector<OBJGroup> groups;
+	std::vector<OBJPartRun> runs;		// Empty for a model without materials and groups
+	std::vector<long> materialTriangles;
+	bool bSortRuns;		// Runs move to sortedFirst while the vertices are unified
+};
+
+//wall time of each stage of the last load in milliseconds, stages that
+//did not run stay zero
+struct OBJLoadTimes
+{
+	double count;		// Splitting the file into chunks and counting their records
+	double parse;
+	double validate;	// Checking every face index against the element counts
+	double triangulate;	// Splitting concave polygons
+	double scale;		// Centre and scale from the bounds found while parsing
+	double unify;
+	double normals;
+	double materials;	// Reading the libraries, numbering the faces and sorting them by material
+	double optimize;
+	double levels;
+	double meshlets;
+	double total;		// The whole Load, reading a cache or packed file included
+};
+
+//lines of each kind in the file, other covers comments, blank lines and
+//every record the loader skips
+struct OBJLineCounts
+{
+	long long vertices;
+	long long texels;
+	long long normals;
+	long long faces;	// Face lines, a polygon counts once
+	long long other;
+};
+
+//why the last load failed
+enum OBJLoadError
+{
+	OBJ_LOAD_OK,
+	OBJ_LOAD_OPEN_FAILED,
+	OBJ_LOAD_EMPTY,				// No positions or no faces
+	OBJ_LOAD_OUT_OF_MEMORY,
+	OBJ_LOAD_BAD_INDEX,			// A face refers to an element the file does not define
+	OBJ_LOAD_BAD_PACKED_FILE,	// Not a packed model, another version or damaged
+	OBJ_LOAD_CANCELLED,			// Stopped through OBJClass::Cancel or the OBJStream
+	OBJ_LOAD_CHANGED_LAYOUT		// FindChanges can not patch the file in, its faces or record counts changed
+};
+
+//where the buffers of the last load came from
+enum OBJLoadSource
+{
+	OBJ_SOURCE_PARSE,
+	OBJ_SOURCE_STREAM,
+	OBJ_SOURCE_CACHE,
+	OBJ_SOURCE_PACKED,
+	OBJ_SOURCE_PATCH		// The stretches of the file that changed, read by FindChanges
+};
+
+//everything recorded about the last load, kept up to date as it runs so a
+//failed load reports how far it got
+struct OBJLoadStats
+{
+	OBJLoadTimes times;
+	OBJLineCounts lines;	// Zero for caches and packed files
+	unsigned long long bytesRead;
+	size_t peakBytes;		// Most the mesh and scratch arenas held, the mapped file not counted
+	OBJLoadSource source;
+	OBJLoadError error;
+	long badTriangle;		// First triangle with an index out of range, -1 if none
+	
+	OBJLoadStats() : times(), lines(), bytesRead(0), peakBytes(0), source(OBJ_SOURCE_PARSE),
+		error(OBJ_LOAD_OK), badTriangle(-1) {};
+};
+
+const char* GetLoadErrorText(OBJLoadError error);
+
+//a stretch of whole lines of the file parsed last, kept by SetTrackChanges
+//so FindChanges can tell the stretches that changed from the ones that did not
+struct OBJFileBlock
+{
+	unsigned long long offset;
+	unsigned long long size;
+	unsigned long long hash;			// Of the bytes, a block that hashes the same is taken as unchanged
+	unsigned long long structureHash;	// Of the face, mtllib, usemtl, o and g lines, in order
+	unsigned long long structureWeight;	// Takes the structure hash of the lines after the block to follow on
+	OBJRecordCounts counts;
+	float vmin[3];			// Bounds and sum of the block's positions
+	float vmax[3];
+	double sum[3];
+};
+
+//elements of one kind that changed, the raw elements [first, first + count)
+//of the file are read into the buffer of OBJFileChanges from offset on
+struct OBJChangedRange
+{
+	long first;
+	long count;
+	long offset;
+};
+
+//everything FindChanges read from a file, for ApplyChanges to write into the model
+struct OBJFileChanges
+{
+	std::vector<OBJFileBlock> blocks;		// Of the file as it is now
+	std::vector<OBJChangedRange> positionRanges;	// In file order
+	std::vector<OBJChangedRange> texelRanges;
+	std::vector<OBJChangedRange> normalRanges;
+	std::vector<float> positions;	// Four floats each, the fourth not used
+	std::vector<float> texels;
+	std::vector<float> normals;
+	unsigned long long fileSize;
+	unsigned long long bytesParsed;	// Of the stretches that changed
+	long changedBlocks;
+	double hashTime;				// Milliseconds spent finding the changed stretches
+	double parseTime;
+	OBJLoadError error;				// Why FindChanges failed
+};
+
 class OBJClass
 {
   private:	
@@ -30,11 +251,14 @@ class OBJClass
 	long* mIndexBufferN;
 	long* mIndexBufferT;
 	long* mIndexBufferV;
+	Meshlet* mMeshlets;		// Runs of the index buffer with their bounds, NULL unless built
+	long mMeshletCount;
 	 
 	float mScale;
 	float mVmax[3];
 	float mVmin[3];	
-	float mCenter[3];
+	float mCenter[3];	// Centroid of the positions
+	float mRadius;		// Of the bounding sphere around mCenter
 	
 	long mFaceCount;
 	long mTexelCount;
@@ -42,25 +266,158 @@ class OBJClass
 	long mVertexCount;
 	long mTotalConnectTriangles;	// Stores the total number of connected triangles
 	
+	OBJMaterial* mMaterials;	// All NULL for a model without usemtl, o and g lines
+	int mMaterialCount;
+	OBJGroup* mGroups;
+	long mGroupCount;
+	int* mFaceMaterials;	// Per triangle, in the order of the index buffer
+	int* mFaceGroups;
+	
+	int mThreadCount;	// Threads used by Load, 0 uses every core
+	bool mbUseCache;
+	NormalWeighting mNormalWeighting;	// For files without normals
+	bool mbGeneratedNormals;	// Some normals of the model were generated with mNormalWeighting
+	bool mbOptimizeVertexCache;
+	VertexCacheStats mCacheStatsBefore;	// Of the index buffer as loaded and as drawn
+	VertexCacheStats mCacheStatsAfter;
+	bool mbBuildMeshlets;
+	bool mbBuildLevels;
+	OBJLevelOfDetail mLevels[OBJ_MAX_LEVELS];	// Finest first, the first is the model itself
+	int mLevelCount;
+	OBJLoadStats mLoadStats;
+	MappedFile mCacheFile;	// Holds the buffers when they come from a cache file
+	MemoryArena mMesh;		// Holds the buffers of a parsed model
+	MemoryArena mScratch;	// Raw parse buffers and temporaries, freed after a load unless kept
+	std::atomic<bool> mbCancelled;	// Set by Cancel from any thread, cleared when a load ends
+	std::atomic<float> mProgress;	// Of the load running, read from any thread
+	bool mbTrackChanges;
+	bool mbKeepScratch;
+	std::vector<OBJFileBlock> mFileBlocks;	// Of the file parsed last, empty unless tracked
+	std::vector<long> mVertexSources;		// Raw position, texel and normal of every vertex, -1 for none
+	unsigned long long mFileSize;
+	
 	void CalcScale();
-	void RemakeNormals();
-	void CreateNewNormals();
-	void RemakeTextures();
-
-	void CalcMaxMin();
-	void CalcCenter();		
+	int UnifyVertices();
+	void CopyPosition(float* to, const float* from, float &radius2);
+	int ReserveMesh(long vertexCount, bool bTextures);
+	int CreateNewNormals();
+	int CreateMissingNormals();
+	int OptimizeVertexOrder();
+	int BuildMeshlets();
+	int BuildLevels();
+	void PlanParts();
+	int BuildParts();
+	int SortByMaterial();
+	int ReorderFaces(const long* order);
+	int SortLevelsByMaterial();
+	void UpdateGroupBounds();
+	
+	std::vector<OBJPolygon> mPolygons;	// Polygons of the current load, checked for concavity
+	std::vector<OBJMarker> mMarkers;	// Of the current load, in file order
+	std::wstring mDirectory;			// Of the file loaded, where its material libraries are looked for
+	OBJParts mParts;
+	
+	int ParseFile(const wchar_t* fileName);
+	void ParseRecords(const char* p, const char* end, OBJRecordCounts &cursor,
+		std::vector<OBJPolygon> &polygons, OBJBounds &bounds);
+	void TriangulatePolygons();
+	int FinishLoad(const OBJBounds &bounds);
+	inline int FailLoad(OBJLoadError error){mLoadStats.error = error; return -1;};
+	bool ReportProgress(float progress);	// Returns false once cancelled
+	void EndScratch();
+	
+	friend class OBJStream;
+	
+	OBJClass(const OBJClass&) = delete;
+	OBJClass& operator=(const OBJClass&) = delete;
 	
  public: 	
 	OBJClass();
+	OBJClass(OBJClass&& other);				// Moves the model, e.g. to another thread
+	OBJClass& operator=(OBJClass&& other);
 	~OBJClass();	
     int Load(wchar_t *fileName);	// Loads the model
 	void Release();				// Release the model	 
+	void ReleaseScratch();		// Frees the parse memory kept by SetKeepScratch
+	//frees the positions and normals for a caller that draws its own copy of
+	//them, GetVertexBuffer and GetNormalBuffer return NULL afterwards and the
+	//model can no longer be patched, cached or packed, returns 0 or -1
+	int ReleaseVertexBuffers();
+	//stops the load running, or the next one when none is, at its next stage
+	//with OBJ_LOAD_CANCELLED, Cancel(false) takes back a cancel no load has
+	//seen yet, both safe to call from any thread
+	void Cancel(bool bCancel = true);
+	inline float GetLoadProgress(){return mProgress.load(std::memory_order_relaxed);};	// 0 to 1, from any thread
+	
+	inline void SetThreadCount(int threads){mThreadCount = threads;};	// 1 loads serially
+	inline void SetUseCache(bool bUseCache){mbUseCache = bUseCache;};	// Load reads and writes the cache
+	inline void SetNormalWeighting(NormalWeighting weighting){mNormalWeighting = weighting;};
+	inline void SetOptimizeVertexCache(bool bOptimize){mbOptimizeVertexCache = bOptimize;};	// Reorders triangles and vertices after a load
+	inline void SetBuildMeshlets(bool bBuild){mbBuildMeshlets = bBuild;};	// Splits the model into meshlets after a load
+	inline void SetBuildLevels(bool bBuild){mbBuildLevels = bBuild;};	// Simplifies the model after a load
+	inline void SetTrackChanges(bool bTrack){mbTrackChanges = bTrack;};	// A parse keeps what FindChanges needs
+	inline void SetKeepScratch(bool bKeep){mbKeepScratch = bKeep;};	// Loads keep their parse memory for the next one
+	
+	//finds the stretches of the file parsed last that changed since and reads
+	//their positions, texels and normals, which only works while the faces,
+	//markers and record counts stay the same, it only reads the model so it
+	//may run on another thread while the model is drawn, returns 0 or -1 with
+	//changes.error set when the file has to be loaded again
+	int FindChanges(const wchar_t* fileName, OBJFileChanges &changes);
+	//writes what FindChanges read into the buffers in place and brings the
+	//bounds, generated normals, group bounds and meshlets up to date, the
+	//levels of detail keep their triangles and polygons their triangulation,
+	//returns 0 or -1 when out of memory, which leaves the model to be loaded again
+	int ApplyChanges(OBJFileChanges &changes);
+	//FindChanges and ApplyChanges in one, returns 0 or -1 as either does
+	int ReloadChanges(const wchar_t* fileName);
+	
+	//binary sidecar next to the OBJ file holding the finished buffers
+	int WriteCache(const wchar_t* fileName);
+	int ReadCache(const wchar_t* fileName);
+	
+	//compressed file of the finished buffers, Load reads files ending in .objpack
+	int WritePacked(const wchar_t* fileName);
+	int ReadPacked(const wchar_t* fileName);
 	
 	inline float* GetNormalBuffer(){return mNormalBuffer;};		
 	inline float* GetTextureBuffer(){return mTextureBuffer;};
 	inline float* GetVertexBuffer(){return mVertexBuffer;};
 	inline long* GetIndexBufferV(){return mIndexBufferV;};	
+	inline long GetVertexCount(){return mVertexCount;};	// Vertices after unification, one per index
 	inline long GetTotalConnectTriangles(){return mTotalConnectTriangles;}; 	
 	
-	inline bool HasNormals(){return mNormalCount > 0;};		
-}; 
+	//bounds of the positions in model units, divide by GetScale for drawing units
+	inline const float* GetBoundsMin(){return mVmin;};
+	inline const float* GetBoundsMax(){return mVmax;};
+	inline const float* GetCenter(){return mCenter;};
+	inline float GetRadius(){return mRadius;};
+	inline float GetScale(){return mScale;};	// The w of every position
+	
+	inline bool HasNormals(){return mNormalCount > 0;};
+	
+	//materials and groups of the usemtl, o and g lines, both counts are 0 and
+	//the face arrays NULL for a model without them
+	inline int GetMaterialCount(){return mMaterialCount;};
+	inline const OBJMaterial& GetMaterial(int material){return mMaterials[material];};
+	inline long GetGroupCount(){return mGroupCount;};
+	inline const OBJGroup& GetGroup(long group){return mGroups[group];};
+	inline const int* GetFaceMaterials(){return mFaceMaterials;};
+	inline const int* GetFaceGroups(){return mFaceGroups;};
+	
+	//simulated post-transform cache use before and after OptimizeVertexOrder,
+	//both zero when the model was loaded without it
+	inline const VertexCacheStats& GetCacheStatsBefore(){return mCacheStatsBefore;};
+	inline const VertexCacheStats& GetCacheStatsAfter(){return mCacheStatsAfter;};
+	
+	inline const Meshlet* GetMeshlets(){return mMeshlets;};
+	inline long GetMeshletCount(){return mMeshletCount;};
+	inline int GetLevelCount(){return mLevelCount;};	// 1 for a model without simplifications
+	inline const OBJLevelOfDetail& GetLevel(int level){return mLevels[level];};
+	inline const OBJLoadTimes& GetLoadTimes(){return mLoadStats.times;};
+	inline const OBJLoadStats& GetLoadStats(){return mLoadStats;};
+	inline MeshletStats GetMeshletStats(){return AnalyzeMeshlets(mMeshlets, mMeshletCount,
+		MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES);};		
+};
+
+#endif
@@ -0,0 +1,655 @@
+/*
+Materials, objects and groups of a Wavefront model and the sort of its
+triangles into one run per material
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include <cstdlib>
+#include <cstring>
+
+#include "arena.h"
+#include "mappedfile.h"
+#include "objparser.h"
+#include "parallel.h"
+#include "wavefrontloader.h"
+
+//triangles handled per task when the faces are numbered and sorted
+static const long PART_BLOCK_FACES = 1 << 16;
+
+//the faces of one run inside one block, merged into its group afterwards
+struct OBJGroupSpan
+{
+	long group;
+	long triangleCount;
+	float vmin[4];		// The fourth is not used
+	float vmax[4];
+};
+
+//bounds of the positions used by the corners [first, last) of the index
+//buffer, positions have four floats, the bounds get four of which three count
+static void CornerBounds(const float* positions, const long* indices, long first, long last, float* vmin, float* vmax)
+{
+#ifdef OBJPARSER_SSE2
+	__m128 lower = _mm_set1_ps(1e30f), upper = _mm_set1_ps(-1e30f);
+	for (long i = first; i < last; ++i)
+	{
+		__m128 position = _mm_loadu_ps(positions + 4*indices[i]);
+		lower = _mm_min_ps(lower, position);
+		upper = _mm_max_ps(upper, position);
+	}
+	_mm_storeu_ps(vmin, lower);
+	_mm_storeu_ps(vmax, upper);
+#else
+	for (int k = 0; k < 4; ++k)
+	{
+		vmin[k] = 1e30f;
+		vmax[k] = -1e30f;
+	}
+	for (long i = first; i < last; ++i)
+	{
+		const float* position = positions + 4*indices[i];
+		for (int k = 0; k < 3; ++k)
+		{
+			vmin[k] = std::min(vmin[k], position[k]);
+			vmax[k] = std::max(vmax[k], position[k]);
+		}
+	}
+#endif
+}
+
+//copies a name cut to fit OBJ_NAME_LENGTH with its terminator
+static void CopyName(char* to, const std::string &name)
+{
+	size_t length = std::min(name.size(), (size_t)(OBJ_NAME_LENGTH - 1));
+	memcpy(to, name.data(), length);
+	memset(to + length, 0, OBJ_NAME_LENGTH - length);
+}
+
+//white, which is what the model was drawn with before it had materials
+static OBJMaterial DefaultMaterial(const std::string &name)
+{
+	OBJMaterial material;
+
+	CopyName(material.name, name);
+	for (int i = 0; i < 3; ++i)
+	{
+		material.ambient[i] = 0.2f;
+		material.diffuse[i] = 1.0f;
+		material.specular[i] = 0.0f;
+	}
+	material.shininess = 0.0f;
+	material.opacity = 1.0f;
+	return material;
+}
+
+//r g b, or a single value for all three
+static void ParseColor(const char* p, const char* end, float* color)
+{
+	float values[3];
+	int count = 0;
+
+	while (count < 3)
+	{
+		const char* next;
+		p = OBJParser::SkipBlanks(p, end);
+		next = OBJParser::ParseFloat(p, end, values[count]);
+		if (next == p)
+			break;
+		p = next;
+		++count;
+	}
+	for (int i = 0; i < 3 && count > 0; ++i)
+		color[i] = values[count == 3 ? i : 0];
+}
+
+//the keyword and a blank or the end of the line, returns what follows or NULL
+static const char* MatchKeyword(const char* p, const char* end, const char* keyword)
+{
+	size_t length = strlen(keyword);
+
+	if ((size_t)(end - p) < length || memcmp(p, keyword, length) != 0)
+		return NULL;
+	if (p + length < end && !OBJParser::IsBlank(p[length]))
+		return NULL;
+	return p + length;
+}
+
+//reads the newmtl entries of a library into the materials the faces use,
+//entries no face uses are skipped, returns 0 or -1 if the file can not be opened
+static int ReadMaterialLibrary(const std::wstring &fileName, const std::unordered_map<std::string, int> &ids,
+	std::vector<OBJMaterial> &materials)
+{
+	MappedFile file;
+	const char *p, *end;
+	OBJMaterial* material = NULL;
+
+	if (file.Open(fileName.c_str()) != 0)
+		return -1;
+	p = file.GetData();
+	end = p + file.GetSize();
+	while (p < end)
+	{
+		const char* lineEnd = OBJParser::FindLineEnd(p, end);
+		const char* rest;
+
+		p = OBJParser::SkipBlanks(p, lineEnd);
+		if ((rest = MatchKeyword(p, lineEnd, "newmtl")) != NULL)
+		{
+			const char* name = OBJParser::SkipBlanks(rest, lineEnd);
+			const char* nameEnd = lineEnd;
+			while (nameEnd > name && OBJParser::IsBlank(nameEnd[-1]))
+				--nameEnd;
+
+			auto found = ids.find(std::string(name, nameEnd));
+			material = found != ids.end() ? &materials[found->second] : NULL;
+		}
+		else if (material != NULL)
+		{
+			if ((rest = MatchKeyword(p, lineEnd, "Ka")) != NULL)
+				ParseColor(rest, lineEnd, material->ambient);
+			else if ((rest = MatchKeyword(p, lineEnd, "Kd")) != NULL)
+				ParseColor(rest, lineEnd, material->diffuse);
+			else if ((rest = MatchKeyword(p, lineEnd, "Ks")) != NULL)
+				ParseColor(rest, lineEnd, material->specular);
+			else if ((rest = MatchKeyword(p, lineEnd, "Ns")) != NULL)
+				OBJParser::ParseFloats(rest, lineEnd, &material->shininess, 1);
+			else if ((rest = MatchKeyword(p, lineEnd, "d")) != NULL)
+				OBJParser::ParseFloats(rest, lineEnd, &material->opacity, 1);
+			else if ((rest = MatchKeyword(p, lineEnd, "Tr")) != NULL)
+			{
+				float transparency = 0.0f;
+				OBJParser::ParseFloats(rest, lineEnd, &transparency, 1);
+				material->opacity = 1.0f - transparency;
+			}
+		}
+		p = lineEnd + 1;
+	}
+	return 0;
+}
+
+//reads the libraries named on an mtllib line from the directory, the line
+//usually names one file but may name several separated by blanks, the
+//whole name is tried first so file names with blanks still work
+static void ReadLibraries(const std::wstring &directory, const std::string &names,
+	const std::unordered_map<std::string, int> &ids, std::vector<OBJMaterial> &materials)
+{
+	auto readLibrary = [&](const std::string &name)
+	{
+		std::vector<wchar_t> wide(name.size() + 1);
+
+		if (mbstowcs(wide.data(), name.c_str(), wide.size()) == (size_t) -1)
+			return -1;
+		return ReadMaterialLibrary(directory + wide.data(), ids, materials);
+	};
+	std::vector<std::string> parts;
+	const char* p = names.c_str();
+	const char* end = p + names.size();
+
+	if (names.empty() || readLibrary(names) == 0)
+		return;
+	while ((p = OBJParser::SkipBlanks(p, end)) < end)
+	{
+		const char* tokenEnd = OBJParser::SkipToken(p, end);
+		parts.push_back(std::string(p, tokenEnd));
+		p = tokenEnd;
+	}
+	if (parts.size() <= 1)
+		std::cout << "Could not read the material library " << names << std::endl;
+	for (size_t i = 0; parts.size() > 1 && i < parts.size(); ++i)
+	{
+		if (readLibrary(parts[i]) != 0)
+			std::cout << "Could not read the material library " << parts[i] << std::endl;
+	}
+}
+
+//turns the usemtl, o and g lines of the load into materials, groups and
+//runs of faces and reads the libraries, only the markers are looked at so
+//this runs before the vertices are unified, which copies the faces in
+//material order when they are not reordered for the vertex cache afterwards
+void OBJClass::PlanParts()
+{
+	std::unordered_map<std::string, int> materialIds;
+	std::unordered_map<std::string, int> groupIds;
+	std::vector<std::string> libraries;
+	std::string object;
+	OBJPartRun run = {0, 0, 0, 0, 0};
+	long position = 0;
+
+	mParts.materials.assign(1, DefaultMaterial(""));
+	mParts.groups.assign(1, OBJGroup());
+	mParts.runs.clear();
+	mParts.bSortRuns = false;
+	if (mMarkers.empty())
+		return;
+
+	//group 0 keeps the faces before any o or g line
+	groupIds[std::string("\n")] = 0;
+	mParts.runs.push_back(run);
+	for (size_t i = 0; i < mMarkers.size(); ++i)
+	{
+		const OBJMarker &marker = mMarkers[i];
+
+		switch (marker.kind)
+		{
+		case OBJ_MARKER_LIBRARY:
+			libraries.push_back(marker.name);
+			continue;
+		case OBJ_MARKER_MATERIAL:
+		{
+			auto found = materialIds.find(marker.name);
+			if (found == materialIds.end())
+			{
+				found = materialIds.insert(std::make_pair(marker.name, (int) mParts.materials.size())).first;
+				mParts.materials.push_back(DefaultMaterial(marker.name));
+			}
+			run.material = found->second;
+			break;
+		}
+		case OBJ_MARKER_OBJECT:
+		case OBJ_MARKER_GROUP:
+		{
+			//an o line starts the object's unnamed group, g lines name groups within it
+			std::string name = marker.kind == OBJ_MARKER_GROUP ? marker.name : std::string();
+			if (marker.kind == OBJ_MARKER_OBJECT)
+				object = marker.name;
+
+			auto found = groupIds.find(object + "\n" + name);
+			if (found == groupIds.end())
+			{
+				OBJGroup group = OBJGroup();
+				found = groupIds.insert(std::make_pair(object + "\n" + name, (int) mParts.groups.size())).first;
+				CopyName(group.name, name);
+				CopyName(group.object, object);
+				mParts.groups.push_back(group);
+			}
+			run.group = found->second;
+			break;
+		}
+		default:
+			continue;
+		}
+
+		//markers without faces between them only leave the last one
+		std::vector<OBJPartRun> &runs = mParts.runs;
+		run.first = std::min(marker.triangle, mFaceCount);
+		if (runs.back().first == run.first)
+			runs.back() = run;
+		else if (runs.back().material != run.material || runs.back().group != run.group)
+			runs.push_back(run);
+	}
+	mMarkers.clear();
+	if (mParts.runs.size() > 1 && mParts.runs.back().first == mFaceCount)
+		mParts.runs.pop_back();
+
+	for (size_t i = 0; i < libraries.size(); ++i)
+		ReadLibraries(mDirectory, libraries[i], materialIds, mParts.materials);
+
+	//a stable counting sort of the runs, each goes after the runs of its
+	//material before it and after every run of the materials before that
+	std::vector<OBJPartRun> &runs = mParts.runs;
+	std::vector<long> next(mParts.materials.size(), 0);
+	mParts.materialTriangles.assign(mParts.materials.size(), 0);
+	for (size_t r = 0; r < runs.size(); ++r)
+	{
+		runs[r].count = (r + 1 < runs.size() ? runs[r + 1].first : mFaceCount) - runs[r].first;
+		mParts.materialTriangles[runs[r].material] += runs[r].count;
+	}
+	for (size_t m = 0; m < next.size(); ++m)
+	{
+		next[m] = position;
+		position += mParts.materialTriangles[m];
+	}
+	for (size_t r = 0; r < runs.size(); ++r)
+	{
+		runs[r].sortedFirst = next[runs[r].material];
+		next[runs[r].material] += runs[r].count;
+	}
+	mParts.bSortRuns = !mbOptimizeVertexCache;
+}
+
+//numbers the material and group of every triangle and gathers the bounds of
+//each group, the faces are in material order already unless they are left
+//for OptimizeVertexOrder to sort, a model without markers gets neither
+int OBJClass::BuildParts()
+{
+	const std::vector<OBJPartRun> &runs = mParts.runs;
+	std::vector<OBJGroup> &groups = mParts.groups;
+	std::vector<std::vector<OBJGroupSpan> > spans(ResolveThreadCount(mThreadCount)*4);
+	long tasks = (long) spans.size();
+	long rangeCount = 0, first = 0;
+
+	mLevels[0].ranges = NULL;
+	mLevels[0].rangeCount = 0;
+	if (runs.empty())
+		return 0;
+
+	mMaterials = mMesh.Allocate<OBJMaterial>(mParts.materials.size());
+	mGroups = mMesh.Allocate<OBJGroup>(groups.size());
+	mFaceMaterials = mMesh.Allocate<int>(mFaceCount);
+	mFaceGroups = mMesh.Allocate<int>(mFaceCount);
+	if (mMaterials == NULL || mGroups == NULL || mFaceMaterials == NULL || mFaceGroups == NULL)
+	{
+		std::cout << "NOT ENOUGH MEMORY FOR THE MATERIALS" << std::endl;
+		return -1;
+	}
+	memcpy(mMaterials, mParts.materials.data(), mParts.materials.size()*sizeof(OBJMaterial));
+	mMaterialCount = (int) mParts.materials.size();
+
+	//each task takes every tasks-th run, long runs are split so no task gets
+	//more than its share, the bounds read the index buffer right after the fill
+	ParallelFor(tasks, mThreadCount, [&](long task)
+	{
+		for (size_t r = task; r < runs.size(); r += tasks)
+		{
+			long first = mParts.bSortRuns ? runs[r].sortedFirst : runs[r].first;
+
+			for (long t = first; t < first + runs[r].count; t += PART_BLOCK_FACES)
+			{
+				long last = std::min(first + runs[r].count, t + PART_BLOCK_FACES);
+				OBJGroupSpan span;
+
+				span.group = runs[r].group;
+				span.triangleCount = last - t;
+				std::fill(mFaceMaterials + t, mFaceMaterials + last, runs[r].material);
+				std::fill(mFaceGroups + t, mFaceGroups + last, runs[r].group);
+				CornerBounds(mVertexBuffer, mIndexBufferV, 3*t, 3*last, span.vmin, span.vmax);
+				spans[task].push_back(span);
+			}
+		}
+	});
+
+	for (size_t g = 0; g < groups.size(); ++g)
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			groups[g].vmin[k] = 1e30f;
+			groups[g].vmax[k] = -1e30f;
+		}
+	}
+	for (long task = 0; task < tasks; ++task)
+	{
+		for (size_t i = 0; i < spans[task].size(); ++i)
+		{
+			const OBJGroupSpan &span = spans[task][i];
+			OBJGroup &group = groups[span.group];
+
+			group.triangleCount += span.triangleCount;
+			for (int k = 0; k < 3; ++k)
+			{
+				group.vmin[k] = std::min(group.vmin[k], span.vmin[k]);
+				group.vmax[k] = std::max(group.vmax[k], span.vmax[k]);
+			}
+		}
+	}
+	for (size_t g = 0; g < groups.size(); ++g)
+	{
+		for (int k = 0; groups[g].triangleCount == 0 && k < 3; ++k)
+			groups[g].vmin[k] = groups[g].vmax[k] = 0.0f;
+	}
+	memcpy(mGroups, groups.data(), groups.size()*sizeof(OBJGroup));
+	mGroupCount = (long) groups.size();
+
+	//faces sorted on the copy only need the ranges
+	if (!mParts.bSortRuns)
+		return 0;
+	for (int m = 0; m < mMaterialCount; ++m)
+		rangeCount += mParts.materialTriangles[m] > 0 ? 1 : 0;
+	mLevels[0].ranges = mMesh.Allocate<OBJMaterialRange>(rangeCount);
+	if (mLevels[0].ranges == NULL)
+		return -1;
+	for (int m = 0; m < mMaterialCount; first += mParts.materialTriangles[m++])
+	{
+		if (mParts.materialTriangles[m] == 0)
+			continue;
+		OBJMaterialRange &range = mLevels[0].ranges[mLevels[0].rangeCount++];
+		range.firstTriangle = first;
+		range.triangleCount = mParts.materialTriangles[m];
+		range.material = m;
+	}
+	return 0;
+}
+
+//gathers the bounds of every group again from the positions as they are
+//now, its faces keep their group so every block splits where it changes
+void OBJClass::UpdateGroupBounds()
+{
+	long blocks = (mFaceCount + PART_BLOCK_FACES - 1) / PART_BLOCK_FACES;
+	std::vector<std::vector<OBJGroupSpan> > spans(blocks);
+
+	ParallelFor(blocks, mThreadCount, [&](long block)
+	{
+		long last = std::min(mFaceCount, (block + 1)*PART_BLOCK_FACES);
+
+		for (long t = block*PART_BLOCK_FACES, next; t < last; t = next)
+		{
+			OBJGroupSpan span;
+
+			for (next = t + 1; next < last && mFaceGroups[next] == mFaceGroups[t]; ++next)
+				;
+			span.group = mFaceGroups[t];
+			span.triangleCount = next - t;
+			CornerBounds(mVertexBuffer, mIndexBufferV, 3*t, 3*next, span.vmin, span.vmax);
+			spans[block].push_back(span);
+		}
+	});
+
+	//groups without faces keep their zero bounds
+	for (long g = 0; g < mGroupCount; ++g)
+	{
+		for (int k = 0; mGroups[g].triangleCount > 0 && k < 3; ++k)
+		{
+			mGroups[g].vmin[k] = 1e30f;
+			mGroups[g].vmax[k] = -1e30f;
+		}
+	}
+	for (long block = 0; block < blocks; ++block)
+	{
+		for (size_t i = 0; i < spans[block].size(); ++i)
+		{
+			const OBJGroupSpan &span = spans[block][i];
+			OBJGroup &group = mGroups[span.group];
+
+			for (int k = 0; k < 3; ++k)
+			{
+				group.vmin[k] = std::min(group.vmin[k], span.vmin[k]);
+				group.vmax[k] = std::max(group.vmax[k], span.vmax[k]);
+			}
+		}
+	}
+}
+
+//stable counting sort of triangleCount triangles by their material, the
+//blocks count their materials and scatter them in parallel, every block
+//writing a material after the same material of the blocks before it, the
+//face arrays (faceGroups may be NULL) move with the triangles and ranges
+//gets one entry from the mesh arena per material used, returns 0 or -1,
+//faces come in long runs of one material, so whole runs are counted and
+//copied at a time and triangles already in order are left where they are
+static int SortTriangles(long* indices, long triangleCount, int* faceMaterials, int* faceGroups,
+	int materialCount, int threads, MemoryArena &scratch, MemoryArena &mesh,
+	OBJMaterialRange* &ranges, long &rangeCount)
+{
+	//a few blocks per thread are enough, more would only grow the counts
+	long blocks = std::max(1L, std::min((triangleCount + PART_BLOCK_FACES - 1) / PART_BLOCK_FACES,
+		(long) ResolveThreadCount(threads)*4));
+	long blockFaces = (triangleCount + blocks - 1) / blocks;
+	long* offsets = scratch.Allocate<long>((size_t) blocks*materialCount);
+	std::vector<char> blockSorted(blocks, 1);
+	std::vector<long> totals(materialCount, 0);
+	bool bSorted = true;
+	long position = 0;
+
+	if (offsets == NULL)
+		return -1;
+	ParallelFor(blocks, threads, [&](long block)
+	{
+		long* counts = offsets + block*materialCount;
+		long last = std::min(triangleCount, (block + 1)*blockFaces);
+
+		memset(counts, 0, materialCount*sizeof(long));
+		for (long t = block*blockFaces; t < last; )
+		{
+			int material = faceMaterials[t];
+			long runEnd = t + 1;
+			while (runEnd < last && faceMaterials[runEnd] == material)
+				++runEnd;
+			if (runEnd < last && faceMaterials[runEnd] < material)
+				blockSorted[block] = 0;
+			counts[material] += runEnd - t;
+			t = runEnd;
+		}
+	});
+
+	rangeCount = 0;
+	for (int m = 0; m < materialCount; ++m)
+	{
+		for (long block = 0; block < blocks; ++block)
+		{
+			long count = offsets[block*materialCount + m];
+			offsets[block*materialCount + m] = position;
+			position += count;
+			totals[m] += count;
+		}
+		rangeCount += totals[m] > 0 ? 1 : 0;
+	}
+	for (long block = 0; block < blocks; ++block)
+	{
+		long first = block*blockFaces;
+		bSorted &= blockSorted[block] != 0 && (block == 0 || first >= triangleCount ||
+			faceMaterials[first - 1] <= faceMaterials[first]);
+	}
+
+	ranges = mesh.Allocate<OBJMaterialRange>(rangeCount);
+	if (ranges == NULL)
+		return -1;
+	rangeCount = 0;
+	position = 0;
+	for (int m = 0; m < materialCount; ++m)
+	{
+		if (totals[m] == 0)
+			continue;
+		ranges[rangeCount].firstTriangle = position;
+		ranges[rangeCount].triangleCount = totals[m];
+		ranges[rangeCount].material = m;
+		position += totals[m];
+		++rangeCount;
+	}
+	if (bSorted)
+		return 0;
+
+	//the triangles are copied aside and scattered back, so the arrays stay where they are
+	long* unsortedIndices = scratch.Allocate<long>(triangleCount*3);
+	int* unsortedMaterials = scratch.Allocate<int>(triangleCount);
+	int* unsortedGroups = faceGroups != NULL ? scratch.Allocate<int>(triangleCount) : NULL;
+	if (unsortedIndices == NULL || unsortedMaterials == NULL || (faceGroups != NULL && unsortedGroups == NULL))
+		return -1;
+	memcpy(unsortedIndices, indices, triangleCount*3*sizeof(long));
+	memcpy(unsortedMaterials, faceMaterials, triangleCount*sizeof(int));
+	if (faceGroups != NULL)
+		memcpy(unsortedGroups, faceGroups, triangleCount*sizeof(int));
+
+	ParallelFor(blocks, threads, [&](long block)
+	{
+		long* next = offsets + block*materialCount;
+		long last = std::min(triangleCount, (block + 1)*blockFaces);
+
+		for (long t = block*blockFaces; t < last; )
+		{
+			int material = unsortedMaterials[t];
+			long runEnd = t + 1, to;
+			while (runEnd < last && unsortedMaterials[runEnd] == material)
+				++runEnd;
+			to = next[material];
+			next[material] += runEnd - t;
+			memcpy(indices + 3*to, unsortedIndices + 3*t, (runEnd - t)*3*sizeof(long));
+			if (faceGroups != NULL)
+				memcpy(faceGroups + to, unsortedGroups + t, (runEnd - t)*sizeof(int));
+			t = runEnd;
+		}
+	});
+	ParallelFor(rangeCount, threads, [&](long r)
+	{
+		std::fill(faceMaterials + ranges[r].firstTriangle, faceMaterials + ranges[r].firstTriangle +
+			ranges[r].triangleCount, ranges[r].material);
+	});
+	return 0;
+}
+
+//sorts the model's triangles so each material is drawn by one range of the
+//index buffer, triangles of a material keep the order they had
+int OBJClass::SortByMaterial()
+{
+	return SortTriangles(mIndexBufferV, mFaceCount, mFaceMaterials, mFaceGroups, mMaterialCount,
+		mThreadCount, mScratch, mMesh, mLevels[0].ranges, mLevels[0].rangeCount);
+}
+
+//moves the face arrays along with the triangles OptimizeVertexCache
+//reordered, order[n] is the old number of the triangle now at n
+int OBJClass::ReorderFaces(const long* order)
+{
+	long blocks = (mFaceCount + PART_BLOCK_FACES - 1) / PART_BLOCK_FACES;
+	int* materials = mScratch.Allocate<int>(mFaceCount);
+	int* groups = mScratch.Allocate<int>(mFaceCount);
+
+	if (materials == NULL || groups == NULL)
+		return -1;
+	ParallelFor(blocks, mThreadCount, [&](long block)
+	{
+		long last = std::min(mFaceCount, (block + 1)*PART_BLOCK_FACES);
+		for (long t = block*PART_BLOCK_FACES; t < last; ++t)
+		{
+			materials[t] = mFaceMaterials[order[t]];
+			groups[t] = mFaceGroups[order[t]];
+		}
+	});
+	memcpy(mFaceMaterials, materials, mFaceCount*sizeof(int));
+	memcpy(mFaceGroups, groups, mFaceCount*sizeof(int));
+	return 0;
+}
+
+//the simplified levels have no faces of the file, each of their triangles
+//takes the material of its first vertex in the model, which is exact inside
+//a material and picks one side on the seams between materials
+int OBJClass::SortLevelsByMaterial()
+{
+	int* vertexMaterials;
+
+	if (mFaceMaterials == NULL || mLevelCount < 2)
+		return 0;
+
+	mScratch.Reset();
+	vertexMaterials = mScratch.Allocate<int>(mVertexCount);
+	if (vertexMaterials == NULL)
+		return -1;
+	memset(vertexMaterials, 0, mVertexCount*sizeof(int));
+	for (long i = 0; i < mFaceCount*3; ++i)
+		vertexMaterials[mIndexBufferV[i]] = mFaceMaterials[i / 3];
+
+	for (int level = 1; level < mLevelCount; ++level)
+	{
+		OBJLevelOfDetail &lod = mLevels[level];
+		int* faceMaterials = mScratch.Allocate<int>(lod.triangleCount);
+
+		if (faceMaterials == NULL)
+			return -1;
+		for (long t = 0; t < lod.triangleCount; ++t)
+			faceMaterials[t] = vertexMaterials[lod.indices[3*t]];
+		if (SortTriangles(lod.indices, lod.triangleCount, faceMaterials, NULL, mMaterialCount,
+			mThreadCount, mScratch, mMesh, lod.ranges, lod.rangeCount) != 0)
+			return -1;
+	}
+	return 0;
+}
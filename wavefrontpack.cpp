@@ -0,0 +1,277 @@
+/*
+Compressed mesh files for the Wavefront loader
+
+A packed file holds the finished, unified buffers of a model coded with
+meshcodec, for archiving and shipping models rather than for the quick
+reopening the cache is for. Reading one decodes straight into the
+buffers of the model, then builds the levels of detail and meshlets the
+load options ask for.
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdint.h>
+#include <vector>
+
+#include "meshcodec.h"
+#include "parallel.h"
+#include "wavefrontloader.h"
+
+//bump whenever the layout or the coding of the streams changes
+static const uint32_t PACK_VERSION = 1;
+static const char PACK_MAGIC[8] = {'O', 'B', 'J', 'P', 'A', 'C', 'K', 0};
+
+//triangles coded independently of each other, so they decode in parallel
+static const long PACK_INDEX_SEGMENT = 1 << 16;
+
+enum PackFlags
+{
+	PACK_FLAG_TEXTURES = 1
+};
+
+enum PackStream
+{
+	PACK_VERTEX,
+	PACK_NORMAL,
+	PACK_TEXTURE,
+	PACK_INDEX,		// A uint32 size per segment, then the segments
+	PACK_STREAM_COUNT
+};
+
+struct OBJPackHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t flags;
+	int64_t vertexCount;
+	int64_t faceCount;
+
+	float scale;
+	float vmax[3];
+	float vmin[3];
+	float center[3];
+	float radius;
+	uint32_t reserved;
+
+	uint64_t sizes[PACK_STREAM_COUNT];	// The streams follow the header in this order
+};
+
+static long SegmentCount(long triangleCount)
+{
+	return (triangleCount + PACK_INDEX_SEGMENT - 1) / PACK_INDEX_SEGMENT;
+}
+
+//codes the segments into out after their size table, returns the stream size or 0
+static size_t EncodeSegments(std::vector<unsigned char> &out, const long* indices, long triangleCount,
+	long vertexCount, int threads)
+{
+	long segments = SegmentCount(triangleCount);
+	std::vector<std::vector<unsigned char> > coded(segments);
+	std::atomic<bool> bFailed(false);
+	size_t size = segments*sizeof(uint32_t);
+
+	ParallelFor(segments, threads, [&](long s)
+	{
+		long first = s*PACK_INDEX_SEGMENT;
+		long count = std::min(PACK_INDEX_SEGMENT, triangleCount - first);
+
+		coded[s].resize(IndexEncodeBound(count));
+		size_t written = EncodeIndexBuffer(coded[s].data(), coded[s].size(), indices + 3*first, count, vertexCount);
+		if (written == 0 && count > 0)
+			bFailed = true;
+		coded[s].resize(written);
+	});
+	if (bFailed)
+		return 0;
+
+	out.clear();
+	out.resize(size);
+	for (long s = 0; s < segments; ++s)
+	{
+		uint32_t segmentSize = (uint32_t) coded[s].size();
+		memcpy(out.data() + s*sizeof(uint32_t), &segmentSize, sizeof(segmentSize));
+		out.insert(out.end(), coded[s].begin(), coded[s].end());
+	}
+	return out.size();
+}
+
+static int DecodeSegments(long* indices, long triangleCount, long vertexCount, const unsigned char* data,
+	size_t size, int threads)
+{
+	long segments = SegmentCount(triangleCount);
+	std::vector<size_t> offsets(segments + 1);
+	std::atomic<bool> bDamaged(false);
+
+	if (size < segments*sizeof(uint32_t))
+		return -1;
+	offsets[0] = segments*sizeof(uint32_t);
+	for (long s = 0; s < segments; ++s)
+	{
+		uint32_t segmentSize;
+		memcpy(&segmentSize, data + s*sizeof(uint32_t), sizeof(segmentSize));
+		if (segmentSize > size - offsets[s])
+			return -1;
+		offsets[s + 1] = offsets[s] + segmentSize;
+	}
+	if (offsets[segments] != size)
+		return -1;
+
+	ParallelFor(segments, threads, [&](long s)
+	{
+		long first = s*PACK_INDEX_SEGMENT;
+		if (DecodeIndexBuffer(indices + 3*first, std::min(PACK_INDEX_SEGMENT, triangleCount - first), vertexCount,
+			data + offsets[s], offsets[s + 1] - offsets[s]) != 0)
+			bDamaged = true;
+	});
+	return bDamaged ? -1 : 0;
+}
+
+//writes the model, which must have been loaded with its vertices unified,
+//levels of detail and meshlets are not written
+int OBJClass::WritePacked(const wchar_t* fileName)
+{
+	OBJPackHeader header;
+	std::vector<unsigned char> streams[PACK_STREAM_COUNT];
+	const float* buffers[PACK_STREAM_COUNT - 1] = {mVertexBuffer, mNormalBuffer, mTextureBuffer};
+	static const int strides[PACK_STREAM_COUNT - 1] = {4*sizeof(float), 3*sizeof(float), 2*sizeof(float)};
+	FILE* file;
+	bool bWriteError = false;
+
+	if (mVertexBuffer == NULL || mNormalBuffer == NULL || mIndexBufferV == NULL ||
+		mIndexBufferN != NULL || mIndexBufferT != NULL || mNormalCount != mVertexCount)
+		return -1;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+	header.version = PACK_VERSION;
+	header.flags = mTextureBuffer ? PACK_FLAG_TEXTURES : 0;
+	header.vertexCount = mVertexCount;
+	header.faceCount = mFaceCount;
+	header.scale = mScale;
+	memcpy(header.vmax, mVmax, sizeof(mVmax));
+	memcpy(header.vmin, mVmin, sizeof(mVmin));
+	memcpy(header.center, mCenter, sizeof(mCenter));
+	header.radius = mRadius;
+
+	for (int i = 0; i < PACK_INDEX; ++i)
+	{
+		if (buffers[i] == NULL)
+			continue;
+		streams[i].resize(VertexEncodeBound(mVertexCount, strides[i]));
+		header.sizes[i] = EncodeVertexBuffer(streams[i].data(), streams[i].size(), buffers[i], mVertexCount, strides[i]);
+		if (header.sizes[i] == 0)
+			return -1;
+	}
+	header.sizes[PACK_INDEX] = EncodeSegments(streams[PACK_INDEX], mIndexBufferV, mFaceCount, mVertexCount, mThreadCount);
+	if (header.sizes[PACK_INDEX] == 0)
+		return -1;
+
+	file = OpenFile(fileName, "wb");
+	if (file == NULL)
+		return -1;
+	bWriteError |= fwrite(&header, sizeof(header), 1, file) != 1;
+	for (int i = 0; i < PACK_STREAM_COUNT && !bWriteError; ++i)
+		bWriteError |= header.sizes[i] > 0 && fwrite(streams[i].data(), (size_t) header.sizes[i], 1, file) != 1;
+	bWriteError |= fclose(file) != 0;
+
+	return bWriteError ? -1 : 0;
+}
+
+//decodes the streams into the mesh arena, the same buffers a parse ends with
+int OBJClass::ReadPacked(const wchar_t* fileName)
+{
+	MappedFile file;
+	OBJPackHeader header;
+	const unsigned char* streams[PACK_STREAM_COUNT];
+	uint64_t offset = sizeof(header);
+	bool bTextures;
+
+	Release();
+	mLoadStats.source = OBJ_SOURCE_PACKED;
+	if (file.Open(fileName) != 0)
+	{
+		std::cout << "ERROR OPENING PACKED FILE" << std::endl;
+		return FailLoad(OBJ_LOAD_OPEN_FAILED);
+	}
+	mLoadStats.bytesRead = file.GetSize();
+	if (file.GetSize() < sizeof(header))
+		return FailLoad(OBJ_LOAD_BAD_PACKED_FILE);
+	memcpy(&header, file.GetData(), sizeof(header));
+
+	if (memcmp(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0 || header.version != PACK_VERSION ||
+		header.vertexCount <= 0 || header.faceCount <= 0 || header.vertexCount > 0x7FFFFFFF ||
+		header.faceCount > 0x7FFFFFFF || header.sizes[PACK_VERTEX] == 0 || header.sizes[PACK_NORMAL] == 0 ||
+		(header.sizes[PACK_TEXTURE] != 0) != ((header.flags & PACK_FLAG_TEXTURES) != 0))
+	{
+		std::cout << "NOT A PACKED MODEL" << std::endl;
+		return FailLoad(OBJ_LOAD_BAD_PACKED_FILE);
+	}
+	for (int i = 0; i < PACK_STREAM_COUNT; ++i)
+	{
+		if (header.sizes[i] > file.GetSize() - offset)
+		{
+			std::cout << "PACKED FILE IS DAMAGED" << std::endl;
+			return FailLoad(OBJ_LOAD_BAD_PACKED_FILE);
+		}
+		streams[i] = (const unsigned char*) file.GetData() + offset;
+		offset += header.sizes[i];
+	}
+
+	bTextures = (header.flags & PACK_FLAG_TEXTURES) != 0;
+	mVertexCount = mNormalCount = (long) header.vertexCount;
+	mTexelCount = bTextures ? mVertexCount : 0;
+	mFaceCount = (long) header.faceCount;
+	if (ReserveMesh(mVertexCount, bTextures) != 0)
+		return FailLoad(OBJ_LOAD_OUT_OF_MEMORY);
+	mVertexBuffer = mMesh.Allocate<float>(mVertexCount*4);
+	mNormalBuffer = mMesh.Allocate<float>(mVertexCount*3);
+	mTextureBuffer = bTextures ? mMesh.Allocate<float>(mVertexCount*2) : NULL;
+	mIndexBufferV = mMesh.Allocate<long>(mFaceCount*3);
+
+	if (DecodeVertexBuffer(mVertexBuffer, mVertexCount, 4*sizeof(float), streams[PACK_VERTEX],
+		(size_t) header.sizes[PACK_VERTEX], mThreadCount) != 0 ||
+		DecodeVertexBuffer(mNormalBuffer, mVertexCount, 3*sizeof(float), streams[PACK_NORMAL],
+		(size_t) header.sizes[PACK_NORMAL], mThreadCount) != 0 ||
+		(bTextures && DecodeVertexBuffer(mTextureBuffer, mVertexCount, 2*sizeof(float), streams[PACK_TEXTURE],
+		(size_t) header.sizes[PACK_TEXTURE], mThreadCount) != 0) ||
+		DecodeSegments(mIndexBufferV, mFaceCount, mVertexCount, streams[PACK_INDEX],
+		(size_t) header.sizes[PACK_INDEX], mThreadCount) != 0)
+	{
+		std::cout << "PACKED FILE IS DAMAGED" << std::endl;
+		Release();
+		return FailLoad(OBJ_LOAD_BAD_PACKED_FILE);
+	}
+
+	mTotalConnectTriangles = mFaceCount*3;
+	mScale = header.scale;
+	memcpy(mVmax, header.vmax, sizeof(mVmax));
+	memcpy(mVmin, header.vmin, sizeof(mVmin));
+	memcpy(mCenter, header.center, sizeof(mCenter));
+	mRadius = header.radius;
+
+	mLevels[0].indices = mIndexBufferV;
+	mLevels[0].triangleCount = mFaceCount;
+	mLevels[0].error = 0.0f;
+	mLevels[0].ranges = NULL;
+	mLevels[0].rangeCount = 0;
+	mLevelCount = 1;
+	if ((mbBuildLevels && BuildLevels() != 0) || (mbBuildMeshlets && BuildMeshlets() != 0))
+	{
+		Release();
+		return FailLoad(OBJ_LOAD_OUT_OF_MEMORY);
+	}
+	mLoadStats.peakBytes = mMesh.GetPeak() + mScratch.GetPeak();
+	mScratch.Reset();
+	return 0;
+}
@@ -0,0 +1,395 @@
+/*
+Scene of many Wavefront models sharing one vertex and index pool, with
+every model placed any number of times as instances
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <vector>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "mappedfile.h"
+#include "objparser.h"
+#include "wavefrontscene.h"
+
+static std::string NarrowPath(const std::wstring &path)
+{
+	std::vector<char> narrow(path.size()*MB_CUR_MAX + 1);
+
+	if (wcstombs(narrow.data(), path.c_str(), narrow.size()) == (size_t) -1)
+		return "?";
+	return narrow.data();
+}
+
+//hashes a whole file, equal hashes are still compared byte by byte, returns 0 or -1
+static int HashFile(const wchar_t* fileName, unsigned long long &hash)
+{
+	MappedFile file;
+
+	if (file.Open(fileName) != 0)
+		return -1;
+	hash = OBJParser::HashBytes(file.GetData(), file.GetSize());
+	return 0;
+}
+
+//whether two files have the same bytes
+static bool SameFiles(const wchar_t* first, const wchar_t* second)
+{
+	MappedFile a, b;
+
+	if (a.Open(first) != 0 || b.Open(second) != 0 || a.GetSize() != b.GetSize())
+		return false;
+	return a.GetSize() == 0 || memcmp(a.GetData(), b.GetData(), a.GetSize()) == 0;
+}
+
+//column major transform scaling, then turning about x, y and z, then moving
+static void ComposeTransform(const float* values, float* transform)
+{
+	float radians[3], c[3], s[3];
+	float rotation[9];
+
+	for (int i = 0; i < 3; ++i)
+	{
+		radians[i] = values[3 + i]*3.14159265f/180.0f;
+		c[i] = cosf(radians[i]);
+		s[i] = sinf(radians[i]);
+	}
+	//rows of Rz Ry Rx
+	rotation[0] = c[2]*c[1];
+	rotation[1] = c[2]*s[1]*s[0] - s[2]*c[0];
+	rotation[2] = c[2]*s[1]*c[0] + s[2]*s[0];
+	rotation[3] = s[2]*c[1];
+	rotation[4] = s[2]*s[1]*s[0] + c[2]*c[0];
+	rotation[5] = s[2]*s[1]*c[0] - c[2]*s[0];
+	rotation[6] = -s[1];
+	rotation[7] = c[1]*s[0];
+	rotation[8] = c[1]*c[0];
+
+	for (int column = 0; column < 3; ++column)
+	{
+		for (int row = 0; row < 3; ++row)
+			transform[4*column + row] = rotation[3*row + column]*values[6];
+		transform[4*column + 3] = 0.0f;
+		transform[12 + column] = values[column];
+	}
+	transform[15] = 1.0f;
+}
+
+bool IsSceneFile(const wchar_t* fileName)
+{
+	size_t nameLength = wcslen(fileName);
+	return nameLength > 9 && wcscmp(fileName + nameLength - 9, L".objscene") == 0;
+}
+
+OBJScene::OBJScene()
+{
+	mLoader.SetOptimizeVertexCache(true);
+	mLoader.SetKeepScratch(true);
+	mbCancelled = false;
+	mProgress = 0.0f;
+	Release();
+}
+
+void OBJScene::Cancel()
+{
+	mbCancelled = true;
+	mLoader.Cancel();
+}
+
+void OBJScene::Release()
+{
+	OBJMaterial white = OBJMaterial();
+
+	//shrink_to_fit so a released scene gives its pools back
+	mPositions.clear();
+	mPositions.shrink_to_fit();
+	mNormals.clear();
+	mNormals.shrink_to_fit();
+	mIndices.clear();
+	mIndices.shrink_to_fit();
+	mRanges.clear();
+	mMeshes.clear();
+	mMeshesByName.clear();
+	mLoader.Release();
+	mStats = OBJSceneStats();
+
+	for (int i = 0; i < 3; ++i)
+		white.ambient[i] = 0.2f;
+	white.diffuse[0] = white.diffuse[1] = white.diffuse[2] = 1.0f;
+	white.opacity = 1.0f;
+	mMaterials.assign(1, white);
+
+	for (int i = 0; i < 3; ++i)
+	{
+		mVmin[i] = mVmax[i] = mCenter[i] = 0.0f;
+	}
+	mRadius = 0.0f;
+	mScale = 1.0f;
+}
+
+//the mesh of a file with the same bytes, or -1, only files of the same size are read
+int OBJScene::FindCopy(const wchar_t* fileName, unsigned long long size)
+{
+	unsigned long long hash = 0;
+	bool bHashed = false;
+
+	for (size_t m = 0; m < mMeshes.size(); ++m)
+	{
+		OBJSceneMesh &mesh = mMeshes[m];
+
+		if (mesh.fileSize != size)
+			continue;
+		if (!bHashed && HashFile(fileName, hash) != 0)
+			return -1;
+		bHashed = true;
+		if (!mesh.bHashed && HashFile(mesh.fileName.c_str(), mesh.contentHash) != 0)
+			continue;
+		mesh.bHashed = true;
+		if (mesh.contentHash == hash && SameFiles(fileName, mesh.fileName.c_str()))
+			return (int) m;
+	}
+	return -1;
+}
+
+//whether two materials draw the same, whatever their names
+static bool SameAppearance(const OBJMaterial &a, const OBJMaterial &b)
+{
+	return memcmp(a.ambient, b.ambient, sizeof(a.ambient)) == 0 && memcmp(a.diffuse, b.diffuse, sizeof(a.diffuse)) == 0 &&
+		memcmp(a.specular, b.specular, sizeof(a.specular)) == 0 && a.shininess == b.shininess && a.opacity == b.opacity;
+}
+
+//loads a file and appends its level 0 to the pools, returns the mesh or -1
+int OBJScene::AppendMesh(const wchar_t* fileName, unsigned long long size)
+{
+	OBJSceneMesh mesh;
+	long materialBase = (long) mMaterials.size();
+
+	mesh.fileName = fileName;
+	if (mLoader.Load(&mesh.fileName[0]) != 0)
+	{
+		std::cout << "Could not load " << NarrowPath(fileName) << ": " << GetLoadErrorText(mLoader.GetLoadStats().error) << std::endl;
+		return -1;
+	}
+	const OBJLevelOfDetail &lod = mLoader.GetLevel(0);
+	const float* positions = mLoader.GetVertexBuffer();
+
+	mesh.fileSize = size;
+	mesh.contentHash = 0;
+	mesh.bHashed = false;
+	mesh.firstVertex = (long)(mPositions.size() / 4);
+	mesh.vertexCount = mLoader.GetVertexCount();
+	mesh.firstTriangle = (long)(mIndices.size() / 3);
+	mesh.triangleCount = lod.triangleCount;
+	mesh.firstRange = (long) mRanges.size();
+	for (int i = 0; i < 3; ++i)
+	{
+		mesh.vmin[i] = mLoader.GetBoundsMin()[i];
+		mesh.vmax[i] = mLoader.GetBoundsMax()[i];
+	}
+
+	//positions keep their model units with w = 1, the loader's w is its own scale
+	mPositions.resize(mPositions.size() + mesh.vertexCount*4);
+	mNormals.resize(mNormals.size() + mesh.vertexCount*3, 0.0f);
+	float* to = &mPositions[mesh.firstVertex*4];
+	for (long v = 0; v < mesh.vertexCount; ++v)
+	{
+		to[4*v] = positions[4*v];
+		to[4*v + 1] = positions[4*v + 1];
+		to[4*v + 2] = positions[4*v + 2];
+		to[4*v + 3] = 1.0f;
+	}
+	if (mLoader.HasNormals() && mesh.vertexCount > 0)
+		memcpy(&mNormals[mesh.firstVertex*3], mLoader.GetNormalBuffer(), mesh.vertexCount*3*sizeof(float));
+
+	mIndices.resize(mIndices.size() + lod.triangleCount*3);
+	long* indices = &mIndices[mesh.firstTriangle*3];
+	for (long i = 0; i < lod.triangleCount*3; ++i)
+		indices[i] = lod.indices[i] + mesh.firstVertex;
+
+	//files without materials draw in the scene's white
+	for (int m = 0; m < mLoader.GetMaterialCount(); ++m)
+		mMaterials.push_back(mLoader.GetMaterial(m));
+	if (lod.ranges == NULL)
+	{
+		OBJMaterialRange whole = {mesh.firstTriangle, lod.triangleCount, 0};
+		mRanges.push_back(whole);
+	}
+	//neighbouring ranges that draw the same become one, so an instance needs one call for them
+	for (long r = 0; lod.ranges != NULL && r < lod.rangeCount; ++r)
+	{
+		OBJMaterialRange range = lod.ranges[r];
+		range.firstTriangle += mesh.firstTriangle;
+		range.material += (int) materialBase;
+		OBJMaterialRange* last = (long) mRanges.size() > mesh.firstRange ? &mRanges.back() : NULL;
+		if (last != NULL && last->firstTriangle + last->triangleCount == range.firstTriangle &&
+			(last->material == range.material || SameAppearance(mMaterials[last->material], mMaterials[range.material])))
+			last->triangleCount += range.triangleCount;
+		else
+			mRanges.push_back(range);
+	}
+	mesh.rangeCount = (long) mRanges.size() - mesh.firstRange;
+
+	mMeshes.push_back(mesh);
+	mStats.meshCount = (long) mMeshes.size();
+	mStats.uniqueTriangles += lod.triangleCount;
+	mStats.poolBytes = mPositions.size()*sizeof(float) + mNormals.size()*sizeof(float) + mIndices.size()*sizeof(long);
+	return (int) mMeshes.size() - 1;
+}
+
+int OBJScene::AddMesh(const wchar_t* fileName)
+{
+	unsigned long long size, modified;
+	int mesh;
+
+	auto found = mMeshesByName.find(fileName);
+	if (found != mMeshesByName.end())
+		return found->second;
+	++mStats.fileCount;
+	if (GetFileStamp(fileName, size, modified) != 0)
+	{
+		std::cout << "Could not open " << NarrowPath(fileName) << std::endl;
+		return -1;
+	}
+
+	mesh = FindCopy(fileName, size);
+	if (mesh < 0)
+		mesh = AppendMesh(fileName, size);
+	if (mesh >= 0)
+		mMeshesByName[fileName] = mesh;
+	return mesh;
+}
+
+int OBJScene::AddInstance(int mesh, const float* transform)
+{
+	if (mesh < 0 || mesh >= (int) mMeshes.size())
+		return -1;
+	OBJSceneMesh &placed = mMeshes[mesh];
+
+	placed.transforms.insert(placed.transforms.end(), transform, transform + 16);
+	++mStats.instanceCount;
+	mStats.drawnTriangles += placed.triangleCount;
+	mStats.drawCalls += placed.rangeCount;
+	mStats.instanceBytes += 16*sizeof(float);
+
+	//the corners of the mesh's box moved into the scene grow its bounds
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		float point[3];
+		for (int i = 0; i < 3; ++i)
+			point[i] = (corner >> i) & 1 ? placed.vmax[i] : placed.vmin[i];
+		for (int row = 0; row < 3; ++row)
+		{
+			float value = transform[12 + row];
+			for (int column = 0; column < 3; ++column)
+				value += transform[4*column + row]*point[column];
+			mVmin[row] = mStats.instanceCount == 1 && corner == 0 ? value : std::min(mVmin[row], value);
+			mVmax[row] = mStats.instanceCount == 1 && corner == 0 ? value : std::max(mVmax[row], value);
+		}
+	}
+
+	//the scale follows OBJClass::CalcScale, so a scene fills the view like a model
+	float diagonal = 0.0f;
+	for (int i = 0; i < 3; ++i)
+	{
+		mCenter[i] = (mVmin[i] + mVmax[i])*0.5f;
+		diagonal += (mVmax[i] - mVmin[i])*(mVmax[i] - mVmin[i]);
+	}
+	diagonal = sqrtf(diagonal);
+	mRadius = diagonal*0.5f;
+	mScale = diagonal > 0.0f ? diagonal/7.2f : 1.0f;
+	return 0;
+}
+
+int OBJScene::Load(const wchar_t* fileName)
+{
+	MappedFile file;
+	std::wstring directory = GetDirectoryOf(fileName);
+	const char *p, *end;
+	long line = 0;
+
+	Release();
+	mProgress = 0.0f;
+	if (file.Open(fileName) != 0)
+	{
+		std::cout << "Could not open the scene " << NarrowPath(fileName) << std::endl;
+		return -1;
+	}
+	p = file.GetData();
+	end = p + file.GetSize();
+	while (p < end && !mbCancelled)
+	{
+		const char* lineEnd = OBJParser::FindLineEnd(p, end);
+		const char* nameEnd = lineEnd;
+		float values[7];
+		float transform[16];
+		int count = 0;
+
+		++line;
+		mProgress.store((float)(p - file.GetData()) / file.GetSize(), std::memory_order_relaxed);
+		p = OBJParser::SkipBlanks(p, lineEnd);
+		if (p == lineEnd || *p == '#')
+		{
+			p = lineEnd + 1;
+			continue;
+		}
+
+		//the keyword, seven numbers and the rest of the line as the file name
+		const char* next = OBJParser::SkipToken(p, lineEnd);
+		bool bInstance = next - p == 8 && memcmp(p, "instance", 8) == 0;
+		for (p = next; bInstance && count < 7; ++count)
+		{
+			p = OBJParser::SkipBlanks(p, lineEnd);
+			next = OBJParser::ParseFloat(p, lineEnd, values[count]);
+			if (next == p)
+				break;
+			p = next;
+		}
+		p = OBJParser::SkipBlanks(p, lineEnd);
+		while (nameEnd > p && OBJParser::IsBlank(nameEnd[-1]))
+			--nameEnd;
+		if (!bInstance || count < 7 || p == nameEnd)
+		{
+			std::cout << "Line " << line << " of the scene is not \"instance x y z rx ry rz scale file\"" << std::endl;
+			p = lineEnd + 1;
+			continue;
+		}
+
+		std::string name(p, nameEnd);
+		std::vector<wchar_t> wide(name.size() + 1);
+		p = lineEnd + 1;
+		if (mbstowcs(wide.data(), name.c_str(), wide.size()) == (size_t) -1)
+			continue;
+
+		//names starting at a root or a drive stay as they are
+		bool bAbsolute = wide[0] == L'/' || wide[0] == L'\\' || (name.size() > 1 && wide[1] == L':');
+		int mesh = AddMesh(bAbsolute ? wide.data() : (directory + wide.data()).c_str());
+		ComposeTransform(values, transform);
+		AddInstance(mesh, transform);
+	}
+
+	//the pools hold everything, the loader's buffers are not needed any more
+	mLoader.Release();
+	mLoader.ReleaseScratch();
+	mProgress = 1.0f;
+	if (mbCancelled)
+	{
+		//a cancel after the last file would otherwise stop the loader's next load
+		mbCancelled = false;
+		mLoader.Cancel(false);
+		Release();
+		return -1;
+	}
+	return IsEmpty() ? -1 : 0;
+}
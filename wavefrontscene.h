@@ -0,0 +1,123 @@
+/*
+Scene of many Wavefront models sharing one vertex and index pool, with
+every model placed any number of times as instances
+
+THE PROGRAM IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+IN THE SOFTWARE.
+*/
+
+#ifndef WAVEFRONTSCENE_H
+#define WAVEFRONTSCENE_H
+
+#include <atomic>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "wavefrontloader.h"
+
+//one file's geometry inside the pools, loaded once however often it is placed
+struct OBJSceneMesh
+{
+	std::wstring fileName;		// The first name it was added by
+	unsigned long long fileSize;
+	unsigned long long contentHash;	// Of the file's bytes, only made when another file has the same size
+	bool bHashed;
+	long firstVertex;			// In the pools, the indices already count from the start of the pools
+	long vertexCount;
+	long firstTriangle;
+	long triangleCount;
+	long firstRange;			// Of the scene's material ranges, at least one per mesh, neighbours draw differently
+	long rangeCount;
+	float vmin[3];				// Bounds in model units
+	float vmax[3];
+	std::vector<float> transforms;	// 16 per instance, column major as glMultMatrixf takes them
+};
+
+//counts of the scene as loaded and as drawn
+struct OBJSceneStats
+{
+	long fileCount;			// Distinct file names added, including the ones found to be copies
+	long meshCount;			// Distinct geometry kept in the pools
+	long instanceCount;
+	long long uniqueTriangles;
+	long long drawnTriangles;	// Of every instance
+	long drawCalls;			// A frame needs one per material range of every instance, rangeCount per instance of a mesh
+	size_t poolBytes;
+	size_t instanceBytes;
+};
+
+class OBJScene
+{
+  private:
+	std::vector<float> mPositions;		// x, y, z and 1 per vertex, in the model units of each file
+	std::vector<float> mNormals;		// 3 per vertex
+	std::vector<long> mIndices;			// 3 per triangle, counting from the start of mPositions
+	std::vector<OBJMaterial> mMaterials;	// The first is the white of files without materials
+	std::vector<OBJMaterialRange> mRanges;	// Triangles from the start of mIndices, materials of mMaterials
+	std::vector<OBJSceneMesh> mMeshes;
+	std::unordered_map<std::wstring, int> mMeshesByName;
+	OBJClass mLoader;		// Loads every file in turn, its arenas kept between them
+	OBJSceneStats mStats;
+	std::atomic<bool> mbCancelled;	// Set by Cancel from any thread, cleared when a load ends
+	std::atomic<float> mProgress;	// Through the scene file of the load running
+
+	float mVmin[3];			// Bounds of every instance, in scene units
+	float mVmax[3];
+	float mCenter[3];
+	float mRadius;
+	float mScale;			// Scene units per drawing unit, as OBJClass::GetScale for a model
+
+	int FindCopy(const wchar_t* fileName, unsigned long long size);
+	int AppendMesh(const wchar_t* fileName, unsigned long long size);
+
+	OBJScene(const OBJScene&) = delete;
+	OBJScene& operator=(const OBJScene&) = delete;
+
+ public:
+	OBJScene();
+
+	//reads a scene file, every line "instance x y z rx ry rz scale file"
+	//places the file at x, y, z, turned by rx, ry and rz degrees about the
+	//x, y and z axes in that order after scaling, file names are relative to
+	//the scene file and # starts a comment, returns 0 or -1
+	int Load(const wchar_t* fileName);
+	void Release();
+	//stops the load running, or the next one, with the file being loaded, safe to call from any thread
+	void Cancel();
+	inline float GetLoadProgress(){return mProgress.load(std::memory_order_relaxed);};	// 0 to 1, from any thread
+
+	//loads a file into the pools unless it or a file with the same bytes is
+	//there already, returns the mesh or -1
+	int AddMesh(const wchar_t* fileName);
+	//places a mesh with a column major 4x4 transform from its model units to scene units, returns 0 or -1
+	int AddInstance(int mesh, const float* transform);
+
+	inline void SetUseCache(bool bUseCache){mLoader.SetUseCache(bUseCache);};
+	inline void SetThreadCount(int threads){mLoader.SetThreadCount(threads);};
+
+	inline bool IsEmpty() const {return mStats.instanceCount == 0;};
+	inline const float* GetPositions() const {return mPositions.data();};
+	inline const float* GetNormals() const {return mNormals.data();};
+	inline const long* GetIndices() const {return mIndices.data();};
+	inline long GetMeshCount() const {return (long) mMeshes.size();};
+	inline const OBJSceneMesh& GetMesh(int mesh) const {return mMeshes[mesh];};
+	inline const OBJMaterialRange* GetRanges() const {return mRanges.data();};
+	inline const OBJMaterial& GetMaterial(int material) const {return mMaterials[material];};
+	inline const OBJSceneStats& GetStats() const {return mStats;};
+	inline const float* GetBoundsMin() const {return mVmin;};
+	inline const float* GetBoundsMax() const {return mVmax;};
+	inline const float* GetCenter() const {return mCenter;};
+	inline float GetRadius() const {return mRadius;};
+	inline float GetScale() const {return mScale;};
+};
+
+//whether a file name ends in .objscene, which Load reads
+bool IsSceneFile(const wchar_t* fileName);
+
+#endif